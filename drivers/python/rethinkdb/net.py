@@ -620,6 +620,19 @@ class Connection(object):
         q = Query(pQuery.SERVER_INFO, self._new_token(), None, None)
         return self._instance.run_query(q, False)
 
+    def prepare(self, func):
+        self.check_open()
+        q = Query(pQuery.PREPARE, self._new_token(), expr(func), None)
+        return self._instance.run_query(q, False)
+
+    def execute(self, prepared_id, *args, **global_optargs):
+        self.check_open()
+        if 'db' in global_optargs or self.db is not None:
+            global_optargs['db'] = DB(global_optargs.get('db', self.db))
+        q = Query(pQuery.EXECUTE, self._new_token(),
+                  expr([prepared_id] + list(args)), global_optargs)
+        return self._instance.run_query(q, global_optargs.get('noreply', False))
+
     def _new_token(self):
         res = self._next_token
         self._next_token += 1
@@ -22,6 +22,7 @@
 #include "arch/runtime/runtime.hpp"
 #include "arch/io/disk/filestat.hpp"
 #include "arch/io/disk/pool.hpp"
+#include "arch/io/disk/uring.hpp"
 #include "arch/io/disk/conflict_resolving.hpp"
 #include "arch/io/disk/stats.hpp"
 #include "arch/io/disk/accounting.hpp"
@@ -50,14 +51,43 @@ public:
     linux_disk_manager_t(linux_event_queue_t *queue,
                          int batch_factor,
                          int max_concurrent_io_requests,
+                         disk_io_backend_t io_backend,
                          perfmon_collection_t *stats) :
         stack_stats(stats, "stack"),
         conflict_resolver(stats),
         accounter(batch_factor),
         backend_stats(stats, "backend", accounter.producer),
-        backend(queue, backend_stats.producer, max_concurrent_io_requests),
         outstanding_txn(0)
     {
+        /* Set up the backend that pops operations off the accounting queue and hands
+        them to the OS. */
+        if (io_backend == disk_io_backend_t::uring) {
+#if USE_IO_URING
+            scoped_ptr_t<linux_io_uring_t> ring(new linux_io_uring_t());
+            int res = ring->init(std::min(max_concurrent_io_requests * 2,
+                                          URING_MAX_ENTRIES));
+            if (res == 0) {
+                uring_backend.init(new uring_diskmgr_t(queue, backend_stats.producer,
+                                                       max_concurrent_io_requests,
+                                                       std::move(ring)));
+                uring_backend->done_fun = std::bind(&stats_diskmgr_2_t::done,
+                                                    &backend_stats, ph::_1);
+            } else {
+                logWRN("Could not set up io_uring (%s). Falling back to the "
+                       "thread pool for disk I/O.", errno_string(res).c_str());
+            }
+#else
+            logWRN("This build of RethinkDB does not support io_uring. Falling back "
+                   "to the thread pool for disk I/O.");
+#endif
+        }
+        if (!uring_backend.has()) {
+            pool_backend.init(new pool_diskmgr_t(queue, backend_stats.producer,
+                                                 max_concurrent_io_requests));
+            pool_backend->done_fun = std::bind(&stats_diskmgr_2_t::done,
+                                               &backend_stats, ph::_1);
+        }
+
         /* Hook up the `submit_fun`s of the parts of the IO stack that are above the
         queue. (The parts below the queue use the `passive_producer_t` interface instead
         of a callback function.) */
@@ -66,8 +96,7 @@ public:
         conflict_resolver.submit_fun = std::bind(&accounting_diskmgr_t::submit,
                                                  &accounter, ph::_1);
 
-        /* Hook up everything's `done_fun`. */
-        backend.done_fun = std::bind(&stats_diskmgr_2_t::done, &backend_stats, ph::_1);
+        /* Hook up everything's `done_fun`. (The backend's was set above.) */
         backend_stats.done_fun = std::bind(&accounting_diskmgr_t::done, &accounter, ph::_1);
         accounter.done_fun = std::bind(&conflict_resolving_diskmgr_t::done,
                                        &conflict_resolver, ph::_1);
@@ -180,7 +209,8 @@ private:
     holding back operations that must be run after other, currently-running, operations.
     Then it goes to the account manager, which queues up running IO operations according
     to which account they are part of. Finally the "backend" pops the IO operations
-    from the queue.
+    from the queue. Exactly one of `pool_backend` (blocking syscalls on a thread pool)
+    and `uring_backend` (io_uring, driven from this thread) is set up.
 
     At two points in the process--once as soon as it is submitted, and again right
     as the backend pops it off the queue--its statistics are recorded. The "stack stats"
@@ -193,7 +223,13 @@ private:
     conflict_resolving_diskmgr_t conflict_resolver;
     accounting_diskmgr_t accounter;
     stats_diskmgr_2_t backend_stats;
-    pool_diskmgr_t backend;
+    scoped_ptr_t<pool_diskmgr_t> pool_backend;
+#if USE_IO_URING
+    scoped_ptr_t<uring_diskmgr_t> uring_backend;
+#else
+    // Never set; keeps the backend selection logic free of `#if`s.
+    scoped_ptr_t<pool_diskmgr_t> uring_backend;
+#endif
 
 
     intptr_t outstanding_txn;
@@ -202,11 +238,13 @@ private:
 };
 
 io_backender_t::io_backender_t(file_direct_io_mode_t _direct_io_mode,
-                               int max_concurrent_io_requests)
+                               int max_concurrent_io_requests,
+                               disk_io_backend_t io_backend)
     : direct_io_mode(_direct_io_mode),
       diskmgr(new linux_disk_manager_t(&linux_thread_pool_t::get_thread()->queue,
                                        DEFAULT_IO_BATCH_FACTOR,
                                        max_concurrent_io_requests,
+                                       io_backend,
                                        &stats)) { }
 
 io_backender_t::~io_backender_t() { }
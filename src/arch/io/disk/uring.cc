@@ -0,0 +1,372 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "arch/io/disk/uring.hpp"
+
+#if USE_IO_URING
+
+#include <errno.h>
+#include <limits.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "logger.hpp"
+
+namespace {
+
+int sys_io_uring_setup(unsigned int entries, io_uring_params *p) {
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+int sys_io_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete,
+                       unsigned int flags) {
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                   nullptr, 0);
+}
+
+int sys_io_uring_register(int fd, unsigned int opcode, void *arg,
+                          unsigned int nr_args) {
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+template <class T>
+T *ring_field(void *ring_ptr, uint32_t offset) {
+    return reinterpret_cast<T *>(static_cast<char *>(ring_ptr) + offset);
+}
+
+int uring_queue_depth(int max_concurrent_io_requests, const linux_io_uring_t *ring) {
+    // Like the pool backend, we keep up to twice `max_concurrent_io_requests`
+    // requests in flight. We must not have more requests in flight than we can fit
+    // into the submission queue, or we might not be able to resubmit the remainder
+    // of a short read or write.
+    return std::min<int>(max_concurrent_io_requests * 2, ring->get_sq_entries());
+}
+
+}  // namespace
+
+linux_io_uring_t::linux_io_uring_t()
+    : ring_fd(-1),
+      sq_ring_ptr(MAP_FAILED), sq_ring_size(0),
+      cq_ring_ptr(MAP_FAILED), cq_ring_size(0),
+      sqes(nullptr), sqes_size(0),
+      sq_entries(0), sq_head(nullptr), sq_tail(nullptr), sq_mask(nullptr),
+      sq_array(nullptr), sq_local_tail(0), sq_to_submit(0),
+      cq_head(nullptr), cq_tail(nullptr), cq_mask(nullptr), cqes(nullptr) { }
+
+linux_io_uring_t::~linux_io_uring_t() {
+    teardown();
+}
+
+void linux_io_uring_t::teardown() {
+    if (sqes != nullptr) {
+        munmap(sqes, sqes_size);
+        sqes = nullptr;
+    }
+    if (cq_ring_ptr != MAP_FAILED && cq_ring_ptr != sq_ring_ptr) {
+        munmap(cq_ring_ptr, cq_ring_size);
+    }
+    cq_ring_ptr = MAP_FAILED;
+    if (sq_ring_ptr != MAP_FAILED) {
+        munmap(sq_ring_ptr, sq_ring_size);
+        sq_ring_ptr = MAP_FAILED;
+    }
+    if (ring_fd != -1) {
+        close(ring_fd);
+        ring_fd = -1;
+    }
+}
+
+int linux_io_uring_t::init(unsigned int entries) {
+    guarantee(ring_fd == -1);
+    guarantee(entries > 0);
+
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd = sys_io_uring_setup(entries, &params);
+    if (ring_fd < 0) {
+        ring_fd = -1;
+        return get_errno();
+    }
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+
+    sq_ring_ptr = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring_ptr == MAP_FAILED) {
+        int errsv = get_errno();
+        teardown();
+        return errsv;
+    }
+    if (single_mmap) {
+        cq_ring_ptr = sq_ring_ptr;
+    } else {
+        cq_ring_ptr = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ring_ptr == MAP_FAILED) {
+            int errsv = get_errno();
+            teardown();
+            return errsv;
+        }
+    }
+
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes_ptr = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqes_ptr == MAP_FAILED) {
+        int errsv = get_errno();
+        teardown();
+        return errsv;
+    }
+    sqes = static_cast<io_uring_sqe *>(sqes_ptr);
+
+    sq_entries = params.sq_entries;
+    sq_head = ring_field<unsigned int>(sq_ring_ptr, params.sq_off.head);
+    sq_tail = ring_field<unsigned int>(sq_ring_ptr, params.sq_off.tail);
+    sq_mask = ring_field<unsigned int>(sq_ring_ptr, params.sq_off.ring_mask);
+    sq_array = ring_field<unsigned int>(sq_ring_ptr, params.sq_off.array);
+    sq_local_tail = *sq_tail;
+    sq_to_submit = 0;
+
+    cq_head = ring_field<unsigned int>(cq_ring_ptr, params.cq_off.head);
+    cq_tail = ring_field<unsigned int>(cq_ring_ptr, params.cq_off.tail);
+    cq_mask = ring_field<unsigned int>(cq_ring_ptr, params.cq_off.ring_mask);
+    cqes = ring_field<io_uring_cqe>(cq_ring_ptr, params.cq_off.cqes);
+
+    return 0;
+}
+
+int linux_io_uring_t::register_eventfd(fd_t event_fd) {
+    guarantee(ring_fd != -1);
+    int res = sys_io_uring_register(ring_fd, IORING_REGISTER_EVENTFD, &event_fd, 1);
+    return res == 0 ? 0 : get_errno();
+}
+
+io_uring_sqe *linux_io_uring_t::get_sqe() {
+    // The kernel advances `sq_head` once it has consumed an entry.
+    const unsigned int head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (sq_local_tail - head >= sq_entries) {
+        return nullptr;
+    }
+    const unsigned int index = sq_local_tail & *sq_mask;
+    io_uring_sqe *sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array[index] = index;
+    ++sq_local_tail;
+    ++sq_to_submit;
+    return sqe;
+}
+
+int linux_io_uring_t::submit() {
+    if (sq_to_submit == 0) {
+        return 0;
+    }
+    // Publish the new entries before telling the kernel about them.
+    __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+    int res;
+    do {
+        res = sys_io_uring_enter(ring_fd, sq_to_submit, 0, 0);
+    } while (res == -1 && get_errno() == EINTR);
+    if (res < 0) {
+        return -get_errno();
+    }
+    rassert(static_cast<unsigned int>(res) <= sq_to_submit);
+    sq_to_submit -= res;
+    return res;
+}
+
+void linux_io_uring_t::reap_completions(
+        const std::function<void(io_uring_cqe *)> &fun) {
+    unsigned int head = *cq_head;
+    const unsigned int tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        fun(&cqes[head & *cq_mask]);
+        ++head;
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+}
+
+uring_diskmgr_t::uring_diskmgr_t(linux_event_queue_t *_queue,
+                                 passive_producer_t<action_t *> *_source,
+                                 int max_concurrent_io_requests,
+                                 scoped_ptr_t<linux_io_uring_t> &&_ring)
+    : queue(_queue),
+      queue_depth(uring_queue_depth(max_concurrent_io_requests, _ring.get())),
+      source(_source),
+      ring(std::move(_ring)),
+      retry_timer(nullptr),
+      requests(queue_depth),
+      n_pending(0),
+      fallback_queue(),
+      fallback_pool(_queue, &fallback_queue,
+                    std::min(max_concurrent_io_requests, URING_FALLBACK_POOL_THREADS)) {
+    guarantee(queue_depth > 0);
+    free_requests.reserve(queue_depth);
+    for (size_t i = 0; i < requests.size(); ++i) {
+        free_requests.push_back(&requests[i]);
+    }
+
+    int res = ring->register_eventfd(completion_event.get_notify_fd());
+    guarantee_xerr(res == 0, res, "Could not register an eventfd with io_uring");
+    queue->watch_event(&completion_event, this);
+
+    fallback_pool.done_fun = [this](action_t *a) { done_fun(a); };
+
+    if (source->available->get()) { pump(); }
+    source->available->set_callback(this);
+}
+
+uring_diskmgr_t::~uring_diskmgr_t() {
+    assert_thread();
+    rassert(n_pending == 0, "Destroying the io_uring disk manager with %d outstanding "
+            "requests", n_pending);
+    if (retry_timer != nullptr) {
+        cancel_timer(retry_timer);
+    }
+    source->available->unset_callback();
+    queue->forget_event(&completion_event, this);
+}
+
+void uring_diskmgr_t::on_source_availability_changed() {
+    assert_thread();
+    if (source->available->get()) pump();
+}
+
+void uring_diskmgr_t::pump() {
+    assert_thread();
+    while (source->available->get() && !free_requests.empty()) {
+        action_t *a = source->pop();
+
+        // io_uring can't truncate files, and there's no point in chaining datasyncs
+        // around the few writes that need them.
+        if (a->get_is_resize() || a->wrap_in_datasyncs) {
+            fallback_queue.push(a);
+            continue;
+        }
+
+        request_t *req = free_requests.back();
+        free_requests.pop_back();
+        ++n_pending;
+
+        req->action = a;
+        a->copy_vectors(&req->vecs);
+        req->remaining_vecs = req->vecs.data();
+        req->remaining_vecs_len = req->vecs.size();
+        req->bytes_done = 0;
+        req->total_bytes = 0;
+        for (size_t i = 0; i < req->vecs.size(); ++i) {
+            req->total_bytes += req->vecs[i].iov_len;
+        }
+        prepare(req);
+    }
+    flush_submissions();
+}
+
+void uring_diskmgr_t::prepare(request_t *req) {
+    io_uring_sqe *sqe = ring->get_sqe();
+    // We never have more requests in flight than there are submission queue entries.
+    guarantee(sqe != nullptr);
+    sqe->opcode = req->action->get_is_read() ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe->fd = req->action->get_fd();
+    sqe->off = req->action->get_offset() + req->bytes_done;
+    sqe->addr = reinterpret_cast<uint64_t>(req->remaining_vecs);
+    sqe->len = std::min<size_t>(req->remaining_vecs_len, IOV_MAX);
+    sqe->user_data = reinterpret_cast<uint64_t>(req);
+}
+
+void uring_diskmgr_t::flush_submissions() {
+    if (retry_timer != nullptr) {
+        // We'll submit the entries when the timer fires.
+        return;
+    }
+    int res = ring->submit();
+    if (res == -EAGAIN || res == -EBUSY) {
+        // The kernel is temporarily out of resources. The remaining entries stay on
+        // the submission queue until `on_timer()` reaps the completions that are
+        // ready and tries again.
+        retry_timer = fire_timer_once(URING_SUBMIT_RETRY_MS, this);
+        return;
+    }
+    guarantee_xerr(res >= 0, -res, "io_uring_enter failed");
+}
+
+void uring_diskmgr_t::on_event(DEBUG_VAR int events) {
+    assert_thread();
+    rassert(events == poll_event_in);
+    completion_event.consume_wakey_wakeys();
+
+    reap_completions();
+
+    // Completions make room for new requests, and resubmit short transfers.
+    pump();
+}
+
+void uring_diskmgr_t::on_timer(UNUSED ticks_t ticks) {
+    assert_thread();
+    retry_timer = nullptr;
+
+    // Reaping completions releases the kernel's resources for them, which makes it
+    // more likely that the retry succeeds.
+    reap_completions();
+    pump();
+}
+
+void uring_diskmgr_t::reap_completions() {
+    ring->reap_completions([this](io_uring_cqe *cqe) {
+        on_completion(reinterpret_cast<request_t *>(cqe->user_data), cqe->res);
+    });
+}
+
+void uring_diskmgr_t::on_completion(request_t *req, int32_t res) {
+    const bool is_write = req->action->get_is_write();
+    if (res == -EINTR || res == -EAGAIN) {
+        prepare(req);
+        return;
+    }
+    if (res < 0) {
+        finish(req, res);
+        return;
+    }
+    if (res == 0 && is_write) {
+        // See `pool_diskmgr_t::action_t::perform_read_write`.
+        logERR("Failed I/O: vectored write of %" PRIi64 " bytes stopped after "
+               "%" PRIi64 " bytes. Assuming we ran out of disk space.",
+               req->total_bytes, req->bytes_done);
+        finish(req, -ENOSPC);
+        return;
+    }
+    if (res == 0) {
+        logERR("Failed I/O: we tried to read from behind the end of the file. "
+               "Either the file got truncated, or there is a bug in RethinkDB.");
+        finish(req, -EINVAL);
+        return;
+    }
+
+    req->bytes_done += action_t::advance_vector(&req->remaining_vecs,
+                                                &req->remaining_vecs_len,
+                                                res);
+    if (req->bytes_done < req->total_bytes) {
+        prepare(req);
+    } else {
+        finish(req, req->total_bytes);
+    }
+}
+
+void uring_diskmgr_t::finish(request_t *req, int64_t io_result) {
+    action_t *a = req->action;
+    a->io_result = io_result;
+    req->action = nullptr;
+    req->vecs.reset();
+    free_requests.push_back(req);
+    --n_pending;
+    done_fun(a);
+}
+
+#endif  // USE_IO_URING
@@ -0,0 +1,172 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_URING_HPP_
+#define ARCH_IO_DISK_URING_HPP_
+
+#include <sys/uio.h>
+
+#include <functional>
+#include <vector>
+
+#include "arch/io/disk/pool.hpp"
+#include "arch/runtime/event_queue.hpp"
+#include "arch/runtime/system_event.hpp"
+#include "arch/timer.hpp"
+#include "concurrency/queue/passive_producer.hpp"
+#include "concurrency/queue/unlimited_fifo.hpp"
+#include "containers/scoped.hpp"
+
+/* io_uring needs a reasonably recent Linux kernel (5.1 or later), and we use an
+eventfd to learn about completions. */
+#if defined(__linux__) && !defined(NO_IO_URING) && !defined(NO_EVENTFD) \
+    && !defined(LEGACY_LINUX)
+#define USE_IO_URING 1
+#else
+#define USE_IO_URING 0
+#endif
+
+// The number of blocker threads that `uring_diskmgr_t` keeps around for the
+// operations that it cannot hand to the kernel asynchronously.
+const int URING_FALLBACK_POOL_THREADS = 4;
+
+// The kernel refuses to create submission queues larger than this.
+const int URING_MAX_ENTRIES = 32768;
+
+// How long `uring_diskmgr_t` waits before it retries a submission that the kernel
+// rejected because it was temporarily out of resources.
+const int64_t URING_SUBMIT_RETRY_MS = 1;
+
+#if USE_IO_URING
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/* `linux_io_uring_t` is a thin wrapper around the raw io_uring system calls and
+the shared submission and completion rings. We don't depend on liburing. */
+class linux_io_uring_t {
+public:
+    linux_io_uring_t();
+    virtual ~linux_io_uring_t();
+
+    /* Sets up a ring with room for at least `entries` submissions. Returns 0 on
+    success and an errno value (e.g. `ENOSYS` on kernels without io_uring) if the
+    ring could not be created. */
+    MUST_USE int init(unsigned int entries);
+
+    /* Returns 0 on success or an errno value. Completions will ping `event`. */
+    MUST_USE int register_eventfd(fd_t event_fd);
+
+    unsigned int get_sq_entries() const { return sq_entries; }
+
+    /* Returns the next free submission queue entry (zeroed), or `nullptr` if the
+    submission queue is full. The entry becomes visible to the kernel on the next
+    call to `submit()`. */
+    io_uring_sqe *get_sqe();
+
+    /* Hands all prepared entries to the kernel in a single system call. Returns the
+    number of entries the kernel consumed, or a negated errno value. It's virtual so
+    that the unit tests can simulate a kernel that runs out of resources. */
+    virtual int submit();
+
+    /* Calls `fun` on each completion that is ready, then retires them. */
+    void reap_completions(const std::function<void(io_uring_cqe *)> &fun);
+
+private:
+    void teardown();
+
+    int ring_fd;
+
+    void *sq_ring_ptr;
+    size_t sq_ring_size;
+    void *cq_ring_ptr;
+    size_t cq_ring_size;
+    io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    unsigned int sq_entries;
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int *sq_mask;
+    unsigned int *sq_array;
+    // Entries we have written to the ring but not yet passed to `io_uring_enter`.
+    unsigned int sq_local_tail;
+    unsigned int sq_to_submit;
+
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int *cq_mask;
+    io_uring_cqe *cqes;
+
+    DISABLE_COPYING(linux_io_uring_t);
+};
+
+/* The io_uring disk manager is a drop-in replacement for `pool_diskmgr_t`. Instead of
+running blocking syscalls on a thread pool, it places batches of reads and writes on
+an io_uring submission queue directly from the event loop thread, and it picks up
+their completions through an eventfd that is watched by the event queue.
+
+Resizes and writes that must be wrapped in datasyncs are rare; they are handed to a
+small internal `pool_diskmgr_t`. */
+class uring_diskmgr_t : private availability_callback_t,
+                        private linux_event_callback_t,
+                        private timer_callback_t,
+                        public home_thread_mixin_debug_only_t {
+public:
+    typedef pool_diskmgr_action_t action_t;
+
+    /* Like `pool_diskmgr_t`, the `uring_diskmgr_t` draws actions to run from
+    `source` and calls `done_fun` on each one when it's done. `ring` must already be
+    initialized. */
+    uring_diskmgr_t(linux_event_queue_t *queue,
+                    passive_producer_t<action_t *> *source,
+                    int max_concurrent_io_requests,
+                    scoped_ptr_t<linux_io_uring_t> &&ring);
+    std::function<void(action_t *)> done_fun;
+    ~uring_diskmgr_t();
+
+private:
+    struct request_t {
+        action_t *action;
+        // A copy of the action's buffers, advanced past the bytes that have already
+        // been transferred when the kernel gives us a short read or write.
+        scoped_array_t<iovec> vecs;
+        iovec *remaining_vecs;
+        size_t remaining_vecs_len;
+        int64_t bytes_done;
+        int64_t total_bytes;
+    };
+
+    void on_source_availability_changed();
+    void on_event(int events);
+    void on_timer(ticks_t ticks);
+
+    void reap_completions();
+    void pump();
+    void prepare(request_t *req);
+    void flush_submissions();
+    void on_completion(request_t *req, int32_t res);
+    void finish(request_t *req, int64_t io_result);
+
+    linux_event_queue_t *const queue;
+    const int queue_depth;
+    passive_producer_t<action_t *> *source;
+    scoped_ptr_t<linux_io_uring_t> ring;
+    system_event_t completion_event;
+
+    // Set while we're waiting to retry a submission that failed with `EAGAIN` or
+    // `EBUSY`. We can't count on a completion to retry it for us, because there
+    // might not be any other requests in flight.
+    timer_token_t *retry_timer;
+
+    scoped_array_t<request_t> requests;
+    std::vector<request_t *> free_requests;
+    int n_pending;
+
+    unlimited_fifo_queue_t<action_t *> fallback_queue;
+    pool_diskmgr_t fallback_pool;
+
+    DISABLE_COPYING(uring_diskmgr_t);
+};
+
+#endif  // USE_IO_URING
+
+#endif  // ARCH_IO_DISK_URING_HPP_
@@ -4,6 +4,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <string.h>
 #include <sys/types.h>
 
@@ -20,6 +21,8 @@
 #include <sys/socket.h>
 #endif
 
+#include <algorithm>
+
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "arch/timing.hpp"
@@ -521,7 +524,9 @@ linux_tcp_conn_t::write_handler_t::write_handler_t(linux_tcp_conn_t *_parent) :
 { }
 
 void linux_tcp_conn_t::write_handler_t::coro_pool_callback(write_queue_op_t *operation, UNUSED signal_t *interruptor) {
-    if (operation->buffer != nullptr) {
+    if (operation->bufs != nullptr) {
+        parent->perform_write_vectored(operation->bufs, operation->buf_count);
+    } else if (operation->buffer != nullptr) {
         parent->perform_write(operation->buffer, operation->size);
         if (operation->dealloc != nullptr) {
             parent->release_write_buffer(operation->dealloc);
@@ -546,6 +551,7 @@ void linux_tcp_conn_t::internal_flush_write_buffer() {
        released once the write is over. */
     op->buffer = current_write_buffer->buffer;
     op->size = current_write_buffer->size;
+    op->bufs = nullptr;
     op->dealloc = current_write_buffer.release();
     op->cond = nullptr;
     op->keepalive = auto_drainer_t::lock_t(drainer.get());
@@ -598,8 +604,41 @@ void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
         rassert(op.nb_bytes == size);  // TODO WINDOWS: does windows guarantee this?
     }
 #else
-    while (size > 0) {
-        ssize_t res = ::write(sock.get(), buf, size);
+    iovec vec;
+    vec.iov_base = const_cast<void *>(buf);
+    vec.iov_len = size;
+    writev_to_socket(&vec, 1);
+#endif
+}
+
+void linux_tcp_conn_t::perform_write_vectored(iovec *bufs, size_t count) {
+    assert_thread();
+
+    if (write_closed.is_pulsed()) {
+        /* See `perform_write()`. */
+        return;
+    }
+
+#ifdef _WIN32
+    for (size_t i = 0; i < count && !write_closed.is_pulsed(); ++i) {
+        perform_write(bufs[i].iov_base, bufs[i].iov_len);
+    }
+#else
+    writev_to_socket(bufs, count);
+#endif
+}
+
+#ifndef _WIN32
+void linux_tcp_conn_t::writev_to_socket(iovec *bufs, size_t count) {
+    /* Skip the empty buffers, so that `count > 0` means there is something left to
+    write. */
+    while (count > 0 && bufs->iov_len == 0) {
+        ++bufs;
+        --count;
+    }
+
+    while (count > 0) {
+        ssize_t res = ::writev(sock.get(), bufs, std::min<size_t>(count, IOV_MAX));
 
         if (res == -1 && (get_errno() == EAGAIN || get_errno() == EWOULDBLOCK)) {
             /* Wait for a notification from the event queue, or for an order to
@@ -637,16 +676,27 @@ void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
             break;
 
         } else {
-            rassert(res <= static_cast<ssize_t>(size));
-            buf = reinterpret_cast<const void *>(reinterpret_cast<const char *>(buf) + res);
-            size -= res;
             if (write_perfmon) {
                 write_perfmon->record(res);
             }
+            /* Advance past what got written, which might end in the middle of a
+            buffer. */
+            size_t written = res;
+            while (count > 0 && written >= bufs->iov_len) {
+                written -= bufs->iov_len;
+                ++bufs;
+                --count;
+            }
+            if (count > 0) {
+                bufs->iov_base = static_cast<char *>(bufs->iov_base) + written;
+                bufs->iov_len -= written;
+            } else {
+                rassert(written == 0);
+            }
         }
     }
-#endif
 }
+#endif
 
 void linux_tcp_conn_t::write(const void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
     write_op_wrapper_t sentry(this, closer);
@@ -665,6 +715,7 @@ void linux_tcp_conn_t::write(const void *buf, size_t size, signal_t *closer) THR
     /* Enqueue the write so it will happen eventually */
     op.buffer = buf;
     op.size = size;
+    op.bufs = nullptr;
     op.dealloc = nullptr;
     op.cond = &to_signal_when_done;
     write_queue.push(&op);
@@ -711,6 +762,38 @@ void linux_tcp_conn_t::write_buffered(const void *vbuf, size_t size, signal_t *c
     }
 }
 
+void linux_tcp_conn_t::write_vectored(const iovec *bufs, size_t count, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
+    write_op_wrapper_t sentry(this, closer);
+
+    write_queue_op_t op;
+    cond_t to_signal_when_done;
+
+    /* Flush out any data that's been buffered, so that things don't get out of order */
+    if (current_write_buffer->size > 0) {
+        internal_flush_write_buffer();
+    }
+
+    /* `perform_write_vectored()` modifies the buffer list as it goes. */
+    scoped_array_t<iovec> bufs_copy(count);
+    std::copy(bufs, bufs + count, bufs_copy.data());
+
+    /* As in `write()`, we block until the write is done, so we don't need the write
+       semaphore. */
+    op.buffer = nullptr;
+    op.size = 0;
+    op.bufs = bufs_copy.data();
+    op.buf_count = count;
+    op.dealloc = nullptr;
+    op.cond = &to_signal_when_done;
+    write_queue.push(&op);
+
+    to_signal_when_done.wait();
+
+    if (write_closed.is_pulsed()) {
+        throw tcp_conn_write_closed_exc_t();
+    }
+}
+
 void linux_tcp_conn_t::writef(signal_t *closer, const char *format, ...) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
     va_list ap;
     va_start(ap, format);
@@ -737,6 +820,7 @@ void linux_tcp_conn_t::flush_buffer(signal_t *closer) THROWS_ONLY(tcp_conn_write
     write_queue_op_t op;
     cond_t to_signal_when_done;
     op.buffer = nullptr;
+    op.bufs = nullptr;
     op.dealloc = nullptr;
     op.cond = &to_signal_when_done;
     write_queue.push(&op);
@@ -1118,6 +1202,12 @@ void linux_secure_tcp_conn_t::perform_write(const void *buffer, size_t size) {
     }
 }
 
+void linux_secure_tcp_conn_t::perform_write_vectored(iovec *bufs, size_t count) {
+    for (size_t i = 0; i < count && !closed.is_pulsed(); ++i) {
+        perform_write(bufs[i].iov_base, bufs[i].iov_len);
+    }
+}
+
 /* It is not possible to close only the read or write side of a TLS connection
 so we use only a single shutdown method which attempts to shutdown the TLS
 before shutting down the underlying tcp connection */
@@ -5,6 +5,7 @@
 #include <stdarg.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #ifdef ENABLE_TLS
 #include <openssl/ssl.h>
@@ -142,6 +143,12 @@ public:
     void write_buffered(const void *buf, size_t size, signal_t *closer)
         THROWS_ONLY(tcp_conn_write_closed_exc_t);
 
+    /* write_vectored() is like write(), but writes the `count` buffers in `bufs` one
+    after another. They are handed to the kernel as they are (with `writev()`) rather
+    than copied into a write buffer first. */
+    void write_vectored(const iovec *bufs, size_t count, signal_t *closer)
+        THROWS_ONLY(tcp_conn_write_closed_exc_t);
+
     void writef(signal_t *closer, const char *format, ...)
         THROWS_ONLY(tcp_conn_write_closed_exc_t) ATTR_FORMAT(printf, 3, 4);
 
@@ -279,6 +286,9 @@ private:
         write_buffer_t *dealloc;
         const void *buffer;
         size_t size;
+        /* Set instead of `buffer` for `write_vectored()`. */
+        iovec *bufs;
+        size_t buf_count;
         cond_t *cond;
         auto_drainer_t::lock_t keepalive;
     };
@@ -345,6 +355,15 @@ private:
     /* Used to actually perform a write. If the write end of the connection is open, then
     writes `size` bytes from `buffer` to the socket. */
     virtual void perform_write(const void *buffer, size_t size);
+
+    /* Like `perform_write()`, but for the buffers of `write_vectored()`. It may modify
+    `bufs` as it goes. */
+    virtual void perform_write_vectored(iovec *bufs, size_t count);
+
+#ifndef _WIN32
+    /* The `writev()` loop behind `perform_write()` and `perform_write_vectored()`. */
+    void writev_to_socket(iovec *bufs, size_t count);
+#endif
 };
 
 #ifdef ENABLE_TLS
@@ -409,6 +428,10 @@ private:
     writes `size` bytes from `buffer` to the socket. */
     virtual void perform_write(const void *buffer, size_t size);
 
+    /* TLS records can't be written with `writev()`, so this calls `perform_write()`
+    for each buffer. */
+    virtual void perform_write_vectored(iovec *bufs, size_t count);
+
     void shutdown();
     void shutdown_socket();
 
@@ -24,6 +24,7 @@ linux_message_hub_t::linux_message_hub_t(linux_event_queue_t *queue,
     : queue_(queue),
       thread_pool_(thread_pool),
       is_woken_up_(false),
+      incoming_messages_(nullptr),
       current_thread_(current_thread) {
 
 #ifndef NDEBUG
@@ -47,7 +48,7 @@ linux_message_hub_t::~linux_message_hub_t() {
         guarantee(get_priority_msg_list(p).empty());
     }
 
-    guarantee(incoming_messages_.empty());
+    guarantee(incoming_messages_.load() == nullptr);
 }
 
 void linux_message_hub_t::do_store_message(threadnum_t nthread, linux_thread_message_t *msg) {
@@ -94,15 +95,44 @@ void linux_message_hub_t::store_message_sometime(threadnum_t nthread, linux_thre
 
 
 void linux_message_hub_t::insert_external_message(linux_thread_message_t *msg) {
-    bool do_wake_up;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        do_wake_up = !check_and_set_is_woken_up();
-        incoming_messages_.push_back(msg);
+    msg_list_t msgs;
+    msgs.push_back(msg);
+    push_incoming_messages(&msgs);
+}
+
+void linux_message_hub_t::push_incoming_messages(msg_list_t *msgs) {
+    // Link the messages in reverse order, so that the oldest one is at the bottom.
+    linux_thread_message_t *top = nullptr;
+    linux_thread_message_t *bottom = nullptr;
+    while (linux_thread_message_t *m = msgs->head()) {
+        msgs->remove(m);
+        m->next_incoming = top;
+        if (bottom == nullptr) {
+            bottom = m;
+        }
+        top = m;
+    }
+    if (top == nullptr) {
+        return;
     }
 
-    // Wakey wakey eggs and bakey
-    if (do_wake_up) {
+    // Put them on top of the stack. There's no ABA problem here, because the receiver
+    // only ever takes the whole stack.
+    linux_thread_message_t *old_top = incoming_messages_.load();
+    do {
+        bottom->next_incoming = old_top;
+    } while (!incoming_messages_.compare_exchange_weak(old_top, top));
+
+    // This must happen after the messages are on the stack. Otherwise the receiver
+    // could clear `is_woken_up_` and take the stack in between, and then miss our
+    // messages without being woken up again.
+    wake_up_if_necessary();
+}
+
+void linux_message_hub_t::wake_up_if_necessary() {
+    // We only need to do a wake up if we're the first people to do a wake up.
+    if (!is_woken_up_.exchange(true)) {
+        // Wakey wakey eggs and bakey
         event_.wakey_wakey();
     }
 }
@@ -178,31 +208,26 @@ void linux_message_hub_t::on_event(int events) {
             // Place wakey_wakey and then yield to the event processing.
             // It will wake us up again immediately, but can handle a few
             // OS events (such as timers, network messages etc.) in the meantime.
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&incoming_messages_lock_);
-                do_wake_up = !check_and_set_is_woken_up();
-            }
-            if (do_wake_up) {
-                event_.wakey_wakey();
-            }
+            wake_up_if_necessary();
             break;
         }
     }
 }
 
 void linux_message_hub_t::sort_incoming_messages_by_priority() {
-    // We do this in two steps to release the spinlock faster.
-    // append_and_clear is a very cheap operation, while
-    // assigning each message to a different priority queue
-    // is more expensive.
+    // 1. Pull the messages. We must clear `is_woken_up_` first, so that anyone who
+    // pushes messages after we've taken the stack wakes us up again.
+    is_woken_up_.store(false);
+    linux_thread_message_t *top = incoming_messages_.exchange(nullptr);
 
-    // 1. Pull the messages
+    // The stack has the newest messages on top, so pushing each one to the front of
+    // `new_messages` puts them back into the order in which they were sent.
     msg_list_t new_messages;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        new_messages.append_and_clear(&incoming_messages_);
-        is_woken_up_ = false;
+    while (top != nullptr) {
+        linux_thread_message_t *m = top;
+        top = m->next_incoming;
+        m->next_incoming = nullptr;
+        new_messages.push_front(m);
     }
 
     // 2. Sort the messages into their respective priority queues
@@ -221,12 +246,6 @@ void linux_message_hub_t::sort_incoming_messages_by_priority() {
     }
 }
 
-bool linux_message_hub_t::check_and_set_is_woken_up() {
-    const bool was_woken_up = is_woken_up_;
-    is_woken_up_ = true;
-    return was_woken_up;
-}
-
 // Pushes messages collected locally global lists available to all
 // threads.
 void linux_message_hub_t::push_messages() {
@@ -236,23 +255,8 @@ void linux_message_hub_t::push_messages() {
         thread_queue_t *queue = &queues_[i];
         if (!queue->msg_local_list.empty()) {
             // Transfer messages to the other core
-
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&thread_pool_->threads[i]->message_hub.incoming_messages_lock_);
-
-                // We only need to do a wake up if we're the first people to do a
-                // wake up.
-                do_wake_up =
-                    !thread_pool_->threads[i]->message_hub.check_and_set_is_woken_up();
-
-                thread_pool_->threads[i]->message_hub.incoming_messages_.append_and_clear(&queue->msg_local_list);
-            }
-
-            // Wakey wakey, perhaps eggs and bakey
-            if (do_wake_up) {
-                thread_pool_->threads[i]->message_hub.event_.wakey_wakey();
-            }
+            thread_pool_->threads[i]->message_hub.push_incoming_messages(
+                &queue->msg_local_list);
         }
     }
 }
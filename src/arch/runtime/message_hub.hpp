@@ -4,10 +4,11 @@
 
 #include <pthread.h>
 
+#include <atomic>
+
 #include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/runtime_utils.hpp"
 #include "arch/runtime/system_event.hpp"
-#include "arch/spinlock.hpp"
 #include "config/args.hpp"
 #include "containers/intrusive_list.hpp"
 #include "threading.hpp"
@@ -23,8 +24,12 @@ class linux_thread_pool_t;
 /* There is one message hub per thread, NOT one message hub for the entire program.
 
 Each message hub stores messages that are going from that message hub's home thread to
-other threads. It keeps a separate queue for messages destined for each other thread. */
+other threads. It keeps a separate queue for messages destined for each other thread.
 
+Messages arrive at a message hub through a lock-free stack. Each sender pushes all of the
+messages it has collected for the receiving thread with a single compare-and-swap, and
+the receiver takes the whole stack at once with an exchange. Only the first sender after
+the receiver has emptied the stack writes to the receiver's eventfd. */
 class linux_message_hub_t : private linux_event_callback_t {
 public:
     typedef intrusive_list_t<linux_thread_message_t> msg_list_t;
@@ -32,8 +37,8 @@ public:
     linux_message_hub_t(linux_event_queue_t *queue, linux_thread_pool_t *thread_pool,
                         threadnum_t current_thread);
 
-    /* For each thread, transfer messages from our msg_local_list for that thread to our
-    msg_global_list for that thread */
+    /* For each thread, transfer messages from our msg_local_list for that thread to that
+    thread's incoming stack */
     void push_messages();
 
     /* Schedules the given message to be sent to the given thread by pushing it onto our
@@ -55,6 +60,13 @@ private:
     // debug mode.
     void do_store_message(threadnum_t nthread, linux_thread_message_t *msg);
 
+    // Pushes the messages from `msgs` onto `incoming_messages_` and wakes up the
+    // receiving thread if necessary. `msgs` is left empty.
+    void push_incoming_messages(msg_list_t *msgs);
+
+    // Wakes up the receiving thread unless somebody else has already done so.
+    void wake_up_if_necessary();
+
     // Moves messages from incoming_messages_ into the respective entries of
     // priority_msg_lists, depending on the messages' priorities.
     void sort_incoming_messages_by_priority();
@@ -68,16 +80,20 @@ private:
     struct thread_queue_t {
         //TODO this doesn't need to be a class anymore
 
-        /* Messages are cached here before being pushed to the global list so that we don't
-        have to acquire the spinlock as often */
+        /* Messages are cached here before being pushed to the other thread's incoming
+        stack, so that we only need one compare-and-swap per batch */
         msg_list_t msg_local_list;
     } queues_[MAX_THREADS];
 
-    // Must only be used with acquired incoming_messages_lock_
-    bool check_and_set_is_woken_up();
-    bool is_woken_up_;
-    msg_list_t incoming_messages_;
-    spinlock_t incoming_messages_lock_;
+    // Set by whoever writes to `event_`, and cleared by the receiving thread right
+    // before it takes the messages from `incoming_messages_`.
+    std::atomic<bool> is_woken_up_;
+
+    // The top of a stack of messages linked through their `next_incoming` fields, with
+    // the most recently pushed message on top. Since each sender pushes its messages
+    // in reverse, reversing the stack gives every sender's messages in the order in
+    // which they were sent.
+    std::atomic<linux_thread_message_t *> incoming_messages_;
 
     // Use `sort_incoming_messages_by_priority()` to sort incoming_messages_ into
     // these lists.
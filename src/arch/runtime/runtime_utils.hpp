@@ -47,14 +47,16 @@ class linux_thread_message_t : public intrusive_list_node_t<linux_thread_message
 public:
     explicit linux_thread_message_t(int _priority)
         : priority(_priority),
-        is_ordered(false)
+        is_ordered(false),
+        next_incoming(nullptr)
 #ifndef NDEBUG
         , reloop_count_(0)
 #endif
         { }
     linux_thread_message_t()
         : priority(MESSAGE_SCHEDULER_DEFAULT_PRIORITY),
-        is_ordered(false)
+        is_ordered(false),
+        next_incoming(nullptr)
 #ifndef NDEBUG
         , reloop_count_(0)
 #endif
@@ -69,6 +71,8 @@ private:
     friend class linux_message_hub_t;
     int priority;
     bool is_ordered; // Used internally by the message hub
+    // Links the message into the receiving message hub's incoming stack
+    linux_thread_message_t *next_incoming;
 #ifndef NDEBUG
     int reloop_count_;
 #endif
@@ -16,6 +16,7 @@
 #include "arch/runtime/coroutines.hpp"
 #include "arch/io/blocker_pool.hpp"
 #include "arch/io/timer_provider.hpp"
+#include "arch/spinlock.hpp"
 #include "arch/timer.hpp"
 
 class linux_thread_t;
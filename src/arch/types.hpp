@@ -105,6 +105,13 @@ enum class file_direct_io_mode_t {
     buffered_desired
 };
 
+// Which mechanism the disk manager uses to run I/O operations asynchronously.  We
+// fall back to `pool` if io_uring is requested but the kernel doesn't support it.
+enum class disk_io_backend_t {
+    pool,
+    uring
+};
+
 // A linux file.  It expects reads and writes and buffers to have an
 // alignment of DEVICE_BLOCK_SIZE.
 class file_t {
@@ -66,6 +66,11 @@ continue_bool_t btree_send_backfill_pre(
         "btree_send_backfill_pre %" PRIu64, reference_timestamp.longtime));
     class callback_t : public depth_first_traversal_callback_t {
     public:
+        /* Most subtrees are usually skipped by `filter_range_ts()`. */
+        int prefetch_count() {
+            return 0;
+        }
+
         continue_bool_t filter_range_ts(
                 UNUSED const btree_key_t *left_excl_or_null,
                 const btree_key_t *right_incl,
@@ -101,7 +106,9 @@ continue_bool_t btree_send_backfill_pre(
                     "pre-item leaf %" PRIu64, min_deletion_timestamp.longtime));
                 return pre_item_consumer->on_pre_item(std::move(pre_item));
             } else {
-                std::vector<const btree_key_t *> keys;
+                /* We copy the keys because `visit_entries()` may assemble them in a
+                temporary buffer. */
+                std::vector<store_key_t> keys;
                 leaf::visit_entries(
                     sizer, lnode, buf->lock.get_recency(),
                     [&](const btree_key_t *key, repli_timestamp_t timestamp,
@@ -121,14 +128,11 @@ continue_bool_t btree_send_backfill_pre(
                         }
                         backfill_debug_key(store_key_t(key), strprintf(
                             "pre-item key %" PRIu64, timestamp.longtime));
-                        keys.push_back(key);
+                        keys.push_back(store_key_t(key));
                         return continue_bool_t::CONTINUE;
                     });
-                std::sort(keys.begin(), keys.end(),
-                    [](const btree_key_t *k1, const btree_key_t *k2) {
-                        return btree_key_cmp(k1, k2) < 0;
-                    });
-                for (const btree_key_t *key : keys) {
+                std::sort(keys.begin(), keys.end());
+                for (const store_key_t &key : keys) {
                     backfill_pre_item_t pre_item;
                     pre_item.range = key_range_t::one_key(key);
                     if (continue_bool_t::ABORT ==
@@ -310,6 +314,16 @@ public:
         memory_tracker(_memory_tracker)
         { }
 
+private:
+    /* Most subtrees are usually skipped by `filter_range_ts()`, so we don't prefetch.
+    The exception is a backfill into a fresh replica, where we have to send every leaf
+    node anyway (each as a single item, since `min_deletion_timestamp()` is always
+    newer than `distant_past`). Then we read the leaves ahead in bulk. */
+    int prefetch_count() {
+        return reference_timestamp == repli_timestamp_t::distant_past
+            ? DEPTH_FIRST_TRAVERSAL_PREFETCH_COUNT : 0;
+    }
+
 private:
     /* Skip B-tree subtrees that haven't changed since the reference timestamp and that
     don't overlap with any pre-items' ranges. */
@@ -55,6 +55,10 @@ public:
         return continue_bool_t::CONTINUE;
     }
 
+    int prefetch_count() {
+        return cb_->prefetch_count();
+    }
+
     void handle_pair_coro(scoped_key_value_t *fragile_keyvalue,
                           semaphore_acq_t *fragile_acq,
                           fifo_enforcer_write_token_t token,
@@ -82,6 +86,11 @@ public:
     }
 
     virtual continue_bool_t handle_pair(scoped_key_value_t &&keyvalue, signal_t *) {
+        if (cb_->skip_key(keyvalue.key())) {
+            return failure_cond_->is_pulsed()
+                ? continue_bool_t::ABORT : continue_bool_t::CONTINUE;
+        }
+
         // First thing first: Get in line with the token enforcer.
 
         fifo_enforcer_write_token_t token = source_.enter_write();
@@ -44,6 +44,18 @@ public:
         *skip_out = false;
     }
 
+    /* Called for every key in the traversed range, in order, before `handle_pair()`.
+    Returning `true` drops the pair right away, without spawning a coroutine for it.
+    This is for callbacks that only want a few of the keys in each leaf. */
+    virtual bool skip_key(UNUSED const btree_key_t *key) {
+        return false;
+    }
+
+    /* See `depth_first_traversal_callback_t`. */
+    virtual int prefetch_count() {
+        return DEPTH_FIRST_TRAVERSAL_PREFETCH_COUNT;
+    }
+
     // Passes a keyvalue and a callback.  waiter.wait_interruptible() must be called to
     // begin the region of "exclusive access", which only handle_pair implementation
     // can enters at a time.  (This should happen after loading the value from disk
@@ -1,22 +1,34 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "btree/depth_first_traversal.hpp"
 
+#include <algorithm>
+
 #include "btree/internal_node.hpp"
+#include "btree/leaf_node.hpp"
 #include "btree/operations.hpp"
 #include "concurrency/interruptor.hpp"
 #include "rdb_protocol/profile.hpp"
 
 scoped_key_value_t::scoped_key_value_t(const btree_key_t *_key,
                                        const void *_value,
-                                       movable_t<counted_buf_lock_and_read_t> &&buf)
+                                       movable_t<counted_buf_lock_and_read_t> &&buf,
+                                       bool copy_key)
     : key_(_key), value_(_value), buf_(std::move(buf)) {
     guarantee(buf_.has());
+    if (copy_key) {
+        key_copy_ = make_optional(store_key_t(_key));
+        key_ = key_copy_->btree_key();
+    }
 }
 
 scoped_key_value_t::scoped_key_value_t(scoped_key_value_t &&movee)
     : key_(movee.key_),
+      key_copy_(std::move(movee.key_copy_)),
       value_(movee.value_),
       buf_(std::move(movee.buf_)) {
+    if (key_copy_.has_value()) {
+        key_ = key_copy_->btree_key();
+    }
     movee.key_ = nullptr;
     movee.value_ = nullptr;
 }
@@ -45,6 +57,8 @@ continue_bool_t btree_depth_first_traversal(
         direction_t direction,
         const btree_key_t *left_excl_or_null,
         const btree_key_t *right_incl,
+        bool left_inside_range,
+        bool right_inside_range,
         signal_t *interruptor);
 
 continue_bool_t btree_depth_first_traversal(
@@ -105,7 +119,8 @@ continue_bool_t btree_depth_first_traversal(
 
         return btree_depth_first_traversal(
             std::move(root_block), range, cb, access, direction,
-            left_excl_or_null, right_incl_buf.btree_key(), interruptor);
+            left_excl_or_null, right_incl_buf.btree_key(),
+            range.left.size() == 0, range.right.unbounded, interruptor);
     }
 }
 
@@ -145,6 +160,54 @@ void get_child_key_range(
     }
 }
 
+/* Determines whether the left and right ends of the key range of `inode`'s child are
+inside `range`. `parent_*_inside_range` tell the same about `inode` itself. */
+void get_child_inside_range(
+        const internal_node_t *inode,
+        int child_index,
+        const key_range_t &range,
+        bool parent_left_inside_range,
+        bool parent_right_inside_range,
+        bool *left_inside_range_out,
+        bool *right_inside_range_out) {
+    if (child_index > 0) {
+        // The child's keys are greater than the key of its left neighbor.
+        *left_inside_range_out = btree_key_cmp(
+            range.left.btree_key(),
+            &internal_node::get_pair_by_index(inode, child_index - 1)->key) <= 0;
+    } else {
+        *left_inside_range_out = parent_left_inside_range;
+    }
+    if (child_index != inode->npairs - 1) {
+        *right_inside_range_out = range.right.unbounded || btree_key_cmp(
+            &internal_node::get_pair_by_index(inode, child_index)->key,
+            range.right.key().btree_key()) < 0;
+    } else {
+        *right_inside_range_out = parent_right_inside_range;
+    }
+}
+
+/* Returns `true` if the traversal can use the count that `inode` has for the child
+instead of visiting it. */
+bool can_use_leaf_count(
+        depth_first_traversal_callback_t *cb,
+        const internal_node_t *inode,
+        int child_index,
+        const key_range_t &range,
+        bool left_inside_range,
+        bool right_inside_range) {
+    if (!cb->use_leaf_counts()
+            || internal_node::child_count(inode, child_index)
+                == internal_node::UNKNOWN_CHILD_COUNT) {
+        return false;
+    }
+    bool child_left_inside_range, child_right_inside_range;
+    get_child_inside_range(inode, child_index, range,
+                           left_inside_range, right_inside_range,
+                           &child_left_inside_range, &child_right_inside_range);
+    return child_left_inside_range && child_right_inside_range;
+}
+
 continue_bool_t btree_depth_first_traversal(
         counted_t<counted_buf_lock_and_read_t> block,
         const key_range_t &range,
@@ -153,6 +216,8 @@ continue_bool_t btree_depth_first_traversal(
         direction_t direction,
         const btree_key_t *left_excl_or_null,
         const btree_key_t *right_incl,
+        bool left_inside_range,
+        bool right_inside_range,
         signal_t *interruptor) {
     bool skip;
     if (continue_bool_t::ABORT == cb->filter_range_ts(
@@ -180,10 +245,33 @@ continue_bool_t btree_depth_first_traversal(
             r.decrement();
             end_index = internal_node::get_offset_index(inode, r.btree_key()) + 1;
         }
+        const int prefetch_count = cb->prefetch_count();
+        // The children before this position in scan order have been prefetched or
+        // acquired already.
+        int prefetched_up_to = 0;
         for (int i = 0; i < end_index - start_index; ++i) {
             int true_index = (direction == FORWARD ? start_index + i : (end_index - 1) - i);
             const btree_internal_pair *pair = internal_node::get_pair_by_index(inode, true_index);
 
+            // Start loading the next few children in scan order, so that they are
+            // likely to be in memory by the time we get to them.  The current child
+            // gets loaded by acquiring it below.
+            prefetched_up_to = std::max(prefetched_up_to, i + 1);
+            const int prefetch_end =
+                std::min(end_index - start_index, i + 1 + prefetch_count);
+            for (; prefetched_up_to < prefetch_end; ++prefetched_up_to) {
+                int prefetch_index = (direction == FORWARD
+                    ? start_index + prefetched_up_to
+                    : (end_index - 1) - prefetched_up_to);
+                if (can_use_leaf_count(cb, inode, prefetch_index, range,
+                                       left_inside_range, right_inside_range)) {
+                    continue;
+                }
+                buf_lock_t::prefetch(
+                    buf_parent_t(&block->lock),
+                    internal_node::get_pair_by_index(inode, prefetch_index)->lnode);
+            }
+
             // Get the child key range
             const btree_key_t *child_left_excl_or_null;
             const btree_key_t *child_right_incl;
@@ -195,7 +283,22 @@ continue_bool_t btree_depth_first_traversal(
                     child_left_excl_or_null, child_right_incl, interruptor, &skip)) {
                 return continue_bool_t::ABORT;
             }
-            if (!skip) {
+            if (skip) {
+                continue;
+            }
+            if (can_use_leaf_count(cb, inode, true_index, range,
+                                   left_inside_range, right_inside_range)) {
+                if (continue_bool_t::ABORT == cb->handle_leaf_count(
+                        child_left_excl_or_null, child_right_incl,
+                        internal_node::child_count(inode, true_index), interruptor)) {
+                    return continue_bool_t::ABORT;
+                }
+            } else {
+                bool child_left_inside_range, child_right_inside_range;
+                get_child_inside_range(inode, true_index, range,
+                                       left_inside_range, right_inside_range,
+                                       &child_left_inside_range,
+                                       &child_right_inside_range);
                 counted_t<counted_buf_lock_and_read_t> lock;
                 {
                     PROFILE_STARTER_IF_ENABLED(
@@ -208,7 +311,9 @@ continue_bool_t btree_depth_first_traversal(
                 }
                 if (continue_bool_t::ABORT == btree_depth_first_traversal(
                         std::move(lock), range, cb, access, direction,
-                        child_left_excl_or_null, child_right_incl, interruptor)) {
+                        child_left_excl_or_null, child_right_incl,
+                        child_left_inside_range, child_right_inside_range,
+                        interruptor)) {
                     return continue_bool_t::ABORT;
                 }
             }
@@ -224,6 +329,7 @@ continue_bool_t btree_depth_first_traversal(
         }
 
         const leaf_node_t *lnode = reinterpret_cast<const leaf_node_t *>(node);
+        const bool copy_keys = leaf::is_prefix_compressed(lnode);
         const btree_key_t *key;
 
         if (direction == FORWARD) {
@@ -238,7 +344,8 @@ continue_bool_t btree_depth_first_traversal(
                 if (continue_bool_t::ABORT == cb->handle_pair(
                         scoped_key_value_t(
                             key, (*it).second,
-                            movable_t<counted_buf_lock_and_read_t>(block)),
+                            movable_t<counted_buf_lock_and_read_t>(block),
+                            copy_keys),
                         interruptor)) {
                     return continue_bool_t::ABORT;
                 }
@@ -261,7 +368,8 @@ continue_bool_t btree_depth_first_traversal(
                 if (continue_bool_t::ABORT == cb->handle_pair(
                         scoped_key_value_t(
                             key, (*it).second,
-                            movable_t<counted_buf_lock_and_read_t>(block)),
+                            movable_t<counted_buf_lock_and_read_t>(block),
+                            copy_keys),
                         interruptor)) {
                     return continue_bool_t::ABORT;
                 }
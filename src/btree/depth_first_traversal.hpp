@@ -5,8 +5,10 @@
 #include "btree/keys.hpp"
 #include "btree/types.hpp"
 #include "buffer_cache/alt.hpp"
+#include "config/args.hpp"
 #include "containers/archive/archive.hpp"
 #include "containers/counted.hpp"
+#include "containers/optional.hpp"
 #include "repli_timestamp.hpp"
 
 namespace profile { class trace_t; }
@@ -28,9 +30,13 @@ public:
 // contains said key/value pair.
 class scoped_key_value_t {
 public:
+    // If `copy_key` is true, we keep a copy of `key` instead of pointing into the
+    // leaf node. That's necessary for prefix-compressed leaf nodes, whose keys don't
+    // exist in one piece inside the node.
     scoped_key_value_t(const btree_key_t *key,
                        const void *value,
-                       movable_t<counted_buf_lock_and_read_t> &&buf);
+                       movable_t<counted_buf_lock_and_read_t> &&buf,
+                       bool copy_key);
     scoped_key_value_t(scoped_key_value_t &&movee);
     ~scoped_key_value_t();
     void operator=(scoped_key_value_t &&) = delete;
@@ -50,7 +56,9 @@ public:
     void reset();
 
 private:
+    // Points either into the leaf node or to `key_copy_`.
     const btree_key_t *key_;
+    optional<store_key_t> key_copy_;
     const void *value_;
     movable_t<counted_buf_lock_and_read_t> buf_;
 
@@ -126,6 +134,27 @@ public:
     resulting key ranges would be contiguous and non-overlapping, and they would together
     cover the full range of the traversal. */
 
+    /* The traversal loads up to this many of the children of an internal node that it
+    will visit next into the cache before it acquires them, so that scanning a range
+    doesn't wait for the disk once per leaf. Callbacks that skip most subtrees through
+    `filter_range()` or `filter_range_ts()` should return 0, since prefetching the
+    skipped children would only waste I/O and cache space. */
+    virtual int prefetch_count() { return DEPTH_FIRST_TRAVERSAL_PREFETCH_COUNT; }
+
+    /* Callbacks that only need to know how many pairs there are can return `true`
+    here. For leaf nodes that lie entirely inside the traversal's range and whose
+    parent knows their number of live entries (see `btree/internal_node.hpp`), the
+    traversal then calls `handle_leaf_count()` instead of acquiring the leaf and calling
+    `filter_range_ts()`, `handle_pre_leaf()` and `handle_pair()`. */
+    virtual bool use_leaf_counts() { return false; }
+    virtual continue_bool_t handle_leaf_count(
+            UNUSED const btree_key_t *left_excl_or_null,
+            UNUSED const btree_key_t *right_incl,
+            UNUSED uint64_t count,
+            UNUSED signal_t *interruptor) {
+        unreachable();
+    }
+
     virtual profile::trace_t *get_trace() THROWS_NOTHING { return nullptr; }
 protected:
     virtual ~depth_first_traversal_callback_t() { }
@@ -1,9 +1,12 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "btree/internal_node.hpp"
 
+#include <string.h>
+
 #include <algorithm>
 
 #include "btree/node.hpp"
+#include "containers/scoped.hpp"
 
 //In this tree, less than or equal takes the left-hand branch and greater than takes the right hand branch
 
@@ -15,27 +18,37 @@ class ibuf_t;
 namespace impl {
 size_t pair_size_with_key(const btree_key_t *key);
 size_t pair_size_with_key_size(uint8_t size);
+size_t count_size(const internal_node_t *node);
+size_t pairs_size_as(block_size_t block_size, const internal_node_t *node,
+                     const internal_node_t *format_node);
+uint64_t get_count(const internal_node_t *node, const btree_internal_pair *pair);
+void set_count(internal_node_t *node, btree_internal_pair *pair, uint64_t count);
 
 void delete_pair(internal_node_t *node, uint16_t offset);
-uint16_t insert_pair(internal_node_t *node, const btree_internal_pair *pair);
-uint16_t insert_pair(internal_node_t *node, block_id_t lnode, const btree_key_t *key);
+// Copies `pair` from `source` into `node`, together with its child count.
+uint16_t insert_pair(internal_node_t *node, const internal_node_t *source,
+                     const btree_internal_pair *pair);
+uint16_t insert_pair(internal_node_t *node, block_id_t lnode, const btree_key_t *key,
+                     uint64_t count = UNKNOWN_CHILD_COUNT);
 void delete_offset(internal_node_t *node, int index);
 void insert_offset(internal_node_t *node, uint16_t offset, int index);
 void make_last_pair_special(internal_node_t *node);
 bool is_equal(const btree_key_t *key1, const btree_key_t *key2);
 }  // namespace impl
 
-void init(block_size_t block_size, internal_node_t *node) {
-    node->magic = internal_node_t::expected_magic;
+void init(block_size_t block_size, internal_node_t *node, bool counted) {
+    node->magic = counted
+        ? internal_node_t::counted_magic
+        : internal_node_t::expected_magic;
     node->npairs = 0;
     node->frontmost_offset = block_size.value();
 }
 
 void init(block_size_t block_size, internal_node_t *node, const internal_node_t *lnode, const uint16_t *offsets, int numpairs) {
-    init(block_size, node);
+    init(block_size, node, is_counted(lnode));
     rassert(get_pair_by_index(lnode, lnode->npairs-1)->key.size == 0);
     for (int i = 0; i < numpairs; i++) {
-        node->pair_offsets[i] = impl::insert_pair(node, get_pair(lnode, offsets[i]));
+        node->pair_offsets[i] = impl::insert_pair(node, lnode, get_pair(lnode, offsets[i]));
     }
     node->npairs = numpairs;
     std::sort(node->pair_offsets, node->pair_offsets+node->npairs-1, internal_key_comp(node));
@@ -65,6 +78,10 @@ bool insert(internal_node_t *node, const btree_key_t *key, block_id_t lnode, blo
     impl::insert_offset(node, offset, index);
 
     get_pair_by_index(node, index + 1)->lnode = rnode;
+    // The count that was there belonged to the child that just got split.
+    if (is_counted(node)) {
+        set_child_count(node, index + 1, UNKNOWN_CHILD_COUNT);
+    }
     return true;
 }
 
@@ -86,7 +103,7 @@ void split(block_size_t block_size, internal_node_t *node, internal_node_t *rnod
     uint16_t first_pairs = 0;
     int index = 0;
     while (first_pairs < total_pairs/2) { // finds the median index
-        first_pairs += pair_size(get_pair_by_index(node, index));
+        first_pairs += pair_size(node, get_pair_by_index(node, index));
         index++;
     }
     int median_index = index;
@@ -118,17 +135,20 @@ void merge(block_size_t block_size, const internal_node_t *node, internal_node_t
     // get the key in parent which points to node
     const btree_key_t *key_from_parent = &get_pair_by_index(parent, get_offset_index(parent, &get_pair_by_index(node, 0)->key))->key;
 
+    // The pairs of `node` take up as much space in `rnode` as they would if they
+    // had `rnode`'s format.
     guarantee(sizeof(internal_node_t) + (node->npairs + rnode->npairs)*sizeof(*node->pair_offsets) +
-        (block_size.value() - node->frontmost_offset) + (block_size.value() - rnode->frontmost_offset) + key_from_parent->size < block_size.value(),
+        impl::pairs_size_as(block_size, node, rnode) + (block_size.value() - rnode->frontmost_offset) + key_from_parent->size < block_size.value(),
         "internal nodes too full to merge");
 
     memmove(rnode->pair_offsets + node->npairs, rnode->pair_offsets, rnode->npairs * sizeof(*rnode->pair_offsets));
 
     for (int i = 0; i < node->npairs-1; i++) { // the last pair is special
-        const uint16_t new_offset = impl::insert_pair(rnode, get_pair_by_index(node, i));
+        const uint16_t new_offset = impl::insert_pair(rnode, node, get_pair_by_index(node, i));
         rnode->pair_offsets[i] = new_offset;
     }
-    const uint16_t new_offset = impl::insert_pair(rnode, get_pair_by_index(node, node->npairs-1)->lnode, key_from_parent);
+    const uint16_t new_offset = impl::insert_pair(rnode, get_pair_by_index(node, node->npairs-1)->lnode, key_from_parent,
+                                                  child_count(node, node->npairs-1));
     rnode->pair_offsets[node->npairs - 1] = new_offset;
 
     const uint16_t new_npairs = rnode->npairs + node->npairs;
@@ -149,11 +169,12 @@ bool level(block_size_t block_size, internal_node_t *node,
 
     if (nodecmp(node, sibling) < 0) {
         const btree_key_t *key_from_parent = &get_pair_by_index(parent, get_offset_index(parent, &get_pair_by_index(node, 0)->key))->key;
-        if (sizeof(internal_node_t) + (node->npairs + 1) * sizeof(*node->pair_offsets) + impl::pair_size_with_key(key_from_parent) >= node->frontmost_offset)
+        if (sizeof(internal_node_t) + (node->npairs + 1) * sizeof(*node->pair_offsets) + impl::pair_size_with_key(key_from_parent) + impl::count_size(node) >= node->frontmost_offset)
             return false;
         uint16_t special_pair_offset = node->pair_offsets[node->npairs-1];
         block_id_t last_offset = get_pair(node, special_pair_offset)->lnode;
-        uint16_t new_pair_offset = impl::insert_pair(node, last_offset, key_from_parent);
+        uint16_t new_pair_offset = impl::insert_pair(node, last_offset, key_from_parent,
+                                                     child_count(node, node->npairs-1));
         node->pair_offsets[node->npairs - 1] = new_pair_offset;
 
         uint16_t new_npairs = node->npairs;
@@ -162,12 +183,15 @@ bool level(block_size_t block_size, internal_node_t *node,
         // and increase efficiency.
         for (;;) {
             const btree_internal_pair *pair_to_move = get_pair_by_index(sibling, 0);
-            uint16_t size_change = sizeof(*node->pair_offsets) + pair_size(pair_to_move);
-            if (new_npairs * sizeof(*node->pair_offsets) + (block_size.value() - node->frontmost_offset) + size_change >= sibling->npairs * sizeof(*sibling->pair_offsets) + (block_size.value() - sibling->frontmost_offset) - size_change) {
+            // The nodes may have different formats, so the pair may not take up the
+            // same space in both.
+            uint16_t size_increase = sizeof(*node->pair_offsets) + pair_size(pair_to_move) + impl::count_size(node);
+            uint16_t size_decrease = sizeof(*node->pair_offsets) + pair_size(sibling, pair_to_move);
+            if (new_npairs * sizeof(*node->pair_offsets) + (block_size.value() - node->frontmost_offset) + size_increase >= sibling->npairs * sizeof(*sibling->pair_offsets) + (block_size.value() - sibling->frontmost_offset) - size_decrease) {
                 break;
             }
 
-            const uint16_t new_offset = impl::insert_pair(node, pair_to_move);
+            const uint16_t new_offset = impl::insert_pair(node, sibling, pair_to_move);
             node->pair_offsets[new_npairs] = new_offset;
             ++new_npairs;
             if (moved_children_out != nullptr) {
@@ -187,6 +211,9 @@ bool level(block_size_t block_size, internal_node_t *node,
 
         btree_internal_pair *special_pair = get_pair(node, special_pair_offset);
         special_pair->lnode = pair_for_parent->lnode;
+        if (is_counted(node)) {
+            impl::set_count(node, special_pair, child_count(sibling, 0));
+        }
 
         keycpy(replacement_key, &pair_for_parent->key);
 
@@ -198,10 +225,11 @@ bool level(block_size_t block_size, internal_node_t *node,
     } else {
         uint16_t offset;
         const btree_key_t *key_from_parent = &get_pair_by_index(parent, get_offset_index(parent, &get_pair_by_index(sibling, 0)->key))->key;
-        if (sizeof(internal_node_t) + (node->npairs + 1) * sizeof(*node->pair_offsets) + impl::pair_size_with_key(key_from_parent) >= node->frontmost_offset)
+        if (sizeof(internal_node_t) + (node->npairs + 1) * sizeof(*node->pair_offsets) + impl::pair_size_with_key(key_from_parent) + impl::count_size(node) >= node->frontmost_offset)
             return false;
         block_id_t first_child = get_pair_by_index(sibling, sibling->npairs-1)->lnode;
-        offset = impl::insert_pair(node, first_child, key_from_parent);
+        offset = impl::insert_pair(node, first_child, key_from_parent,
+                                   child_count(sibling, sibling->npairs-1));
         impl::insert_offset(node, offset, 0);
         if (moved_children_out != nullptr) {
             moved_children_out->push_back(first_child);
@@ -213,12 +241,13 @@ bool level(block_size_t block_size, internal_node_t *node,
         // drastically reduce the number and increase efficiency.
         for (;;) {
             const btree_internal_pair *pair_to_move = get_pair_by_index(sibling, sibling->npairs-1);
-            uint16_t size_change = sizeof(*node->pair_offsets) + pair_size(pair_to_move);
-            if (node->npairs * sizeof(*node->pair_offsets) + (block_size.value() - node->frontmost_offset) + size_change >= sibling->npairs * sizeof(*sibling->pair_offsets) + (block_size.value() - sibling->frontmost_offset) - size_change) {
+            uint16_t size_increase = sizeof(*node->pair_offsets) + pair_size(pair_to_move) + impl::count_size(node);
+            uint16_t size_decrease = sizeof(*node->pair_offsets) + pair_size(sibling, pair_to_move);
+            if (node->npairs * sizeof(*node->pair_offsets) + (block_size.value() - node->frontmost_offset) + size_increase >= sibling->npairs * sizeof(*sibling->pair_offsets) + (block_size.value() - sibling->frontmost_offset) - size_decrease) {
                 break;
             }
 
-            offset = impl::insert_pair(node, pair_to_move);
+            offset = impl::insert_pair(node, sibling, pair_to_move);
             impl::insert_offset(node, offset, 0);
             if (moved_children_out != nullptr) {
                 moved_children_out->push_back(pair_to_move->lnode);
@@ -274,12 +303,13 @@ void update_key(internal_node_t *node, const btree_key_t *key_to_replace, const
 
     const int index = get_offset_index(node, key_to_replace);
     const block_id_t tmp_lnode = get_pair_by_index(node, index)->lnode;
+    const uint64_t tmp_count = child_count(node, index);
     impl::delete_pair(node, node->pair_offsets[index]);
 
-    guarantee(sizeof(internal_node_t) + (node->npairs) * sizeof(*node->pair_offsets) + impl::pair_size_with_key(replacement_key) < node->frontmost_offset,
+    guarantee(sizeof(internal_node_t) + (node->npairs) * sizeof(*node->pair_offsets) + impl::pair_size_with_key(replacement_key) + impl::count_size(node) < node->frontmost_offset,
         "cannot fit updated key in internal node");
 
-    const uint16_t new_offset = impl::insert_pair(node, tmp_lnode, replacement_key);
+    const uint16_t new_offset = impl::insert_pair(node, tmp_lnode, replacement_key, tmp_count);
     node->pair_offsets[index] = new_offset;
 
     rassert(is_sorted(node->pair_offsets, node->pair_offsets+node->npairs-1, internal_key_comp(node)),
@@ -288,15 +318,17 @@ void update_key(internal_node_t *node, const btree_key_t *key_to_replace, const
 }
 
 bool is_full(const internal_node_t *node) {
-    return sizeof(internal_node_t) + (node->npairs + 1) * sizeof(*node->pair_offsets) + impl::pair_size_with_key_size(MAX_KEY_SIZE) >=  node->frontmost_offset;
+    return sizeof(internal_node_t) + (node->npairs + 1) * sizeof(*node->pair_offsets) + impl::pair_size_with_key_size(MAX_KEY_SIZE) + impl::count_size(node) >=  node->frontmost_offset;
 }
 
 bool change_unsafe(const internal_node_t *node) {
-    return sizeof(internal_node_t) + node->npairs * sizeof(*node->pair_offsets) + MAX_KEY_SIZE >= node->frontmost_offset;
+    return sizeof(internal_node_t) + node->npairs * sizeof(*node->pair_offsets) + MAX_KEY_SIZE + impl::count_size(node) >= node->frontmost_offset;
 }
 
 void validate(DEBUG_VAR block_size_t block_size, DEBUG_VAR const internal_node_t *node) {
 #ifndef NDEBUG
+    rassert(node->magic == internal_node_t::expected_magic
+            || node->magic == internal_node_t::counted_magic);
     rassert(reinterpret_cast<const char *>(&(node->pair_offsets[node->npairs])) <= reinterpret_cast<const char *>(get_pair(node, node->frontmost_offset)));
     rassert(node->frontmost_offset > 0);
     rassert(node->frontmost_offset <= block_size.value());
@@ -325,11 +357,14 @@ bool is_mergable(block_size_t block_size, const internal_node_t *node, const int
     } else {
         key_from_parent = &get_pair_by_index(parent, get_offset_index(parent, &get_pair_by_index(sibling, 0)->key))->key;
     }
+    // We don't know which of the two nodes the pairs end up in, so we assume the
+    // bigger format if they differ.
+    const internal_node_t *format_node = is_counted(node) ? node : sibling;
     return sizeof(internal_node_t) +
         (node->npairs + sibling->npairs + 1)*sizeof(*node->pair_offsets) +
-        (block_size.value() - node->frontmost_offset) +
-        (block_size.value() - sibling->frontmost_offset) + key_from_parent->size +
-        impl::pair_size_with_key_size(MAX_KEY_SIZE) +
+        impl::pairs_size_as(block_size, node, format_node) +
+        impl::pairs_size_as(block_size, sibling, format_node) + key_from_parent->size +
+        impl::pair_size_with_key_size(MAX_KEY_SIZE) + impl::count_size(format_node) +
         INTERNAL_EPSILON < block_size.value(); // must still have enough room for an arbitrary key  // TODO: we can't be tighter?
 }
 
@@ -341,6 +376,57 @@ size_t pair_size(const btree_internal_pair *pair) {
     return impl::pair_size_with_key_size(pair->key.size);
 }
 
+size_t pair_size(const internal_node_t *node, const btree_internal_pair *pair) {
+    return pair_size(pair) + impl::count_size(node);
+}
+
+bool is_counted(const internal_node_t *node) {
+    return node->magic == internal_node_t::counted_magic;
+}
+
+bool make_counted(block_size_t block_size, internal_node_t *node) {
+    rassert(!is_counted(node));
+    // The node mustn't become full, so that the write path doesn't have to deal with
+    // a full node that it didn't split on the way down.
+    if (sizeof(internal_node_t) + (node->npairs + 1) * sizeof(*node->pair_offsets)
+        + impl::pair_size_with_key_size(MAX_KEY_SIZE)
+        + (node->npairs + 1) * sizeof(uint64_t) >= node->frontmost_offset) {
+        return false;
+    }
+
+    scoped_array_t<char> old_copy(block_size.value());
+    memcpy(old_copy.data(), node, block_size.value());
+    const internal_node_t *old_node
+        = reinterpret_cast<const internal_node_t *>(old_copy.data());
+
+    init(block_size, node, true);
+    for (int i = 0; i < old_node->npairs; ++i) {
+        node->pair_offsets[i]
+            = impl::insert_pair(node, old_node, get_pair_by_index(old_node, i));
+    }
+    node->npairs = old_node->npairs;
+    validate(block_size, node);
+    return true;
+}
+
+uint64_t child_count(const internal_node_t *node, int index) {
+    return impl::get_count(node, get_pair_by_index(node, index));
+}
+
+void set_child_count(internal_node_t *node, int index, uint64_t count) {
+    rassert(is_counted(node));
+    impl::set_count(node, get_pair_by_index(node, index), count);
+}
+
+int child_index(const internal_node_t *node, block_id_t child) {
+    for (int i = 0; i < node->npairs; ++i) {
+        if (get_pair_by_index(node, i)->lnode == child) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 const btree_internal_pair *get_pair(const internal_node_t *node, uint16_t offset) {
     return reinterpret_cast<const btree_internal_pair *>(reinterpret_cast<const char *>(node) + offset);
 }
@@ -377,15 +463,41 @@ size_t pair_size_with_key_size(uint8_t size) {
     return offsetof(btree_internal_pair, key) + offsetof(btree_key_t, contents) + size;
 }
 
+size_t count_size(const internal_node_t *node) {
+    return is_counted(node) ? sizeof(uint64_t) : 0;
+}
+
+// The space that the pairs of `node` would take up in a node of `format_node`'s
+// format.
+size_t pairs_size_as(block_size_t block_size, const internal_node_t *node,
+                     const internal_node_t *format_node) {
+    return block_size.value() - node->frontmost_offset
+        - node->npairs * count_size(node) + node->npairs * count_size(format_node);
+}
+
+uint64_t get_count(const internal_node_t *node, const btree_internal_pair *pair) {
+    if (!is_counted(node)) {
+        return UNKNOWN_CHILD_COUNT;
+    }
+    uint64_t count;
+    memcpy(&count, reinterpret_cast<const char *>(pair) + pair_size(pair), sizeof(count));
+    return count;
+}
+
+void set_count(internal_node_t *node, btree_internal_pair *pair, uint64_t count) {
+    rassert(is_counted(node));
+    memcpy(reinterpret_cast<char *>(pair) + pair_size(pair), &count, sizeof(count));
+}
+
 void delete_pair(internal_node_t *node, uint16_t offset) {
     btree_internal_pair *pair_to_delete = get_pair(node, offset);
     btree_internal_pair *front_pair = get_pair(node, node->frontmost_offset);
-    const size_t shift = pair_size(pair_to_delete);
+    const size_t shift = pair_size(node, pair_to_delete);
     const size_t size = offset - node->frontmost_offset;
 
-    rassert(node->magic == internal_node_t::expected_magic);
+    DEBUG_VAR const block_magic_t magic = node->magic;
     memmove(reinterpret_cast<char *>(front_pair) + shift, front_pair, size);
-    rassert(node->magic == internal_node_t::expected_magic);
+    rassert(node->magic == magic);
 
 
     node->frontmost_offset = node->frontmost_offset + shift;
@@ -401,17 +513,23 @@ void delete_pair(internal_node_t *node, uint16_t offset) {
     memcpy(node->pair_offsets, new_pair_offsets.data(), sizeof(uint16_t) * node->npairs);
 }
 
-uint16_t insert_pair(internal_node_t *node, const btree_internal_pair *pair) {
-    const uint16_t frontmost_offset = node->frontmost_offset - pair_size(pair);
+uint16_t insert_pair(internal_node_t *node, const internal_node_t *source,
+                     const btree_internal_pair *pair) {
+    const uint16_t frontmost_offset = node->frontmost_offset - pair_size(node, pair);
     node->frontmost_offset = frontmost_offset;
 
     // insert contents
-    memcpy(get_pair(node, frontmost_offset), pair, pair_size(pair));
+    btree_internal_pair *new_pair = get_pair(node, frontmost_offset);
+    memcpy(new_pair, pair, pair_size(pair));
+    if (is_counted(node)) {
+        set_count(node, new_pair, get_count(source, pair));
+    }
     return frontmost_offset;
 }
 
-uint16_t insert_pair(internal_node_t *node, block_id_t lnode, const btree_key_t *key) {
-    const uint16_t frontmost_offset = node->frontmost_offset - pair_size_with_key(key);
+uint16_t insert_pair(internal_node_t *node, block_id_t lnode, const btree_key_t *key,
+                     uint64_t count) {
+    const uint16_t frontmost_offset = node->frontmost_offset - pair_size_with_key(key) - count_size(node);
     node->frontmost_offset = frontmost_offset;
 
     btree_internal_pair *new_pair = get_pair(node, frontmost_offset);
@@ -426,6 +544,9 @@ uint16_t insert_pair(internal_node_t *node, block_id_t lnode, const btree_key_t
 
     // Patch the new pair into node_buf
     memcpy(new_pair, new_buf_pair, pair_size_with_key(key));
+    if (is_counted(node)) {
+        set_count(node, new_pair, count);
+    }
 
     return frontmost_offset;
 }
@@ -450,7 +571,8 @@ void make_last_pair_special(internal_node_t *node) {
     const uint16_t old_offset = node->pair_offsets[index];
     btree_key_t tmp;
     tmp.size = 0;
-    const uint16_t new_offset = insert_pair(node, get_pair(node, old_offset)->lnode, &tmp);
+    const uint16_t new_offset = insert_pair(node, get_pair(node, old_offset)->lnode, &tmp,
+                                            get_count(node, get_pair(node, old_offset)));
     node->pair_offsets[index] = new_offset;
     delete_pair(node, old_offset);
 }
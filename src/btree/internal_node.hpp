@@ -2,6 +2,8 @@
 #ifndef BTREE_INTERNAL_NODE_HPP_
 #define BTREE_INTERNAL_NODE_HPP_
 
+#include <stdint.h>
+
 #include <vector>
 
 #include "arch/compiler.hpp"
@@ -22,15 +24,35 @@ ATTR_PACKED(struct btree_internal_pair {
     btree_key_t key;
 });
 
+/* A counted internal node has `internal_node_t::counted_magic` and the same layout as
+a classic one, except that each pair is followed by a `uint64_t` (unaligned) that holds
+the number of live entries in the pair's child, or `UNKNOWN_CHILD_COUNT`.  Counts are
+only ever known for children that are leaf nodes, because those are the only children
+that are write-acquired together with their parent when their entries change (see
+`update_leaf_count()` in btree/operations.hpp).  Readers can use them to count the
+entries in a range without loading every leaf. */
 
 class internal_key_comp;
 
 // In a perfect world, this namespace would be 'branch'.
 namespace internal_node {
 
-void init(block_size_t block_size, internal_node_t *node);
+const uint64_t UNKNOWN_CHILD_COUNT = UINT64_MAX;
+
+void init(block_size_t block_size, internal_node_t *node, bool counted = false);
+// `node` gets the same format as `lnode`.
 void init(block_size_t block_size, internal_node_t *node, const internal_node_t *lnode, const uint16_t *offsets, int numpairs);
 
+bool is_counted(const internal_node_t *node);
+// Converts a classic node into a counted node with every count unknown.  Returns
+// false and leaves the node alone if the counts wouldn't fit.
+bool make_counted(block_size_t block_size, internal_node_t *node);
+// Returns `UNKNOWN_CHILD_COUNT` for classic nodes.
+uint64_t child_count(const internal_node_t *node, int index);
+void set_child_count(internal_node_t *node, int index, uint64_t count);
+// Returns -1 if no pair of `node` points to `child`.
+int child_index(const internal_node_t *node, block_id_t child);
+
 block_id_t lookup(const internal_node_t *node, const btree_key_t *key);
 bool insert(internal_node_t *node, const btree_key_t *key, block_id_t lnode, block_id_t rnode);
 bool remove(block_size_t block_size, internal_node_t *node, const btree_key_t *key);
@@ -51,6 +73,8 @@ bool is_doubleton(const internal_node_t *node);
 void validate(block_size_t block_size, const internal_node_t *node);
 
 size_t pair_size(const btree_internal_pair *pair);
+// The size of `pair` inside of `node`, including its child count if `node` is counted.
+size_t pair_size(const internal_node_t *node, const btree_internal_pair *pair);
 const btree_internal_pair *get_pair(const internal_node_t *node, uint16_t offset);
 btree_internal_pair *get_pair(internal_node_t *node, uint16_t offset);
 
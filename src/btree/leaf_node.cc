@@ -79,6 +79,28 @@ const int SKIP_ENTRY_RESERVED = 251;
 // itself three bytes, so it can't fit in a slot of size one or two. We don't
 // expect to actually see many entries of size one or two, but it pays to be
 // thorough.
+//
+// That's the classic format. A prefix-compressed leaf node (see
+// `is_prefix_compressed()`) has the same layout, except that it keeps a
+// key prefix right in front of the frontmost entry
+//
+// ...[offN-1]........[prefix][prefix size][tstamp][entry][tstamp][entry]...
+//                                         ^
+//                                     frontmost
+//
+// and that its entries store keys relative to that prefix:
+//
+//   [shared][suffix key][btree value]              -- a live entry
+//   [255][shared][suffix key]                      -- a deletion entry
+//
+// The entry's key is the first `shared` bytes of the prefix followed by
+// the contents of `suffix key`. Since `shared` is at most the prefix
+// size, which is at most `MAX_KEY_SIZE`, it doubles as the code byte of
+// a live entry. A key that doesn't start with the whole prefix just gets
+// a smaller `shared`, so inserting a key never has to re-encode the other
+// entries. The prefix itself only changes when a split, merge or level
+// rebuilds the node (see `reprefix()`). Binary search compares the search
+// key with the prefix once and then only looks at the suffixes.
 
 
 struct entry_t;
@@ -101,27 +123,173 @@ bool entry_is_skip(const entry_t *p) {
     return !entry_is_deletion(p) && !entry_is_live(p);
 }
 
-const btree_key_t *entry_key(const entry_t *p) {
+// How the keys of a node are stored: in full, or relative to `prefix`.
+struct key_format_t {
+    bool prefixed;
+    const uint8_t *prefix;
+    int prefix_size;
+};
+
+// A key as it is stored in an entry: the first `shared` bytes of the
+// node's prefix, followed by `suffix`. `shared` is zero for classic nodes.
+struct stored_key_t {
+    const uint8_t *prefix;
+    int shared;
+    const btree_key_t *suffix;
+
+    int size() const { return shared + suffix->size; }
+};
+
+block_magic_t prefixed_leaf_magic(block_magic_t leaf_magic) {
+    rassert((leaf_magic.bytes[3] & 0x80) == 0);
+    leaf_magic.bytes[3] = static_cast<char>(leaf_magic.bytes[3] | 0x80);
+    return leaf_magic;
+}
+
+bool is_prefix_compressed(const leaf_node_t *node) {
+    return (node->magic.bytes[3] & 0x80) != 0;
+}
+
+bool is_leaf_magic(value_sizer_t *sizer, block_magic_t magic) {
+    block_magic_t leaf_magic = sizer->btree_leaf_magic();
+    return magic == leaf_magic || magic == prefixed_leaf_magic(leaf_magic);
+}
+
+// The prefix of a prefix-compressed node sits right in front of `frontmost`.
+const uint8_t *get_prefix(const leaf_node_t *node, int *size_out) {
+    rassert(is_prefix_compressed(node));
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(node) + node->frontmost - 1;
+    *size_out = *p;
+    return p - *p;
+}
+
+// The space the prefix and its size byte take up. Zero for classic nodes.
+int prefix_cost(const leaf_node_t *node) {
+    if (!is_prefix_compressed(node)) {
+        return 0;
+    }
+    int size;
+    get_prefix(node, &size);
+    return 1 + size;
+}
+
+// Moves the prefix of a prefix-compressed node from in front of `old_frontmost` to
+// in front of `new_frontmost`. This has to happen before we write entries below
+// the old frontmost offset.
+void move_prefix(leaf_node_t *node, int old_frontmost, int new_frontmost) {
+    if (!is_prefix_compressed(node) || old_frontmost == new_frontmost) {
+        return;
+    }
+    char *base = reinterpret_cast<char *>(node);
+    int cost = 1 + static_cast<uint8_t>(base[old_frontmost - 1]);
+    memmove(base + new_frontmost - cost, base + old_frontmost - cost, cost);
+}
+
+key_format_t get_key_format(const leaf_node_t *node) {
+    key_format_t ret;
+    ret.prefixed = is_prefix_compressed(node);
+    if (ret.prefixed) {
+        ret.prefix = get_prefix(node, &ret.prefix_size);
+    } else {
+        ret.prefix = nullptr;
+        ret.prefix_size = 0;
+    }
+    return ret;
+}
+
+bool same_key_format(const key_format_t &a, const key_format_t &b) {
+    return a.prefixed == b.prefixed && a.prefix_size == b.prefix_size
+        && memcmp(a.prefix, b.prefix, a.prefix_size) == 0;
+}
+
+int common_prefix_size(const uint8_t *a, int a_size, const uint8_t *b, int b_size) {
+    int n = std::min(a_size, b_size);
+    int i = 0;
+    while (i < n && a[i] == b[i]) {
+        ++i;
+    }
+    return i;
+}
+
+// The number of bytes `key` takes up in an entry.
+int key_cost(const key_format_t &format, const btree_key_t *key) {
+    if (!format.prefixed) {
+        return key->full_size();
+    }
+    int shared = common_prefix_size(key->contents, key->size,
+                                    format.prefix, format.prefix_size);
+    return 1 + sizeof(uint8_t) + key->size - shared;
+}
+
+// Writes `key` the way an entry stores it and returns the number of bytes written.
+int write_key(const key_format_t &format, const btree_key_t *key, char *dest) {
+    if (!format.prefixed) {
+        memcpy(dest, key, key->full_size());
+        return key->full_size();
+    }
+    int shared = common_prefix_size(key->contents, key->size,
+                                    format.prefix, format.prefix_size);
+    dest[0] = static_cast<char>(shared);
+    dest[1] = static_cast<char>(key->size - shared);
+    memcpy(dest + 2, key->contents + shared, key->size - shared);
+    return 2 + key->size - shared;
+}
+
+stored_key_t entry_key(const leaf_node_t *node, const entry_t *p) {
+    const uint8_t *q = reinterpret_cast<const uint8_t *>(p);
     if (entry_is_deletion(p)) {
-        return reinterpret_cast<const btree_key_t *>(1 + reinterpret_cast<const char *>(p));
+        ++q;
+    }
+    stored_key_t ret;
+    if (is_prefix_compressed(node)) {
+        int prefix_size;
+        ret.prefix = get_prefix(node, &prefix_size);
+        ret.shared = *q;
+        rassert(ret.shared <= prefix_size);
+        ++q;
     } else {
-        return reinterpret_cast<const btree_key_t *>(p);
+        ret.prefix = nullptr;
+        ret.shared = 0;
     }
+    ret.suffix = reinterpret_cast<const btree_key_t *>(q);
+    return ret;
 }
 
-const void *entry_value(const entry_t *p) {
+int stored_key_cost(const stored_key_t &key) {
+    return (key.prefix != nullptr ? 1 : 0) + key.suffix->full_size();
+}
+
+void copy_key(btree_key_t *dest, const stored_key_t &key) {
+    dest->size = key.size();
+    if (key.shared > 0) {
+        memcpy(dest->contents, key.prefix, key.shared);
+    }
+    memcpy(dest->contents + key.shared, key.suffix->contents, key.suffix->size);
+}
+
+// Returns the full key, either by pointing into the node or by assembling it in
+// `buf`.
+const btree_key_t *full_key(const stored_key_t &key, store_key_t *buf) {
+    if (key.shared == 0) {
+        return key.suffix;
+    }
+    copy_key(buf->btree_key(), key);
+    return buf->btree_key();
+}
+
+const void *entry_value(const leaf_node_t *node, const entry_t *p) {
     if (entry_is_deletion(p)) {
         return nullptr;
     } else {
-        return reinterpret_cast<const char *>(p) + entry_key(p)->full_size();
+        return reinterpret_cast<const char *>(p) + stored_key_cost(entry_key(node, p));
     }
 }
 
-int entry_size(value_sizer_t *sizer, const entry_t *p) {
+int entry_size(value_sizer_t *sizer, const leaf_node_t *node, const entry_t *p) {
     uint8_t code = *reinterpret_cast<const uint8_t *>(p);
     switch (code) {
     case DELETE_ENTRY_CODE:
-        return 1 + entry_key(p)->full_size();
+        return 1 + stored_key_cost(entry_key(node, p));
     case SKIP_ENTRY_CODE_ONE:
         return 1;
     case SKIP_ENTRY_CODE_TWO:
@@ -130,10 +298,89 @@ int entry_size(value_sizer_t *sizer, const entry_t *p) {
         return 3 + *reinterpret_cast<const uint16_t *>(1 + reinterpret_cast<const char *>(p));
     default:
         rassert(code <= MAX_KEY_SIZE);
-        return entry_key(p)->full_size() + sizer->size(entry_value(p));
+        return stored_key_cost(entry_key(node, p)) + sizer->size(entry_value(node, p));
+    }
+}
+
+// The size of a live or deletion entry of `node` once it's re-encoded for `format`.
+int reencoded_entry_size(value_sizer_t *sizer, const leaf_node_t *node,
+                         const entry_t *p, const key_format_t &format) {
+    if (same_key_format(get_key_format(node), format)) {
+        return entry_size(sizer, node, p);
+    }
+    store_key_t buf;
+    const btree_key_t *key = full_key(entry_key(node, p), &buf);
+    if (entry_is_deletion(p)) {
+        return 1 + key_cost(format, key);
+    } else {
+        rassert(entry_is_live(p));
+        return key_cost(format, key) + sizer->size(entry_value(node, p));
     }
 }
 
+// Copies a live or deletion entry of `node` to `dest`, re-encoding it for `format`
+// if necessary. Returns the number of bytes written.
+int copy_entry(value_sizer_t *sizer, const leaf_node_t *node, const entry_t *p,
+               const key_format_t &format, char *dest) {
+    if (same_key_format(get_key_format(node), format)) {
+        int sz = entry_size(sizer, node, p);
+        memmove(dest, p, sz);
+        return sz;
+    }
+    store_key_t buf;
+    const btree_key_t *key = full_key(entry_key(node, p), &buf);
+    if (entry_is_deletion(p)) {
+        dest[0] = static_cast<char>(DELETE_ENTRY_CODE);
+        return 1 + write_key(format, key, dest + 1);
+    } else {
+        rassert(entry_is_live(p));
+        int keysz = write_key(format, key, dest);
+        const void *value = entry_value(node, p);
+        memcpy(dest + keysz, value, sizer->size(value));
+        return keysz + sizer->size(value);
+    }
+}
+
+// Compares a search key with the keys of one node. For prefix-compressed nodes we
+// compare the search key with the node's prefix once, so that comparing it with
+// an entry only has to look at the entry's suffix.
+class key_comparator_t {
+public:
+    key_comparator_t(const leaf_node_t *node, const btree_key_t *key)
+        : node_(node), key_(key), common_(0), prefix_cmp_(0) {
+        if (is_prefix_compressed(node)) {
+            int prefix_size;
+            const uint8_t *prefix = get_prefix(node, &prefix_size);
+            common_ = common_prefix_size(key->contents, key->size, prefix, prefix_size);
+            if (common_ < prefix_size) {
+                prefix_cmp_ = (common_ == key->size || key->contents[common_] < prefix[common_])
+                    ? -1 : 1;
+            }
+        }
+    }
+
+    // Returns a negative number if the search key is smaller than the entry's key,
+    // zero if they are equal and a positive number otherwise.
+    int cmp(const entry_t *ent) const {
+        stored_key_t k = entry_key(node_, ent);
+        if (common_ < k.shared) {
+            // The keys already differ within the shared part.
+            return prefix_cmp_;
+        }
+        return sized_strcmp(key_->contents + k.shared, key_->size - k.shared,
+                            k.suffix->contents, k.suffix->size);
+    }
+
+private:
+    const leaf_node_t *node_;
+    const btree_key_t *key_;
+    // The size of the common prefix of the search key and the node's prefix.
+    int common_;
+    // The result of comparing the search key with a longer prefix of the node's
+    // prefix than `common_`.
+    int prefix_cmp_;
+};
+
 const entry_t *get_entry(const leaf_node_t *node, int offset) {
     return reinterpret_cast<const entry_t *>(reinterpret_cast<const char *>(node) + offset + (offset < node->tstamp_cutpoint ? sizeof(repli_timestamp_t) : 0));
 }
@@ -156,7 +403,7 @@ struct entry_iter_t {
     void step(value_sizer_t *sizer, const leaf_node_t *node) {
         rassert(!done(sizer));
 
-        offset += entry_size(sizer, get_entry(node, offset)) + (offset < node->tstamp_cutpoint ? sizeof(repli_timestamp_t) : 0);
+        offset += entry_size(sizer, node, get_entry(node, offset)) + (offset < node->tstamp_cutpoint ? sizeof(repli_timestamp_t) : 0);
     }
 
     bool done(value_sizer_t *sizer) const {
@@ -172,17 +419,19 @@ struct entry_iter_t {
     }
 };
 
-void strprint_entry(std::string *out, value_sizer_t *sizer, const entry_t *entry) {
+void strprint_entry(std::string *out, value_sizer_t *sizer, const leaf_node_t *node,
+                    const entry_t *entry) {
+    store_key_t buf;
     if (entry_is_live(entry)) {
-        const btree_key_t *key = entry_key(entry);
+        const btree_key_t *key = full_key(entry_key(node, entry), &buf);
         *out += strprintf("%.*s:", static_cast<int>(key->size), key->contents);
-        *out += strprintf("[entry size=%d]", entry_size(sizer, entry));
-        *out += strprintf("[value size=%d]", sizer->size(entry_value(entry)));
+        *out += strprintf("[entry size=%d]", entry_size(sizer, node, entry));
+        *out += strprintf("[value size=%d]", sizer->size(entry_value(node, entry)));
     } else if (entry_is_deletion(entry)) {
-        const btree_key_t *key = entry_key(entry);
+        const btree_key_t *key = full_key(entry_key(node, entry), &buf);
         *out += strprintf("%.*s:[deletion]", static_cast<int>(key->size), key->contents);
     } else if (entry_is_skip(entry)) {
-        *out += strprintf("[skip %d]", entry_size(sizer, entry));
+        *out += strprintf("[skip %d]", entry_size(sizer, node, entry));
     } else {
         *out += strprintf("[code %d]", *reinterpret_cast<const uint8_t *>(entry));
     }
@@ -194,6 +443,12 @@ std::string strprint_leaf(value_sizer_t *sizer, const leaf_node_t *node) {
     out += strprintf("Leaf(magic='%4.4s', num_pairs=%u, live_size=%u, frontmost=%u, tstamp_cutpoint=%u)\n",
             node->magic.bytes, node->num_pairs, node->live_size, node->frontmost, node->tstamp_cutpoint);
 
+    if (is_prefix_compressed(node)) {
+        int prefix_size;
+        const uint8_t *prefix = get_prefix(node, &prefix_size);
+        out += strprintf("  Prefix: %.*s\n", prefix_size, prefix);
+    }
+
     out += strprintf("  Offsets:");
     for (int i = 0; i < node->num_pairs; ++i) {
         out += strprintf(" %d", node->pair_offsets[i]);
@@ -203,7 +458,7 @@ std::string strprint_leaf(value_sizer_t *sizer, const leaf_node_t *node) {
     out += strprintf("  By Key:");
     for (int i = 0; i < node->num_pairs; ++i) {
         out += strprintf(" %d:", node->pair_offsets[i]);
-        strprint_entry(&out, sizer, get_entry(node, node->pair_offsets[i]));
+        strprint_entry(&out, sizer, node, get_entry(node, node->pair_offsets[i]));
     }
     out += strprintf("\n");
 
@@ -216,7 +471,7 @@ std::string strprint_leaf(value_sizer_t *sizer, const leaf_node_t *node) {
             repli_timestamp_t tstamp = get_timestamp(node, iter.offset);
             out += strprintf("[t=%" PRIu64 "]", tstamp.longtime);
         }
-        strprint_entry(&out, sizer, get_entry(node, iter.offset));
+        strprint_entry(&out, sizer, node, get_entry(node, iter.offset));
         iter.step(sizer, node);
     }
     out += strprintf("\n");
@@ -225,17 +480,19 @@ std::string strprint_leaf(value_sizer_t *sizer, const leaf_node_t *node) {
 }
 
 
-void print_entry(FILE *fp, value_sizer_t *sizer, const entry_t *entry) {
+void print_entry(FILE *fp, value_sizer_t *sizer, const leaf_node_t *node,
+                 const entry_t *entry) {
+    store_key_t buf;
     if (entry_is_live(entry)) {
-        const btree_key_t *key = entry_key(entry);
+        const btree_key_t *key = full_key(entry_key(node, entry), &buf);
         fprintf(fp, "%.*s:", static_cast<int>(key->size), key->contents);
-        fprintf(fp, "[entry size=%d]", entry_size(sizer, entry));
-        fprintf(fp, "[value size=%d]", sizer->size(entry_value(entry)));
+        fprintf(fp, "[entry size=%d]", entry_size(sizer, node, entry));
+        fprintf(fp, "[value size=%d]", sizer->size(entry_value(node, entry)));
     } else if (entry_is_deletion(entry)) {
-        const btree_key_t *key = entry_key(entry);
+        const btree_key_t *key = full_key(entry_key(node, entry), &buf);
         fprintf(fp, "%.*s:[deletion]", static_cast<int>(key->size), key->contents);
     } else if (entry_is_skip(entry)) {
-        fprintf(fp, "[skip %d]", entry_size(sizer, entry));
+        fprintf(fp, "[skip %d]", entry_size(sizer, node, entry));
     } else {
         fprintf(fp, "[code %d]", *reinterpret_cast<const uint8_t *>(entry));
     }
@@ -247,6 +504,12 @@ void print(FILE *fp, value_sizer_t *sizer, const leaf_node_t *node) {
     fprintf(fp, "Leaf(magic='%4.4s', num_pairs=%u, live_size=%u, frontmost=%u, tstamp_cutpoint=%u)\n",
             node->magic.bytes, node->num_pairs, node->live_size, node->frontmost, node->tstamp_cutpoint);
 
+    if (is_prefix_compressed(node)) {
+        int prefix_size;
+        const uint8_t *prefix = get_prefix(node, &prefix_size);
+        fprintf(fp, "  Prefix: %.*s\n", prefix_size, prefix);
+    }
+
     fprintf(fp, "  Offsets:");
     for (int i = 0; i < node->num_pairs; ++i) {
         fprintf(fp, " %d", node->pair_offsets[i]);
@@ -257,7 +520,7 @@ void print(FILE *fp, value_sizer_t *sizer, const leaf_node_t *node) {
     fprintf(fp, "  By Key:");
     for (int i = 0; i < node->num_pairs; ++i) {
         fprintf(fp, " %d:", node->pair_offsets[i]);
-        print_entry(fp, sizer, get_entry(node, node->pair_offsets[i]));
+        print_entry(fp, sizer, node, get_entry(node, node->pair_offsets[i]));
     }
     fprintf(fp, "\n");
 
@@ -273,7 +536,7 @@ void print(FILE *fp, value_sizer_t *sizer, const leaf_node_t *node) {
             fprintf(fp, "[t=%" PRIu64 "]", tstamp.longtime);
             fflush(fp);
         }
-        print_entry(fp, sizer, get_entry(node, iter.offset));
+        print_entry(fp, sizer, node, get_entry(node, iter.offset));
         iter.step(sizer, node);
     }
     fprintf(fp, "\n");
@@ -309,7 +572,7 @@ bool fsck(value_sizer_t *sizer, const btree_key_t *left_exclusive_or_null, const
     // is not before the end of pair_offsets
 
     // Basic sanity checks on fields' values.
-    if (failed(node->magic == sizer->btree_leaf_magic(),
+    if (failed(is_leaf_magic(sizer, node->magic),
                "bad leaf magic")
         || failed(node->frontmost >= offsetof(leaf_node_t, pair_offsets) + node->num_pairs * sizeof(uint16_t),
                   "frontmost offset is before the end of pair_offsets")
@@ -323,6 +586,17 @@ bool fsck(value_sizer_t *sizer, const btree_key_t *left_exclusive_or_null, const
         return false;
     }
 
+    if (is_prefix_compressed(node)) {
+        int offsets_end = offsetof(leaf_node_t, pair_offsets) + node->num_pairs * sizeof(uint16_t);
+        // The prefix size byte comes first, so we can only look at it once we know
+        // that it's behind pair_offsets.
+        if (failed(node->frontmost > offsets_end, "no room for the key prefix")
+            || failed(node->frontmost - prefix_cost(node) >= offsets_end,
+                      "key prefix overlaps pair_offsets")) {
+            return false;
+        }
+    }
+
     // sizeof(offs) is guaranteed to be less than the block_size() thanks to assertions above.
     scoped_array_t<uint16_t> offs(node->num_pairs);
     memcpy(offs.data(), node->pair_offsets, node->num_pairs * sizeof(uint16_t));
@@ -372,21 +646,33 @@ bool fsck(value_sizer_t *sizer, const btree_key_t *left_exclusive_or_null, const
         }
 
         const entry_t *ent = get_entry(node, offset);
+        if (!entry_is_skip(ent) && is_prefix_compressed(node)) {
+            stored_key_t k = entry_key(node, ent);
+            int prefix_size;
+            get_prefix(node, &prefix_size);
+            if (failed(k.shared <= prefix_size, "shared key bytes exceed the prefix")
+                || failed(k.size() <= MAX_KEY_SIZE, "key is too long")) {
+                return false;
+            }
+        }
+
         if (entry_is_live(ent)) {
-            const void *value = entry_value(ent);
+            const void *value = entry_value(node, ent);
             int space = sizer->block_size().value() - (reinterpret_cast<const char *>(value) - reinterpret_cast<const char *>(node));
+            store_key_t key_buf;
+            const btree_key_t *key = full_key(entry_key(node, ent), &key_buf);
             if (!sizer->fits(value, space)) {
-                *msg_out = strprintf("problem with key %.*s: value does not fit\n", entry_key(ent)->size, entry_key(ent)->contents);
+                *msg_out = strprintf("problem with key %.*s: value does not fit\n", key->size, key->contents);
                 return false;
             }
 
             std::string fscker_msg;
-            if (!fscker->fsck(sizer, entry_key(ent), value, &fscker_msg)) {
-                *msg_out = strprintf("Problem with key %.*s: %s\n", entry_key(ent)->size, entry_key(ent)->contents, fscker_msg.c_str());
+            if (!fscker->fsck(sizer, key, value, &fscker_msg)) {
+                *msg_out = strprintf("Problem with key %.*s: %s\n", key->size, key->contents, fscker_msg.c_str());
                 return false;
             }
 
-            observed_live_size += sizeof(uint16_t) + entry_size(sizer, ent);
+            observed_live_size += sizeof(uint16_t) + entry_size(sizer, node, ent);
             if (failed(i < node->num_pairs, "missing entry offsets")) {
                 return false;
             }
@@ -420,8 +706,10 @@ bool fsck(value_sizer_t *sizer, const btree_key_t *left_exclusive_or_null, const
     // Entries look valid, check key ordering.
 
     const btree_key_t *last = left_exclusive_or_null;
+    store_key_t key_bufs[2];
     for (int k = 0; k < node->num_pairs; ++k) {
-        const btree_key_t *key = entry_key(get_entry(node, node->pair_offsets[k]));
+        const btree_key_t *key = full_key(
+            entry_key(node, get_entry(node, node->pair_offsets[k])), &key_bufs[k % 2]);
         if (failed(last == nullptr || btree_key_cmp(last, key) < 0,
                    "keys out of order")) {
             return false;
@@ -450,10 +738,30 @@ void validate(DEBUG_VAR value_sizer_t *sizer, DEBUG_VAR const leaf_node_t *node)
 
 void init(value_sizer_t *sizer, leaf_node_t *node) {
     node->magic = sizer->btree_leaf_magic();
+    if (sizer->btree_leaf_prefix_compression()) {
+        node->magic = prefixed_leaf_magic(node->magic);
+    }
+    node->num_pairs = 0;
+    node->live_size = 0;
+    node->frontmost = sizer->block_size().value();
+    node->tstamp_cutpoint = node->frontmost;
+    if (is_prefix_compressed(node)) {
+        // The prefix starts out empty.
+        *get_at_offset(node, node->frontmost - 1) = 0;
+    }
+}
+
+// Initializes `node` as an empty node with the same format and key prefix as
+// `model`, so that entries can be moved from `model` to `node` verbatim.
+void init_like(value_sizer_t *sizer, leaf_node_t *node, const leaf_node_t *model) {
+    node->magic = model->magic;
     node->num_pairs = 0;
     node->live_size = 0;
     node->frontmost = sizer->block_size().value();
     node->tstamp_cutpoint = node->frontmost;
+    int cost = prefix_cost(model);
+    memcpy(get_at_offset(node, node->frontmost - cost),
+           reinterpret_cast<const char *>(model) + model->frontmost - cost, cost);
 }
 
 int free_space(value_sizer_t *sizer) {
@@ -464,11 +772,11 @@ int free_space(value_sizer_t *sizer) {
 // in the closed interval [0, free_space(sizer)].  Outputs the offset
 // of the first entry for which storing a timestamp is not mandatory.
 int mandatory_cost(value_sizer_t *sizer, const leaf_node_t *node, int required_timestamps, int *tstamp_back_offset_out) {
-    int size = node->live_size;
+    int size = node->live_size + prefix_cost(node);
 
     // node->live_size does not include deletion entries, deletion
     // entries' timestamps, and live entries' timestamps.  We add that
-    // to size.
+    // to size, just like the key prefix above.
 
     entry_iter_t iter = entry_iter_t::make(node);
     int count = 0;
@@ -481,7 +789,7 @@ int mandatory_cost(value_sizer_t *sizer, const leaf_node_t *node, int required_t
                 break;
             }
 
-            int this_entry_cost = sizeof(uint16_t) + sizeof(repli_timestamp_t) + entry_size(sizer, ent);
+            int this_entry_cost = sizeof(uint16_t) + sizeof(repli_timestamp_t) + entry_size(sizer, node, ent);
             deletions_cost += this_entry_cost;
             size += this_entry_cost;
             ++count;
@@ -509,6 +817,12 @@ int leaf_epsilon(value_sizer_t *sizer) {
 
     int key_cost = sizeof(uint8_t) + MAX_KEY_SIZE;
 
+    // Prefix-compressed nodes store an extra byte with the size of the part of the
+    // key that's shared with the prefix.
+    if (sizer->btree_leaf_prefix_compression()) {
+        key_cost += sizeof(uint8_t);
+    }
+
     // If the value is always empty, the DELETE_ENTRY_CODE byte needs to be considered.
     int n = std::max(sizer->max_possible_size(), 1);
     int pair_offsets_cost = sizeof(uint16_t);
@@ -521,6 +835,16 @@ bool is_empty(const leaf_node_t *node) {
     return node->num_pairs == 0;
 }
 
+size_t live_count(const leaf_node_t *node) {
+    size_t count = 0;
+    for (int i = 0; i < node->num_pairs; ++i) {
+        if (entry_is_live(get_entry(node, node->pair_offsets[i]))) {
+            ++count;
+        }
+    }
+    return count;
+}
+
 bool is_full(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *key, const void *value) {
 
     // Upon an insertion, we preserve `MANDATORY_TIMESTAMPS - 1`
@@ -540,7 +864,8 @@ bool is_full(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *k
     // insert.  We conservatively assume the key is not already
     // contained in the node.
 
-    size += sizeof(uint16_t) + sizeof(repli_timestamp_t) + key->full_size() + sizer->size(value);
+    size += sizeof(uint16_t) + sizeof(repli_timestamp_t)
+        + key_cost(get_key_format(node), key) + sizer->size(value);
 
     // The node is full if we can't fit all that data within the free space.
     return size > free_space(sizer);
@@ -613,7 +938,7 @@ void garbage_collect(
 
         entry_t *ent = get_entry(node, offset);
         if (entry_is_live(ent)) {
-            int sz = entry_size(sizer, ent);
+            int sz = entry_size(sizer, node, ent);
             w -= sz;
             memmove(get_at_offset(node, w), ent, sz);
             node->pair_offsets[indices[i]] = w;
@@ -632,7 +957,7 @@ void garbage_collect(
         rassert(!entry_is_skip(ent));
 
         // Preserve the timestamp.
-        int sz = sizeof(repli_timestamp_t) + entry_size(sizer, ent);
+        int sz = sizeof(repli_timestamp_t) + entry_size(sizer, node, ent);
 
         w -= sz;
 
@@ -640,6 +965,7 @@ void garbage_collect(
         node->pair_offsets[indices[i]] = w;
     }
 
+    move_prefix(node, node->frontmost, w);
     node->frontmost = w;
 
     // Now squash dead indices.
@@ -693,7 +1019,9 @@ void clean_entry(void *p, int sz) {
 }
 
 // Moves entries with pair_offsets indices in the clopen range [beg,
-// end) from fro to tow.
+// end) from fro to tow.  Entries get re-encoded if fro and tow store
+// their keys differently, so fro_copysize has to be computed with
+// reencoded_entry_size().
 void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
                    int wpoint, leaf_node_t *tow, int fro_copysize,
                    int fro_mand_offset,
@@ -735,6 +1063,13 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
 
     const int new_frontmost = tow->frontmost - fro_copysize;
 
+    // Get tow's prefix out of the way before we write over it.  From
+    // here on the frontmost offset of tow is the new one, which keeps
+    // the prefix reachable.
+    move_prefix(tow, tow->frontmost, new_frontmost);
+    tow->frontmost = new_frontmost;
+    const key_format_t tow_format = get_key_format(tow);
+
     int wri_offset = new_frontmost;
 
     int adjustable_tow_offsets[MANDATORY_TIMESTAMPS];
@@ -784,12 +1119,15 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
         // Greater timestamps go first.
         if (tow_tstamp < fro_tstamp) {
             entry_t *ent = get_entry(fro, fro_offset);
-            int entsz = entry_size(sizer, ent);
-            int sz = sizeof(repli_timestamp_t) + entsz;
-            memmove(get_at_offset(tow, wri_offset), get_at_offset(fro, fro_offset), sz);
+            int entsz = entry_size(sizer, fro, ent);
+            memmove(get_at_offset(tow, wri_offset), get_at_offset(fro, fro_offset),
+                    sizeof(repli_timestamp_t));
+            int towsz = copy_entry(sizer, fro, ent, tow_format,
+                                   get_at_offset(tow, wri_offset + sizeof(repli_timestamp_t)));
+            int sz = sizeof(repli_timestamp_t) + towsz;
 
             if (entry_is_live(ent)) {
-                livesize += entsz + sizeof(uint16_t);
+                livesize += towsz + sizeof(uint16_t);
                 fro_live_size_adjustment -= entsz + sizeof(uint16_t);
             }
 
@@ -805,7 +1143,7 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
             fro_index++;
 
         } else {
-            int sz = sizeof(repli_timestamp_t) + entry_size(sizer, get_entry(tow, tow_offset));
+            int sz = sizeof(repli_timestamp_t) + entry_size(sizer, tow, get_entry(tow, tow_offset));
             memmove(get_at_offset(tow, wri_offset), get_at_offset(tow, tow_offset), sz);
 
             // Update the pair offset of the entry we've moved.
@@ -833,10 +1171,10 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
         int fro_offset = fro->pair_offsets[beg + tow->pair_offsets[fro_index]];
         entry_t *ent = get_entry(fro, fro_offset);
         if (entry_is_live(ent)) {
-            int sz = entry_size(sizer, ent);
-            memmove(get_at_offset(tow, wri_offset), ent, sz);
-            clean_entry(ent, sz);
-            fro_live_size_adjustment -= sz + sizeof(uint16_t);
+            int entsz = entry_size(sizer, fro, ent);
+            int sz = copy_entry(sizer, fro, ent, tow_format, get_at_offset(tow, wri_offset));
+            clean_entry(ent, entsz);
+            fro_live_size_adjustment -= entsz + sizeof(uint16_t);
 
             fro->pair_offsets[beg + tow->pair_offsets[fro_index]] = wri_offset;
 
@@ -850,7 +1188,7 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
             // This is a dead entry.  We'll need to squash this dead entry later.
             fro->pair_offsets[beg + tow->pair_offsets[fro_index]] = 0;
 
-            int sz = entry_size(sizer, ent);
+            int sz = entry_size(sizer, fro, ent);
             clean_entry(ent, sz);
         }
     }
@@ -864,7 +1202,7 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
         rassert(wri_offset <= tow_offset);
 
         entry_t *ent = get_entry(tow, tow_offset);
-        int sz = entry_size(sizer, ent);
+        int sz = entry_size(sizer, tow, ent);
         if (entry_is_live(ent)) {
             memmove(get_at_offset(tow, wri_offset), ent, sz);
 
@@ -917,8 +1255,6 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
     memmove(fro->pair_offsets + beg, fro->pair_offsets + end, sizeof(uint16_t) * (fro->num_pairs - end));
     fro->num_pairs -= end - beg;
 
-    tow->frontmost = new_frontmost;
-
     tow->live_size = livesize;
 
     tow->tstamp_cutpoint = new_tstamp_cutpoint;
@@ -936,7 +1272,7 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
                 const entry_t *entry = get_entry(tow, offset);
                 // Skip deletions
                 if (entry_is_live(entry)) {
-                    moved_values_out->push_back(entry_value(entry));
+                    moved_values_out->push_back(entry_value(tow, entry));
                 }
             }
         }
@@ -960,6 +1296,102 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
     validate(sizer, tow);
 }
 
+// Re-encodes the keys of a prefix-compressed node against the longest
+// prefix that all of its keys share, dropping skip entries on the way.
+// Leaves the node alone if that wouldn't make it any smaller.
+void reprefix(value_sizer_t *sizer, leaf_node_t *node) {
+    if (!is_prefix_compressed(node) || node->num_pairs == 0) {
+        return;
+    }
+
+    // The keys are sorted, so all of them start with the common prefix of
+    // the first and the last key.
+    store_key_t first;
+    store_key_t last;
+    copy_key(first.btree_key(),
+             entry_key(node, get_entry(node, node->pair_offsets[0])));
+    copy_key(last.btree_key(),
+             entry_key(node, get_entry(node, node->pair_offsets[node->num_pairs - 1])));
+
+    key_format_t format;
+    format.prefixed = true;
+    format.prefix = first.contents();
+    format.prefix_size = common_prefix_size(first.contents(), first.size(),
+                                            last.contents(), last.size());
+    if (same_key_format(get_key_format(node), format)) {
+        return;
+    }
+
+    // Collect the offsets of the entries we keep (in increasing order) and
+    // make sure that they fit once they are re-encoded.
+    const int bs = sizer->block_size().value();
+    std::vector<int> offsets;
+    int new_size = 1 + format.prefix_size;
+    for (entry_iter_t iter = entry_iter_t::make(node); !iter.done(sizer);
+         iter.step(sizer, node)) {
+        const entry_t *ent = get_entry(node, iter.offset);
+        if (!entry_is_skip(ent)) {
+            offsets.push_back(iter.offset);
+            new_size += reencoded_entry_size(sizer, node, ent, format)
+                + (iter.offset < node->tstamp_cutpoint ? sizeof(repli_timestamp_t) : 0);
+        }
+    }
+    if (offsetof(leaf_node_t, pair_offsets) + sizeof(uint16_t) * node->num_pairs
+        + new_size > static_cast<size_t>(bs)) {
+        return;
+    }
+
+    const int old_cost = mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS);
+
+    scoped_array_t<char> scratch(bs);
+    memcpy(scratch.data(), node, bs);
+    const leaf_node_t *old_node = reinterpret_cast<const leaf_node_t *>(scratch.data());
+
+    // Write the entries back to front, so that they keep their order.
+    std::vector<uint16_t> new_offsets(offsets.size());
+    int w = bs;
+    int new_tstamp_cutpoint = bs;
+    int live_size = 0;
+    for (int k = static_cast<int>(offsets.size()) - 1; k >= 0; --k) {
+        const entry_t *ent = get_entry(old_node, offsets[k]);
+        int sz = reencoded_entry_size(sizer, old_node, ent, format);
+        w -= sz;
+        copy_entry(sizer, old_node, ent, format, get_at_offset(node, w));
+        if (entry_is_live(ent)) {
+            live_size += sz + sizeof(uint16_t);
+        }
+        if (offsets[k] < old_node->tstamp_cutpoint) {
+            w -= sizeof(repli_timestamp_t);
+            *reinterpret_cast<repli_timestamp_t *>(get_at_offset(node, w))
+                = get_timestamp(old_node, offsets[k]);
+        } else {
+            new_tstamp_cutpoint = w;
+        }
+        new_offsets[k] = w;
+    }
+
+    for (int i = 0; i < node->num_pairs; ++i) {
+        auto it = std::lower_bound(offsets.begin(), offsets.end(),
+                                   old_node->pair_offsets[i]);
+        rassert(it != offsets.end() && *it == old_node->pair_offsets[i]);
+        node->pair_offsets[i] = new_offsets[it - offsets.begin()];
+    }
+
+    node->frontmost = w;
+    node->tstamp_cutpoint = new_tstamp_cutpoint;
+    node->live_size = live_size;
+    *get_at_offset(node, w - 1) = static_cast<char>(format.prefix_size);
+    memcpy(get_at_offset(node, w - 1 - format.prefix_size), format.prefix,
+           format.prefix_size);
+
+    if (mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS) > old_cost) {
+        // Re-encoding the entries cost more than the longer prefix saved.
+        memcpy(node, scratch.data(), bs);
+    }
+
+    validate(sizer, node);
+}
+
 void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out) {
     int tstamp_back_offset;
     int mandatory = mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS, &tstamp_back_offset);
@@ -984,7 +1416,7 @@ void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_ke
 
         if (entry_is_live(ent)) {
             prev_rcost = rcost;
-            rcost += entry_size(sizer, ent) + sizeof(uint16_t) + (offset < tstamp_back_offset ? sizeof(repli_timestamp_t) : 0);
+            rcost += entry_size(sizer, node, ent) + sizeof(uint16_t) + (offset < tstamp_back_offset ? sizeof(repli_timestamp_t) : 0);
 
             ++num_mandatories;
         } else {
@@ -992,7 +1424,7 @@ void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_ke
 
             if (offset < tstamp_back_offset) {
                 prev_rcost = rcost;
-                rcost += entry_size(sizer, ent) + sizeof(uint16_t) + sizeof(repli_timestamp_t);
+                rcost += entry_size(sizer, node, ent) + sizeof(uint16_t) + sizeof(repli_timestamp_t);
 
                 ++num_mandatories;
             }
@@ -1026,38 +1458,68 @@ void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_ke
     guarantee(mandatory - end_rcost >= free_space(sizer) / 2 - leaf_epsilon(sizer));
 
     // Now we wish to move the elements at indices [s, num_pairs) to rnode.
+    // rnode starts out with node's prefix, so the entries can be moved as
+    // they are.
 
-    init(sizer, rnode);
+    init_like(sizer, rnode, node);
 
     int node_copysize = end_rcost - num_mandatories * sizeof(uint16_t);
     move_elements(sizer, node, s, node->num_pairs, 0, rnode, node_copysize,
                   tstamp_back_offset, nullptr);
 
-    keycpy(median_out, entry_key(get_entry(node, node->pair_offsets[s - 1])));
+    copy_key(median_out, entry_key(node, get_entry(node, node->pair_offsets[s - 1])));
+
+    // Each half covers a narrower range of keys, so they may be able to
+    // use longer prefixes.
+    reprefix(sizer, node);
+    reprefix(sizer, rnode);
+}
+
+// An upper bound for how much the entries of `node` grow if they get
+// re-encoded for `format`.
+int reencoding_growth(value_sizer_t *sizer, const leaf_node_t *node,
+                      const key_format_t &format) {
+    if (same_key_format(get_key_format(node), format)) {
+        return 0;
+    }
+    int growth = 0;
+    for (int i = 0; i < node->num_pairs; ++i) {
+        const entry_t *ent = get_entry(node, node->pair_offsets[i]);
+        growth += std::max(0, reencoded_entry_size(sizer, node, ent, format)
+                              - entry_size(sizer, node, ent));
+    }
+    return growth;
 }
 
 void merge(value_sizer_t *sizer, leaf_node_t *left, leaf_node_t *right) {
     rassert(left != right);
 
-    rassert(is_underfull(sizer, left));
-    rassert(is_underfull(sizer, right));
+    rassert(is_mergable(sizer, left, right));
 
     int tstamp_back_offset;
     int mandatory = mandatory_cost(sizer, left, MANDATORY_TIMESTAMPS, &tstamp_back_offset);
 
-    int left_copysize = mandatory;
+    // left's entries take on right's key format.
+    const key_format_t right_format = get_key_format(right);
+
+    // left's prefix doesn't get copied.
+    int left_copysize = mandatory - prefix_cost(left);
     // Uncount the uint16_t cost of mandatory entries.  Sigh.
     // This includes deletion entries *before* the `tstamp_back_offset`, as well
     // as all non-deletion entries.
     for (int i = 0; i < left->num_pairs; ++i) {
-        if (left->pair_offsets[i] < tstamp_back_offset
-            || !entry_is_deletion(get_entry(left, left->pair_offsets[i]))) {
+        const entry_t *ent = get_entry(left, left->pair_offsets[i]);
+        if (left->pair_offsets[i] < tstamp_back_offset || !entry_is_deletion(ent)) {
             left_copysize -= sizeof(uint16_t);
+            left_copysize += reencoded_entry_size(sizer, left, ent, right_format)
+                - entry_size(sizer, left, ent);
         }
     }
 
     move_elements(sizer, left, 0, left->num_pairs, 0, right, left_copysize,
                   tstamp_back_offset, nullptr);
+
+    reprefix(sizer, right);
 }
 
 // We move keys out of sibling and into node.
@@ -1067,9 +1529,14 @@ bool level(value_sizer_t *sizer, int nodecmp_node_with_sib,
            std::vector<const void *> *moved_values_out) {
     rassert(node != sibling);
 
-    // If sibling were underfull, we'd just merge the nodes.
+    // Entries that we move get re-encoded for node's key format.
+    const key_format_t node_format = get_key_format(node);
+    const bool same_format = same_key_format(node_format, get_key_format(sibling));
+
+    // If sibling were underfull, we'd just merge the nodes -- unless
+    // is_mergable() found that re-encoding the keys wouldn't fit.
     rassert(is_underfull(sizer, node));
-    rassert(!is_underfull(sizer, sibling));
+    rassert(!is_underfull(sizer, sibling) || !same_format);
 
     // First figure out the inclusive range [beg, end] of elements we want to move
     // from sibling.
@@ -1080,6 +1547,11 @@ bool level(value_sizer_t *sizer, int nodecmp_node_with_sib,
     int sibling_weight = mandatory_cost(sizer, sibling, MANDATORY_TIMESTAMPS,
                                         &tstamp_back_offset);
 
+    if (!same_format && (node_weight >= sibling_weight || sibling->num_pairs < 2)) {
+        // An underfull sibling that has nothing to spare.
+        return false;
+    }
+
     guarantee(node_weight < sibling_weight);
 
     if (nodecmp_node_with_sib < 0) {
@@ -1106,36 +1578,42 @@ bool level(value_sizer_t *sizer, int nodecmp_node_with_sib,
     int weight_movement = 0;
     int num_mandatories = 0;
     int prev_diff = sizer->block_size().value();  // some impossibly large value
+    bool node_is_full = false;
     for (;;) {
         int offset = sibling->pair_offsets[*w];
         entry_t *ent = get_entry(sibling, offset);
 
         // We only take mandatory entries' costs into consideration.
+        bool is_mandatory;
+        int overhead = sizeof(uint16_t);
         if (entry_is_live(ent)) {
-            int sz = entry_size(sizer, ent) + sizeof(uint16_t) + (offset < tstamp_back_offset ? sizeof(repli_timestamp_t) : 0);
+            is_mandatory = true;
+            overhead += (offset < tstamp_back_offset ? sizeof(repli_timestamp_t) : 0);
+        } else {
+            rassert(entry_is_deletion(ent));
+            is_mandatory = offset < tstamp_back_offset;
+            overhead += sizeof(repli_timestamp_t);
+        }
+
+        if (is_mandatory) {
+            int sz = entry_size(sizer, sibling, ent) + overhead;
+            int node_sz = reencoded_entry_size(sizer, sibling, ent, node_format) + overhead;
+            if (node_weight + node_sz > free_space(sizer)) {
+                // Re-encoding the keys made them too big for node.
+                node_is_full = true;
+                break;
+            }
             prev_diff = sibling_weight - node_weight;
             prev_weight_movement = weight_movement;
-            weight_movement += sz;
-            node_weight += sz;
+            weight_movement += node_sz;
+            node_weight += node_sz;
             sibling_weight -= sz;
 
             ++num_mandatories;
-        } else {
-            rassert(entry_is_deletion(ent));
-
-            if (offset < tstamp_back_offset) {
-                int sz = entry_size(sizer, ent) + sizeof(uint16_t) + sizeof(repli_timestamp_t);
-                prev_diff = sibling_weight - node_weight;
-                prev_weight_movement = weight_movement;
-                weight_movement += sz;
-                node_weight += sz;
-                sibling_weight -= sz;
-
-                ++num_mandatories;
-            }
         }
 
-        if (end - beg == sibling->num_pairs - 1 || node_weight >= sibling_weight) {
+        // We always leave at least one entry in sibling.
+        if (end - beg == sibling->num_pairs - 2 || node_weight >= sibling_weight) {
             break;
         }
 
@@ -1144,7 +1622,10 @@ bool level(value_sizer_t *sizer, int nodecmp_node_with_sib,
 
     guarantee(end - beg < sibling->num_pairs - 1);
 
-    if (prev_diff <= sibling_weight - node_weight) {
+    if (node_is_full) {
+        // The entry at *w didn't make it.
+        *w -= wstep;
+    } else if (prev_diff <= sibling_weight - node_weight) {
         *w -= wstep;
         --num_mandatories;
         weight_movement = prev_weight_movement;
@@ -1165,16 +1646,37 @@ bool level(value_sizer_t *sizer, int nodecmp_node_with_sib,
     guarantee(sibling->num_pairs > 0);
 
     if (nodecmp_node_with_sib < 0) {
-        keycpy(replacement_key_out, entry_key(get_entry(node, node->pair_offsets[node->num_pairs - 1])));
+        copy_key(replacement_key_out,
+                 entry_key(node, get_entry(node, node->pair_offsets[node->num_pairs - 1])));
     } else {
-        keycpy(replacement_key_out, entry_key(get_entry(sibling, sibling->pair_offsets[sibling->num_pairs - 1])));
+        copy_key(replacement_key_out,
+                 entry_key(sibling, get_entry(sibling, sibling->pair_offsets[sibling->num_pairs - 1])));
     }
 
+    // We can't re-encode node, because `moved_values_out` points into it.
+    reprefix(sizer, sibling);
+
     return true;
 }
 
 bool is_mergable(value_sizer_t *sizer, const leaf_node_t *node, const leaf_node_t *sibling) {
-    return is_underfull(sizer, node) && is_underfull(sizer, sibling);
+    if (!is_underfull(sizer, node) || !is_underfull(sizer, sibling)) {
+        return false;
+    }
+
+    const key_format_t node_format = get_key_format(node);
+    const key_format_t sibling_format = get_key_format(sibling);
+    if (same_key_format(node_format, sibling_format)) {
+        return true;
+    }
+
+    // The keys of the node that gets merged into the other one get
+    // re-encoded, so we have to check that they still fit.
+    int growth = std::max(reencoding_growth(sizer, node, sibling_format),
+                          reencoding_growth(sizer, sibling, node_format));
+    return mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS)
+        + mandatory_cost(sizer, sibling, MANDATORY_TIMESTAMPS) + growth
+        < free_space(sizer) - 2 * leaf_epsilon(sizer);
 }
 
 // Sets *index_out to the index for the live entry or deletion entry
@@ -1187,13 +1689,13 @@ bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) {
     // beg == 0 or key > *(beg - 1).
     // end == num_pairs or key < *end.
 
+    key_comparator_t comparator(node, key);
+
     while (beg < end) {
         // when (end - beg) > 0, (end - beg) / 2 is always less than (end - beg).  So beg <= test_point < end.
         int test_point = beg + (end - beg) / 2;
 
-        const btree_key_t *ek = entry_key(get_entry(node, node->pair_offsets[test_point]));
-
-        int res = btree_key_cmp(key, ek);
+        int res = comparator.cmp(get_entry(node, node->pair_offsets[test_point]));
 
         if (res < 0) {
             // key < *test_point.
@@ -1220,7 +1722,7 @@ bool lookup(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *ke
     if (find_key(node, key, &index)) {
         const entry_t *ent = get_entry(node, node->pair_offsets[index]);
         if (entry_is_live(ent)) {
-            const void *val = entry_value(ent);
+            const void *val = entry_value(node, ent);
             memcpy(value_out, val, sizer->size(val));
             return true;
         }
@@ -1291,7 +1793,7 @@ MUST_USE bool prepare_space_for_new_entry(
         int offset = node->pair_offsets[index];
         entry_t *ent = get_entry(node, offset);
 
-        int sz = entry_size(sizer, ent);
+        int sz = entry_size(sizer, node, ent);
 
         if (entry_is_live(ent)) {
             node->live_size -= sizeof(uint16_t) + sz;
@@ -1323,7 +1825,7 @@ MUST_USE bool prepare_space_for_new_entry(
             sizeof(uint16_t) * (node->num_pairs + (found ? 0 : 1)) +
             sizeof(repli_timestamp_t) +
             new_entry_size >
-            node->frontmost) {
+            static_cast<size_t>(node->frontmost - prefix_cost(node))) {
 
         if (found) {
             /* We can't re-use an existing index if we're garbage collecting. */
@@ -1402,7 +1904,7 @@ MUST_USE bool prepare_space_for_new_entry(
            + sizeof(uint16_t) * (node->num_pairs + (found ? 0 : 1))
            + new_entry_size
            + sizeof(repli_timestamp_t)
-           > node->frontmost) {
+           > static_cast<size_t>(node->frontmost - prefix_cost(node))) {
         actually_create_entry = false;
         drop_timestamps = true;
     }
@@ -1444,6 +1946,8 @@ MUST_USE bool prepare_space_for_new_entry(
 
     int total_space_for_new_entry = new_entry_size + (new_entry_should_have_timestamp ? sizeof(repli_timestamp_t) : 0);
 
+    move_prefix(node, node->frontmost, node->frontmost - total_space_for_new_entry);
+
     if (end_of_where_new_entry_should_go == node->frontmost) {
         /* This is the common case. Just like before, we check for this case
         specially and short-circuit, even though the algorithm in the `else`
@@ -1467,7 +1971,7 @@ MUST_USE bool prepare_space_for_new_entry(
 
     node->frontmost -= total_space_for_new_entry;
     guarantee(offsetof(leaf_node_t, pair_offsets)
-              + sizeof(uint16_t) * node->num_pairs <= node->frontmost);
+              + sizeof(uint16_t) * node->num_pairs + prefix_cost(node) <= node->frontmost);
 
     /* Write the timestamp if we need one, and update `node->tstamp_cutpoint` if
     we don't. */
@@ -1510,20 +2014,21 @@ void insert(
 
     /* Make space for the entry itself */
 
+    const int keysz = key_cost(get_key_format(node), key);
+
     char *location_to_write_data;
     bool should_write = prepare_space_for_new_entry(sizer, node,
-        key, key->full_size() + sizer->size(value), tstamp, maximum_existing_tstamp,
+        key, keysz + sizer->size(value), tstamp, maximum_existing_tstamp,
         true,
         &location_to_write_data);
     guarantee(should_write);
 
     /* Now copy the data into the node itself */
 
-    memcpy(location_to_write_data, key, key->full_size());
-    location_to_write_data += key->full_size();
+    location_to_write_data += write_key(get_key_format(node), key, location_to_write_data);
     memcpy(location_to_write_data, value, sizer->size(value));
 
-    node->live_size += sizeof(uint16_t) + key->full_size() + sizer->size(value);
+    node->live_size += sizeof(uint16_t) + keysz + sizer->size(value);
 
     validate(sizer, node);
 }
@@ -1543,14 +2048,14 @@ void remove(
     char *location_to_write_data;
     if (prepare_space_for_new_entry(sizer, node,
             key,
-            1 + key->full_size(),   /* 1 for `DELETE_ENTRY_CODE` */
+            1 + key_cost(get_key_format(node), key),   /* 1 for `DELETE_ENTRY_CODE` */
             tstamp,
             maximum_existing_tstamp,
             false,
             &location_to_write_data)) {
         *location_to_write_data = static_cast<char>(DELETE_ENTRY_CODE);
         ++location_to_write_data;
-        memcpy(location_to_write_data, key, key->full_size());
+        write_key(get_key_format(node), key, location_to_write_data);
     }
 
     validate(sizer, node);
@@ -1564,7 +2069,7 @@ void erase_presence(value_sizer_t *sizer, leaf_node_t *node, const btree_key_t *
         int offset = node->pair_offsets[index];
         entry_t *ent = get_entry(node, offset);
 
-        int sz = entry_size(sizer, ent);
+        int sz = entry_size(sizer, node, ent);
         if (entry_is_live(ent)) {
             node->live_size -= sizeof(uint16_t) + sz;
         }
@@ -1637,7 +2142,7 @@ void erase_deletions(
         if (entry_is_deletion(ent)) {
             clean_entry(
                 get_at_offset(node, off),
-                sizeof(repli_timestamp_t) + entry_size(sizer, ent));
+                sizeof(repli_timestamp_t) + entry_size(sizer, node, ent));
             deletion_offsets.insert(off);
         } else {
             /* This is the code path for both skip entries and live entries, because skip
@@ -1701,7 +2206,9 @@ continue_bool_t visit_entries(
             continue;
         }
 
-        if (continue_bool_t::ABORT == cb(entry_key(ent), tstamp, entry_value(ent))) {
+        store_key_t key_buf;
+        const btree_key_t *key = full_key(entry_key(node, ent), &key_buf);
+        if (continue_bool_t::ABORT == cb(key, tstamp, entry_value(node, ent))) {
             return continue_bool_t::ABORT;
         }
     }
@@ -1718,7 +2225,8 @@ std::pair<const btree_key_t *, const void *> iterator::operator*() const {
     guarantee(index_ < static_cast<int>(node_->num_pairs));
     guarantee(index_ >= 0);
     const entry_t *entree = get_entry(node_, node_->pair_offsets[index_]);
-    return std::make_pair(entry_key(entree), entry_value(entree));
+    return std::make_pair(full_key(entry_key(node_, entree), &key_buf_),
+                          entry_value(node_, entree));
 }
 
 iterator &iterator::operator++() {
@@ -1809,9 +2317,8 @@ leaf::reverse_iterator exclusive_upper_bound(const btree_key_t *key, const leaf_
     leaf::find_key(&leaf_node, key, &index);
     if (index < leaf_node.num_pairs) {
         const leaf::entry_t *entry = leaf::get_entry(&leaf_node, leaf_node.pair_offsets[index]);
-        const btree_key_t *ekey = leaf::entry_key(entry);
         if (entry_is_live(entry) &&
-            btree_key_cmp(ekey, key) == 0) {
+            key_comparator_t(&leaf_node, key).cmp(entry) == 0) {
             // We have to skip this entry to make the iterator exclusive,
             // hence the ++.
             return ++leaf_node_t::reverse_iterator(&leaf_node, index);
@@ -7,6 +7,7 @@
 #include <vector>
 
 #include "arch/compiler.hpp"
+#include "btree/keys.hpp"
 #include "btree/types.hpp"
 #include "buffer_cache/types.hpp"
 #include "containers/optional.hpp"
@@ -120,10 +121,27 @@ bool fsck(value_sizer_t *sizer, const btree_key_t *left_exclusive_or_null, const
 
 void validate(value_sizer_t *sizer, const leaf_node_t *node);
 
+// Leaf nodes come in two formats, which are described in leaf_node.cc. The classic
+// format stores every key in full, the prefix-compressed format stores keys
+// front-coded against a prefix that is kept once per node. The magic tells them
+// apart: a prefix-compressed node has the value type's `btree_leaf_magic()` with
+// the high bit of the last byte set.
+block_magic_t prefixed_leaf_magic(block_magic_t leaf_magic);
+
+bool is_prefix_compressed(const leaf_node_t *node);
+
+// Returns true if `magic` is the magic of a leaf node of `sizer`'s value type, in
+// either format.
+bool is_leaf_magic(value_sizer_t *sizer, block_magic_t magic);
+
+// Creates an empty leaf node in the format that `sizer` asks for.
 void init(value_sizer_t *sizer, leaf_node_t *node);
 
 bool is_empty(const leaf_node_t *node);
 
+// The number of entries in the node that aren't deletions.
+size_t live_count(const leaf_node_t *node);
+
 bool is_full(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *key, const void *value);
 
 bool is_underfull(value_sizer_t *sizer, const leaf_node_t *node);
@@ -202,6 +220,8 @@ class iterator {
 public:
     iterator();
     iterator(const leaf_node_t *node, int index);
+    // The key of a prefix-compressed node gets assembled in a buffer inside the
+    // iterator, so the key pointer is only valid until the iterator changes.
     std::pair<const btree_key_t *, const void *> operator*() const;
     iterator &operator++();
     iterator &operator--();
@@ -216,6 +236,7 @@ private:
     int cmp(const iterator &other) const;
     const leaf_node_t *node_;
     int index_;
+    mutable store_key_t key_buf_;
 };
 
 class reverse_iterator {
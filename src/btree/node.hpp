@@ -27,6 +27,14 @@ public:
     virtual block_magic_t btree_leaf_magic() const = 0;
     virtual max_block_size_t block_size() const = 0;
 
+    // Whether new leaf nodes should use the prefix-compressed format (see
+    // `btree/leaf_node.cc`). Existing leaf nodes keep whichever format they have.
+    virtual bool btree_leaf_prefix_compression() const { return false; }
+
+    // Whether the parents of leaf nodes should keep a count of each leaf's live
+    // entries (see `btree/internal_node.hpp`).
+    virtual bool btree_counted_internal_nodes() const { return false; }
+
 private:
     DISABLE_COPYING(value_sizer_t);
 };
@@ -50,6 +58,8 @@ ATTR_PACKED(struct internal_node_t {
     uint16_t pair_offsets[0];
 
     static const block_magic_t expected_magic;
+    // The magic of counted internal nodes (see btree/internal_node.hpp).
+    static const block_magic_t counted_magic;
 });
 
 // A node_t is either a btree_internal_node or a btree_leaf_node.
@@ -60,7 +70,8 @@ ATTR_PACKED(struct node_t {
 namespace node {
 
 inline bool is_internal(const node_t *node) {
-    if (node->magic == internal_node_t::expected_magic) {
+    if (node->magic == internal_node_t::expected_magic
+        || node->magic == internal_node_t::counted_magic) {
         return true;
     }
     return false;
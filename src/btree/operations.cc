@@ -134,8 +134,11 @@ void check_and_handle_split(value_sizer_t *sizer,
         *last_buf = buf_lock_t(sb->expose_buf(), alt_create_t::create);
         {
             buf_write_t last_write(last_buf);
+            // Only parents of leaf nodes keep counts.
             internal_node::init(sizer->block_size(),
-                                static_cast<internal_node_t *>(last_write.get_data_write()));
+                                static_cast<internal_node_t *>(last_write.get_data_write()),
+                                new_value != nullptr
+                                    && sizer->btree_counted_internal_nodes());
         }
         // We set the recency of the new root block to the recency of its two sub-trees.
         last_buf->set_recency(buf->get_recency());
@@ -152,6 +155,9 @@ void check_and_handle_split(value_sizer_t *sizer,
         rassert(success, "could not insert internal btree node");
     }
 
+    update_leaf_count(sizer, buf, last_buf);
+    update_leaf_count(sizer, &rbuf, last_buf);
+
     // We've split the node; now figure out where the key goes and release the other buf (since we're done with it).
     if (0 >= btree_key_cmp(key, median)) {
         // The key goes in the old buf (the left one).
@@ -164,6 +170,57 @@ void check_and_handle_split(value_sizer_t *sizer,
     }
 }
 
+void update_leaf_count(value_sizer_t *sizer,
+                       buf_lock_t *buf,
+                       buf_lock_t *last_buf) {
+    if (last_buf->empty()) {
+        return;
+    }
+    uint64_t count;
+    {
+        buf_read_t buf_read(buf);
+        const node_t *node = static_cast<const node_t *>(buf_read.get_data_read());
+        if (node::is_internal(node)) {
+            return;
+        }
+        count = leaf::live_count(reinterpret_cast<const leaf_node_t *>(node));
+    }
+    {
+        buf_read_t last_buf_read(last_buf);
+        const internal_node_t *parent_node
+            = static_cast<const internal_node_t *>(last_buf_read.get_data_read());
+        if (!internal_node::is_counted(parent_node)) {
+            // Parents only become counted when counts were asked for.  A parent that
+            // is already counted has to be kept up to date either way, because
+            // readers trust its counts.
+            if (!sizer->btree_counted_internal_nodes()) {
+                return;
+            }
+        } else {
+            const int index = internal_node::child_index(parent_node, buf->block_id());
+            guarantee(index != -1, "leaf node is missing from its parent");
+            if (internal_node::child_count(parent_node, index) == count) {
+                // Don't dirty the parent if nothing changed, e.g. on an update.
+                return;
+            }
+        }
+    }
+
+    buf_write_t last_buf_write(last_buf);
+    internal_node_t *parent_node
+        = static_cast<internal_node_t *>(last_buf_write.get_data_write());
+    if (!internal_node::is_counted(parent_node)
+        && !internal_node::make_counted(sizer->block_size(), parent_node)) {
+        // The parent is too full to be converted.  It gets another chance when it
+        // gets split.
+        return;
+    }
+    internal_node::set_child_count(parent_node,
+                                   internal_node::child_index(parent_node,
+                                                              buf->block_id()),
+                                   count);
+}
+
 // Merge or level the node if necessary.
 // `detacher` is used to detach any values that are removed from `buf` or its
 // sibling, in case `buf` is a leaf.
@@ -280,10 +337,13 @@ void check_and_handle_underfull(value_sizer_t *sizer,
             buf->set_recency(superceding_recency(buf_recency, sib_buf_recency));
 
             if (!parent_was_doubleton) {
-                buf_write_t last_buf_write(last_buf);
-                internal_node::remove(sizer->block_size(),
-                                      static_cast<internal_node_t *>(last_buf_write.get_data_write()),
-                                      key_in_middle.btree_key());
+                {
+                    buf_write_t last_buf_write(last_buf);
+                    internal_node::remove(sizer->block_size(),
+                                          static_cast<internal_node_t *>(last_buf_write.get_data_write()),
+                                          key_in_middle.btree_key());
+                }
+                update_leaf_count(sizer, buf, last_buf);
             } else {
                 // The parent has only 1 key after the merge (which means that
                 // it's the root and our node is its only child). Insert our
@@ -353,6 +413,8 @@ void check_and_handle_underfull(value_sizer_t *sizer,
                                           key_in_middle.btree_key(),
                                           replacement_key);
             }
+            update_leaf_count(sizer, buf, last_buf);
+            update_leaf_count(sizer, &sib_buf, last_buf);
         }
     }
 }
@@ -652,6 +714,8 @@ void apply_keyvalue_change(
         }
     }
 
+    update_leaf_count(sizer, &kv_loc->buf, &kv_loc->last_buf);
+
     // Check to see if the leaf is underfull (following a change in
     // size or a deletion, and merge/level if it is.
     check_and_handle_underfull(sizer, &kv_loc->buf, &kv_loc->last_buf,
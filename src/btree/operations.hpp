@@ -185,6 +185,13 @@ void check_and_handle_underfull(value_sizer_t *sizer,
                                 const btree_key_t *key,
                                 const value_deleter_t *detacher);
 
+/* If `buf` is a leaf node, stores its number of live entries in its parent
+`last_buf` (see `btree/internal_node.hpp`).  Has to be called whenever a leaf node
+changes.  Converts the parent to the counted format if `sizer` asks for it. */
+void update_leaf_count(value_sizer_t *sizer,
+                       buf_lock_t *buf,
+                       buf_lock_t *last_buf);
+
 /* Set sb to have root id as its root block and release sb */
 void insert_root(block_id_t root_id, superblock_t *sb);
 
@@ -5,6 +5,7 @@
 #include "arch/types.hpp"
 #include "arch/runtime/coroutines.hpp"
 #include "buffer_cache/stats.hpp"
+#include "buffer_cache/warm_cache.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "utils.hpp"
 
@@ -141,6 +142,12 @@ void cache_t::configure_flush_interval(flush_interval_t interval) {
         clamp_ring_length(which_cpu_shard_, interval.millis));
 }
 
+void cache_t::keep_warm(const std::string &path) {
+    assert_thread();
+    guarantee(!warmer_.has());
+    warmer_.init(new cache_warmer_t(&page_cache_, path));
+}
+
 cache_account_t cache_t::create_cache_account(int priority) {
     return page_cache_.create_cache_account(priority);
 }
@@ -750,6 +757,20 @@ void buf_lock_t::detach_child(block_id_t child_id) {
             child_id);
 }
 
+void buf_lock_t::prefetch(buf_parent_t parent, block_id_t block_id) {
+    ASSERT_FINITE_CORO_WAITING;
+    cache_t *cache = parent.cache();
+    cache->assert_thread();
+    buf_lock_t *parent_lock = parent.lock_or_null_;
+    if (parent_lock != nullptr && parent_lock->snapshot_node_ != nullptr
+        && parent_lock->snapshot_node_->children_.count(block_id) > 0) {
+        // The snapshotted parent would see an older version of the block, which is
+        // already held by its snapshot node.
+        return;
+    }
+    cache->page_cache_.prefetch(block_id, parent.txn()->account());
+}
+
 repli_timestamp_t buf_lock_t::get_recency() const {
     guarantee(!empty());
     current_page_acq_t *cpa = current_page_acq();
@@ -3,6 +3,7 @@
 #define BUFFER_CACHE_ALT_HPP_
 
 #include <map>
+#include <string>
 #include <vector>
 #include <utility>
 
@@ -16,6 +17,7 @@ class serializer_t;
 
 class buf_lock_t;
 class alt_cache_stats_t;
+class cache_warmer_t;
 class alt_snapshot_node_t;
 class perfmon_collection_t;
 class cache_balancer_t;
@@ -64,6 +66,17 @@ public:
 
     void configure_flush_interval(flush_interval_t interval);
 
+    // Which optional node formats the B-tree code may use for the nodes that it
+    // writes through this cache.  Existing nodes keep their format either way.
+    btree_node_formats_t btree_node_formats() const { return btree_node_formats_; }
+    void set_btree_node_formats(const btree_node_formats_t &formats) {
+        btree_node_formats_ = formats;
+    }
+
+    // Warms up the cache from the warm cache list at `path`, and keeps the list up to
+    // date for as long as the cache exists.  See `buffer_cache/warm_cache.hpp`.
+    void keep_warm(const std::string &path);
+
 private:
     friend class txn_t;
     friend class buf_read_t;
@@ -89,6 +102,12 @@ private:
     repeating_timer_t soft_durability_flusher_;
     which_cpu_shard_t which_cpu_shard_;
 
+    btree_node_formats_t btree_node_formats_;
+
+    // This saves the warm cache list when it's destroyed, so it has to be destroyed
+    // before `page_cache_`.
+    scoped_ptr_t<cache_warmer_t> warmer_;
+
     DISABLE_COPYING(cache_t);
 };
 
@@ -204,6 +223,12 @@ public:
 
     void detach_child(block_id_t child_id);
 
+    // Starts loading the child `block_id` of `parent` into the cache, without
+    // acquiring it, so that a later acquisition through `parent` doesn't have to
+    // wait for the disk.  Does nothing if the child that a snapshotted parent would
+    // see isn't the current version of the block.
+    static void prefetch(buf_parent_t parent, block_id_t block_id);
+
     block_id_t block_id() const {
         guarantee(txn_ != nullptr);
         return current_page_acq()->block_id();
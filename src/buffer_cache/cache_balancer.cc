@@ -6,6 +6,7 @@
 #include "buffer_cache/evicter.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "concurrency/pmap.hpp"
+#include "serializer/block_arena.hpp"
 
 const uint64_t alt_cache_balancer_t::rebalance_check_interval_ms = 20;
 const uint64_t alt_cache_balancer_t::rebalance_access_count_threshold = 100;
@@ -13,6 +14,8 @@ const int64_t alt_cache_balancer_t::rebalance_timeout_ms = 500;
 
 const double alt_cache_balancer_t::read_ahead_proportion = 0.9;
 
+const double alt_cache_balancer_t::max_arena_overhead_proportion = 0.25;
+
 alt_cache_balancer_t::cache_data_t::cache_data_t(alt::evicter_t *_evicter) :
     evicter(_evicter),
     new_size(0),
@@ -24,8 +27,10 @@ alt_cache_balancer_t::cache_data_t::cache_data_t(alt::evicter_t *_evicter) :
     access_count(evicter->access_count()) { }
 
 alt_cache_balancer_t::alt_cache_balancer_t(
-        clone_ptr_t<watchable_t<uint64_t> > _total_cache_size_watchable) :
+        clone_ptr_t<watchable_t<uint64_t> > _total_cache_size_watchable,
+        cache_eviction_policy_t _eviction_policy) :
     total_cache_size_watchable(_total_cache_size_watchable),
+    cache_eviction_policy(_eviction_policy),
     rebalance_timer(make_scoped<repeating_timer_t>(rebalance_check_interval_ms, this)),
     rebalance_timer_state(rebalance_timer_state_t::normal),
     last_rebalance_time{0},
@@ -106,6 +111,17 @@ void alt_cache_balancer_t::rebalance_blocking(UNUSED signal_t *interruptor) {
     guarantee(total_cache_size_watchable->get() <=
         static_cast<uint64_t>(std::numeric_limits<intptr_t>::max()));
 
+    // The caches account for exactly the memory their blocks take up in the block
+    // arena, but the arena also holds on to the free space in partially used chunks.
+    // We take that space out of the budget, so that the resident memory of the caches
+    // stays close to the configured cache size.
+    const block_arena_usage_t arena_usage = get_block_arena_usage();
+    if (arena_usage.bytes_reserved > arena_usage.bytes_in_use) {
+        total_cache_size -= std::min<uint64_t>(
+            arena_usage.bytes_reserved - arena_usage.bytes_in_use,
+            total_cache_size * max_arena_overhead_proportion);
+    }
+
     const size_t num_threads = per_thread_data.size();
     scoped_array_t<std::vector<cache_data_t> > cache_data(num_threads);
     scoped_array_t<bool> zero_access_counts(num_threads);
@@ -8,6 +8,7 @@
 #include "errors.hpp"
 #include "time.hpp"
 
+#include "buffer_cache/types.hpp"
 #include "threading.hpp"
 #include "arch/timing.hpp"
 #include "concurrency/pump_coro.hpp"
@@ -30,6 +31,9 @@ public:
     // Tells caches whether to start read ahead initially
     virtual bool read_ahead_ok_at_start() const = 0;
 
+    // The eviction policy that the caches using this balancer should use
+    virtual cache_eviction_policy_t eviction_policy() const = 0;
+
     // Returns a pointer to a boolean for the given thread number (which must be the
     // current thread) which, when set to true, means you should notify the balancer
     // that it should wake up.  Stuff outside the balancer should only set it from
@@ -55,8 +59,12 @@ protected:
 // Dummy balancer that does nothing but provide the initial size of a cache
 class dummy_cache_balancer_t final : public cache_balancer_t {
 public:
-    explicit dummy_cache_balancer_t(uint64_t _base_mem_per_store)
+    explicit dummy_cache_balancer_t(
+            uint64_t _base_mem_per_store,
+            cache_eviction_policy_t _eviction_policy
+                = cache_eviction_policy_t::random_sampling)
         : base_mem_per_store_(_base_mem_per_store),
+          eviction_policy_(_eviction_policy),
           notify_activity_boolean_(false) { }
     ~dummy_cache_balancer_t() { }
 
@@ -68,6 +76,10 @@ public:
         return false;
     }
 
+    cache_eviction_policy_t eviction_policy() const final {
+        return eviction_policy_;
+    }
+
     bool *notify_activity_boolean(threadnum_t) final {
         return &notify_activity_boolean_;
     }
@@ -79,6 +91,7 @@ private:
     void remove_evicter(alt::evicter_t *) { }
 
     uint64_t base_mem_per_store_;
+    cache_eviction_policy_t eviction_policy_;
 
     bool notify_activity_boolean_;
 
@@ -89,8 +102,9 @@ class alt_cache_balancer_t final :
     public cache_balancer_t,
     public repeating_timer_callback_t {
 public:
-    explicit alt_cache_balancer_t(
-        clone_ptr_t<watchable_t<uint64_t> > _total_cache_size_watchable);
+    alt_cache_balancer_t(
+        clone_ptr_t<watchable_t<uint64_t> > _total_cache_size_watchable,
+        cache_eviction_policy_t _eviction_policy);
     ~alt_cache_balancer_t();
 
     uint64_t base_mem_per_store() const final {
@@ -101,6 +115,10 @@ public:
         return true;
     }
 
+    cache_eviction_policy_t eviction_policy() const final {
+        return cache_eviction_policy;
+    }
+
     bool *notify_activity_boolean(threadnum_t thread) final;
 
     void wake_up_activity_happened() final;
@@ -116,6 +134,10 @@ private:
     // Controls how much read ahead is allowed out of total cache size
     static const double read_ahead_proportion;
 
+    // Limits how much of the total cache size we give up to make room for the unused
+    // space in the block arena
+    static const double max_arena_overhead_proportion;
+
     // Constants to determine when to stop read-ahead
     static const uint64_t read_ahead_ratio_numerator;
     static const uint64_t read_ahead_ratio_denominator;
@@ -162,6 +184,7 @@ private:
                                    bool new_read_ahead_ok);
 
     clone_ptr_t<watchable_t<uint64_t> > total_cache_size_watchable;
+    const cache_eviction_policy_t cache_eviction_policy;
     scoped_ptr_t<repeating_timer_t> rebalance_timer;
     enum class rebalance_timer_state_t {
         // Normal operating condition: there is a timer, and it'll ping soon.  Can
@@ -1,5 +1,9 @@
 #include "buffer_cache/evicter.hpp"
 
+#include <algorithm>
+#include <queue>
+#include <unordered_set>
+
 #include "arch/runtime/coroutines.hpp"
 #include "buffer_cache/alt.hpp"
 #include "buffer_cache/page.hpp"
@@ -8,16 +12,30 @@
 
 namespace alt {
 
+// Like in the 2Q paper, probationary pages get evicted first as long as they take up
+// more than a quarter of the memory limit, and the ghost list remembers as many
+// blocks as would fill half of the memory limit.
+static const uint64_t TWO_QUEUE_PROBATIONARY_SHARE_DIVISOR = 4;
+static const uint64_t TWO_QUEUE_GHOST_SHARE_DIVISOR = 2;
+static const size_t TWO_QUEUE_MIN_GHOST_BLOCKS = 64;
+
 evicter_t::evicter_t()
     : initialized_(false),
       page_cache_(nullptr),
       balancer_(nullptr),
       balancer_notify_activity_boolean_(nullptr),
       throttler_(nullptr),
+      eviction_policy_(cache_eviction_policy_t::random_sampling),
       bytes_loaded_counter_(0),
       access_count_counter_(0),
       access_time_counter_(INITIAL_ACCESS_TIME),
+      page_hits_(0),
+      page_misses_(0),
+      prefetches_(0),
+      prefetch_hits_(0),
+      prefetch_waste_(0),
       evict_if_necessary_active_(false),
+      ghost_sequence_counter_(0),
       last_force_flush_time_(ticks_t{0}) { }
 
 evicter_t::~evicter_t() {
@@ -40,6 +58,7 @@ void evicter_t::initialize(page_cache_t *page_cache,
     page_cache_ = page_cache;
     throttler_ = throttler;
     balancer_ = balancer;
+    eviction_policy_ = balancer->eviction_policy();
     balancer_notify_activity_boolean_
         = balancer_->notify_activity_boolean(get_thread_id());
     balancer_->add_evicter(this);
@@ -108,6 +127,24 @@ void evicter_t::reloading_page(page_t *page) {
     notify_bytes_loading(page->hypothetical_memory_usage(page_cache_));
 }
 
+void evicter_t::record_page_hit() {
+    guarantee_initialized();
+    ++page_hits_;
+}
+
+void evicter_t::record_page_miss(page_t *page) {
+    guarantee_initialized();
+    ++page_misses_;
+    if (eviction_policy_ == cache_eviction_policy_t::two_queue
+        && forget_evicted_block(page->block_id())) {
+        // The page is needed again shortly after it left probation, so it's worth
+        // protecting.  It's unevictable right now, so flipping the flag doesn't
+        // change which bag it belongs in.
+        rassert(unevictable_.has_page(page));
+        page->set_protected(true);
+    }
+}
+
 bool evicter_t::page_is_in_unevictable_bag(page_t *page) const {
     guarantee_initialized();
     return unevictable_.has_page(page);
@@ -160,7 +197,7 @@ eviction_bag_t *evicter_t::correct_eviction_category(page_t *page) {
     } else if (!page->is_loaded()) {
         return &evicted_;
     } else if (page->is_disk_backed()) {
-        return &evictable_disk_backed_;
+        return page->is_protected() ? &evictable_protected_ : &evictable_disk_backed_;
     } else {
         return &evictable_unbacked_;
     }
@@ -177,9 +214,88 @@ uint64_t evicter_t::in_memory_size() const {
     guarantee_initialized();
     return unevictable_.size()
         + evictable_disk_backed_.size()
+        + evictable_protected_.size()
         + evictable_unbacked_.size();
 }
 
+std::vector<block_id_t> evicter_t::hottest_block_ids(size_t max_count) const {
+    guarantee_initialized();
+    if (max_count == 0) {
+        return std::vector<block_id_t>();
+    }
+    // Pairs of how long ago a page was accessed and its block id.  As in
+    // `select_oldish`, we compare access times relative to the counter.  This is a
+    // max-heap of the `max_count` most recently accessed pages, so that we don't have
+    // to sort every page in the cache.
+    std::priority_queue<std::pair<uint64_t, block_id_t> > hottest;
+    auto add_page = [&](page_t *page) {
+        if (page->is_loaded()) {
+            hottest.push(std::make_pair(access_time_counter_ - page->access_time(),
+                                        page->block_id()));
+            if (hottest.size() > max_count) {
+                hottest.pop();
+            }
+        }
+    };
+    unevictable_.visit_pages(add_page);
+    evictable_disk_backed_.visit_pages(add_page);
+    evictable_protected_.visit_pages(add_page);
+    evictable_unbacked_.visit_pages(add_page);
+
+    std::vector<block_id_t> pages;
+    pages.reserve(hottest.size());
+    while (!hottest.empty()) {
+        pages.push_back(hottest.top().second);
+        hottest.pop();
+    }
+
+    // Snapshotted pages can share a block id with the current version of the block,
+    // in which case we return fewer than `max_count` block ids.
+    std::unordered_set<block_id_t> seen;
+    std::vector<block_id_t> ret;
+    for (auto it = pages.rbegin(); it != pages.rend(); ++it) {
+        if (seen.insert(*it).second) {
+            ret.push_back(*it);
+        }
+    }
+    return ret;
+}
+
+eviction_bag_t *evicter_t::select_eviction_bag() {
+    // Protected pages only get evicted once the probationary pages are down to their
+    // share of the memory limit.  With the random sampling policy there are no
+    // protected pages, so we always pick `evictable_disk_backed_`.
+    if (evictable_protected_.size() == 0
+        || evictable_disk_backed_.size()
+           > memory_limit_ / TWO_QUEUE_PROBATIONARY_SHARE_DIVISOR) {
+        return &evictable_disk_backed_;
+    }
+    return &evictable_protected_;
+}
+
+void evicter_t::remember_evicted_block(block_id_t block_id) {
+    const uint64_t sequence = ++ghost_sequence_counter_;
+    ghost_queue_.push_back(std::make_pair(block_id, sequence));
+    ghost_blocks_[block_id] = sequence;
+
+    const size_t capacity = std::max<size_t>(
+        TWO_QUEUE_MIN_GHOST_BLOCKS,
+        memory_limit_ / TWO_QUEUE_GHOST_SHARE_DIVISOR
+            / page_cache_->max_block_size().ser_value());
+    while (ghost_queue_.size() > capacity) {
+        auto it = ghost_blocks_.find(ghost_queue_.front().first);
+        if (it != ghost_blocks_.end() && it->second == ghost_queue_.front().second) {
+            ghost_blocks_.erase(it);
+        }
+        ghost_queue_.pop_front();
+    }
+}
+
+bool evicter_t::forget_evicted_block(block_id_t block_id) {
+    // The block's entry in `ghost_queue_` stays behind until it falls off the end.
+    return ghost_blocks_.erase(block_id) != 0;
+}
+
 void evicter_t::evict_if_necessary() THROWS_NOTHING {
     guarantee_initialized();
     if (evict_if_necessary_active_) {
@@ -195,13 +311,21 @@ void evicter_t::evict_if_necessary() THROWS_NOTHING {
     // currently being written for the purpose of eviction.
 
     evict_if_necessary_active_ = true;
-    page_t *page;
-    while (in_memory_size() > memory_limit_
-           && eviction_bag_t::select_oldish(
-                &evictable_disk_backed_, access_time_counter_, &page)) {
+    while (in_memory_size() > memory_limit_) {
+        eviction_bag_t *bag = select_eviction_bag();
+        page_t *page;
+        if (!eviction_bag_t::select_oldish(bag, access_time_counter_, &page)) {
+            break;
+        }
         uint32_t mem_usage = page->hypothetical_memory_usage(page_cache_);
-        evictable_disk_backed_.remove(page, mem_usage);
+        bag->remove(page, mem_usage);
         evicted_.add(page, mem_usage);
+        if (eviction_policy_ == cache_eviction_policy_t::two_queue
+            && bag == &evictable_disk_backed_) {
+            remember_evicted_block(page->block_id());
+        }
+        // Once it's evicted, a page has to earn its protection again.
+        page->set_protected(false);
         page->evict_self(page_cache_);
         page_cache_->consider_evicting_current_page(page->block_id());
     }
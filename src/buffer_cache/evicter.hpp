@@ -3,9 +3,14 @@
 
 #include <stdint.h>
 
+#include <deque>
 #include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "buffer_cache/eviction_bag.hpp"
+#include "buffer_cache/types.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/cache_line_padded.hpp"
 #include "concurrency/pubsub.hpp"
@@ -35,6 +40,26 @@ public:
     void remove_page(page_t *page);
     void reloading_page(page_t *page);
 
+    // Records that a page was already in memory when somebody acquired it.
+    void record_page_hit();
+    // Records that a page has to be read from disk. The page must be in the
+    // unevictable bag.
+    void record_page_miss(page_t *page);
+    // Records that a page is being loaded by a prefetch, and whether a prefetched page
+    // got acquired (a hit) or evicted or destroyed without being acquired (waste).
+    void record_prefetch() {
+        guarantee_initialized();
+        ++prefetches_;
+    }
+    void record_prefetch_hit() {
+        guarantee_initialized();
+        ++prefetch_hits_;
+    }
+    void record_prefetch_waste() {
+        guarantee_initialized();
+        ++prefetch_waste_;
+    }
+
     // Evicter will be unusable until initialize is called
     evicter_t();
     ~evicter_t();
@@ -66,7 +91,7 @@ public:
     }
     uint64_t evictable_disk_backed_size() const {
         guarantee_initialized();
-        return evictable_disk_backed_.size();
+        return evictable_disk_backed_.size() + evictable_protected_.size();
     }
     uint64_t evictable_unbacked_size() const {
         guarantee_initialized();
@@ -78,9 +103,38 @@ public:
         return bytes_loaded_counter_;
     }
 
+    cache_eviction_policy_t eviction_policy() const {
+        guarantee_initialized();
+        return eviction_policy_;
+    }
+    uint64_t page_hits() const {
+        guarantee_initialized();
+        return page_hits_;
+    }
+    uint64_t page_misses() const {
+        guarantee_initialized();
+        return page_misses_;
+    }
+    uint64_t prefetches() const {
+        guarantee_initialized();
+        return prefetches_;
+    }
+    uint64_t prefetch_hits() const {
+        guarantee_initialized();
+        return prefetch_hits_;
+    }
+    uint64_t prefetch_waste() const {
+        guarantee_initialized();
+        return prefetch_waste_;
+    }
+
 
     uint64_t in_memory_size() const;
 
+    // Returns the ids of up to `max_count` of the blocks in memory, most recently
+    // accessed first.
+    std::vector<block_id_t> hottest_block_ids(size_t max_count) const;
+
     // This is decremented past UINT64_MAX to force code to be aware of access time
     // rollovers.
     static const uint64_t INITIAL_ACCESS_TIME = UINT64_MAX - 100;
@@ -99,6 +153,13 @@ private:
     // Evicts any evictable pages until under the memory limit
     void evict_if_necessary() THROWS_NOTHING;
 
+    // Returns the bag that the next page to evict should come from.
+    eviction_bag_t *select_eviction_bag();
+
+    // Maintain the 2Q ghost list of recently evicted probationary pages.
+    void remember_evicted_block(block_id_t block_id);
+    bool forget_evicted_block(block_id_t block_id);
+
     bool initialized_;
     page_cache_t *page_cache_;
     cache_balancer_t *balancer_;
@@ -106,6 +167,8 @@ private:
 
     alt_txn_throttler_t *throttler_;
 
+    cache_eviction_policy_t eviction_policy_;
+
     uint64_t memory_limit_;
 
     // These are updated every time a page is loaded, created, or destroyed, and
@@ -117,16 +180,39 @@ private:
     // This gets incremented every time a page is accessed.
     uint64_t access_time_counter_;
 
+    // How often an acquired page was or wasn't in memory already.
+    uint64_t page_hits_;
+    uint64_t page_misses_;
+
+    // How many pages were loaded by prefetches, and how many of those got acquired or
+    // dropped without being acquired.
+    uint64_t prefetches_;
+    uint64_t prefetch_hits_;
+    uint64_t prefetch_waste_;
+
     // This is set to true while `evict_if_necessary()` is active.
     // It avoids reentrant calls to that function.
     bool evict_if_necessary_active_;
 
-    // These track every page's eviction status.
+    // These track every page's eviction status.  With the 2Q policy, disk backed
+    // pages start out on probation in `evictable_disk_backed_`.  They only get
+    // moved to `evictable_protected_` if they're read again soon after getting
+    // evicted from there, which a page touched by a one-off scan never is.  With
+    // the random sampling policy, `evictable_protected_` stays empty.
     eviction_bag_t unevictable_;
     eviction_bag_t evictable_disk_backed_;
+    eviction_bag_t evictable_protected_;
     eviction_bag_t evictable_unbacked_;
     eviction_bag_t evicted_;
 
+    // The ghost list of 2Q: the ids of the blocks recently evicted from
+    // `evictable_disk_backed_`, oldest first, each with a sequence number so that a
+    // block which was forgotten and then remembered again doesn't get forgotten by
+    // its stale queue entry.
+    std::deque<std::pair<block_id_t, uint64_t> > ghost_queue_;
+    std::unordered_map<block_id_t, uint64_t> ghost_blocks_;
+    uint64_t ghost_sequence_counter_;
+
     ticks_t last_force_flush_time_;
 
     auto_drainer_t drainer_;
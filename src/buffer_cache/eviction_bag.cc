@@ -38,6 +38,12 @@ bool eviction_bag_t::has_page(page_t *page) const {
     return bag_.has_element(page);
 }
 
+void eviction_bag_t::visit_pages(const std::function<void(page_t *)> &cb) const {
+    for (size_t i = 0; i < bag_.size(); ++i) {
+        cb(bag_.access_random(i));
+    }
+}
+
 bool eviction_bag_t::select_oldish(eviction_bag_t *eb, uint64_t access_time_offset,
                                    page_t **page_out) {
     if (eb->bag_.size() == 0) {
@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 
+#include <functional>
+
 #include "containers/backindex_bag.hpp"
 
 namespace alt {
@@ -30,6 +32,9 @@ public:
 
     uint64_t size() const { return size_; }
 
+    // Calls `cb` on every page in the bag.  `cb` must not add or remove pages.
+    void visit_pages(const std::function<void(page_t *)> &cb) const;
+
     static bool select_oldish(
         eviction_bag_t *eb, uint64_t access_time_offset,
         page_t **page_out);
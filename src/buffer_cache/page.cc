@@ -56,6 +56,8 @@ page_t::page_t(block_id_t _block_id, page_cache_t *page_cache)
     : block_id_(_block_id),
       loader_(nullptr),
       access_time_(page_cache->evicter().next_access_time()),
+      protected_(false),
+      prefetched_(false),
       snapshot_refcount_(0) {
     page_cache->evicter().add_deferred_loaded(this);
 
@@ -70,8 +72,11 @@ page_t::page_t(block_id_t _block_id, page_cache_t *page_cache,
     : block_id_(_block_id),
       loader_(nullptr),
       access_time_(page_cache->evicter().next_access_time()),
+      protected_(false),
+      prefetched_(false),
       snapshot_refcount_(0) {
     page_cache->evicter().add_not_yet_loaded(this);
+    page_cache->evicter().record_page_miss(this);
 
     coro_t::spawn_now_dangerously(std::bind(&page_t::load_with_block_id,
                                             this,
@@ -86,6 +91,8 @@ page_t::page_t(block_id_t _block_id, buf_ptr_t buf,
       loader_(nullptr),
       buf_(std::move(buf)),
       access_time_(page_cache->evicter().next_access_time()),
+      protected_(false),
+      prefetched_(false),
       snapshot_refcount_(0) {
     rassert(buf_.has());
     page_cache->evicter().add_to_evictable_unbacked(this);
@@ -100,6 +107,8 @@ page_t::page_t(block_id_t _block_id,
       buf_(std::move(buf)),
       block_token_(_block_token),
       access_time_(READ_AHEAD_ACCESS_TIME),
+      protected_(false),
+      prefetched_(false),
       snapshot_refcount_(0) {
     rassert(buf_.has());
     page_cache->evicter().add_to_evictable_disk_backed(this);
@@ -109,6 +118,8 @@ page_t::page_t(page_t *copyee, page_cache_t *page_cache, cache_account_t *accoun
     : block_id_(copyee->block_id_),
       loader_(nullptr),
       access_time_(page_cache->evicter().next_access_time()),
+      protected_(false),
+      prefetched_(false),
       snapshot_refcount_(0) {
     page_cache->evicter().add_not_yet_loaded(this);
     coro_t::spawn_now_dangerously(std::bind(&page_t::load_from_copyee,
@@ -151,14 +162,14 @@ void page_t::load_from_copyee(page_t *page, page_t *copyee,
 
         ASSERT_FINITE_CORO_WAITING;
         if (!loader.abandon_page()) {
-            // KSI: If somehow there are no snapshotters of copyee now (besides
-            // ourself), maybe we could avoid copying this memory.  We need to
-            // carefully track snapshotters anyway, once we're comfortable with that,
-            // we could do it.
-
+            // We share the copyee's buffer instead of copying it.  It only gets
+            // copied once one of the pages is actually modified (see
+            // `set_page_buf_size`), and not at all if the copyee is gone by then.
+            // Each page still counts the whole buffer towards its memory usage,
+            // which errs on the safe side of the memory limit.
             {
                 usage_adjuster_t adjuster(page_cache, page);
-                page->buf_ = buf_ptr_t::alloc_copy(copyee->buf_);
+                page->buf_ = copyee->buf_.share();
                 page->loader_ = nullptr;
             }
 
@@ -260,6 +271,7 @@ void page_t::catch_up_with_deferred_load(
 
     // Before blocking, tell the evicter to put us in the right category.
     page_cache->evicter().catch_up_deferred_load(page);
+    page_cache->evicter().record_page_miss(page);
 
     buf_ptr_t buf;
     {
@@ -384,6 +396,9 @@ void page_t::remove_snapshotter(page_cache_t *page_cache) {
         // load_from_copyee.
         rassert(waiters_.empty());
 
+        if (prefetched_) {
+            page_cache->evicter().record_prefetch_waste();
+        }
         page_cache->evicter().remove_page(this);
         delete this;
     }
@@ -415,7 +430,12 @@ void page_t::add_waiter(page_acq_t *acq, cache_account_t *account) {
         = acq->page_cache()->evicter().correct_eviction_category(this);
     waiters_.push_front(acq);
     acq->page_cache()->evicter().change_to_correct_eviction_bag(old_bag, this);
+    if (prefetched_) {
+        prefetched_ = false;
+        acq->page_cache()->evicter().record_prefetch_hit();
+    }
     if (buf_.has()) {
+        acq->page_cache()->evicter().record_page_hit();
         acq->buf_ready_signal_.pulse();
     } else if (loader_ != nullptr) {
         loader_->added_waiter(acq->page_cache(), account);
@@ -429,6 +449,36 @@ void page_t::add_waiter(page_acq_t *acq, cache_account_t *account) {
     }
 }
 
+void page_t::prefetch(page_cache_t *page_cache, cache_account_t *account) {
+    if (buf_.has()) {
+        return;
+    }
+    if (loader_ != nullptr) {
+        if (!loader_->is_really_loading()) {
+            // A deferred load starts reading the block as soon as it has a waiter.
+            loader_->added_waiter(page_cache, account);
+            mark_prefetched(page_cache);
+        }
+        return;
+    }
+    rassert(block_token_.has());
+    // Nobody is waiting for the page, so unlike in `add_waiter`, nothing else moves
+    // it out of the evicted bag while it's loading.
+    eviction_bag_t *old_bag = page_cache->evicter().correct_eviction_category(this);
+    coro_t::spawn_now_dangerously(std::bind(&page_t::load_using_block_token,
+                                            this,
+                                            page_cache,
+                                            account));
+    page_cache->evicter().change_to_correct_eviction_bag(old_bag, this);
+    mark_prefetched(page_cache);
+}
+
+void page_t::mark_prefetched(page_cache_t *page_cache) {
+    rassert(!prefetched_);
+    prefetched_ = true;
+    page_cache->evicter().record_prefetch();
+}
+
 // Unevicts page.
 void page_t::load_using_block_token(page_t *page, page_cache_t *page_cache,
                                     cache_account_t *account) {
@@ -439,6 +489,7 @@ void page_t::load_using_block_token(page_t *page, page_cache_t *page_cache,
     page->loader_ = &loader;
 
     page_cache->evicter().reloading_page(page);
+    page_cache->evicter().record_page_miss(page);
 
     auto_drainer_t::lock_t lock = page_cache->drainer_lock();
 
@@ -478,6 +529,8 @@ void page_t::set_page_buf_size(block_size_t block_size, page_cache_t *page_cache
             "Modified a page_t without resetting the block token.");
     {
         usage_adjuster_t adjuster(page_cache, this);
+        // This also gives the page a buffer of its own, if it shared one with a
+        // snapshot.
         buf_.resize_fill_zero(block_size);
     }
 }
@@ -550,12 +603,16 @@ void page_t::remove_waiter(page_acq_t *acq) {
     rassert(snapshot_refcount_ > 0);
 }
 
-void page_t::evict_self(DEBUG_VAR page_cache_t *page_cache) {
+void page_t::evict_self(page_cache_t *page_cache) {
     // A page_t can only self-evict if it has a block token (for now).
     rassert(waiters_.empty());
     rassert(block_token_.has());
     rassert(buf_.has());
     rassert(block_token_->block_size() == buf_.block_size());
+    if (prefetched_) {
+        prefetched_ = false;
+        page_cache->evicter().record_prefetch_waste();
+    }
 #ifndef NDEBUG
     const uint32_t usage_before = hypothetical_memory_usage(page_cache);
 #endif
@@ -66,8 +66,21 @@ public:
     bool is_loaded() const { return buf_.has(); }
     bool is_disk_backed() const { return block_token_.has(); }
 
+    // Whether the 2Q eviction policy has moved the page out of probation.  Only the
+    // evicter changes this, at times when the change doesn't move the page to a
+    // different eviction bag.
+    bool is_protected() const { return protected_; }
+    void set_protected(bool value) { protected_ = value; }
+
     void evict_self(page_cache_t *page_cache);
 
+    // Starts loading an evicted page without waiting for it, and marks it as
+    // prefetched.  Does nothing if the page is in memory or already being loaded.
+    void prefetch(page_cache_t *page_cache, cache_account_t *account);
+    // Marks a page whose load was started for a prefetch, so that the evicter can
+    // count whether it gets acquired before it's evicted again.
+    void mark_prefetched(page_cache_t *page_cache);
+
     block_id_t block_id() const { return block_id_; }
 
     bool page_ptr_count() const { return snapshot_refcount_; }
@@ -132,6 +145,11 @@ private:
 
     uint64_t access_time_;
 
+    bool protected_;
+
+    // True if the page was loaded by a prefetch and hasn't been acquired since.
+    bool prefetched_;
+
     // How many page_ptr_t's point at this page, expecting nothing to modify it,
     // other than themselves.
     size_t snapshot_refcount_;
@@ -146,7 +164,8 @@ private:
     // if loader_ is non-null:  unevictable_
     // else if waiters_ is non-empty: unevictable_
     // else if buf_ is null: evicted_ (and block_token_ is non-null)
-    // else if block_token_ is non-null: evictable_disk_backed_
+    // else if block_token_ is non-null: evictable_protected_ if protected_ is true,
+    //                                   evictable_disk_backed_ otherwise
     // else: evictable_unbacked_ (buf_ is non-null, block_token_ is null)
     //
     // So, when loader_, waiters_, buf_, or block_token_ is touched, we might
@@ -8,9 +8,12 @@
 #include "arch/runtime/coroutines.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/runtime_utils.hpp"
+#include "arch/timing.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/new_mutex.hpp"
+#include "concurrency/pmap.hpp"
 #include "buffer_cache/cache_balancer.hpp"
+#include "config/args.hpp"
 #include "do_on_thread.hpp"
 #include "serializer/serializer.hpp"
 #include "stl_utils.hpp"
@@ -97,7 +100,7 @@ void page_read_ahead_cb_t::offer_read_ahead_buf(
     buf_ptr_t local_buf = std::move(*buf);
 
     block_size_t block_size = block_size_t::undefined();
-    scoped_device_block_aligned_ptr_t<ser_buffer_t> ptr;
+    scoped_block_arena_ptr_t<ser_buffer_t> ptr;
     local_buf.release(&block_size, &ptr);
 
     // We're going to reconstruct the buf_ptr_t on the other side of this do_on_thread
@@ -110,7 +113,7 @@ void page_read_ahead_cb_t::offer_read_ahead_buf(
                  std::bind(&page_cache_t::add_read_ahead_buf,
                            page_cache_,
                            block_id,
-                           copyable_unique_t<scoped_device_block_aligned_ptr_t<ser_buffer_t> >(std::move(ptr)),
+                           copyable_unique_t<scoped_block_arena_ptr_t<ser_buffer_t> >(std::move(ptr)),
                            token));
 }
 
@@ -132,8 +135,8 @@ void page_cache_t::consider_evicting_current_page(block_id_t block_id) {
     ASSERT_NO_CORO_WAITING;
     // We can't do anything until read-ahead is done, because it uses the existence
     // of a current_page_t entry to figure out whether the read-ahead page could be
-    // out of date.
-    if (read_ahead_cb_ != nullptr) {
+    // out of date.  The same goes for warming up the cache.
+    if (read_ahead_cb_ != nullptr || warm_up_active_) {
         return;
     }
 
@@ -159,7 +162,7 @@ block_version_t page_cache_t::gen_block_version() {
 
 
 void page_cache_t::add_read_ahead_buf(block_id_t block_id,
-                                      scoped_device_block_aligned_ptr_t<ser_buffer_t> ptr,
+                                      scoped_block_arena_ptr_t<ser_buffer_t> ptr,
                                       const counted_t<block_token_t> &token) {
     assert_thread();
 
@@ -201,6 +204,85 @@ void page_cache_t::have_read_ahead_cb_destroyed() {
     }
 }
 
+bool page_cache_t::wait_for_warm_up_room(uint64_t size, signal_t *interruptor) {
+    // A new cache only gets memory from the cache balancer once the balancer notices
+    // it, so we give the balancer some time.
+    const int64_t poll_interval_ms = 50;
+    for (int64_t waited_ms = 0;
+         evicter_.in_memory_size() + size > evicter_.memory_limit();
+         waited_ms += poll_interval_ms) {
+        if (waited_ms >= WARM_CACHE_MAX_WAIT_FOR_ROOM_MS) {
+            return false;
+        }
+        try {
+            nap(poll_interval_ms, interruptor);
+        } catch (const interrupted_exc_t &) {
+            return false;
+        }
+    }
+    return !interruptor->is_pulsed();
+}
+
+void page_cache_t::warm_up(const std::vector<block_id_t> &block_ids,
+                           signal_t *interruptor) {
+    assert_thread();
+    rassert(!warm_up_active_);
+    warm_up_active_ = true;
+
+    struct warm_up_block_t {
+        block_id_t block_id;
+        counted_t<block_token_t> token;
+        buf_ptr_t buf;
+    };
+
+    for (size_t begin = 0; begin < block_ids.size();
+         begin += WARM_CACHE_LOAD_BATCH_SIZE) {
+        const size_t end = std::min<size_t>(block_ids.size(),
+                                            begin + WARM_CACHE_LOAD_BATCH_SIZE);
+        if (!wait_for_warm_up_room((end - begin) * max_block_size_.ser_value(),
+                                   interruptor)) {
+            break;
+        }
+
+        std::vector<warm_up_block_t> batch;
+        {
+            on_thread_t th(serializer_->home_thread());
+            for (size_t i = begin; i < end; ++i) {
+                counted_t<block_token_t> token = serializer_->index_read(block_ids[i]);
+                if (token.has()) {
+                    batch.push_back(warm_up_block_t{block_ids[i], std::move(token),
+                                                    buf_ptr_t()});
+                }
+            }
+            // Reading the batch in the order of the blocks' offsets keeps the disk
+            // access pattern as sequential as it can be.
+            std::sort(batch.begin(), batch.end(),
+                      [](const warm_up_block_t &a, const warm_up_block_t &b) {
+                          return a.token->offset() < b.token->offset();
+                      });
+            pmap(batch.size(), [&](int64_t i) {
+                batch[i].buf = serializer_->block_read(batch[i].token,
+                                                       default_reads_account_.get());
+            });
+        }
+
+        for (warm_up_block_t &block : batch) {
+            // See `add_read_ahead_buf` for why this means that the buf is up to date.
+            if (current_pages_.count(block.block_id) == 0) {
+                current_pages_[block.block_id] = new current_page_t(
+                    block.block_id, std::move(block.buf), block.token, this);
+            }
+        }
+    }
+
+    warm_up_active_ = false;
+    if (read_ahead_cb_ == nullptr) {
+        coro_t::spawn_sometime(
+            std::bind(&page_cache_t::consider_evicting_all_current_pages,
+                      this, drainer_->lock()));
+    }
+}
+
 void page_cache_t::consider_evicting_all_current_pages(page_cache_t *page_cache,
                                                        auto_drainer_t::lock_t lock) {
     // Atomically grab a list of block IDs that currently exist in current_pages.
@@ -249,6 +331,7 @@ page_cache_t::page_cache_t(serializer_t *_serializer,
       free_list_(_serializer),
       evicter_(),
       read_ahead_cb_(nullptr),
+      warm_up_active_(false),
       drainer_(make_scoped<auto_drainer_t>()) {
 
     const bool start_read_ahead = balancer->read_ahead_ok_at_start();
@@ -388,6 +471,33 @@ current_page_t *page_cache_t::page_for_block_id(block_id_t block_id) {
     return page_it->second;
 }
 
+void page_cache_t::prefetch(block_id_t block_id, cache_account_t *account) {
+    assert_thread();
+
+    current_page_t *current_page;
+    auto page_it = current_pages_.find(block_id);
+    if (page_it == current_pages_.end()) {
+        if (!is_aux_block_id(block_id)
+            && recency_for_block_id(block_id) == repli_timestamp_t::invalid) {
+            return;
+        }
+        current_page = page_for_block_id(block_id);
+    } else {
+        current_page = page_it->second;
+        if (current_page->is_deleted()) {
+            return;
+        }
+    }
+
+    if (current_page->page_.has()) {
+        current_page->page_.get_page_for_read()->prefetch(this, account);
+    } else {
+        current_page->convert_from_serializer_if_necessary(
+            current_page_help_t(block_id, this), account);
+        current_page->page_.get_page_for_read()->mark_prefetched(this);
+    }
+}
+
 current_page_t *page_cache_t::page_for_new_block_id(
         block_type_t block_type,
         block_id_t *block_id_out) {
@@ -482,6 +482,19 @@ public:
 
     void have_read_ahead_cb_destroyed();
 
+    // Reads the given blocks into the cache, hottest first, until the cache is full.
+    // This is used to warm up the cache after a restart, from a list of block ids
+    // that `evicter_t::hottest_block_ids()` returned before the shutdown.  Block ids
+    // that no longer exist are skipped.  Blocks that somebody acquires while they're
+    // being read are left alone, just like with read-ahead.  Stops early, without
+    // throwing, if `interruptor` is pulsed.
+    void warm_up(const std::vector<block_id_t> &block_ids, signal_t *interruptor);
+
+    // Starts loading the given block, if it isn't in memory, without acquiring it or
+    // waiting for it.  Somebody who acquires the block soon afterwards then waits
+    // less, or not at all.  Deleted blocks are skipped.
+    void prefetch(block_id_t block_id, cache_account_t *account);
+
     evicter_t &evicter() { return evicter_; }
 
     auto_drainer_t::lock_t drainer_lock() { return drainer_->lock(); }
@@ -493,11 +506,16 @@ private:
 
     friend class page_read_ahead_cb_t;
     void add_read_ahead_buf(block_id_t block_id,
-                            scoped_device_block_aligned_ptr_t<ser_buffer_t> ptr,
+                            scoped_block_arena_ptr_t<ser_buffer_t> ptr,
                             const counted_t<block_token_t> &token);
 
     void read_ahead_cb_is_destroyed();
 
+    // Waits until `size` more bytes fit below the memory limit.  Returns false if
+    // that doesn't happen within WARM_CACHE_MAX_WAIT_FOR_ROOM_MS, or if `interruptor`
+    // is pulsed.
+    bool wait_for_warm_up_room(uint64_t size, signal_t *interruptor);
+
 
     current_page_t *internal_page_for_new_chosen(block_id_t block_id);
 
@@ -650,6 +668,11 @@ private:
     // destroyed and all possible read-ahead operations have completed.
     auto_drainer_t::lock_t read_ahead_cb_existence_;
 
+    // True while `warm_up()` is running.  Like the existence of `read_ahead_cb_`, it
+    // keeps current_page_t's from getting destroyed, so that a block's buf can't be
+    // out of date if there's still no current_page_t for it once the buf was read.
+    bool warm_up_active_;
+
     scoped_ptr_t<auto_drainer_t> drainer_;
 
     DISABLE_COPYING(page_cache_t);
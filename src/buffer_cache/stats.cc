@@ -8,13 +8,25 @@ alt_cache_stats_t::alt_cache_stats_t(alt::page_cache_t *_page_cache,
     page_cache(_page_cache),
     cache_collection(),
     cache_membership(parent, &cache_collection, "cache"),
-    in_use_bytes(this),
+    in_use_bytes(this, &alt::evicter_t::in_memory_size),
     in_use_bytes_membership(&cache_collection,
                             &in_use_bytes, "in_use_bytes"),
+    page_hits(this, &alt::evicter_t::page_hits),
+    page_hits_membership(&cache_collection, &page_hits, "page_hits"),
+    page_misses(this, &alt::evicter_t::page_misses),
+    page_misses_membership(&cache_collection, &page_misses, "page_misses"),
+    prefetches(this, &alt::evicter_t::prefetches),
+    prefetches_membership(&cache_collection, &prefetches, "prefetches"),
+    prefetch_hits(this, &alt::evicter_t::prefetch_hits),
+    prefetch_hits_membership(&cache_collection, &prefetch_hits, "prefetch_hits"),
+    prefetch_waste(this, &alt::evicter_t::prefetch_waste),
+    prefetch_waste_membership(&cache_collection, &prefetch_waste, "prefetch_waste"),
     cache_collection_membership(&cache_collection) { }
 
-alt_cache_stats_t::perfmon_value_t::perfmon_value_t(alt_cache_stats_t *_parent) :
-    parent(_parent) { }
+alt_cache_stats_t::perfmon_value_t::perfmon_value_t(
+        alt_cache_stats_t *_parent,
+        uint64_t (alt::evicter_t::*_getter)() const) :
+    parent(_parent), getter(_getter) { }
 
 void *alt_cache_stats_t::perfmon_value_t::begin_stats() {
     return new uint64_t;
@@ -23,7 +35,7 @@ void *alt_cache_stats_t::perfmon_value_t::begin_stats() {
 void alt_cache_stats_t::perfmon_value_t::visit_stats(void *ptr) {
     if (get_thread_id() == parent->home_thread()) {
         uint64_t *value = reinterpret_cast<uint64_t *>(ptr);
-        *value = parent->page_cache->evicter().in_memory_size();
+        *value = (parent->page_cache->evicter().*getter)();
     }
 }
 
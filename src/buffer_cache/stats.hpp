@@ -15,18 +15,35 @@ public:
     perfmon_collection_t cache_collection;
     perfmon_membership_t cache_membership;
 
+    // Reports one of the evicter's values, read on the cache's home thread.
     class perfmon_value_t : public perfmon_t {
     public:
-        explicit perfmon_value_t(alt_cache_stats_t *_parent);
+        perfmon_value_t(alt_cache_stats_t *_parent,
+                        uint64_t (alt::evicter_t::*_getter)() const);
         void *begin_stats();
         void visit_stats(void *);
         ql::datum_t end_stats(void *);
     private:
         alt_cache_stats_t *parent;
+        uint64_t (alt::evicter_t::*getter)() const;
         DISABLE_COPYING(perfmon_value_t);
     };
     perfmon_value_t in_use_bytes;
     perfmon_membership_t in_use_bytes_membership;
+    // How many page acquisitions found the page in memory, and how many had to
+    // read it from disk.
+    perfmon_value_t page_hits;
+    perfmon_membership_t page_hits_membership;
+    perfmon_value_t page_misses;
+    perfmon_membership_t page_misses_membership;
+    // How many pages were loaded ahead of time by prefetches (for example by range
+    // scans), and how many of those were then acquired or dropped unused.
+    perfmon_value_t prefetches;
+    perfmon_membership_t prefetches_membership;
+    perfmon_value_t prefetch_hits;
+    perfmon_membership_t prefetch_hits_membership;
+    perfmon_value_t prefetch_waste;
+    perfmon_membership_t prefetch_waste_membership;
 
 
     perfmon_multi_membership_t cache_collection_membership;
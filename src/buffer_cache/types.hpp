@@ -22,6 +22,25 @@ struct flush_interval_t {
     int64_t millis;
 };
 
+// How the page cache picks pages to evict. `random_sampling` evicts the least
+// recently used of a few randomly sampled pages. `two_queue` is a sampled variant of
+// 2Q, which keeps pages that get touched only once (such as those read by a table
+// scan) from pushing the frequently used pages out of the cache.
+enum class cache_eviction_policy_t { random_sampling, two_queue };
+
+// The optional B-tree node formats (see `btree/node.hpp`) that the B-tree code may use
+// for new nodes that it writes through a cache.  They are off by default, because
+// versions of RethinkDB that don't know them crash on files that contain such nodes.
+struct btree_node_formats_t {
+    btree_node_formats_t()
+        : prefix_compressed_leaves(false), counted_internal_nodes(false) { }
+
+    // Store the keys of new leaf nodes front-coded against a common prefix.
+    bool prefix_compressed_leaves;
+    // Keep a count of each leaf's live entries in its parent.
+    bool counted_internal_nodes;
+};
+
 typedef uint32_t block_magic_comparison_t;
 
 struct block_magic_t {
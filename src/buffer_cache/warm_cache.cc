@@ -0,0 +1,144 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "buffer_cache/warm_cache.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "arch/timing.hpp"
+#include "arch/types.hpp"
+#include "buffer_cache/page_cache.hpp"
+#include "config/args.hpp"
+#include "crc32c.hpp"
+#include "logger.hpp"
+#include "paths.hpp"
+
+static const char WARM_CACHE_LIST_MAGIC[8] = { 'w', 'a', 'r', 'm', 'l', 'i', 's', 't' };
+
+std::vector<block_id_t> blocking_read_warm_cache_list(const std::string &path) {
+    std::string contents;
+    if (!blocking_read_file(path.c_str(), &contents) || contents.empty()) {
+        // There's no list, for example because the table was just created.
+        return std::vector<block_id_t>();
+    }
+
+    const size_t header_size = sizeof(WARM_CACHE_LIST_MAGIC) + sizeof(uint64_t);
+    uint64_t count = 0;
+    if (contents.size() >= header_size) {
+        memcpy(&count, contents.data() + sizeof(WARM_CACHE_LIST_MAGIC), sizeof(count));
+    }
+    if (contents.size() < header_size + sizeof(uint32_t)
+        || memcmp(contents.data(), WARM_CACHE_LIST_MAGIC,
+                  sizeof(WARM_CACHE_LIST_MAGIC)) != 0
+        || count > WARM_CACHE_MAX_BLOCKS
+        || contents.size() != header_size + count * sizeof(block_id_t)
+                              + sizeof(uint32_t)) {
+        logWRN("Ignoring the damaged warm cache list `%s`.", path.c_str());
+        return std::vector<block_id_t>();
+    }
+
+    const size_t checksum_offset = contents.size() - sizeof(uint32_t);
+    uint32_t checksum;
+    memcpy(&checksum, contents.data() + checksum_offset, sizeof(checksum));
+    if (checksum != crc32c(contents.data(), checksum_offset)) {
+        logWRN("Ignoring the warm cache list `%s` because its checksum doesn't match.",
+               path.c_str());
+        return std::vector<block_id_t>();
+    }
+
+    std::vector<block_id_t> block_ids(count);
+    memcpy(block_ids.data(), contents.data() + header_size,
+           count * sizeof(block_id_t));
+    return block_ids;
+}
+
+bool blocking_write_warm_cache_list(const std::string &path,
+                                    const std::vector<block_id_t> &block_ids) {
+    std::string contents(WARM_CACHE_LIST_MAGIC, sizeof(WARM_CACHE_LIST_MAGIC));
+    const uint64_t count = block_ids.size();
+    contents.append(reinterpret_cast<const char *>(&count), sizeof(count));
+    contents.append(reinterpret_cast<const char *>(block_ids.data()),
+                    count * sizeof(block_id_t));
+    const uint32_t checksum = crc32c(contents.data(), contents.size());
+    contents.append(reinterpret_cast<const char *>(&checksum), sizeof(checksum));
+
+    const std::string temporary_path = path + ".tmp";
+    FILE *file = fopen(temporary_path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool ok = fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+    ok = fflush(file) == 0 && ok;
+#ifndef _WIN32
+    ok = fsync(fileno(file)) == 0 && ok;
+#endif
+    ok = fclose(file) == 0 && ok;
+    if (ok) {
+#ifdef _WIN32
+        // `rename` doesn't replace an existing file on Windows.
+        remove(path.c_str());
+#endif
+        ok = rename(temporary_path.c_str(), path.c_str()) == 0;
+    }
+    if (!ok) {
+        remove(temporary_path.c_str());
+    }
+    return ok;
+}
+
+cache_warmer_t::cache_warmer_t(alt::page_cache_t *page_cache, const std::string &path)
+    : page_cache_(page_cache), path_(path), warmed_up_(false) {
+    // Warming up can take a while, so we don't make the cache's creator wait for it.
+    coro_t::spawn_sometime(std::bind(&cache_warmer_t::warm_up_and_save_periodically,
+                                     this, drainer_.lock()));
+}
+
+cache_warmer_t::~cache_warmer_t() {
+    assert_thread();
+    drainer_.drain();
+    // If we were shut down before the warm-up finished, the cache only has part of the
+    // blocks in the old list, so the old list is the better hint for the next start.
+    if (warmed_up_) {
+        save();
+    }
+}
+
+void cache_warmer_t::warm_up_and_save_periodically(auto_drainer_t::lock_t keepalive) {
+    std::vector<block_id_t> block_ids;
+    thread_pool_t::run_in_blocker_pool([&]() {
+        block_ids = blocking_read_warm_cache_list(path_);
+    });
+    page_cache_->warm_up(block_ids, keepalive.get_drain_signal());
+    if (keepalive.get_drain_signal()->is_pulsed()) {
+        return;
+    }
+    warmed_up_ = true;
+
+    try {
+        while (true) {
+            nap(WARM_CACHE_SAVE_INTERVAL_MS, keepalive.get_drain_signal());
+            save();
+        }
+    } catch (const interrupted_exc_t &) {
+        // We are shutting down.  The destructor saves the list one last time.
+    }
+}
+
+void cache_warmer_t::save() {
+    assert_thread();
+    const std::vector<block_id_t> block_ids =
+        page_cache_->evicter().hottest_block_ids(WARM_CACHE_MAX_BLOCKS);
+    bool ok;
+    thread_pool_t::run_in_blocker_pool([&]() {
+        ok = blocking_write_warm_cache_list(path_, block_ids);
+    });
+    if (!ok) {
+        logWRN("Failed to write the warm cache list `%s`.", path_.c_str());
+    }
+}
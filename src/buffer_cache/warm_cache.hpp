@@ -0,0 +1,59 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_WARM_CACHE_HPP_
+#define BUFFER_CACHE_WARM_CACHE_HPP_
+
+#include <string>
+#include <vector>
+
+#include "concurrency/auto_drainer.hpp"
+#include "serializer/types.hpp"
+#include "threading.hpp"
+
+namespace alt {
+class page_cache_t;
+}
+
+/* A warm cache list is a file with the ids of the blocks that were hottest in a
+cache, most recently accessed first.  It lets the cache read those blocks back in
+after a restart, instead of starting out cold.
+
+The file consists of an 8-byte magic, the number of block ids as a `uint64_t`, the
+block ids, and a CRC-32C of everything before it.  A list is only a hint, so a
+missing or damaged list just means that the cache starts out cold. */
+
+/* The next two functions block, so they should be run in the blocker pool.
+
+Returns the block ids in the list at `path`, or an empty vector if there is no usable
+list. */
+std::vector<block_id_t> blocking_read_warm_cache_list(const std::string &path);
+
+/* Replaces the list at `path`.  The list is written to a temporary file first, so a
+crash doesn't leave a partially written list behind.  Returns false on failure. */
+bool blocking_write_warm_cache_list(const std::string &path,
+                                    const std::vector<block_id_t> &block_ids);
+
+/* Warms up a page cache from the list at `path` in the background when it's
+constructed, then keeps the list up to date.  It rewrites the list every
+WARM_CACHE_SAVE_INTERVAL_MS, and one last time when it's destroyed on a clean shutdown.
+Destroying it interrupts a warm-up that is still running. */
+class cache_warmer_t : public home_thread_mixin_t {
+public:
+    cache_warmer_t(alt::page_cache_t *page_cache, const std::string &path);
+    ~cache_warmer_t();
+
+private:
+    void warm_up_and_save_periodically(auto_drainer_t::lock_t keepalive);
+    void save();
+
+    alt::page_cache_t *const page_cache_;
+    const std::string path_;
+
+    // Whether the warm-up finished, so that the cache's contents are worth saving.
+    bool warmed_up_;
+
+    auto_drainer_t drainer_;
+
+    DISABLE_COPYING(cache_warmer_t);
+};
+
+#endif  // BUFFER_CACHE_WARM_CACHE_HPP_
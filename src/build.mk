@@ -211,6 +211,10 @@ ifeq ($(NO_EPOLL),1)
   RT_CXXFLAGS += -DNO_EPOLL
 endif
 
+ifeq ($(NO_IO_URING),1)
+  RT_CXXFLAGS += -DNO_IO_URING
+endif
+
 ifeq ($(THREADED_COROUTINES),1)
   RT_CXXFLAGS += -DTHREADED_COROUTINES
 endif
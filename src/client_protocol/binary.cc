@@ -0,0 +1,104 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "client_protocol/binary.hpp"
+
+#include <vector>
+
+#include "arch/io/network.hpp"
+#include "client_protocol/protocols.hpp"
+#include "containers/archive/vector_stream.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/query_params.hpp"
+#include "rdb_protocol/rdb_backtrace.hpp"
+#include "rdb_protocol/response.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
+#include "rdb_protocol/term_storage.hpp"
+
+scoped_ptr_t<ql::query_params_t> binary_protocol_t::parse_query(
+        tcp_conn_t *conn,
+        signal_t *interruptor,
+        ql::query_cache_t *query_cache) {
+    return json_protocol_t::parse_query(conn, interruptor, query_cache,
+                                        &binary_protocol_t::send_response);
+}
+
+ql::datum_t response_to_datum(ql::response_t *response) {
+    ql::datum_object_builder_t builder;
+    builder.overwrite("t", ql::datum_t(static_cast<double>(response->type())));
+    if (response->type() == Response::RUNTIME_ERROR &&
+        response->error_type()) {
+        builder.overwrite(
+            "e", ql::datum_t(static_cast<double>(*response->error_type())));
+    }
+    // This only copies references to the rows.
+    builder.overwrite("r", ql::datum_t(std::vector<ql::datum_t>(response->data()),
+                                       ql::configured_limits_t::unlimited));
+    if (response->backtrace()) {
+        builder.overwrite("b", *response->backtrace());
+    }
+    if (response->profile()) {
+        builder.overwrite("p", *response->profile());
+    }
+    if (response->type() == Response::SUCCESS_PARTIAL ||
+        response->type() == Response::SUCCESS_SEQUENCE) {
+        std::vector<ql::datum_t> notes;
+        for (const auto &note : response->notes()) {
+            notes.push_back(ql::datum_t(static_cast<double>(note)));
+        }
+        builder.overwrite("n", ql::datum_t(std::move(notes),
+                                           ql::configured_limits_t::unlimited));
+    }
+    return std::move(builder).to_datum();
+}
+
+void binary_protocol_t::write_response_to_message(ql::response_t *response,
+                                                  write_message_t *wm_out) {
+    write_message_t wm;
+    ql::serialization_result_t res = ql::datum_serialize(
+        &wm, response_to_datum(response),
+        ql::check_datum_serialization_errors_t::NO);
+    if (res & ql::serialization_result_t::EXTREMA_PRESENT) {
+        // The JSON protocol can't send these either.
+        response->fill_error(Response::RUNTIME_ERROR, Response::QUERY_LOGIC,
+                             "Cannot send `r.minval` or `r.maxval` to the client.",
+                             ql::backtrace_registry_t::EMPTY_BACKTRACE);
+        write_response_to_message(response, wm_out);
+        return;
+    }
+    wm_out->unsafe_expose_buffers()->append_and_clear(wm.unsafe_expose_buffers());
+}
+
+void binary_protocol_t::send_response(ql::response_t *response,
+                                      int64_t token,
+                                      tcp_conn_t *conn,
+                                      signal_t *interruptor) {
+    write_message_t wm;
+    write_response_to_message(response, &wm);
+    size_t payload_size = wm.size();
+    guarantee(payload_size > 0);
+
+    if (payload_size >= wire_protocol_t::TOO_LARGE_RESPONSE_SIZE) {
+        response->fill_error(Response::RUNTIME_ERROR,
+                             Response::RESOURCE_LIMIT,
+                             wire_protocol_t::too_large_response_message(payload_size),
+                             ql::backtrace_registry_t::EMPTY_BACKTRACE);
+        send_response(response, token, conn, interruptor);
+        return;
+    }
+
+    uint32_t data_size = static_cast<uint32_t>(payload_size);
+#ifdef __s390x__
+    token = __builtin_bswap64(token);
+    data_size = __builtin_bswap32(data_size);
+#endif
+
+    // The token, the size and the response go out in a single write.
+    vector_stream_t stream;
+    stream.reserve(sizeof(token) + sizeof(data_size) + payload_size);
+    int64_t written = stream.write(&token, sizeof(token));
+    written += stream.write(&data_size, sizeof(data_size));
+    guarantee(written == sizeof(token) + sizeof(data_size));
+    int send_res = send_write_message(&stream, &wm);
+    guarantee(send_res == 0);
+
+    conn->write(stream.vector().data(), stream.vector().size(), interruptor);
+}
@@ -0,0 +1,39 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#ifndef CLIENT_PROTOCOL_BINARY_HPP_
+#define CLIENT_PROTOCOL_BINARY_HPP_
+
+#include <stdint.h>
+
+#include "arch/types.hpp"
+#include "containers/scoped.hpp"
+
+class signal_t;
+class write_message_t;
+
+namespace ql {
+class response_t;
+class query_cache_t;
+class query_params_t;
+}
+
+// Queries are read as JSON, exactly like in `json_protocol_t`, but each response is a
+// single object datum with the same fields as the JSON response (`t`, `e`, `r`, `b`,
+// `p` and `n`) in the format of `rdb_protocol/serialize_datum.cc`.  Rows that are
+// still in their serialized form are copied into the response as they are.  Clients
+// ask for this with `protocol_version` 1 in the V1_0 handshake.
+class binary_protocol_t {
+public:
+    static scoped_ptr_t<ql::query_params_t> parse_query(tcp_conn_t *conn,
+                                                        signal_t *interruptor,
+                                                        ql::query_cache_t *query_cache);
+
+    static void write_response_to_message(ql::response_t *response,
+                                          write_message_t *wm_out);
+
+    static void send_response(ql::response_t *response,
+                              int64_t token,
+                              tcp_conn_t *conn,
+                              signal_t *interruptor);
+};
+
+#endif // CLIENT_PROTOCOL_BINARY_HPP_
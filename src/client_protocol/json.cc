@@ -20,6 +20,13 @@ scoped_ptr_t<ql::query_params_t> json_protocol_t::parse_query_from_buffer(
         scoped_array_t<char> &&buffer, size_t offset,
         ql::query_cache_t *query_cache, int64_t token,
         ql::response_t *error_out) {
+    // Queries don't go through `ql::parse_json`, even for insert payloads.  Drivers
+    // send documents as term trees (objects become `MAKE_OBJ` terms, arrays
+    // `MAKE_ARRAY` terms), and `preprocess_term_tree` edits that tree in place to
+    // attach backtraces, so we need the DOM rather than a datum.  Parsing in situ
+    // also leaves no source text behind for the few `DATUM` terms with structured
+    // values; those are small and `to_datum` converts them directly from the DOM.
+    // See `JsonParserTest.QueryBenchmark` for where the time goes.
     rapidjson::Document doc;
     doc.ParseInsitu(buffer.data() + offset);
 
@@ -48,7 +55,8 @@ scoped_ptr_t<ql::query_params_t> json_protocol_t::parse_query_from_buffer(
 scoped_ptr_t<ql::query_params_t> json_protocol_t::parse_query(
         tcp_conn_t *conn,
         signal_t *interruptor,
-        ql::query_cache_t *query_cache) {
+        ql::query_cache_t *query_cache,
+        send_response_t send_error) {
     int64_t token;
     uint32_t size;
     conn->read_buffered(&token, sizeof(token), interruptor);
@@ -75,7 +83,7 @@ scoped_ptr_t<ql::query_params_t> json_protocol_t::parse_query(
             conn->pop(size, &pop_interruptor);
         }
 
-        send_response(&error, token, conn, interruptor);
+        send_error(&error, token, conn, interruptor);
         throw tcp_conn_read_closed_exc_t();
     }
 
@@ -91,7 +99,7 @@ scoped_ptr_t<ql::query_params_t> json_protocol_t::parse_query(
         parse_query_from_buffer(std::move(data), 0, query_cache, token, &error);
 
     if (!res.has()) {
-        send_response(&error, token, conn, interruptor);
+        send_error(&error, token, conn, interruptor);
     }
     return res;
 }
@@ -7,6 +7,7 @@
 #include <string>
 
 // Include all available wire protocols
+#include "client_protocol/binary.hpp"
 #include "client_protocol/json.hpp"
 
 // Contains common declarations used by all wire protocols, this is a class rather than
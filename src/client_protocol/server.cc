@@ -272,6 +272,8 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
     }
 
     uint8_t version = 0;
+    // Whether the client asked for `binary_protocol_t` responses.
+    bool binary_responses = false;
     std::unique_ptr<auth::base_authenticator_t> authenticator;
     uint32_t error_code = 0;
     std::string error_message;
@@ -367,7 +369,7 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
             {
                 ql::datum_object_builder_t datum_object_builder;
                 datum_object_builder.overwrite("success", ql::datum_t::boolean(true));
-                datum_object_builder.overwrite("max_protocol_version", ql::datum_t(0.0));
+                datum_object_builder.overwrite("max_protocol_version", ql::datum_t(1.0));
                 datum_object_builder.overwrite("min_protocol_version", ql::datum_t(0.0));
                 datum_object_builder.overwrite(
                     "server_version", ql::datum_t(RETHINKDB_VERSION));
@@ -387,10 +389,13 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
                     throw client_protocol::client_server_error_t(
                         1, "Expected a number for `protocol_version`.");
                 }
-                if (protocol_version.as_num() != 0.0) {
+                if (protocol_version.as_num() != 0.0
+                    && protocol_version.as_num() != 1.0) {
                     throw client_protocol::client_server_error_t(
                         2, "Unsupported `protocol_version`.");
                 }
+                // Version 1 is version 0 with binary responses.
+                binary_responses = protocol_version.as_num() == 1.0;
 
                 ql::datum_t authentication_method =
                     datum.get_field("authentication_method", ql::NOTHROW);
@@ -459,13 +464,18 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
                 : ql::return_empty_normal_batches_t::NO,
             auth::user_context_t(authenticator->get_authenticated_username()));
 
-        connection_loop<json_protocol_t>(
-            conn.get(),
-            (version < 4)
-                ? 1
-                : 1024,
-            &query_cache,
-            &ct_keepalive);
+        if (binary_responses) {
+            connection_loop<binary_protocol_t>(
+                conn.get(), 1024, &query_cache, &ct_keepalive);
+        } else {
+            connection_loop<json_protocol_t>(
+                conn.get(),
+                (version < 4)
+                    ? 1
+                    : 1024,
+                &query_cache,
+                &ct_keepalive);
+        }
     } catch (client_protocol::client_server_error_t const &error) {
         // We can't write the response here due to coroutine switching inside an
         // exception handler
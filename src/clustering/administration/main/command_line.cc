@@ -1045,6 +1045,7 @@ void run_rethinkdb_create(const base_path_t &base_path,
                           optional<uint64_t> total_cache_size,
                           const file_direct_io_mode_t direct_io_mode,
                           const int max_concurrent_io_requests,
+                          const disk_io_backend_t io_backend,
                           bool *const result_out) {
     server_id_t our_server_id = server_id_t::generate_server_id();
 
@@ -1058,7 +1059,7 @@ void run_rethinkdb_create(const base_path_t &base_path,
     server_config.config.cache_size_bytes = total_cache_size;
     server_config.version = 1;
 
-    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests);
+    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests, io_backend);
 
     perfmon_collection_t metadata_perfmon_collection;
     perfmon_membership_t metadata_perfmon_membership(&get_global_perfmon_collection(), &metadata_perfmon_collection, "metadata");
@@ -1139,6 +1140,7 @@ void run_rethinkdb_serve(const base_path_t &base_path,
                          const std::string &initial_password,
                          const file_direct_io_mode_t direct_io_mode,
                          const int max_concurrent_io_requests,
+                         const disk_io_backend_t io_backend,
                          const optional<optional<uint64_t> >
                             &total_cache_size,
                          const server_id_t *our_server_id,
@@ -1156,7 +1158,7 @@ void run_rethinkdb_serve(const base_path_t &base_path,
 
     logNTC("Loading data from directory %s\n", base_path.path().c_str());
 
-    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests);
+    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests, io_backend);
 
     perfmon_collection_t metadata_perfmon_collection;
     perfmon_membership_t metadata_perfmon_membership(&get_global_perfmon_collection(), &metadata_perfmon_collection, "metadata");
@@ -1284,6 +1286,7 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
                              const std::string &initial_password,
                              const file_direct_io_mode_t direct_io_mode,
                              const int max_concurrent_io_requests,
+                             const disk_io_backend_t io_backend,
                              const optional<optional<uint64_t> >
                                 &total_cache_size,
                              const bool new_directory,
@@ -1292,7 +1295,7 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
                              bool *const result_out) {
     if (!new_directory) {
         run_rethinkdb_serve(base_path, serve_info, initial_password, direct_io_mode,
-                            max_concurrent_io_requests, total_cache_size,
+                            max_concurrent_io_requests, io_backend, total_cache_size,
                             nullptr, nullptr, nullptr, data_directory_lock,
                             result_out);
     } else {
@@ -1328,7 +1331,7 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
         server_config.version = 1;
 
         run_rethinkdb_serve(base_path, serve_info, initial_password, direct_io_mode,
-                            max_concurrent_io_requests,
+                            max_concurrent_io_requests, io_backend,
                             optional<optional<uint64_t> >(),
                             &our_server_id, &server_config, &cluster_metadata,
                             data_directory_lock, result_out);
@@ -1412,11 +1415,52 @@ options::help_section_t get_file_options(std::vector<options::option_t> *options
     options_out->push_back(options::option_t(options::names_t("--direct-io"),
                                              options::OPTIONAL_NO_PARAMETER));
     help.add("--direct-io", "use direct I/O for file access");
+    options_out->push_back(options::option_t(options::names_t("--io-uring"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--io-uring", "use io_uring instead of a thread pool for file access, if "
+             "the kernel supports it");
 #endif
     options_out->push_back(options::option_t(options::names_t("--cache-size"),
                                              options::OPTIONAL));
     help.add("--cache-size mb", "total cache size (in megabytes) for the process. Can "
         "be 'auto'.");
+    options_out->push_back(options::option_t(options::names_t("--block-compression"),
+                                             options::OPTIONAL,
+                                             "none"));
+    help.add("--block-compression {none|zlib}",
+             "compress table data blocks before writing them to disk");
+    options_out->push_back(options::option_t(options::names_t("--no-block-checksums"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--no-block-checksums", "don't checksum newly written table data blocks, "
+             "and don't scrub the table files in the background");
+    options_out->push_back(options::option_t(options::names_t("--gc-policy"),
+                                             options::OPTIONAL,
+                                             "greedy"));
+    help.add("--gc-policy {greedy|cost-benefit}",
+             "how the garbage collector picks the parts of the table files that it "
+             "compacts; 'cost-benefit' separates cold data from hot data");
+    options_out->push_back(
+        options::option_t(options::names_t("--btree-prefix-compression"),
+                          options::OPTIONAL_NO_PARAMETER));
+    help.add("--btree-prefix-compression",
+             "store the keys of new B-tree leaf nodes prefix-compressed. Table files "
+             "written with this option can't be opened by older versions of "
+             "RethinkDB");
+    options_out->push_back(
+        options::option_t(options::names_t("--btree-leaf-counts"),
+                          options::OPTIONAL_NO_PARAMETER));
+    help.add("--btree-leaf-counts",
+             "keep the number of documents in each B-tree leaf node in its parent, "
+             "which makes counting large ranges faster but makes writes slower. Table "
+             "files written with this option can't be opened by older versions of "
+             "RethinkDB");
+    options_out->push_back(
+        options::option_t(options::names_t("--cache-eviction-policy"),
+                          options::OPTIONAL,
+                          "random"));
+    help.add("--cache-eviction-policy {random|2q}",
+             "how the cache picks pages to evict; '2q' keeps large scans from "
+             "evicting frequently used data");
     return help;
 }
 
@@ -1624,6 +1668,13 @@ options::help_section_t get_network_options(const bool join_required, std::vecto
                                                     "before giving up, the default is "
                                                     "24 hours");
 
+    options_out->push_back(options::option_t(options::names_t("--cluster-compression"),
+                                             options::OPTIONAL,
+                                             "none"));
+    help.add("--cluster-compression {none|zlib}",
+             "compress the messages sent to other servers that support it, which "
+             "reduces the bandwidth used by backfills");
+
     return help;
 }
 
@@ -1899,6 +1950,84 @@ file_direct_io_mode_t parse_direct_io_mode_option(const std::map<std::string, op
         file_direct_io_mode_t::buffered_desired;
 }
 
+disk_io_backend_t parse_io_backend_option(const std::map<std::string, options::values_t> &opts) {
+    return exists_option(opts, "--io-uring") ?
+        disk_io_backend_t::uring :
+        disk_io_backend_t::pool;
+}
+
+block_compression_t parse_block_compression_option(
+        const std::map<std::string, options::values_t> &opts) {
+    const std::string compression_opt = get_single_option(opts, "--block-compression");
+    if (compression_opt == "none") {
+        return block_compression_t::none;
+    } else if (compression_opt == "zlib") {
+        return block_compression_t::zlib;
+    } else {
+        throw std::runtime_error(strprintf(
+                "ERROR: block-compression should be 'none' or 'zlib', got '%s'",
+                compression_opt.c_str()));
+    }
+}
+
+gc_policy_t parse_gc_policy_option(const std::map<std::string, options::values_t> &opts) {
+    const std::string policy_opt = get_single_option(opts, "--gc-policy");
+    if (policy_opt == "greedy") {
+        return gc_policy_t::greedy;
+    } else if (policy_opt == "cost-benefit") {
+        return gc_policy_t::cost_benefit;
+    } else {
+        throw std::runtime_error(strprintf(
+                "ERROR: gc-policy should be 'greedy' or 'cost-benefit', got '%s'",
+                policy_opt.c_str()));
+    }
+}
+
+log_serializer_dynamic_config_t parse_serializer_config_options(
+        const std::map<std::string, options::values_t> &opts) {
+    log_serializer_dynamic_config_t config;
+    config.compression = parse_block_compression_option(opts);
+    config.checksum_blocks = !exists_option(opts, "--no-block-checksums");
+    config.gc_policy = parse_gc_policy_option(opts);
+    return config;
+}
+
+btree_node_formats_t parse_btree_node_formats_options(
+        const std::map<std::string, options::values_t> &opts) {
+    btree_node_formats_t formats;
+    formats.prefix_compressed_leaves = exists_option(opts, "--btree-prefix-compression");
+    formats.counted_internal_nodes = exists_option(opts, "--btree-leaf-counts");
+    return formats;
+}
+
+cluster_compression_t parse_cluster_compression_option(
+        const std::map<std::string, options::values_t> &opts) {
+    const std::string compression_opt = get_single_option(opts, "--cluster-compression");
+    if (compression_opt == "none") {
+        return cluster_compression_t::none;
+    } else if (compression_opt == "zlib") {
+        return cluster_compression_t::zlib;
+    } else {
+        throw std::runtime_error(strprintf(
+                "ERROR: cluster-compression should be 'none' or 'zlib', got '%s'",
+                compression_opt.c_str()));
+    }
+}
+
+cache_eviction_policy_t parse_cache_eviction_policy_option(
+        const std::map<std::string, options::values_t> &opts) {
+    const std::string policy_opt = get_single_option(opts, "--cache-eviction-policy");
+    if (policy_opt == "random") {
+        return cache_eviction_policy_t::random_sampling;
+    } else if (policy_opt == "2q") {
+        return cache_eviction_policy_t::two_queue;
+    } else {
+        throw std::runtime_error(strprintf(
+                "ERROR: cache-eviction-policy should be 'random' or '2q', got '%s'",
+                policy_opt.c_str()));
+    }
+}
+
 int main_rethinkdb_create(int argc, char *argv[]) {
     std::vector<options::option_t> options;
     std::vector<options::help_section_t> help;
@@ -1948,6 +2077,7 @@ int main_rethinkdb_create(int argc, char *argv[]) {
         recreate_temporary_directory(base_path);
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
+        const disk_io_backend_t io_backend = parse_io_backend_option(opts);
 
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_create,
@@ -1958,6 +2088,7 @@ int main_rethinkdb_create(int argc, char *argv[]) {
                                      total_cache_size,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend,
                                      &result),
                            num_workers);
 
@@ -2107,9 +2238,14 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
                                 std::vector<std::string>(argv, argv + argc),
                                 join_delay_secs.value_or(0),
                                 node_reconnect_timeout_secs.value_or(cluster_defaults::reconnect_timeout),
-                                tls_configs);
+                                tls_configs,
+                                parse_cluster_compression_option(opts),
+                                parse_serializer_config_options(opts),
+                                parse_btree_node_formats_options(opts),
+                                parse_cache_eviction_policy_option(opts));
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
+        const disk_io_backend_t io_backend = parse_io_backend_option(opts);
 
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_serve,
@@ -2118,6 +2254,7 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
                                      initial_password,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend,
                                      total_cache_size,
                                      static_cast<server_id_t*>(nullptr),
                                      static_cast<server_config_versioned_t *>(nullptr),
@@ -2210,7 +2347,11 @@ int main_rethinkdb_proxy(int argc, char *argv[]) {
                                 std::vector<std::string>(argv, argv + argc),
                                 join_delay_secs.value_or(0),
                                 node_reconnect_timeout_secs.value_or(cluster_defaults::reconnect_timeout),
-                                tls_configs);
+                                tls_configs,
+                                parse_cluster_compression_option(opts),
+                                log_serializer_dynamic_config_t(),
+                                btree_node_formats_t(),
+                                cache_eviction_policy_t::random_sampling);
 
         bool result;
         run_in_thread_pool(
@@ -2400,9 +2541,14 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
                                 std::vector<std::string>(argv, argv + argc),
                                 join_delay_secs.value_or(0),
                                 node_reconnect_timeout_secs.value_or(cluster_defaults::reconnect_timeout),
-                                tls_configs);
+                                tls_configs,
+                                parse_cluster_compression_option(opts),
+                                parse_serializer_config_options(opts),
+                                parse_btree_node_formats_options(opts),
+                                parse_cache_eviction_policy_option(opts));
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
+        const disk_io_backend_t io_backend = parse_io_backend_option(opts);
 
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_porcelain,
@@ -2412,6 +2558,7 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
                                      initial_password,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend,
                                      total_cache_size,
                                      is_new_directory,
                                      &serve_info,
@@ -236,7 +236,8 @@ bool do_serve(io_backender_t *io_backender,
                 serve_info.ports.client_port,
                 semilattice_manager_heartbeat.get_root_view(),
                 semilattice_manager_auth.get_root_view(),
-                serve_info.tls_configs.cluster.get()));
+                serve_info.tls_configs.cluster.get(),
+                serve_info.cluster_compression));
         } catch (const address_in_use_exc_t &ex) {
             throw address_in_use_exc_t(strprintf("Could not bind to cluster port: %s", ex.what()));
         }
@@ -283,7 +284,9 @@ bool do_serve(io_backender_t *io_backender,
                               nullptr,   /* we'll fill this in later */
                               semilattice_manager_auth.get_root_view(),
                               &get_global_perfmon_collection(),
-                              serve_info.reql_http_proxy);
+                              serve_info.reql_http_proxy,
+                              io_backender,
+                              base_path);
         {
             /* Extract a subview of the directory with all the table meta manager
             business cards. */
@@ -305,14 +308,17 @@ bool do_serve(io_backender_t *io_backender,
             scoped_ptr_t<multi_table_manager_t> multi_table_manager;
             if (i_am_a_server) {
                 cache_balancer.init(new alt_cache_balancer_t(
-                    server_config_server->get_actual_cache_size_bytes()));
+                    server_config_server->get_actual_cache_size_bytes(),
+                    serve_info.cache_eviction_policy));
                 table_persistence_interface.init(
                     new real_table_persistence_interface_t(
                         io_backender,
                         cache_balancer.get(),
                         base_path,
                         &rdb_ctx,
-                        metadata_file));
+                        metadata_file,
+                        serve_info.serializer_config,
+                        serve_info.btree_node_formats));
                 multi_table_manager.init(new multi_table_manager_t(
                     server_id,
                     &mailbox_manager,
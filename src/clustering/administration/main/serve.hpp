@@ -13,6 +13,8 @@
 #include "clustering/administration/main/version_check.hpp"
 #include "arch/address.hpp"
 #include "arch/io/openssl.hpp"
+#include "buffer_cache/types.hpp"
+#include "serializer/log/config.hpp"
 
 class os_signal_cond_t;
 
@@ -120,7 +122,11 @@ public:
                  std::vector<std::string> &&_argv,
                  const int _join_delay_secs,
                  const int _node_reconnect_timeout_secs,
-                 tls_configs_t _tls_configs) :
+                 tls_configs_t _tls_configs,
+                 cluster_compression_t _cluster_compression,
+                 log_serializer_dynamic_config_t _serializer_config,
+                 btree_node_formats_t _btree_node_formats,
+                 cache_eviction_policy_t _cache_eviction_policy) :
         joins(std::move(_joins)),
         reql_http_proxy(std::move(_reql_http_proxy)),
         web_assets(std::move(_web_assets)),
@@ -129,7 +135,11 @@ public:
         config_file(_config_file),
         argv(std::move(_argv)),
         join_delay_secs(_join_delay_secs),
-        node_reconnect_timeout_secs(_node_reconnect_timeout_secs)
+        node_reconnect_timeout_secs(_node_reconnect_timeout_secs),
+        cluster_compression(_cluster_compression),
+        serializer_config(_serializer_config),
+        btree_node_formats(_btree_node_formats),
+        cache_eviction_policy(_cache_eviction_policy)
     {
         tls_configs = _tls_configs;
     }
@@ -151,6 +161,15 @@ public:
     int join_delay_secs;
     int node_reconnect_timeout_secs;
     tls_configs_t tls_configs;
+    /* How the messages we send to other servers get compressed. */
+    cluster_compression_t cluster_compression;
+    /* How the table files' serializers write and collect blocks, e.g. whether they
+    compress and checksum newly written blocks. */
+    log_serializer_dynamic_config_t serializer_config;
+    /* Which optional node formats the tables' B-trees use for new nodes. */
+    btree_node_formats_t btree_node_formats;
+    /* How the table caches pick pages to evict. */
+    cache_eviction_policy_t cache_eviction_policy;
 };
 
 /* This has been factored out from `command_line.hpp` because it takes a very
@@ -14,6 +14,12 @@
 #include "serializer/merger.hpp"
 #include "serializer/translator.hpp"
 
+/* Each store's cache keeps its warm cache list (see `buffer_cache/warm_cache.hpp`) next
+to the table file. */
+std::string warm_cache_list_path(const serializer_filepath_t &path, int shard) {
+    return strprintf("%s.warm_cache_%d", path.permanent_path().c_str(), shard);
+}
+
 class real_multistore_ptr_t :
     public multistore_ptr_t {
 public:
@@ -25,6 +31,8 @@ public:
             io_backender_t *io_backender,
             cache_balancer_t *cache_balancer,
             rdb_context_t *rdb_context,
+            const log_serializer_dynamic_config_t &serializer_config,
+            const btree_node_formats_t &btree_node_formats,
             perfmon_collection_t *perfmon_collection_serializers,
             scoped_ptr_t<thread_allocation_t> &&serializer_thread,
             std::vector<scoped_ptr_t<thread_allocation_t> > &&store_threads,
@@ -63,7 +71,7 @@ public:
         // now, we don't.
 
         scoped_ptr_t<serializer_t> inner_serializer(new log_serializer_t(
-            log_serializer_t::dynamic_config_t(),
+            serializer_config,
             &file_opener,
             perfmon_collection_serializers));
         serializer.init(new merger_serializer_t(
@@ -96,6 +104,7 @@ public:
                 table_id,
                 update_sindexes_t::UPDATE,
                 which_cpu_shard_t{ix, CPU_SHARDING_FACTOR}));
+            stores[ix]->cache->set_btree_node_formats(btree_node_formats);
 
             /* Initialize the metainfo if necessary */
             if (create) {
@@ -112,6 +121,10 @@ public:
                     write_durability_t::HARD,
                     &non_interruptor);
             }
+
+            /* Read the blocks that were hot before the last shutdown back into the
+            cache, so that the store doesn't start out with a cold cache. */
+            stores[ix]->cache->keep_warm(warm_cache_list_path(path, ix));
         });
 
         if (create) {
@@ -298,6 +311,8 @@ void real_table_persistence_interface_t::load_multistore(
         io_backender,
         cache_balancer,
         rdb_context,
+        serializer_config,
+        btree_node_formats,
         perfmon_collection_serializers,
         std::move(serializer_thread),
         std::move(store_threads),
@@ -326,6 +341,14 @@ void real_table_persistence_interface_t::destroy_multistore(
     const int res = ::unlink(filepath.c_str());
     guarantee_err(res == 0 || get_errno() == ENOENT,
                   "unlink failed for file %s", filepath.c_str());
+
+    for (int ix = 0; ix < CPU_SHARDING_FACTOR; ++ix) {
+        const std::string warm_cache_path =
+            warm_cache_list_path(file_name_for(table_id), ix);
+        const int warm_cache_res = ::unlink(warm_cache_path.c_str());
+        guarantee_err(warm_cache_res == 0 || get_errno() == ENOENT,
+                      "unlink failed for file %s", warm_cache_path.c_str());
+    }
 }
 
 serializer_filepath_t real_table_persistence_interface_t::file_name_for(
@@ -5,6 +5,7 @@
 #include "clustering/administration/perfmon_collection_repo.hpp"
 #include "clustering/administration/persist/raft_storage_interface.hpp"
 #include "clustering/table_manager/table_metadata.hpp"
+#include "serializer/log/config.hpp"
 
 class cache_balancer_t;
 class metadata_file_t;
@@ -19,12 +20,16 @@ public:
             cache_balancer_t *_cache_balancer,
             const base_path_t &_base_path,
             rdb_context_t *_rdb_context,
-            metadata_file_t *_metadata_file) :
+            metadata_file_t *_metadata_file,
+            const log_serializer_dynamic_config_t &_serializer_config,
+            const btree_node_formats_t &_btree_node_formats) :
         io_backender(_io_backender),
         cache_balancer(_cache_balancer),
         base_path(_base_path),
         rdb_context(_rdb_context),
         metadata_file(_metadata_file),
+        serializer_config(_serializer_config),
+        btree_node_formats(_btree_node_formats),
         /* We assign threads from the lowest thread number upwards. This is to reduce
         the potential for conflicting with cluster connection threads, which are
         assigned from the highest thread number downwards. */
@@ -81,6 +86,10 @@ private:
     base_path_t const base_path;
     rdb_context_t * const rdb_context;
     metadata_file_t * const metadata_file;
+    /* The configuration for the tables' serializers. */
+    log_serializer_dynamic_config_t const serializer_config;
+    /* The node formats that the tables' B-trees use for new nodes. */
+    btree_node_formats_t const btree_node_formats;
 
     std::map<
         namespace_id_t, std::pair<real_multistore_ptr_t *, auto_drainer_t::lock_t>
@@ -500,8 +500,9 @@ void backfillee_t::send_pre_items(auto_drainer_t::lock_t keepalive) {
             sem_acq.change_count(chunk.get_mem_size());
             pre_item_throttler_acq.transfer_in(std::move(sem_acq));
 
-            /* Send the chunk over the network */
-            send(mailbox_manager, intro.pre_items_mailbox,
+            /* Send the chunk over the network, compressed if the connection
+            supports it */
+            send(mailbox_manager, message_compression_t::ALWAYS, intro.pre_items_mailbox,
                 fifo_source.enter_write(), chunk);
 
             /* Update `progress` */
@@ -375,8 +375,11 @@ private:
                     represent the state of the backfillee after it applies all the chunks
                     we've sent. */
                     try {
-                        /* Send the chunk over the network */
+                        /* Send the chunk over the network. Backfill chunks are
+                        large and throughput-bound, so we compress them even if
+                        they happen to be small. */
                         send(parent->parent->mailbox_manager,
+                            message_compression_t::ALWAYS,
                             parent->intro.items_mailbox,
                             parent->fifo_source.enter_write(), metainfo, chunk);
 
@@ -126,6 +126,38 @@
 // How many block ids should the LBA garbage collector rewrite before yielding?
 #define LBA_GC_BATCH_SIZE                         (1024 * 8)
 
+// The background scrubber re-reads blocks at a very low I/O priority to verify their
+// checksums.  It checks SCRUBBER_BATCH_SIZE blocks at a time, then pauses for
+// SCRUBBER_BATCH_INTERVAL_MS.  After a full pass over the file, it waits for
+// SCRUBBER_PASS_INTERVAL_MS before starting over.
+#define SCRUBBER_IO_PRIORITY                      1
+#define SCRUBBER_BATCH_SIZE                       128
+#define SCRUBBER_BATCH_INTERVAL_MS                100
+#define SCRUBBER_START_DELAY_MS                   (60 * 1000)
+#define SCRUBBER_PASS_INTERVAL_MS                 (24 * 60 * 60 * 1000)
+
+// Every store's cache keeps a list of its hottest blocks in a file next to the table
+// file, so that it can read them back in when the server restarts.  The list gets
+// rewritten every WARM_CACHE_SAVE_INTERVAL_MS and on shutdown, and holds at most
+// WARM_CACHE_MAX_BLOCKS block ids.  On startup the blocks are read in batches of
+// WARM_CACHE_LOAD_BATCH_SIZE.  If a batch doesn't fit into the cache, we wait up to
+// WARM_CACHE_MAX_WAIT_FOR_ROOM_MS for the cache balancer to make room before we give up.
+#define WARM_CACHE_SAVE_INTERVAL_MS               (5 * 60 * 1000)
+#define WARM_CACHE_MAX_BLOCKS                     (1024 * 1024)
+#define WARM_CACHE_LOAD_BATCH_SIZE                256
+#define WARM_CACHE_MAX_WAIT_FOR_ROOM_MS           2000
+
+// How many of the upcoming children of an internal node a depth-first B-tree
+// traversal asks the cache to load ahead of acquiring them (see
+// btree/depth_first_traversal.cc).
+#define DEPTH_FIRST_TRAVERSAL_PREFETCH_COUNT      16
+
+// The buffers of cached blocks are carved out of chunks of BLOCK_ARENA_CHUNK_SIZE
+// bytes (see serializer/block_arena.hpp).  This is the size of a huge page on x86-64,
+// so that each chunk can be backed by a single huge page.  Chunks must be mapped at
+// addresses that are a multiple of their size.
+#define BLOCK_ARENA_CHUNK_SIZE                    (2 * MEGABYTE)
+
 // How many LBA structures to have for each file (This value defines the disk format!
 // It can't change unless you're very careful.)
 #define LBA_SHARD_FACTOR                          4
@@ -141,8 +173,32 @@
 // block infos.
 #define LBA_RECONSTRUCTION_BATCH_SIZE             1024
 
+// If loading the LBA of a file takes longer than this, the serializer logs its progress
+// every `LBA_LOAD_PROGRESS_INTERVAL_MS`.
+#define LBA_LOAD_PROGRESS_INTERVAL_MS             (10 * 1000)
+
 #define COROUTINE_STACK_SIZE                      131072
 
+// An external sort (see rdb_protocol/datum_stream/external_sort.hpp) merges its runs
+// into one whenever it has this many, so that it never has more temporary files open
+// at once.
+#define EXTERNAL_SORT_MAX_RUNS                    32
+
+// A query may write at most this many bytes to temporary files for external sorts and
+// spilled groups, so that a single query can't fill up the disk.
+#define QUERY_MAX_TEMPORARY_FILES_SIZE            (16 * GIGABYTE)
+
+// A grouped reduction (like `group(...).count()`) keeps at most this many groups in
+// memory where the results of the shards are merged.  Beyond that it spills the groups
+// to temporary files, split into this many partitions by the hash of the group.  The
+// merged result is kept in memory, so it is still limited by the query's `array_limit`.
+#define GROUPED_ACC_MAX_IN_MEMORY_GROUPS          100000
+#define GROUPED_ACC_SPILL_PARTITIONS              16
+
+// The number of prepared queries (see `Query::PREPARE`) that a client connection may
+// keep on the server at once.
+#define MAX_PREPARED_QUERIES_PER_CONNECTION       1024
+
 
 /**
  * Message scheduler configuration
@@ -58,6 +58,20 @@ int64_t tcp_conn_stream_t::write_buffered(const void *p, int64_t n) {
     }
 }
 
+int64_t tcp_conn_stream_t::write_vectored(const iovec *bufs, size_t count) {
+    int64_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += bufs[i].iov_len;
+    }
+    try {
+        cond_t non_closer;
+        conn_->write_vectored(bufs, count, &non_closer);
+        return total;
+    } catch (const tcp_conn_write_closed_exc_t &) {
+        return -1;
+    }
+}
+
 bool tcp_conn_stream_t::flush_buffer() {
     try {
         cond_t non_closer;
@@ -147,6 +161,14 @@ int64_t keepalive_tcp_conn_stream_t::write_buffered(const void *p, int64_t n) {
     return tcp_conn_stream_t::write_buffered(p, n);
 }
 
+int64_t keepalive_tcp_conn_stream_t::write_vectored(const iovec *bufs, size_t count) {
+    if (keepalive_callback != nullptr) {
+        keepalive_callback->keepalive_write();
+    }
+
+    return tcp_conn_stream_t::write_vectored(bufs, count);
+}
+
 bool keepalive_tcp_conn_stream_t::flush_buffer() {
     if (keepalive_callback != nullptr) {
         keepalive_callback->keepalive_write();
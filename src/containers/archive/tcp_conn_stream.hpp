@@ -23,6 +23,9 @@ public:
     virtual MUST_USE int64_t read(void *p, int64_t n);
     virtual MUST_USE int64_t write(const void *p, int64_t n);
     virtual MUST_USE int64_t write_buffered(const void *p, int64_t n);
+    // Writes `count` buffers one after another without copying them. Returns the
+    // total number of bytes written, or -1 on failure.
+    virtual MUST_USE int64_t write_vectored(const iovec *bufs, size_t count);
     virtual bool flush_buffer();
 
     void rethread(threadnum_t new_thread);
@@ -75,6 +78,7 @@ public:
     virtual MUST_USE int64_t read(void *p, int64_t n);
     virtual MUST_USE int64_t write(const void *p, int64_t n);
     virtual MUST_USE int64_t write_buffered(const void *p, int64_t n);
+    virtual MUST_USE int64_t write_vectored(const iovec *bufs, size_t count);
     virtual bool flush_buffer();
 
 private:
@@ -54,6 +54,10 @@ public:
     void remove(entry_t *);
     T pop();
     void update(int);
+    /* \brief rebuild() restores the order of the queue after a change that
+     * affects the order of many entries at once
+     */
+    void rebuild();
 public:
     void validate();
 
@@ -0,0 +1,107 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "crc32c.hpp"
+
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(_WIN32)
+#define CRC32C_HAVE_SSE42 1
+#include <nmmintrin.h>
+#else
+#define CRC32C_HAVE_SSE42 0
+#endif
+
+namespace {
+
+// The reflected Castagnoli polynomial.
+const uint32_t crc32c_polynomial = 0x82F63B78;
+
+class crc32c_table_t {
+public:
+    crc32c_table_t() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int j = 0; j < 8; ++j) {
+                crc = (crc >> 1) ^ ((crc & 1) != 0 ? crc32c_polynomial : 0);
+            }
+            table[0][i] = crc;
+        }
+        // The additional tables let us process eight bytes per iteration
+        // ("slicing-by-8").
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int k = 1; k < 8; ++k) {
+                table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+            }
+        }
+    }
+
+    uint32_t table[8][256];
+};
+
+const crc32c_table_t crc32c_table;
+
+#if CRC32C_HAVE_SSE42
+
+__attribute__((target("sse4.2")))
+uint32_t crc32c_sse42(const void *data, size_t size, uint32_t crc) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    uint64_t c = ~crc;
+    for (; size > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0; --size, ++p) {
+        c = _mm_crc32_u8(c, *p);
+    }
+    for (; size >= 8; size -= 8, p += 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        c = _mm_crc32_u64(c, word);
+    }
+    for (; size > 0; --size, ++p) {
+        c = _mm_crc32_u8(c, *p);
+    }
+    return ~static_cast<uint32_t>(c);
+}
+
+bool detect_sse42() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+}
+
+const bool have_sse42 = detect_sse42();
+
+#endif  // CRC32C_HAVE_SSE42
+
+}  // namespace
+
+uint32_t crc32c_software(const void *data, size_t size, uint32_t crc) {
+    const uint32_t (&t)[8][256] = crc32c_table.table;
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    uint32_t c = ~crc;
+    for (; size >= 8; size -= 8, p += 8) {
+        const uint32_t lo = c ^ (static_cast<uint32_t>(p[0])
+                                 | static_cast<uint32_t>(p[1]) << 8
+                                 | static_cast<uint32_t>(p[2]) << 16
+                                 | static_cast<uint32_t>(p[3]) << 24);
+        c = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF]
+            ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+            ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+    for (; size > 0; --size, ++p) {
+        c = (c >> 8) ^ t[0][(c ^ *p) & 0xFF];
+    }
+    return ~c;
+}
+
+uint32_t crc32c(const void *data, size_t size, uint32_t crc) {
+#if CRC32C_HAVE_SSE42
+    if (have_sse42) {
+        return crc32c_sse42(data, size, crc);
+    }
+#endif
+    return crc32c_software(data, size, crc);
+}
+
+bool crc32c_is_hardware_accelerated() {
+#if CRC32C_HAVE_SSE42
+    return have_sse42;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,22 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#ifndef CRC32C_HPP_
+#define CRC32C_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* CRC-32C (the Castagnoli polynomial, as used by iSCSI and ext4). `crc32c()` uses
+the SSE4.2 `crc32` instruction if the CPU supports it, and a table-driven software
+implementation otherwise. Both produce the same results.
+
+To checksum data that is split across several buffers, pass the result for the
+previous buffer as `crc` for the next one. */
+uint32_t crc32c(const void *data, size_t size, uint32_t crc = 0);
+
+// Always uses the software implementation. Exposed for testing.
+uint32_t crc32c_software(const void *data, size_t size, uint32_t crc = 0);
+
+// Whether `crc32c()` uses hardware instructions on this machine.
+bool crc32c_is_hardware_accelerated();
+
+#endif  // CRC32C_HPP_
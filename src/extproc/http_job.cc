@@ -15,9 +15,8 @@
 #include "containers/archive/stl_types.hpp"
 #include "extproc/extproc_job.hpp"
 #include "http/http_parser.hpp"
-#include "rapidjson/document.h"
-#include "rapidjson/error/en.h"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/json_parser.hpp"
 
 #define RETHINKDB_USER_AGENT (SOFTWARE_NAME_STRING "/" RETHINKDB_VERSION)
 
@@ -868,14 +867,11 @@ void json_to_datum(const std::string &json,
                    reql_version_t reql_version,
                    attach_json_to_error_t attach_json,
                    http_result_t *res_out) {
-    rapidjson::Document doc;
-    doc.Parse(json.c_str());
-    if (!doc.HasParseError()) {
-        res_out->body = ql::to_datum(doc, limits, reql_version);
-    } else {
+    try {
+        res_out->body = ql::parse_json(json.data(), json.size(), limits, reql_version);
+    } catch (const ql::json_parse_exc_t &ex) {
         res_out->error.assign(
-            strprintf("failed to parse JSON response: %s",
-                      rapidjson::GetParseError_En(doc.GetParseError())));
+            strprintf("failed to parse JSON response: %s", ex.what()));
         if (attach_json == attach_json_to_error_t::YES) {
             res_out->body = ql::datum_t(datum_string_t(json));
         }
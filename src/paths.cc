@@ -2,6 +2,7 @@
 
 #include <fcntl.h>
 #include <limits.h>
+#include <string.h>
 #include <unistd.h>
 
 #ifdef _WIN32
@@ -12,9 +13,12 @@
 #include <filesystem>
 #endif
 #else  // _WIN32
+#include <dirent.h>
 #include <ftw.h>
 #endif  // _WIN32
 
+#include <vector>
+
 #include "arch/io/disk.hpp"
 #include "clustering/administration/main/directory_lock.hpp"
 #include "logger.hpp"
@@ -126,7 +130,50 @@ bool is_rw_directory(const base_path_t& path) {
     return (details.st_mode & S_IFDIR) > 0;
 }
 
+static bool is_query_temporary_file(const std::string &name) {
+    return name.compare(0, strlen(EXTERNAL_SORT_FILE_PREFIX),
+                        EXTERNAL_SORT_FILE_PREFIX) == 0
+        || name.compare(0, strlen(GROUPED_SPILL_FILE_PREFIX),
+                        GROUPED_SPILL_FILE_PREFIX) == 0;
+}
+
+// The temporary files of queries are deleted when the query finishes, so any that
+// still exist on startup were left behind by a crash.
+static void remove_query_temporary_files(const base_path_t &base_path) {
+#ifdef _MSC_VER
+    for (auto it : std::tr2::sys::directory_iterator(base_path.path())) {
+        if (is_query_temporary_file(it.path().filename().string())) {
+            logNTC("Removing the stale temporary file '%s'\n",
+                   it.path().string().c_str());
+            remove_directory_helper(it.path().string().c_str());
+        }
+    }
+#else
+    DIR *dp = opendir(base_path.path().c_str());
+    if (dp == nullptr) {
+        return;
+    }
+    std::vector<std::string> stale_paths;
+    struct dirent *ep;
+    // See `check_dir_emptiness()` for why `readdir` is fine here.
+    while ((ep = readdir(dp)) != nullptr) {  // NOLINT(runtime/threadsafe_fn)
+        if (is_query_temporary_file(ep->d_name)) {
+            stale_paths.push_back(base_path.path() + PATH_SEPARATOR + ep->d_name);
+        }
+    }
+    closedir(dp);
+    for (const std::string &stale_path : stale_paths) {
+        logNTC("Removing the stale temporary file '%s'\n", stale_path.c_str());
+        int res = ::remove(stale_path.c_str());
+        guarantee_err(res == 0 || get_errno() == ENOENT,
+                      "Fatal error: failed to delete '%s'.", stale_path.c_str());
+    }
+#endif
+}
+
 void recreate_temporary_directory(const base_path_t& base_path) {
+    remove_query_temporary_files(base_path);
+
     const base_path_t path(temporary_directory_path(base_path));
 
     if (is_rw_directory(path) && check_dir_emptiness(path))
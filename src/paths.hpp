@@ -28,6 +28,11 @@ private:
 
 static const char *TEMPORARY_DIRECTORY_NAME = "tmp";
 
+// Queries write temporary files with these prefixes directly into the data directory
+// (see `external_sort_datum_stream_t` and `grouped_spill_t`).
+static const char *EXTERNAL_SORT_FILE_PREFIX = "external_sort_";
+static const char *GROUPED_SPILL_FILE_PREFIX = "grouped_spill_";
+
 class serializer_filepath_t;
 
 namespace unittest {
@@ -60,6 +65,8 @@ private:
     const std::string temporary_path_;
 };
 
+// Empties the temporary directory, and removes the temporary files of queries that a
+// crash left behind in `base_path`.
 void recreate_temporary_directory(const base_path_t& base_path);
 
 void remove_directory_recursive(const char *path);
@@ -25,6 +25,12 @@ static const int64_t SCALE_CONSTANT = 0;
 #else
 static const int64_t SCALE_CONSTANT = 32;
 #endif // NDEBUG
+// In adaptive batching mode, the batcher measures the exact size of every this many
+// arrays and objects that aren't backed by a serialization, and assumes that the
+// others have the average size of the ones it measured.
+static const int64_t ADAPTIVE_SIZE_SAMPLE_INTERVAL = 16;
+// `batch_tuner_t` never scales the limits of a batch up by more than this.
+static const int64_t ADAPTIVE_MAX_GROWTH = 16;
 
 batchspec_t::batchspec_t(
     batch_type_t _batch_type,
@@ -33,14 +39,16 @@ batchspec_t::batchspec_t(
     int64_t _max_size,
     int64_t _first_scaledown,
     kiloticks_t _max_dur,
-    kiloticks_t _start_time)
+    kiloticks_t _start_time,
+    bool _adaptive)
     : batch_type(_batch_type),
       min_els(_min_els),
       max_els(_max_els),
       max_size(_max_size),
       first_scaledown_factor(_first_scaledown),
       max_dur(_max_dur),
-      start_time(_start_time) {
+      start_time(_start_time),
+      adaptive(_adaptive) {
     r_sanity_check(first_scaledown_factor >= 1);
     r_sanity_check(max_els >= 1);
     r_sanity_check(min_els >= 1);
@@ -56,7 +64,8 @@ batchspec_t batchspec_t::default_for(batch_type_t batch_type) {
                        DEFAULT_MAX_SIZE,
                        DEFAULT_FIRST_SCALEDOWN,
                        DEFAULT_MAX_DURATION,
-                       get_kiloticks());
+                       get_kiloticks(),
+                       false);
 }
 
 batchspec_t batchspec_t::all() {
@@ -66,7 +75,8 @@ batchspec_t batchspec_t::all() {
                        std::numeric_limits<decltype(batchspec_t().max_size)>::max(),
                        1,
                        kiloticks_t{0},  // Ignored when batch_type is TERMINAL.
-                       get_kiloticks());
+                       get_kiloticks(),
+                       false);
 }
 
 static bool set_if_present(const char *argname, env_t *env, datum_t * dest) {
@@ -85,7 +95,7 @@ batchspec_t batchspec_t::user(batch_type_t batch_type, env_t *env) {
     // casting from double to int64_t
     const double MAX_BATCH_SECONDS = 60 * 60 * 24;
     datum_t max_els_d, min_els_d, max_size_d, max_dur_d;
-    datum_t first_scaledown_d;
+    datum_t first_scaledown_d, adaptive_d;
 
     set_if_present("min_batch_rows", env, &min_els_d);
     set_if_present("max_batch_rows", env, &max_els_d);
@@ -94,6 +104,7 @@ batchspec_t batchspec_t::user(batch_type_t batch_type, env_t *env) {
     // in microseconds, so a scaling operation will be necessary.
     set_if_present("max_batch_seconds", env, &max_dur_d);
     set_if_present("first_batch_scaledown_factor", env, &first_scaledown_d);
+    set_if_present("adaptive_batching", env, &adaptive_d);
 
     int64_t max_els = max_els_d.has()
                       ? max_els_d.as_int()
@@ -134,22 +145,23 @@ batchspec_t batchspec_t::user(batch_type_t batch_type, env_t *env) {
                        max_size,
                        first_sd,
                        max_dur,
-                       get_kiloticks());
+                       get_kiloticks(),
+                       adaptive_d.has() ? adaptive_d.as_bool() : false);
 }
 
 batchspec_t batchspec_t::with_new_batch_type(batch_type_t new_batch_type) const {
     return batchspec_t(new_batch_type, min_els, max_els, max_size,
-                       first_scaledown_factor, max_dur, start_time);
+                       first_scaledown_factor, max_dur, start_time, adaptive);
 }
 
 batchspec_t batchspec_t::with_min_els(int64_t new_min_els) const {
     return batchspec_t(batch_type, std::min(new_min_els, max_els), max_els, max_size,
-                       first_scaledown_factor, max_dur, start_time);
+                       first_scaledown_factor, max_dur, start_time, adaptive);
 }
 
 batchspec_t batchspec_t::with_max_dur(kiloticks_t new_max_dur) const {
     return batchspec_t(batch_type, min_els, max_els, max_size,
-                       first_scaledown_factor, new_max_dur, start_time);
+                       first_scaledown_factor, new_max_dur, start_time, adaptive);
 }
 
 batchspec_t batchspec_t::with_at_most(uint64_t raw_max_els) const {
@@ -172,7 +184,8 @@ batchspec_t batchspec_t::with_at_most(uint64_t raw_max_els) const {
         max_size,
         first_scaledown_factor,
         max_dur,
-        start_time);
+        start_time,
+        adaptive);
 }
 
 batchspec_t batchspec_t::with_lazy_sorting_override(sorting_t sort) const {
@@ -204,7 +217,24 @@ batchspec_t batchspec_t::scale_down(int64_t divisor) const {
     new_max_els = std::max(min_els, new_max_els);
 
     return batchspec_t(batch_type, min_els, new_max_els, new_max_size,
-                       first_scaledown_factor, max_dur, start_time);
+                       first_scaledown_factor, max_dur, start_time, adaptive);
+}
+
+batchspec_t batchspec_t::scale_up(int64_t factor) const {
+    r_sanity_check(factor >= 1);
+    // Unlimited or huge limits stay where they are instead of overflowing.
+    int64_t new_max_els =
+        max_els > std::numeric_limits<decltype(batchspec_t().max_els)>::max() / factor
+            ? max_els
+            : max_els * factor;
+    int64_t new_max_size =
+        max_size > std::numeric_limits<decltype(batchspec_t().max_size)>::max() / factor
+            ? max_size
+            : max_size * factor;
+    batchspec_t ret(batch_type, min_els, new_max_els, new_max_size,
+                    first_scaledown_factor, max_dur, start_time, adaptive);
+    ret.lazy_sorting_override = lazy_sorting_override;
+    return ret;
 }
 
 batcher_t batchspec_t::to_batcher() const {
@@ -238,7 +268,8 @@ batcher_t batchspec_t::to_batcher() const {
         break;
     default: unreachable();
     }
-    return batcher_t(batch_type, real_min_els, real_max_els, real_max_size, end_time);
+    return batcher_t(batch_type, real_min_els, real_max_els, real_max_size, end_time,
+                     adaptive);
 }
 
 template<cluster_version_t W>
@@ -253,6 +284,10 @@ void serialize(write_message_t *wm, const batchspec_t &batchspec) {
     serialize<W>(wm, batchspec.max_size);
     serialize<W>(wm, batchspec.first_scaledown_factor);
     serialize<W>(wm, batchspec.max_dur.micros);
+    // `adaptive` was added in cluster protocol version 2.5.1, which is why servers
+    // with version 2.5.0 can't join the cluster anymore (see
+    // `version_number_recognized_compatible()` in rpc/connectivity/cluster.cc).
+    serialize<W>(wm, batchspec.adaptive);
 
     // Here we serialize the duration instead of the `start_time` to account for clocks
     // being out of sync between processes.  (Before, we needed this same logic for
@@ -285,6 +320,8 @@ archive_result_t deserialize(read_stream_t *s, batchspec_t *batchspec) {
     if (bad(res)) { return res; }
     res = deserialize<W>(s, deserialize_deref(batchspec->max_dur.micros));
     if (bad(res)) { return res; }
+    res = deserialize<W>(s, deserialize_deref(batchspec->adaptive));
+    if (bad(res)) { return res; }
 
     uint64_t duration = 0;
     static_assert(sizeof(uint64_t) >= sizeof(kiloticks_t),
@@ -311,12 +348,68 @@ batcher_t::batcher_t(
     int64_t min_els,
     int64_t max_els,
     int64_t max_size,
-    kiloticks_t _end_time)
+    kiloticks_t _end_time,
+    bool _estimate_sizes)
     : batch_type(_batch_type),
       seen_one_el(false),
       min_els_left(min_els),
       els_left(max_els),
       size_left(max_size),
-      end_time(_end_time) { }
+      end_time(_end_time),
+      estimate_sizes(_estimate_sizes),
+      sampled_els(0),
+      sampled_size(0),
+      unsampled_els(0) { }
+
+int64_t batcher_t::estimate_size(const datum_t &t) {
+    // Arrays and objects that are still backed by their serialization know their
+    // size, and scalars are cheap to measure.
+    if (t.get_buf_ref() != nullptr
+        || (t.get_type() != datum_t::R_ARRAY && t.get_type() != datum_t::R_OBJECT)) {
+        return serialized_size<cluster_version_t::CLUSTER>(t);
+    }
+    if (sampled_els == 0 || unsampled_els >= ADAPTIVE_SIZE_SAMPLE_INTERVAL) {
+        int64_t size = serialized_size<cluster_version_t::CLUSTER>(t);
+        sampled_els += 1;
+        sampled_size += size;
+        unsampled_els = 0;
+        return size;
+    }
+    unsampled_els += 1;
+    return sampled_size / sampled_els;
+}
+
+batchspec_t batch_tuner_t::tune(const batchspec_t &batchspec) const {
+    if (!batchspec.adaptive
+        || batchspec.batch_type != batch_type_t::NORMAL
+        || growth == 1) {
+        return batchspec;
+    }
+    return batchspec.scale_up(growth);
+}
+
+void batch_tuner_t::note_batch(const batchspec_t &batchspec,
+                               size_t els,
+                               kiloticks_t duration) {
+    if (!batchspec.adaptive || els == 0) {
+        return;
+    }
+    double micros = static_cast<double>(duration.micros) / els;
+    micros_per_el = micros_per_el == 0.0 ? micros : (micros_per_el + micros) / 2;
+
+    // The first batch is scaled down, so it says little about how big the next ones
+    // can get. Otherwise we grow as long as a batch twice this size would still take
+    // at most half of the maximum duration, and shrink again once a batch takes
+    // longer than that.
+    if (batchspec.batch_type != batch_type_t::NORMAL) {
+        return;
+    }
+    double half_max_dur = static_cast<double>(batchspec.max_dur.micros) / 2;
+    if (micros_per_el * els * 2 <= half_max_dur && growth < ADAPTIVE_MAX_GROWTH) {
+        growth *= 2;
+    } else if (static_cast<double>(duration.micros) > half_max_dur && growth > 1) {
+        growth /= 2;
+    }
+}
 
 } // namespace ql
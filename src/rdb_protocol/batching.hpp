@@ -46,7 +46,9 @@ public:
         seen_one_el = true;
         els_left -= 1;
         min_els_left -= 1;
-        size_left -= serialized_size<cluster_version_t::CLUSTER>(t);
+        size_left -= estimate_sizes
+            ? estimate_size(t)
+            : serialized_size<cluster_version_t::CLUSTER>(t);
         return should_send_batch();
     }
     bool should_send_batch(
@@ -57,7 +59,11 @@ public:
         min_els_left(std::move(other.min_els_left)),
         els_left(std::move(other.els_left)),
         size_left(std::move(other.size_left)),
-        end_time(std::move(other.end_time)) { }
+        end_time(std::move(other.end_time)),
+        estimate_sizes(std::move(other.estimate_sizes)),
+        sampled_els(std::move(other.sampled_els)),
+        sampled_size(std::move(other.sampled_size)),
+        unsampled_els(std::move(other.unsampled_els)) { }
     kiloticks_t kiloticks_left() {
         kiloticks_t cur_time = get_kiloticks();
         return kiloticks_t{end_time.micros > cur_time.micros ?
@@ -69,12 +75,22 @@ private:
     DISABLE_COPYING(batcher_t);
     friend class batchspec_t;
     batcher_t(batch_type_t batch_type, int64_t min_els, int64_t max_els,
-              int64_t max_size, kiloticks_t end_time);
+              int64_t max_size, kiloticks_t end_time, bool estimate_sizes);
+
+    // Used in adaptive batching mode instead of computing the exact serialized size
+    // of every element, which means walking every array and object that isn't
+    // still backed by its serialization.
+    int64_t estimate_size(const datum_t &t);
 
     const batch_type_t batch_type;
     bool seen_one_el;
     int64_t min_els_left, els_left, size_left;
     const kiloticks_t end_time;
+
+    const bool estimate_sizes;
+    // The number and total size of the elements that `estimate_size()` measured,
+    // and how many it has estimated since it last measured one.
+    int64_t sampled_els, sampled_size, unsampled_els;
 };
 
 class batchspec_t {
@@ -99,29 +115,52 @@ public:
     }
 
     batchspec_t scale_down(int64_t divisor) const;
+    batchspec_t scale_up(int64_t factor) const;
     batcher_t to_batcher() const;
 
+    // Set by the `adaptive_batching` optarg. See `batch_tuner_t`.
+    bool is_adaptive() const { return adaptive; }
+
 private:
     // I made this private and accessible through a static function because it
     // was being accidentally default-initialized.
     batchspec_t() { } // USE ONLY FOR SERIALIZATION
     batchspec_t(batch_type_t batch_type, int64_t min_els, int64_t max_els,
                 int64_t max_size, int64_t first_scaledown,
-                kiloticks_t max_dur, kiloticks_t start_time);
+                kiloticks_t max_dur, kiloticks_t start_time, bool adaptive);
 
     template<cluster_version_t W>
     friend void serialize(write_message_t *wm, const batchspec_t &batchspec);
     template<cluster_version_t W>
     friend archive_result_t deserialize(read_stream_t *s, batchspec_t *batchspec);
+    friend class batch_tuner_t;
 
     batch_type_t batch_type;
     int64_t min_els, max_els, max_size, first_scaledown_factor;
     kiloticks_t max_dur;
     kiloticks_t start_time;
+    bool adaptive;
     optional<sorting_t> lazy_sorting_override;
 };
 RDB_DECLARE_SERIALIZABLE(batchspec_t);
 
+// In adaptive batching mode, this tunes the batches that one stream sends to the
+// client. It keeps track of how long each element takes to produce, and as long as
+// batches come back well within `max_batch_seconds` it scales the row and byte limits
+// of the following batches up. It never touches the first batch, so the latency until
+// the first response doesn't change.
+class batch_tuner_t {
+public:
+    batch_tuner_t() : growth(1), micros_per_el(0.0) { }
+    batchspec_t tune(const batchspec_t &batchspec) const;
+    void note_batch(const batchspec_t &batchspec, size_t els, kiloticks_t duration);
+private:
+    // The factor `tune()` scales the limits up by. Always a power of two.
+    int64_t growth;
+    // A moving average of the time it took to produce each element.
+    double micros_per_el;
+};
+
 } // namespace ql
 
 #endif // RDB_PROTOCOL_BATCHING_HPP_
@@ -34,6 +34,10 @@
 
 #include "debug.hpp"
 
+rdb_value_sizer_t::rdb_value_sizer_t(const cache_t *cache)
+    : block_size_(cache->max_block_size()),
+      node_formats_(cache->btree_node_formats()) { }
+
 rdb_value_sizer_t::rdb_value_sizer_t(max_block_size_t bs) : block_size_(bs) { }
 
 const rdb_value_t *rdb_value_sizer_t::as_rdb(const void *p) {
@@ -63,6 +67,20 @@ block_magic_t rdb_value_sizer_t::btree_leaf_magic() const {
 
 max_block_size_t rdb_value_sizer_t::block_size() const { return block_size_; }
 
+// Primary keys within one leaf node tend to share long prefixes (especially
+// secondary index keys, which start with the secondary key), so they benefit from
+// prefix compression.  It's only turned on with `--btree-prefix-compression`.
+bool rdb_value_sizer_t::btree_leaf_prefix_compression() const {
+    return node_formats_.prefix_compressed_leaves;
+}
+
+// Lets `count` add up leaf counts instead of reading every leaf.  Keeping the counts
+// up to date writes to the parent on every insert or delete, so it's only turned on
+// with `--btree-leaf-counts`.
+bool rdb_value_sizer_t::btree_counted_internal_nodes() const {
+    return node_formats_.counted_internal_nodes;
+}
+
 bool btree_value_fits(max_block_size_t bs, int data_length, const rdb_value_t *value) {
     return blob::ref_fits(bs, data_length, value->value_ref(), blob::btree_maxreflen);
 }
@@ -90,7 +108,7 @@ void rdb_get(const store_key_t &store_key, btree_slice_t *slice,
              superblock_t *superblock, point_read_response_t *response,
              profile::trace_t *trace) {
     keyvalue_location_t kv_location;
-    rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+    rdb_value_sizer_t sizer(superblock->cache());
     find_keyvalue_location_for_read(&sizer, superblock,
                                     store_key.btree_key(), &kv_location,
                                     &slice->stats, trace);
@@ -129,7 +147,7 @@ void kv_location_delete(keyvalue_location_t *kv_location,
                                                       kv_location->value.get());
 
     kv_location->value.reset();
-    rdb_value_sizer_t sizer(block_size);
+    rdb_value_sizer_t sizer(kv_location->buf.cache());
     null_key_modification_callback_t null_cb;
     apply_keyvalue_change(&sizer, kv_location, key.btree_key(), timestamp,
             deletion_context->balancing_detacher(), &null_cb, delete_mode);
@@ -175,7 +193,7 @@ kv_location_set(keyvalue_location_t *kv_location,
     // Actually update the leaf, if needed.
     kv_location->value = std::move(new_value);
     null_key_modification_callback_t null_cb;
-    rdb_value_sizer_t sizer(block_size);
+    rdb_value_sizer_t sizer(kv_location->buf.cache());
     apply_keyvalue_change(&sizer, kv_location, key.btree_key(),
                           timestamp,
                           deletion_context->balancing_detacher(), &null_cb,
@@ -202,7 +220,7 @@ kv_location_set(keyvalue_location_t *kv_location,
     kv_location->value = std::move(new_value);
 
     null_key_modification_callback_t null_cb;
-    rdb_value_sizer_t sizer(kv_location->buf.cache()->max_block_size());
+    rdb_value_sizer_t sizer(kv_location->buf.cache());
     apply_keyvalue_change(&sizer, kv_location, key.btree_key(), timestamp,
                           deletion_context->balancing_detacher(), &null_cb,
                           delete_mode_t::REGULAR_QUERY);
@@ -222,7 +240,7 @@ batched_replace_response_t rdb_replace_and_return_superblock(
 
     try {
         keyvalue_location_t kv_location;
-        rdb_value_sizer_t sizer(info.superblock->cache()->max_block_size());
+        rdb_value_sizer_t sizer(info.superblock->cache());
         find_keyvalue_location_for_write(&sizer, info.superblock,
                                          info.key->btree_key(),
                                          info.btree->timestamp,
@@ -520,7 +538,7 @@ void rdb_set(const store_key_t &key,
              profile::trace_t *trace,
              promise_t<superblock_t *> *pass_back_superblock) {
     keyvalue_location_t kv_location;
-    rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+    rdb_value_sizer_t sizer(superblock->cache());
     find_keyvalue_location_for_write(&sizer, superblock, key.btree_key(), timestamp,
                                      deletion_context->balancing_detacher(),
                                      &kv_location, trace, pass_back_superblock);
@@ -565,7 +583,7 @@ void rdb_delete(const store_key_t &key, btree_slice_t *slice,
                 profile::trace_t *trace,
                 promise_t<superblock_t *> *pass_back_superblock) {
     keyvalue_location_t kv_location;
-    rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+    rdb_value_sizer_t sizer(superblock->cache());
     find_keyvalue_location_for_write(&sizer, superblock, key.btree_key(), timestamp,
             deletion_context->balancing_detacher(), &kv_location, trace,
             pass_back_superblock);
@@ -586,7 +604,7 @@ void rdb_delete(const store_key_t &key, btree_slice_t *slice,
 
 void rdb_value_deleter_t::delete_value(buf_parent_t parent, const void *value) const {
     // To not destroy constness, we operate on a copy of the value
-    rdb_value_sizer_t sizer(parent.cache()->max_block_size());
+    rdb_value_sizer_t sizer(parent.cache());
     scoped_malloc_t<rdb_value_t> value_copy(sizer.max_possible_size());
     memcpy(value_copy.get(), value, sizer.size(value));
     actually_delete_rdb_value(parent, value_copy.get());
@@ -735,6 +753,48 @@ private:
     optional<std::string> skey_left;
 };
 
+// Used for primary key `get_all` and `eq_join`: visits all of the requested keys in a
+// shard in one traversal, so that the internal nodes on the way to neighbouring keys
+// are only acquired once. Subtrees and pairs that hold none of the keys are skipped.
+class rget_cb_multi_key_wrapper_t : public concurrent_traversal_callback_t {
+public:
+    rget_cb_multi_key_wrapper_t(
+            rget_cb_t *_cb,
+            const std::map<store_key_t, uint64_t> *_keys)
+        : cb(_cb), keys(_keys) { }
+    void filter_range(
+            const btree_key_t *left_excl_or_null,
+            const btree_key_t *right_incl,
+            bool *skip_out) {
+        auto it = left_excl_or_null == nullptr
+            ? keys->begin()
+            : keys->upper_bound(store_key_t(left_excl_or_null));
+        *skip_out = it == keys->end() || store_key_t(right_incl) < it->first;
+    }
+    bool skip_key(const btree_key_t *key) {
+        return keys->count(store_key_t(key)) == 0;
+    }
+    // Most of the children of each internal node are skipped by `filter_range()`.
+    int prefetch_count() {
+        return 0;
+    }
+    virtual continue_bool_t handle_pair(
+        scoped_key_value_t &&keyvalue,
+        concurrent_traversal_fifo_enforcer_signal_t waiter)
+        THROWS_ONLY(interrupted_exc_t) {
+        auto it = keys->find(store_key_t(keyvalue.key()));
+        guarantee(it != keys->end());
+        return cb->handle_pair(
+            std::move(keyvalue),
+            it->second,
+            r_nullopt,
+            std::move(waiter));
+    }
+private:
+    rget_cb_t *cb;
+    const std::map<store_key_t, uint64_t> *keys;
+};
+
 rget_cb_t::rget_cb_t(rget_io_data_t &&_io,
                      job_data_t &&_job,
                      optional<rget_sindex_data_t> &&_sindex)
@@ -798,6 +858,17 @@ continue_bool_t rget_cb_t::handle_pair(
     }
     guarantee(!row.references_parent());
     keyvalue.reset();
+
+    // If the first transformation is a `filter` with a compiled predicate, we can run
+    // it here, where the rows are loaded in parallel.  It only looks up the fields it
+    // needs in the serialized row, and rows it rejects skip the transformations.
+    ql::filter_program_t::result_t prefilter = ql::filter_program_t::result_t::UNKNOWN;
+    if (!job.transformers.empty() && val.has()) {
+        if (const ql::filter_program_t *program = job.transformers[0]->filter_program()) {
+            prefilter = program->run(val);
+        }
+    }
+
     waiter.wait_interruptible(); // This enforces ordering.
 
     ///////////////////////////////////////////////////////
@@ -976,9 +1047,17 @@ continue_bool_t rget_cb_t::handle_pair(
             }
         }
 
-        ql::groups_t data = {{ql::datum_t(), ql::datums_t(copies, val)}};
+        ql::groups_t data;
+        if (prefilter != ql::filter_program_t::result_t::NO_MATCH) {
+            data = {{ql::datum_t(), ql::datums_t(copies, val)}};
+        }
 
-        for (auto it = job.transformers.begin(); it != job.transformers.end(); ++it) {
+        auto it = job.transformers.begin();
+        if (prefilter != ql::filter_program_t::result_t::UNKNOWN) {
+            // The filter has already been decided.
+            ++it;
+        }
+        for (; it != job.transformers.end(); ++it) {
             (**it)(job.env, &data, lazy_sindex_val);
         }
         // We need lots of extra data for the accumulation because we might be
@@ -1006,6 +1085,63 @@ continue_bool_t rget_cb_t::handle_pair(
     }
 }
 
+// Counts the entries in a range of a B-tree.  Where it can, it adds up the counts
+// that the parents of the leaf nodes keep instead of reading the leaves.
+class count_entries_cb_t : public depth_first_traversal_callback_t {
+public:
+    explicit count_entries_cb_t(btree_slice_t *_slice) : slice(_slice), count(0) { }
+
+    bool use_leaf_counts() { return true; }
+
+    continue_bool_t handle_leaf_count(const btree_key_t *, const btree_key_t *,
+                                      uint64_t leaf_count, signal_t *) {
+        count += leaf_count;
+        return continue_bool_t::CONTINUE;
+    }
+
+    continue_bool_t handle_pair(scoped_key_value_t &&, signal_t *) {
+        slice->stats.pm_keys_read.record();
+        slice->stats.pm_total_keys_read += 1;
+        ++count;
+        return continue_bool_t::CONTINUE;
+    }
+
+    uint64_t get_count() const { return count; }
+
+private:
+    btree_slice_t *const slice;
+    uint64_t count;
+
+    DISABLE_COPYING(count_entries_cb_t);
+};
+
+// Handles a read that is a plain `count` of `range` without looking at the rows.
+// Returns `false` if the read isn't one.
+bool rdb_rget_count(
+        btree_slice_t *slice,
+        superblock_t *superblock,
+        const key_range_t &range,
+        ql::env_t *ql_env,
+        const std::vector<transform_variant_t> &transforms,
+        const optional<terminal_variant_t> &terminal,
+        rget_read_response_t *response,
+        release_superblock_t release_superblock) {
+    if (!transforms.empty() || !terminal.has_value()) {
+        return false;
+    }
+    scoped_ptr_t<ql::accumulator_t> accumulator = ql::make_terminal(*terminal);
+    if (!accumulator->counts_rows_without_keys()) {
+        return false;
+    }
+    count_entries_cb_t callback(slice);
+    continue_bool_t cont = btree_depth_first_traversal(
+        superblock, range, &callback, access_t::read, FORWARD, release_superblock,
+        ql_env->interruptor);
+    accumulator->add_row_count(callback.get_count());
+    accumulator->finish(cont, &response->result);
+    return true;
+}
+
 // TODO: Having two functions which are 99% the same sucks.
 void rdb_rget_slice(
         btree_slice_t *slice,
@@ -1026,6 +1162,12 @@ void rdb_rget_slice(
         "Do range scan on primary index.",
         ql_env->trace);
 
+    if (!primary_keys.has_value()
+        && rdb_rget_count(slice, superblock, range, ql_env, transforms, terminal,
+                          response, release_superblock)) {
+        return;
+    }
+
     rget_cb_t callback(
         rget_io_data_t(response, slice),
         job_data_t(ql_env,
@@ -1043,33 +1185,21 @@ void rdb_rget_slice(
     direction_t direction = reversed(sorting) ? BACKWARD : FORWARD;
     continue_bool_t cont = continue_bool_t::CONTINUE;
     if (primary_keys.has_value()) {
-        auto cb = [&](const std::pair<store_key_t, uint64_t> &pair, bool is_last) {
-            rget_cb_wrapper_t wrapper(&callback, pair.second, r_nullopt);
-            return btree_concurrent_traversal(
+        // The keys have already been restricted to this shard's region, so a single
+        // traversal of the range between the smallest and largest key covers them.
+        key_range_t keys_range = primary_keys->empty()
+            ? key_range_t::empty()
+            : range.intersection(key_range_t(
+                key_range_t::closed, primary_keys->begin()->first,
+                key_range_t::closed, primary_keys->rbegin()->first));
+        if (!keys_range.is_empty()) {
+            rget_cb_multi_key_wrapper_t wrapper(&callback, &*primary_keys);
+            cont = btree_concurrent_traversal(
                 superblock,
-                key_range_t::one_key(pair.first),
+                keys_range,
                 &wrapper,
                 direction,
-                is_last ? release_superblock : release_superblock_t::KEEP);
-        };
-        if (!reversed(sorting)) {
-            for (auto it = primary_keys->begin(); it != primary_keys->end();) {
-                auto this_it = it++;
-                if (cb(*this_it, it == primary_keys->end()) == continue_bool_t::ABORT) {
-                    // If required the superblock will get released further up the stack.
-                    cont = continue_bool_t::ABORT;
-                    break;
-                }
-            }
-        } else {
-            for (auto it = primary_keys->rbegin(); it != primary_keys->rend();) {
-                auto this_it = it++;
-                if (cb(*this_it, it == primary_keys->rend()) == continue_bool_t::ABORT) {
-                    // If required the superblock will get released further up the stack.
-                    cont = continue_bool_t::ABORT;
-                    break;
-                }
-            }
+                release_superblock);
         }
     } else {
         rget_cb_wrapper_t wrapper(&callback, 1, r_nullopt);
@@ -1102,6 +1232,14 @@ void rdb_rget_secondary_slice(
         "Do range scan on secondary index.",
         ql_env->trace);
 
+    // Every entry of the secondary index counts if there are no bounds to check.
+    if (datumspec.is_universe()
+        && pk_range == key_range_t::universe()
+        && rdb_rget_count(slice, superblock, sindex_region_range, ql_env, transforms,
+                          terminal, response, release_superblock)) {
+        return;
+    }
+
     const reql_version_t sindex_func_reql_version =
         sindex_info.mapping_version_info.latest_compatible_reql_version;
 
@@ -1799,7 +1937,7 @@ void rdb_update_single_sindex(
                 promise_t<superblock_t *> return_superblock_local;
                 {
                     keyvalue_location_t kv_location;
-                    rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+                    rdb_value_sizer_t sizer(superblock->cache());
 
                     find_keyvalue_location_for_write(
                         &sizer,
@@ -1877,7 +2015,7 @@ void rdb_update_single_sindex(
                 {
                     keyvalue_location_t kv_location;
 
-                    rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+                    rdb_value_sizer_t sizer(superblock->cache());
                     find_keyvalue_location_for_write(
                         &sizer,
                         superblock,
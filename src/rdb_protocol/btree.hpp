@@ -9,6 +9,7 @@
 #include <vector>
 
 #include "btree/types.hpp"
+#include "buffer_cache/types.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/func.hpp"
@@ -16,6 +17,7 @@
 #include "rdb_protocol/store.hpp"
 
 class btree_slice_t;
+class cache_t;
 enum class delete_mode_t;
 class deletion_context_t;
 class key_tester_t;
@@ -29,6 +31,9 @@ bool btree_value_fits(max_block_size_t bs, int data_length, const rdb_value_t *v
 
 class rdb_value_sizer_t : public value_sizer_t {
 public:
+    // Uses the block size and the B-tree node formats of `cache`.
+    explicit rdb_value_sizer_t(const cache_t *cache);
+    // Uses the classic node formats.
     explicit rdb_value_sizer_t(max_block_size_t bs);
 
     static const rdb_value_t *as_rdb(const void *p);
@@ -45,11 +50,17 @@ public:
 
     max_block_size_t block_size() const;
 
+    bool btree_leaf_prefix_compression() const;
+
+    bool btree_counted_internal_nodes() const;
+
 private:
     // The block size.  It's convenient for leaf node code and for
     // some subclasses, too.
     max_block_size_t block_size_;
 
+    btree_node_formats_t node_formats_;
+
     DISABLE_COPYING(rdb_value_sizer_t);
 };
 
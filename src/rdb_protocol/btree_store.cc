@@ -808,6 +808,7 @@ void store_t::clear_sindex_data(
                                  kv_location.buf.get_recency(),
                                  key_modification_proof_t::real_proof());
                 }
+                update_leaf_count(sizer, &kv_location.buf, &kv_location.last_buf);
                 check_and_handle_underfull(sizer, &kv_location.buf,
                         &kv_location.last_buf, kv_location.superblock,
                         keys[i].btree_key(),
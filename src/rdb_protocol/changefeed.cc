@@ -499,6 +499,35 @@ struct stamped_msg_t {
 
 RDB_MAKE_SERIALIZABLE_3(stamped_msg_t, server_uuid, stamp, submsg);
 
+// Writes a `stamped_msg_t` whose `submsg` was serialized ahead of time, so that
+// `server_t::send_all` only serializes a change once no matter how many clients it
+// goes to.
+class stamped_msg_writer_t : public mailbox_write_callback_t {
+public:
+    stamped_msg_writer_t(const uuid_u &_server_uuid,
+                         uint64_t _stamp,
+                         const std::vector<char> *_serialized_submsg)
+        : server_uuid(_server_uuid),
+          stamp(_stamp),
+          serialized_submsg(_serialized_submsg) { }
+    void write(DEBUG_VAR cluster_version_t cluster_version, write_message_t *wm) {
+        rassert(cluster_version == cluster_version_t::CLUSTER);
+        // The same fields in the same order as `RDB_MAKE_SERIALIZABLE_3` above.
+        serialize<cluster_version_t::CLUSTER>(wm, server_uuid);
+        serialize<cluster_version_t::CLUSTER>(wm, stamp);
+        wm->append(serialized_submsg->data(), serialized_submsg->size());
+    }
+#ifdef ENABLE_MESSAGE_PROFILER
+    const char *message_profiler_tag() const {
+        return "mailbox<stamped_msg_t>";
+    }
+#endif
+private:
+    uuid_u server_uuid;
+    uint64_t stamp;
+    const std::vector<char> *serialized_submsg;
+};
+
 // This function takes a `lock_t` to make sure you have one.  (We can't just
 // always acquire a drainer lock before sending because we sometimes send a
 // `stop_t` during destruction, and you can't acquire a drain lock on a draining
@@ -541,9 +570,36 @@ void server_t::send_all(
     }
     acq.reset();
     stamp_spot->reset(); // Done stamping, no need to hold onto it while we send.
+    if (stamps.empty()) {
+        return;
+    }
+
+    // Only the stamp differs between the clients, so we serialize `msg` once and
+    // send it to all of them together.  Each client's message still gets its own copy
+    // of `serialized_msg`, but `send_multi` only writes a bounded number of them at a
+    // time.
+    std::vector<char> serialized_msg;
+    {
+        write_message_t wm;
+        serialize<cluster_version_t::CLUSTER>(&wm, msg);
+        vector_stream_t stream;
+        stream.reserve(wm.size());
+        int res = send_write_message(&stream, &wm);
+        guarantee(res == 0);
+        stream.swap(&serialized_msg);
+    }
+    std::vector<client_t::addr_t> addrs;
+    std::vector<stamped_msg_writer_t> writers;
+    std::vector<mailbox_write_callback_t *> writer_ptrs;
+    addrs.reserve(stamps.size());
+    writers.reserve(stamps.size());
+    writer_ptrs.reserve(stamps.size());
     for (const auto &pair : stamps) {
-        send(manager, pair.first, stamped_msg_t(uuid, pair.second, msg));
+        addrs.push_back(pair.first);
+        writers.emplace_back(uuid, pair.second, &serialized_msg);
+        writer_ptrs.push_back(&writers.back());
     }
+    send_multi(manager, addrs, writer_ptrs);
 }
 
 server_t::addr_t server_t::get_stop_addr() {
@@ -1840,6 +1840,76 @@ int datum_t::cmp(const datum_t &rhs) const {
         });
 }
 
+static size_t hash_combine(size_t seed, size_t value) {
+    return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+static size_t hash_bytes(const char *data, size_t size) {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= static_cast<uint8_t>(data[i]);
+        h *= 1099511628211ULL;
+    }
+    return static_cast<size_t>(h);
+}
+
+size_t datum_t::hash_unchecked_stack() const {
+    // This has to follow `cmp_unchecked_stack`, which compares most pseudotypes by
+    // something other than their object representation.
+    if (is_ptype() && !pseudo_compares_as_obj()) {
+        if (get_type() == R_BINARY) {
+            return hash_combine(R_BINARY,
+                                hash_bytes(as_binary().data(), as_binary().size()));
+        } else if (get_reql_type() == pseudo::time_string) {
+            // Times compare by their epoch time only, not by their time zone.
+            return datum_t(pseudo::time_to_epoch_time(*this)).hash();
+        } else {
+            // `pseudo_cmp` fails on these, so any hash will do.
+            return hash_combine(get_type(), std::hash<std::string>()(get_reql_type()));
+        }
+    }
+
+    size_t h = get_type();
+    switch (get_type()) {
+    case R_NULL: // fallthru
+    case MINVAL: // fallthru
+    case MAXVAL: return h;
+    case R_BOOL: return hash_combine(h, as_bool());
+    case R_NUM: {
+        // `0.0` and `-0.0` compare equal.
+        double d = as_num() == 0.0 ? 0.0 : as_num();
+        return hash_combine(h, std::hash<double>()(d));
+    } unreachable();
+    case R_STR: return hash_combine(h, hash_bytes(as_str().data(), as_str().size()));
+    case R_ARRAY: {
+        const size_t sz = arr_size();
+        for (size_t i = 0; i < sz; ++i) {
+            h = hash_combine(h, unchecked_get(i).hash());
+        }
+        return h;
+    } unreachable();
+    case R_OBJECT: {
+        const size_t sz = obj_size();
+        for (size_t i = 0; i < sz; ++i) {
+            auto pair = unchecked_get_pair(i);
+            h = hash_combine(h, hash_bytes(pair.first.data(), pair.first.size()));
+            h = hash_combine(h, pair.second.hash());
+        }
+        return h;
+    } unreachable();
+    case R_BINARY: // This should be handled by the ptype code above
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
+size_t datum_t::hash() const {
+    return call_with_enough_stack_datum<size_t>([&] {
+            return this->hash_unchecked_stack();
+        });
+}
+
 bool datum_t::operator==(const datum_t &rhs) const { return cmp(rhs) == 0; }
 bool datum_t::operator!=(const datum_t &rhs) const { return cmp(rhs) != 0; }
 bool datum_t::operator<(const datum_t &rhs) const { return cmp(rhs) < 0; }
@@ -327,6 +327,9 @@ public:
     bool operator>(const datum_t &rhs) const;
     bool operator>=(const datum_t &rhs) const;
 
+    // A hash that agrees with `cmp`: data that compare equal have the same hash.
+    size_t hash() const;
+
     NORETURN void runtime_fail(base_exc_t::type_t exc_type,
                                const char *test, const char *file, int line,
                                std::string msg) const;
@@ -400,6 +403,7 @@ private:
         std::string *str_out) const;
 
     int cmp_unchecked_stack(const datum_t &rhs) const;
+    size_t hash_unchecked_stack() const;
 
     int pseudo_cmp(const datum_t &rhs) const;
     bool pseudo_compares_as_obj() const;
@@ -1,11 +1,17 @@
 // Copyright 2010-2015 RethinkDB, all rights reserved.
 #include "rdb_protocol/datum_stream.hpp"
 
+#include <algorithm>
 #include <map>
 
+#include "config/args.hpp"
+#include "containers/archive/vector_stream.hpp"
+#include "containers/disk_backed_queue.hpp"
 #include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/context.hpp"
 #include "rdb_protocol/datum_stream/array.hpp"
 #include "rdb_protocol/datum_stream/eq_join.hpp"
+#include "rdb_protocol/datum_stream/external_sort.hpp"
 #include "rdb_protocol/datum_stream/fold.hpp"
 #include "rdb_protocol/datum_stream/indexed_sort.hpp"
 #include "rdb_protocol/datum_stream/lazy.hpp"
@@ -1622,6 +1628,185 @@ indexed_sort_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batch
     return ret;
 }
 
+// EXTERNAL_SORT_DATUM_STREAM_T
+
+// The rows of a run are written to its file in batches of this many, one transaction
+// per batch.
+const size_t EXTERNAL_SORT_WRITE_BATCH_SIZE = 1000;
+
+class external_sort_datum_stream_t::run_t {
+public:
+    run_t(env_t *env, perfmon_collection_t *stats)
+        : budget(env->get_temporary_files_budget()),
+          bytes_charged(0),
+          queue(env->get_rdb_ctx()->io_backender,
+                serializer_filepath_t(env->get_rdb_ctx()->base_path,
+                                      EXTERNAL_SORT_FILE_PREFIX
+                                          + uuid_to_str(generate_uuid())),
+                stats) { }
+
+    ~run_t() {
+        budget->release(bytes_charged);
+    }
+
+    void push(const std::vector<datum_t> &rows) {
+        for (size_t i = 0; i < rows.size(); i += EXTERNAL_SORT_WRITE_BATCH_SIZE) {
+            const size_t end = std::min(rows.size(), i + EXTERNAL_SORT_WRITE_BATCH_SIZE);
+            scoped_array_t<write_message_t> wms(end - i);
+            uint64_t bytes = 0;
+            for (size_t j = i; j < end; ++j) {
+                // The file doesn't outlive the query, so the version doesn't matter.
+                serialize<cluster_version_t::LATEST_OVERALL>(&wms[j - i], rows[j]);
+                bytes += wms[j - i].size();
+            }
+            budget->charge(bytes);
+            bytes_charged += bytes;
+            queue.push(wms);
+        }
+    }
+
+    // Replaces `head` by the next row of the run, or by an empty `datum_t` if there
+    // is none.
+    void advance() {
+        if (queue.empty()) {
+            head = datum_t();
+        } else {
+            deserializing_viewer_t<datum_t> viewer(&head);
+            queue.pop(&viewer);
+        }
+    }
+
+    datum_t head;
+
+private:
+    const counted_t<temporary_files_budget_t> budget;
+    // The bytes that the rows that we pushed take up in the file.  We charge them to
+    // the budget until the file gets deleted.
+    uint64_t bytes_charged;
+    internal_disk_backed_queue_t queue;
+
+    DISABLE_COPYING(run_t);
+};
+
+external_sort_datum_stream_t::external_sort_datum_stream_t(
+        lt_cmp_t _lt_cmp, backtrace_id_t _bt)
+    : eager_datum_stream_t(_bt), lt_cmp(std::move(_lt_cmp)), merge_started(false) { }
+
+external_sort_datum_stream_t::~external_sort_datum_stream_t() { }
+
+bool external_sort_datum_stream_t::is_available(env_t *env) {
+    return env->get_rdb_ctx() != nullptr
+        && env->get_rdb_ctx()->io_backender != nullptr;
+}
+
+void external_sort_datum_stream_t::add_run(env_t *env, std::vector<datum_t> &&rows) {
+    r_sanity_check(!merge_started);
+    if (rows.empty()) {
+        return;
+    }
+    if (runs.size() >= EXTERNAL_SORT_MAX_RUNS) {
+        merge_runs(env);
+    }
+    {
+        profile::sampler_t sampler("Sorting in-memory.", env->trace);
+        std::stable_sort(rows.begin(), rows.end(),
+                         std::bind(lt_cmp, env, &sampler, ph::_1, ph::_2));
+    }
+    profile::starter_t starter("Writing sorted rows to disk.", env->trace);
+    scoped_ptr_t<run_t> run(new run_t(env, &run_stats));
+    run->push(rows);
+    runs.push_back(std::move(run));
+}
+
+bool external_sort_datum_stream_t::is_exhausted() const {
+    return merge_started ? heap.empty() : runs.empty();
+}
+feed_type_t external_sort_datum_stream_t::cfeed_type() const {
+    return feed_type_t::not_feed;
+}
+bool external_sort_datum_stream_t::is_infinite() const {
+    return false;
+}
+
+void external_sort_datum_stream_t::start_merge(env_t *env) {
+    heap.clear();
+    for (size_t i = 0; i < runs.size(); ++i) {
+        runs[i]->advance();
+        if (runs[i]->head.has()) {
+            heap.push_back(i);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), [&](size_t a, size_t b) {
+        return run_comes_after(env, nullptr, a, b);
+    });
+    merge_started = true;
+}
+
+bool external_sort_datum_stream_t::run_comes_after(
+        env_t *env, profile::sampler_t *sampler, size_t a, size_t b) const {
+    // Of two equal rows, the one from the run that was added first comes first.  This
+    // keeps the sort stable.
+    return lt_cmp(env, sampler, runs[b]->head, runs[a]->head)
+        || (a > b && !lt_cmp(env, sampler, runs[a]->head, runs[b]->head));
+}
+
+datum_t external_sort_datum_stream_t::pop_min(
+        env_t *env, profile::sampler_t *sampler) {
+    if (!merge_started) {
+        start_merge(env);
+    }
+    if (heap.empty()) {
+        return datum_t();
+    }
+    auto comes_after = [&](size_t a, size_t b) {
+        return run_comes_after(env, sampler, a, b);
+    };
+    std::pop_heap(heap.begin(), heap.end(), comes_after);
+    run_t *run = runs[heap.back()].get();
+    datum_t ret = std::move(run->head);
+    run->advance();
+    if (run->head.has()) {
+        std::push_heap(heap.begin(), heap.end(), comes_after);
+    } else {
+        heap.pop_back();
+    }
+    return ret;
+}
+
+void external_sort_datum_stream_t::merge_runs(env_t *env) {
+    profile::sampler_t sampler("Merging sorted runs on disk.", env->trace);
+    scoped_ptr_t<run_t> merged(new run_t(env, &run_stats));
+    std::vector<datum_t> rows;
+    datum_t d;
+    while (d = pop_min(env, &sampler), d.has()) {
+        rows.push_back(std::move(d));
+        if (rows.size() == EXTERNAL_SORT_WRITE_BATCH_SIZE) {
+            merged->push(rows);
+            rows.clear();
+        }
+    }
+    merged->push(rows);
+    runs.clear();
+    runs.push_back(std::move(merged));
+    heap.clear();
+    merge_started = false;
+}
+
+std::vector<datum_t>
+external_sort_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batchspec) {
+    std::vector<datum_t> ret;
+    batcher_t batcher = batchspec.to_batcher();
+
+    profile::sampler_t sampler("Merging sorted runs.", env->trace);
+    datum_t d;
+    while (!batcher.should_send_batch() && (d = pop_min(env, &sampler), d.has())) {
+        batcher.note_el(d);
+        ret.push_back(std::move(d));
+        sampler.new_sample();
+    }
+    return ret;
+}
+
 // ORDERED_DISTINCT_DATUM_STREAM_T
 ordered_distinct_datum_stream_t::ordered_distinct_datum_stream_t(
     counted_t<datum_stream_t> _source) : wrapper_datum_stream_t(_source) { }
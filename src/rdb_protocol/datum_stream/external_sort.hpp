@@ -0,0 +1,65 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_DATUM_STREAM_EXTERNAL_SORT_HPP_
+#define RDB_PROTOCOL_DATUM_STREAM_EXTERNAL_SORT_HPP_
+
+#include <vector>
+
+#include "containers/scoped.hpp"
+#include "perfmon/core.hpp"
+#include "rdb_protocol/datum_stream.hpp"
+#include "rdb_protocol/order_util.hpp"
+
+namespace ql {
+
+/* Sorts a sequence that doesn't fit into memory.  The sequence is handed over in runs
+that do fit into memory.  Each run gets sorted and written to a temporary file in the
+server's data directory, and reading from the stream merges the runs.  The sort is
+stable if the runs are added in the order of the sequence. */
+class external_sort_datum_stream_t : public eager_datum_stream_t {
+public:
+    external_sort_datum_stream_t(lt_cmp_t lt_cmp, backtrace_id_t bt);
+    ~external_sort_datum_stream_t();
+
+    // Returns whether `env` has a place for the temporary files.
+    static bool is_available(env_t *env);
+
+    // Sorts `rows` and writes them out as a new run.  Must not be called once the
+    // stream has been read from.
+    void add_run(env_t *env, std::vector<datum_t> &&rows);
+
+    virtual bool is_exhausted() const;
+    virtual feed_type_t cfeed_type() const;
+    virtual bool is_infinite() const;
+
+private:
+    class run_t;
+
+    virtual bool is_array() const { return false; }
+    virtual std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    // Loads the first row of every run and orders the runs in `heap`.
+    void start_merge(env_t *env);
+    // Whether the current row of run `a` goes after that of run `b`.
+    bool run_comes_after(env_t *env, profile::sampler_t *sampler,
+                         size_t a, size_t b) const;
+    // Returns the smallest row of all the runs, or an empty `datum_t` if there are no
+    // rows left.
+    datum_t pop_min(env_t *env, profile::sampler_t *sampler);
+    // Replaces all the runs by a single run.
+    void merge_runs(env_t *env);
+
+    const lt_cmp_t lt_cmp;
+    // The temporary files get a perfmon collection of their own, so that they don't
+    // show up in the server's stats.
+    perfmon_collection_t run_stats;
+    std::vector<scoped_ptr_t<run_t> > runs;
+    // The indices of the runs that have rows left, as a heap with the run that has
+    // the smallest row on top.
+    std::vector<size_t> heap;
+    bool merge_started;
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_DATUM_STREAM_EXTERNAL_SORT_HPP_
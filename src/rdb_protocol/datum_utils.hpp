@@ -17,4 +17,25 @@ public:
     }
 };
 
+// Hashes and compares possibly empty data for unordered containers.
+class optional_datum_hash_t {
+public:
+    optional_datum_hash_t() { }
+    size_t operator()(const ql::datum_t &d) const {
+        return d.has() ? d.hash() : 0;
+    }
+};
+
+class optional_datum_equal_t {
+public:
+    optional_datum_equal_t() { }
+    bool operator()(const ql::datum_t &a, const ql::datum_t &b) const {
+        if (a.has()) {
+            return b.has() && a == b;
+        } else {
+            return !b.has();
+        }
+    }
+};
+
 #endif /* RDB_PROTOCOL_DATUM_UTILS_HPP_ */
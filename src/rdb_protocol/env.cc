@@ -2,6 +2,7 @@
 #include "rdb_protocol/env.hpp"
 
 #include "concurrency/cross_thread_watchable.hpp"
+#include "config/args.hpp"
 #include "extproc/js_runner.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/minidriver.hpp"
@@ -63,6 +64,21 @@ scoped_ptr_t<profile::trace_t> maybe_make_profile_trace(profile_bool_t profile)
         : scoped_ptr_t<profile::trace_t>();
 }
 
+void temporary_files_budget_t::charge(uint64_t bytes) {
+    rcheck_toplevel(
+        bytes_used_ + bytes <= static_cast<uint64_t>(QUERY_MAX_TEMPORARY_FILES_SIZE),
+        base_exc_t::RESOURCE,
+        strprintf("Query exceeded the limit of %" PRIu64 " bytes of temporary files "
+                  "on disk.", static_cast<uint64_t>(QUERY_MAX_TEMPORARY_FILES_SIZE))
+            .c_str());
+    bytes_used_ += bytes;
+}
+
+void temporary_files_budget_t::release(uint64_t bytes) {
+    rassert(bytes <= bytes_used_);
+    bytes_used_ -= bytes;
+}
+
 env_t::env_t(rdb_context_t *ctx,
              return_empty_normal_batches_t _return_empty_normal_batches,
              signal_t *_interruptor,
@@ -78,7 +94,8 @@ env_t::env_t(rdb_context_t *ctx,
       trace(_trace),
       evals_since_yield_(0),
       rdb_ctx_(ctx),
-      eval_callback_(NULL) {
+      eval_callback_(NULL),
+      temporary_files_budget_(make_counted<temporary_files_budget_t>()) {
     rassert(ctx != NULL);
     rassert(interruptor != NULL);
 }
@@ -114,7 +131,8 @@ env_t::env_t(signal_t *_interruptor,
       trace(NULL),
       evals_since_yield_(0),
       rdb_ctx_(NULL),
-      eval_callback_(NULL) {
+      eval_callback_(NULL),
+      temporary_files_budget_(make_counted<temporary_files_budget_t>()) {
     rassert(interruptor != NULL);
 }
 
@@ -40,6 +40,25 @@ struct regex_cache_t {
     lru_cache_t<std::string, std::shared_ptr<re2::RE2> > regexes;
 };
 
+/* Counts the bytes that a query has written to temporary files in the data directory
+(for external sorts and spilled groups), and fails the query once they would exceed
+QUERY_MAX_TEMPORARY_FILES_SIZE.  The query cache keeps one per query, because the
+temporary files can outlive the `env_t` of a single batch. */
+class temporary_files_budget_t
+    : public single_threaded_countable_t<temporary_files_budget_t> {
+public:
+    temporary_files_budget_t() : bytes_used_(0) { }
+
+    // Throws a `RESOURCE` error if `bytes` more don't fit into the budget.
+    void charge(uint64_t bytes);
+    void release(uint64_t bytes);
+
+private:
+    uint64_t bytes_used_;
+
+    DISABLE_COPYING(temporary_files_budget_t);
+};
+
 class env_t : public home_thread_mixin_t {
 public:
     // This is _not_ to be used for secondary index function evaluation -- it doesn't
@@ -157,6 +176,14 @@ public:
 
     rdb_context_t *get_rdb_ctx() { return rdb_ctx_; }
 
+    const counted_t<temporary_files_budget_t> &get_temporary_files_budget() {
+        return temporary_files_budget_;
+    }
+    // Lets the `env_t`s of all the batches of a query share one budget.
+    void set_temporary_files_budget(counted_t<temporary_files_budget_t> budget) {
+        temporary_files_budget_ = std::move(budget);
+    }
+
 private:
     static const uint32_t EVALS_BEFORE_YIELD = 256;
     uint32_t evals_since_yield_;
@@ -167,6 +194,8 @@ private:
 
     eval_callback_t *eval_callback_;
 
+    counted_t<temporary_files_budget_t> temporary_files_budget_;
+
     DISABLE_COPYING(env_t);
 };
 
@@ -98,7 +98,7 @@ continue_bool_t rdb_erase_small_range(
     /* Step 2: Erase each key individually and create the corresponding
        modification reports. */
     const max_block_size_t max_block_size = superblock->cache()->max_block_size();
-    rdb_value_sizer_t sizer(max_block_size);
+    rdb_value_sizer_t sizer(superblock->cache());
     for (const auto &key : key_collector.get_collected_keys()) {
         promise_t<superblock_t *> pass_back_superblock_promise;
         {
@@ -0,0 +1,379 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "rdb_protocol/filter_program.hpp"
+
+#include "rdb_protocol/error.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/pseudo_literal.hpp"
+#include "rdb_protocol/ql2proto.hpp"
+#include "rdb_protocol/term.hpp"
+#include "rdb_protocol/term_storage.hpp"
+
+namespace ql {
+
+// `filter_match()` treats `r.literal` specially at every level of the object.
+static bool has_literal(const datum_t &pattern) {
+    if (pattern.get_type() != datum_t::R_OBJECT) {
+        return false;
+    }
+    if (pattern.is_ptype(pseudo::literal_string)) {
+        return true;
+    }
+    for (size_t i = 0; i < pattern.obj_size(); ++i) {
+        if (has_literal(pattern.get_pair(i).second)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Turns the body of an object-literal filter into the object it evaluates to, if all
+// of its values are constants.
+static bool constant_pattern(const raw_term_t &term, datum_t *out) {
+    if (term.type() == Term::DATUM) {
+        *out = term.datum();
+        return true;
+    }
+    if (term.type() != Term::MAKE_OBJ || term.num_args() != 0) {
+        return false;
+    }
+    bool ok = true;
+    datum_object_builder_t builder;
+    term.each_optarg([&](const raw_term_t &value_term, const std::string &key) {
+        datum_t value;
+        if (!ok || !constant_pattern(value_term, &value)) {
+            ok = false;
+            return;
+        }
+        bool dup = builder.add(datum_string_t(key), value);
+        ok = !dup;
+    });
+    if (ok) {
+        *out = std::move(builder).to_datum();
+    }
+    return ok;
+}
+
+optional<filter_program_t> filter_program_t::compile(const func_t &func) {
+    class reql_func_visitor_t : public func_visitor_t {
+    public:
+        reql_func_visitor_t() : reql_func(nullptr) { }
+        void on_reql_func(const reql_func_t *f) { reql_func = f; }
+        void on_js_func(const js_func_t *) { }
+        const reql_func_t *reql_func;
+    } visitor;
+    func.visit(&visitor);
+    if (visitor.reql_func == nullptr || visitor.reql_func->arg_names.size() != 1) {
+        return r_nullopt;
+    }
+
+    const raw_term_t &body = visitor.reql_func->body->get_src();
+    filter_program_t program;
+    try {
+        if (body.type() == Term::DATUM || body.type() == Term::MAKE_OBJ) {
+            datum_t pattern;
+            if (!constant_pattern(body, &pattern)
+                || pattern.get_type() != datum_t::R_OBJECT
+                || has_literal(pattern)) {
+                return r_nullopt;
+            }
+            instruction_t instruction;
+            instruction.opcode = opcode_t::MATCH_OBJECT;
+            instruction.num_children = 0;
+            instruction.subtree_size = 0;
+            instruction.lhs.is_field = false;
+            instruction.lhs.constant = pattern;
+            instruction.rhs.is_field = false;
+            program.instructions.push_back(std::move(instruction));
+        } else if (!program.compile_predicate(body, visitor.reql_func->arg_names[0])) {
+            return r_nullopt;
+        }
+    } catch (const base_exc_t &) {
+        // Constants that don't parse are left for the interpreter to complain about.
+        return r_nullopt;
+    }
+    return make_optional(std::move(program));
+}
+
+bool filter_program_t::compile_predicate(const raw_term_t &term, sym_t arg) {
+    if (term.num_optargs() != 0) {
+        return false;
+    }
+    instruction_t instruction;
+    instruction.num_children = 0;
+    instruction.subtree_size = 0;
+    instruction.lhs.is_field = false;
+    instruction.rhs.is_field = false;
+    switch (static_cast<int>(term.type())) {
+    case Term::AND: // fallthru
+    case Term::OR: // fallthru
+    case Term::NOT: {
+        if (term.num_args() == 0
+            || (term.type() == Term::NOT && term.num_args() != 1)) {
+            return false;
+        }
+        instruction.opcode = term.type() == Term::AND ? opcode_t::AND
+            : term.type() == Term::OR ? opcode_t::OR
+            : opcode_t::NOT;
+        instruction.num_children = term.num_args();
+        size_t index = instructions.size();
+        instructions.push_back(std::move(instruction));
+        for (size_t i = 0; i < term.num_args(); ++i) {
+            if (!compile_predicate(term.arg(i), arg)) {
+                return false;
+            }
+        }
+        instructions[index].subtree_size = instructions.size() - index - 1;
+        return true;
+    }
+    case Term::EQ: instruction.opcode = opcode_t::EQ; break;
+    case Term::NE: instruction.opcode = opcode_t::NE; break;
+    case Term::LT: instruction.opcode = opcode_t::LT; break;
+    case Term::LE: instruction.opcode = opcode_t::LE; break;
+    case Term::GT: instruction.opcode = opcode_t::GT; break;
+    case Term::GE: instruction.opcode = opcode_t::GE; break;
+    case Term::HAS_FIELDS: {
+        if (term.num_args() < 2
+            || !compile_operand(term.arg(0), arg, &instruction.lhs)
+            || !instruction.lhs.is_field) {
+            return false;
+        }
+        for (size_t i = 1; i < term.num_args(); ++i) {
+            raw_term_t field = term.arg(i);
+            if (field.type() != Term::DATUM) {
+                return false;
+            }
+            datum_t d = field.datum();
+            if (d.get_type() != datum_t::R_STR) {
+                return false;
+            }
+            instruction.fields.push_back(d.as_str());
+        }
+        instruction.opcode = opcode_t::HAS_FIELDS;
+        instructions.push_back(std::move(instruction));
+        return true;
+    }
+    default: {
+        // A field that holds a boolean.
+        if (!compile_operand(term, arg, &instruction.lhs)
+            || !instruction.lhs.is_field) {
+            return false;
+        }
+        instruction.opcode = opcode_t::IS_TRUE;
+        instructions.push_back(std::move(instruction));
+        return true;
+    }
+    }
+
+    // The comparisons.  With more than two arguments they compare neighbours, which
+    // isn't worth compiling.
+    if (term.num_args() != 2
+        || !compile_operand(term.arg(0), arg, &instruction.lhs)
+        || !compile_operand(term.arg(1), arg, &instruction.rhs)) {
+        return false;
+    }
+    instructions.push_back(std::move(instruction));
+    return true;
+}
+
+bool filter_program_t::compile_operand(
+        const raw_term_t &term, sym_t arg, operand_t *out) {
+    if (term.num_optargs() != 0) {
+        return false;
+    }
+    switch (static_cast<int>(term.type())) {
+    case Term::DATUM: {
+        out->is_field = false;
+        out->constant = term.datum();
+        return true;
+    }
+    case Term::IMPLICIT_VAR: {
+        // `r.row` is the argument of the innermost one-argument function.
+        out->is_field = true;
+        return term.num_args() == 0;
+    }
+    case Term::VAR: {
+        if (term.num_args() != 1 || term.arg(0).type() != Term::DATUM) {
+            return false;
+        }
+        datum_t d = term.arg(0).datum();
+        out->is_field = true;
+        return d.get_type() == datum_t::R_NUM && d.as_num() == arg.value;
+    }
+    case Term::BRACKET: // fallthru
+    case Term::GET_FIELD: {
+        // `BRACKET` with a number is `nth`, and on an array either of them plucks the
+        // field from every element; `run()` leaves rows like that to the interpreter.
+        if (term.num_args() != 2
+            || !compile_operand(term.arg(0), arg, out)
+            || !out->is_field
+            || term.arg(1).type() != Term::DATUM) {
+            return false;
+        }
+        datum_t field = term.arg(1).datum();
+        if (field.get_type() != datum_t::R_STR) {
+            return false;
+        }
+        out->path.push_back(field.as_str());
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+filter_program_t::result_t filter_program_t::run(const datum_t &row) const {
+    r_sanity_check(!instructions.empty());
+    value_t value;
+    try {
+        value = eval(0, row);
+    } catch (const base_exc_t &) {
+        // E.g. comparisons of pseudotypes that can't be compared.
+        return result_t::UNKNOWN;
+    }
+    switch (value) {
+    case value_t::YES: return result_t::MATCH;
+    case value_t::NO: // fallthru
+    case value_t::MISSING: return result_t::NO_MATCH;
+    case value_t::UNKNOWN: return result_t::UNKNOWN;
+    default: unreachable();
+    }
+}
+
+filter_program_t::value_t filter_program_t::eval(
+        size_t index, const datum_t &row) const {
+    const instruction_t &instruction = instructions[index];
+    switch (instruction.opcode) {
+    case opcode_t::AND: // fallthru
+    case opcode_t::OR: {
+        // Like `r.and` and `r.or`, stop at the first operand that decides the result,
+        // so that errors in the later ones don't happen.
+        value_t decisive = instruction.opcode == opcode_t::AND
+            ? value_t::NO : value_t::YES;
+        size_t child = index + 1;
+        for (size_t i = 0; i < instruction.num_children; ++i) {
+            value_t v = eval(child, row);
+            if (v == decisive || v == value_t::MISSING || v == value_t::UNKNOWN) {
+                return v;
+            }
+            child += 1 + instructions[child].subtree_size;
+        }
+        return instruction.opcode == opcode_t::AND ? value_t::YES : value_t::NO;
+    }
+    case opcode_t::NOT: {
+        value_t v = eval(index + 1, row);
+        return v == value_t::YES ? value_t::NO
+            : v == value_t::NO ? value_t::YES
+            : v;
+    }
+    case opcode_t::EQ: // fallthru
+    case opcode_t::NE: // fallthru
+    case opcode_t::LT: // fallthru
+    case opcode_t::LE: // fallthru
+    case opcode_t::GT: // fallthru
+    case opcode_t::GE: {
+        datum_t lhs, rhs;
+        value_t v = resolve(instruction.lhs, row, &lhs);
+        if (v != value_t::YES) {
+            return v;
+        }
+        v = resolve(instruction.rhs, row, &rhs);
+        if (v != value_t::YES) {
+            return v;
+        }
+        bool res;
+        switch (instruction.opcode) {
+        case opcode_t::EQ: res = lhs == rhs; break;
+        case opcode_t::NE: res = !(lhs == rhs); break;
+        case opcode_t::LT: res = lhs.cmp(rhs) < 0; break;
+        case opcode_t::LE: res = lhs.cmp(rhs) <= 0; break;
+        case opcode_t::GT: res = lhs.cmp(rhs) > 0; break;
+        case opcode_t::GE: res = lhs.cmp(rhs) >= 0; break;
+        default: unreachable();
+        }
+        return res ? value_t::YES : value_t::NO;
+    }
+    case opcode_t::HAS_FIELDS: {
+        datum_t obj;
+        value_t v = resolve(instruction.lhs, row, &obj);
+        if (v != value_t::YES) {
+            return v;
+        }
+        if (obj.get_type() != datum_t::R_OBJECT || obj.is_ptype()) {
+            return value_t::UNKNOWN;
+        }
+        for (const auto &field : instruction.fields) {
+            datum_t d = obj.get_field(field, NOTHROW);
+            if (!d.has() || d.get_type() == datum_t::R_NULL) {
+                return value_t::NO;
+            }
+        }
+        return value_t::YES;
+    }
+    case opcode_t::IS_TRUE: {
+        datum_t d;
+        value_t v = resolve(instruction.lhs, row, &d);
+        if (v != value_t::YES) {
+            return v;
+        }
+        if (d.get_type() != datum_t::R_BOOL) {
+            return value_t::UNKNOWN;
+        }
+        return d.as_bool() ? value_t::YES : value_t::NO;
+    }
+    case opcode_t::MATCH_OBJECT: {
+        if (row.get_type() != datum_t::R_OBJECT) {
+            return value_t::UNKNOWN;
+        }
+        return match_object(instruction.lhs.constant, row);
+    }
+    default: unreachable();
+    }
+}
+
+filter_program_t::value_t filter_program_t::resolve(
+        const operand_t &operand, const datum_t &row, datum_t *out) {
+    if (!operand.is_field) {
+        *out = operand.constant;
+        return value_t::YES;
+    }
+    datum_t d = row;
+    for (const auto &field : operand.path) {
+        if (d.get_type() != datum_t::R_OBJECT || d.is_ptype()) {
+            return value_t::UNKNOWN;
+        }
+        d = d.get_field(field, NOTHROW);
+        if (!d.has()) {
+            return value_t::MISSING;
+        }
+    }
+    *out = std::move(d);
+    return value_t::YES;
+}
+
+// Keep in sync with `filter_match()` in func.cc.
+filter_program_t::value_t filter_program_t::match_object(
+        const datum_t &pattern, const datum_t &value) {
+    for (size_t i = 0; i < pattern.obj_size(); ++i) {
+        auto pair = pattern.get_pair(i);
+        datum_t elt = value.get_field(pair.first, NOTHROW);
+        if (!elt.has()) {
+            return value_t::MISSING;
+        } else if (pair.second.get_type() == datum_t::R_OBJECT) {
+            // Whether a nested pattern matches anything but a plain object is up to
+            // the interpreter to decide.
+            if (elt.get_type() != datum_t::R_OBJECT
+                || elt.is_ptype() || pair.second.is_ptype()) {
+                return value_t::UNKNOWN;
+            }
+            value_t v = match_object(pair.second, elt);
+            if (v != value_t::YES) {
+                return v;
+            }
+        } else if (elt != pair.second) {
+            return value_t::NO;
+        }
+    }
+    return value_t::YES;
+}
+
+}  // namespace ql
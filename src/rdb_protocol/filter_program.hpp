@@ -0,0 +1,87 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_FILTER_PROGRAM_HPP_
+#define RDB_PROTOCOL_FILTER_PROGRAM_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "containers/optional.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/sym.hpp"
+
+namespace ql {
+
+class func_t;
+class raw_term_t;
+
+/* A compiled form of the most common `filter` predicates: comparisons of fields of
+the row (or of nested fields) with constants or with each other, `has_fields`,
+boolean fields, `and`, `or` and `not` of those, and object literals like
+`{'a': 1, 'b': {'c': 2}}`.
+
+Running the program only looks up the fields it needs, so for a row that is still
+backed by its serialization (as the rows read from a B-tree are) nothing but those
+fields gets deserialized.  It also doesn't need an `env_t`, so the B-tree code can run
+it while it loads the rows in parallel. */
+class filter_program_t {
+public:
+    enum class result_t { MATCH, NO_MATCH, UNKNOWN };
+
+    // Returns an empty optional if the body of `func` isn't one of the shapes above.
+    // Only use this if the `filter` has no `default` optarg, because the program
+    // treats missing fields as not matching.
+    static optional<filter_program_t> compile(const func_t &func);
+
+    // Returns `UNKNOWN` if the program can't tell what the function would return for
+    // `row` without evaluating it, e.g. because the function would throw an error
+    // other than a non-existence error.  The caller must call the function instead.
+    result_t run(const datum_t &row) const;
+
+private:
+    enum class opcode_t : uint8_t {
+        AND, OR, NOT,
+        EQ, NE, LT, LE, GT, GE,
+        HAS_FIELDS,
+        IS_TRUE,
+        MATCH_OBJECT
+    };
+
+    // Either a (possibly nested) field of the row, or a constant.
+    struct operand_t {
+        bool is_field;
+        std::vector<datum_string_t> path;
+        datum_t constant;
+    };
+
+    // The instructions are stored in prefix order.  `subtree_size` is the number of
+    // instructions that make up the operands of `AND`, `OR` and `NOT`, so that `run()`
+    // can skip the ones it doesn't need.
+    struct instruction_t {
+        opcode_t opcode;
+        size_t num_children;
+        size_t subtree_size;
+        operand_t lhs, rhs;
+        // The fields for `HAS_FIELDS`.
+        std::vector<datum_string_t> fields;
+    };
+
+    // What evaluating part of the predicate would do: return `true` or `false`, or
+    // throw a non-existence error (which makes the whole filter not match).
+    enum class value_t { YES, NO, MISSING, UNKNOWN };
+
+    filter_program_t() { }
+
+    bool compile_predicate(const raw_term_t &term, sym_t arg);
+    static bool compile_operand(const raw_term_t &term, sym_t arg, operand_t *out);
+
+    value_t eval(size_t index, const datum_t &row) const;
+    static value_t resolve(const operand_t &operand, const datum_t &row, datum_t *out);
+    static value_t match_object(const datum_t &pattern, const datum_t &value);
+
+    std::vector<instruction_t> instructions;
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_FILTER_PROGRAM_HPP_
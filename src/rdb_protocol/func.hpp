@@ -111,6 +111,7 @@ public:
 
 private:
     template <cluster_version_t> friend class wire_func_serialization_visitor_t;
+    friend class filter_program_t;
     bool filter_helper(env_t *env, datum_t arg) const;
 
     // Only contains the parts of the scope that `body` uses.
@@ -0,0 +1,625 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "rdb_protocol/json_parser.hpp"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define JSON_PARSER_USE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <limits>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "arch/runtime/coroutines.hpp"
+#include "config/args.hpp"
+#include "parsing/utf8.hpp"
+#include "rapidjson/document.h"
+#include "rapidjson/error/en.h"
+#include "rapidjson/memorystream.h"
+#include "rapidjson/reader.h"
+#include "rdb_protocol/configured_limits.hpp"
+#include "rdb_protocol/error.hpp"
+#include "rdb_protocol/pseudo_literal.hpp"
+
+namespace ql {
+
+const size_t MIN_JSON_PARSER_STACK_SPACE = 16 * KILOBYTE;
+
+const char *json_parse_exc_t::what() const throw () {
+    return rapidjson::GetParseError_En(code);
+}
+
+inline size_t lowest_bit_index(uint64_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return index;
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+// Bit `i` of the result is the XOR of bits `0` to `i` of `bits`.
+inline uint64_t prefix_xor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+// The characters of a block of 64 bytes that the first pass cares about, with bit `i`
+// of each mask standing for byte `i` of the block.
+struct json_block_t {
+    uint64_t quote;
+    uint64_t backslash;
+    // `{`, `}`, `[`, `]`, `:` and `,`
+    uint64_t op;
+    uint64_t whitespace;
+};
+
+#ifdef JSON_PARSER_USE_SSE2
+inline uint64_t block_eq(const __m128i chunks[4], char c) {
+    const __m128i pattern = _mm_set1_epi8(c);
+    uint64_t res = 0;
+    for (int i = 0; i < 4; ++i) {
+        const uint64_t bits = static_cast<uint16_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(chunks[i], pattern)));
+        res |= bits << (16 * i);
+    }
+    return res;
+}
+
+void classify_block(const char *block, json_block_t *out) {
+    __m128i chunks[4];
+    __m128i folded[4];
+    for (int i = 0; i < 4; ++i) {
+        chunks[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 16 * i));
+        // Setting bit 5 turns `[` into `{` and `]` into `}`, and nothing else into
+        // either of them.
+        folded[i] = _mm_or_si128(chunks[i], _mm_set1_epi8(0x20));
+    }
+    out->quote = block_eq(chunks, '"');
+    out->backslash = block_eq(chunks, '\\');
+    out->op = block_eq(folded, '{') | block_eq(folded, '}')
+        | block_eq(chunks, ':') | block_eq(chunks, ',');
+    out->whitespace = block_eq(chunks, ' ') | block_eq(chunks, '\t')
+        | block_eq(chunks, '\n') | block_eq(chunks, '\r');
+}
+#else
+void classify_block(const char *block, json_block_t *out) {
+    *out = json_block_t{0, 0, 0, 0};
+    for (int i = 0; i < 64; ++i) {
+        const uint64_t bit = static_cast<uint64_t>(1) << i;
+        switch (block[i]) {
+        case '"': out->quote |= bit; break;
+        case '\\': out->backslash |= bit; break;
+        case '{': case '}': case '[': case ']': case ':': case ',':
+            out->op |= bit;
+            break;
+        case ' ': case '\t': case '\n': case '\r':
+            out->whitespace |= bit;
+            break;
+        default: break;
+        }
+    }
+}
+#endif
+
+/* The first pass.  Appends the positions of the structural characters of `json` to
+`out`: the brackets, braces, colons and commas outside of strings, the opening quotes
+of strings, and every character outside of strings that starts a run of characters
+that are neither whitespace nor one of the former.  The second pass relies on the
+next non-whitespace character after every string, array or object being indexed. */
+void find_structurals(const char *json, size_t size, std::vector<uint32_t> *out) {
+    const uint64_t even_bits = 0x5555555555555555ULL;
+    // Whether the first byte of the next block is escaped by a backslash at the end
+    // of this one (0 or 1).
+    uint64_t prev_escaped = 0;
+    // All ones if the next block starts inside of a string, all zeros otherwise.
+    uint64_t prev_in_string = 0;
+    // Whether this block ends in a run of scalar characters (0 or 1).
+    uint64_t prev_scalar = 0;
+
+    char tail[64];
+    for (size_t offset = 0; offset < size; offset += 64) {
+        const char *block = json + offset;
+        if (size - offset < 64) {
+            // Whitespace is never structural, so it's safe to pad with it.
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, block, size - offset);
+            block = tail;
+        }
+        json_block_t masks;
+        classify_block(block, &masks);
+
+        // A character is escaped if it follows an odd number of backslashes.  Adding
+        // the starts of the runs that begin on odd bits to the runs carries through
+        // them, which tells apart runs that end on an even bit from those that end on
+        // an odd one.
+        const uint64_t backslash = masks.backslash & ~prev_escaped;
+        const uint64_t follows_escape = (backslash << 1) | prev_escaped;
+        const uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+        const uint64_t sequences = odd_starts + backslash;
+        prev_escaped = sequences < odd_starts ? 1 : 0;
+        const uint64_t escaped = (even_bits ^ (sequences << 1)) & follows_escape;
+
+        // Strings go from an unescaped quote up to, but not including, the next one.
+        const uint64_t quote = masks.quote & ~escaped;
+        const uint64_t in_string = prefix_xor(quote) ^ prev_in_string;
+        prev_in_string = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+        // The contents of strings and their closing quotes.
+        const uint64_t string_tail = in_string ^ quote;
+
+        // Quotes don't count as part of a run, so that anything that directly follows
+        // a string is indexed (and then rejected by the second pass).
+        const uint64_t scalar = ~(masks.op | masks.whitespace);
+        const uint64_t nonquote_scalar = scalar & ~quote;
+        const uint64_t follows_scalar = (nonquote_scalar << 1) | prev_scalar;
+        prev_scalar = nonquote_scalar >> 63;
+
+        uint64_t structurals = (masks.op | (scalar & ~follows_scalar)) & ~string_tail;
+        while (structurals != 0) {
+            out->push_back(
+                static_cast<uint32_t>(offset + lowest_bit_index(structurals)));
+            structurals &= structurals - 1;
+        }
+    }
+}
+
+// Returns the first quote, backslash or control character in `[p, end)`, or `end`.
+inline const char *find_string_special(const char *p, const char *end) {
+#ifdef JSON_PARSER_USE_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i max_control = _mm_set1_epi8(0x1f);
+    while (end - p >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                         _mm_cmpeq_epi8(chunk, backslash)),
+            // Only bytes up to 0x1f are their own unsigned minimum with 0x1f.
+            _mm_cmpeq_epi8(_mm_min_epu8(chunk, max_control), chunk));
+        const int mask = _mm_movemask_epi8(special);
+        if (mask != 0) {
+            return p + lowest_bit_index(mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p != end && *p != '"' && *p != '\\'
+           && static_cast<unsigned char>(*p) >= 0x20) {
+        ++p;
+    }
+    return p;
+}
+
+inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Whether a value may be directly followed by `c`.
+inline bool is_delimiter(char c) {
+    switch (c) {
+    case ' ': case '\t': case '\n': case '\r':
+    case '{': case '}': case '[': case ']': case ':': case ',':
+        return true;
+    default:
+        return false;
+    }
+}
+
+void encode_utf8(unsigned codepoint, std::string *out) {
+    if (codepoint <= 0x7F) {
+        out->push_back(static_cast<char>(codepoint));
+    } else if (codepoint <= 0x7FF) {
+        out->push_back(static_cast<char>(0xC0 | (codepoint >> 6)));
+        out->push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    } else if (codepoint <= 0xFFFF) {
+        out->push_back(static_cast<char>(0xE0 | (codepoint >> 12)));
+        out->push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    } else {
+        out->push_back(static_cast<char>(0xF0 | (codepoint >> 18)));
+        out->push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    }
+}
+
+// Collects the value of a JSON text that consists of a single number.
+class json_number_handler_t
+    : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, json_number_handler_t> {
+public:
+    json_number_handler_t() : value(0) { }
+    bool Default() { return false; }
+    bool Int(int i) { value = i; return true; }
+    bool Uint(unsigned u) { value = u; return true; }
+    bool Int64(int64_t i) { value = i; return true; }
+    bool Uint64(uint64_t u) { value = u; return true; }
+    bool Double(double d) { value = d; return true; }
+
+    double value;
+};
+
+// Thrown by the second pass when it runs into something it can't handle, which is
+// usually an error in the text.  We then parse the text again with RapidJSON, so that
+// the error is reported exactly as it would have been before.
+class json_fallback_exc_t { };
+
+/* The second pass.  This doesn't bother to tell apart the different errors, see
+`json_fallback_exc_t`. */
+class json_datum_parser_t {
+public:
+    json_datum_parser_t(const char *_json, size_t _size,
+                        const configured_limits_t &_limits)
+        : json(_json),
+          end(_json + _size),
+          limits(_limits),
+          next(0),
+          literal_ptypes({ pseudo::literal_string }) {
+        for (size_t i = 0; i < KEY_CACHE_SLOTS; ++i) {
+            key_cache_slots[i] = 0;
+        }
+    }
+
+    datum_t parse() {
+        find_structurals(json, end - json, &structurals);
+        const char *value_end;
+        datum_t res = parse_value(&value_end);
+        if (next != structurals.size() || !ends_cleanly(value_end)) {
+            fail();
+        }
+        return res;
+    }
+
+private:
+    NORETURN void fail() const {
+        throw json_fallback_exc_t();
+    }
+
+    // Returns the next structural character, or '\0' if there are none left.
+    char peek() const {
+        return next < structurals.size() ? json[structurals[next]] : '\0';
+    }
+
+    // Whether the value that ends right before `p` isn't directly followed by
+    // something that isn't structural, such as the `x` in `truex` or `"a"x`.
+    bool ends_cleanly(const char *p) const {
+        return p == end || is_delimiter(*p);
+    }
+
+    datum_t parse_value(const char **end_out) {
+        if (next == structurals.size()) {
+            fail();
+        }
+        const char *p = json + structurals[next++];
+        switch (*p) {
+        case '{': return parse_object(end_out);
+        case '[': return parse_array(end_out);
+        case '"': {
+            size_t length;
+            const char *str = parse_string(p, end_out, &length);
+            if (!utf8::is_valid(str, str + length)) {
+                fail();
+            }
+            return datum_t(datum_string_t(length, str));
+        }
+        case 't': return parse_literal(p, "true", datum_t::boolean(true), end_out);
+        case 'f': return parse_literal(p, "false", datum_t::boolean(false), end_out);
+        case 'n': return parse_literal(p, "null", datum_t::null(), end_out);
+        default: return datum_t(parse_number(p, end_out));
+        }
+    }
+
+    datum_t parse_literal(const char *p, const char *literal, datum_t value,
+                          const char **end_out) {
+        const size_t length = strlen(literal);
+        if (static_cast<size_t>(end - p) < length || memcmp(p, literal, length) != 0) {
+            fail();
+        }
+        *end_out = p + length;
+        return value;
+    }
+
+    datum_t parse_array(const char **end_out) {
+        return call_with_enough_stack<datum_t>([&]() {
+            datum_array_builder_t builder(limits);
+            if (peek() != ']') {
+                for (;;) {
+                    const char *value_end;
+                    builder.add(parse_value(&value_end));
+                    if (!ends_cleanly(value_end) || (peek() != ',' && peek() != ']')) {
+                        fail();
+                    } else if (peek() == ']') {
+                        break;
+                    }
+                    ++next;
+                }
+            }
+            *end_out = json + structurals[next++] + 1;
+            return std::move(builder).to_datum();
+        }, MIN_JSON_PARSER_STACK_SPACE);
+    }
+
+    datum_t parse_object(const char **end_out) {
+        return call_with_enough_stack<datum_t>([&]() {
+            datum_object_builder_t builder;
+            if (peek() != '}') {
+                for (;;) {
+                    if (peek() != '"') {
+                        fail();
+                    }
+                    const char *key_end;
+                    datum_string_t key = parse_key(json + structurals[next++], &key_end);
+                    if (peek() != ':') {
+                        fail();
+                    }
+                    ++next;
+                    const char *value_end;
+                    datum_t value = parse_value(&value_end);
+                    if (builder.add(key, std::move(value))) {
+                        // A duplicate key, which is an error in `to_datum()`.
+                        fail();
+                    }
+                    if (!ends_cleanly(value_end) || (peek() != ',' && peek() != '}')) {
+                        fail();
+                    } else if (peek() == '}') {
+                        break;
+                    }
+                    ++next;
+                }
+            }
+            *end_out = json + structurals[next++] + 1;
+            return std::move(builder).to_datum(literal_ptypes);
+        }, MIN_JSON_PARSER_STACK_SPACE);
+    }
+
+    // Returns the contents of the string that starts at the quote `p`.  The result
+    // points either into the text or into `scratch` and is valid until the next call.
+    const char *parse_string(const char *p, const char **end_out, size_t *length_out) {
+        const char *const start = p + 1;
+        p = find_string_special(start, end);
+        if (p != end && *p == '"') {
+            *end_out = p + 1;
+            *length_out = p - start;
+            return start;
+        }
+
+        scratch.assign(start, p);
+        for (;;) {
+            if (p == end || static_cast<unsigned char>(*p) < 0x20) {
+                fail();
+            } else if (*p == '"') {
+                break;
+            }
+            p = parse_escape(p + 1);
+            const char *special = find_string_special(p, end);
+            scratch.append(p, special);
+            p = special;
+        }
+        *end_out = p + 1;
+        *length_out = scratch.size();
+        return scratch.data();
+    }
+
+    // Appends the character that the escape sequence after the backslash at `p - 1`
+    // stands for to `scratch`, and returns the end of the sequence.
+    const char *parse_escape(const char *p) {
+        if (p == end) {
+            fail();
+        }
+        switch (*p) {
+        case '"': scratch.push_back('"'); return p + 1;
+        case '\\': scratch.push_back('\\'); return p + 1;
+        case '/': scratch.push_back('/'); return p + 1;
+        case 'b': scratch.push_back('\b'); return p + 1;
+        case 'f': scratch.push_back('\f'); return p + 1;
+        case 'n': scratch.push_back('\n'); return p + 1;
+        case 'r': scratch.push_back('\r'); return p + 1;
+        case 't': scratch.push_back('\t'); return p + 1;
+        case 'u': {
+            unsigned codepoint = parse_hex4(p + 1);
+            p += 5;
+            if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+                if (end - p < 2 || p[0] != '\\' || p[1] != 'u') {
+                    fail();
+                }
+                const unsigned low = parse_hex4(p + 2);
+                p += 6;
+                if (low < 0xDC00 || low > 0xDFFF) {
+                    fail();
+                }
+                codepoint = (((codepoint - 0xD800) << 10) | (low - 0xDC00)) + 0x10000;
+            }
+            encode_utf8(codepoint, &scratch);
+            return p;
+        }
+        default: fail();
+        }
+    }
+
+    unsigned parse_hex4(const char *p) const {
+        if (end - p < 4) {
+            fail();
+        }
+        unsigned res = 0;
+        for (int i = 0; i < 4; ++i) {
+            const char c = p[i];
+            res <<= 4;
+            if (c >= '0' && c <= '9') {
+                res += c - '0';
+            } else if (c >= 'A' && c <= 'F') {
+                res += c - 'A' + 10;
+            } else if (c >= 'a' && c <= 'f') {
+                res += c - 'a' + 10;
+            } else {
+                fail();
+            }
+        }
+        return res;
+    }
+
+    // Object keys repeat a lot, e.g. in an array of similar documents.  We remember
+    // the most recent ones so that repeated keys can share a buffer.
+    datum_string_t parse_key(const char *p, const char **end_out) {
+        size_t length;
+        const char *str = parse_string(p, end_out, &length);
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < length; ++i) {
+            hash = (hash ^ static_cast<unsigned char>(str[i])) * 1099511628211ULL;
+        }
+        size_t *slot = &key_cache_slots[hash % KEY_CACHE_SLOTS];
+        if (*slot != 0) {
+            const datum_string_t &cached = key_cache[*slot - 1];
+            if (cached.size() == length && memcmp(cached.data(), str, length) == 0) {
+                return cached;
+            }
+        }
+        if (!utf8::is_valid(str, str + length)) {
+            fail();
+        }
+        if (*slot == 0) {
+            key_cache.push_back(datum_string_t(length, str));
+            *slot = key_cache.size();
+        } else {
+            key_cache[*slot - 1] = datum_string_t(length, str);
+        }
+        return key_cache[*slot - 1];
+    }
+
+    double parse_number(const char *p, const char **end_out) {
+        const char *const start = p;
+        const bool minus = (p != end && *p == '-');
+        if (minus) {
+            ++p;
+        }
+        if (p == end || !is_digit(*p)) {
+            fail();
+        }
+
+        // We compute the number ourselves if it has at most 19 digits and no fraction
+        // or exponent, or if it has at most 15 digits and a small exponent.  Both the
+        // digits and the power of ten are then exact doubles, so that we get the same
+        // correctly rounded result as RapidJSON.
+        uint64_t significand = 0;
+        int digits = 0;
+        int exponent = 0;
+        bool is_integer = true;
+        if (*p == '0') {
+            ++p;
+        } else {
+            for (; p != end && is_digit(*p); ++p, ++digits) {
+                significand = significand * 10 + (*p - '0');
+            }
+        }
+        if (p != end && *p == '.') {
+            is_integer = false;
+            ++p;
+            if (p == end || !is_digit(*p)) {
+                fail();
+            }
+            for (; p != end && is_digit(*p); ++p, ++digits, --exponent) {
+                significand = significand * 10 + (*p - '0');
+            }
+        }
+        if (p != end && (*p == 'e' || *p == 'E')) {
+            is_integer = false;
+            ++p;
+            bool exponent_minus = false;
+            if (p != end && (*p == '+' || *p == '-')) {
+                exponent_minus = (*p == '-');
+                ++p;
+            }
+            if (p == end || !is_digit(*p)) {
+                fail();
+            }
+            int explicit_exponent = 0;
+            for (; p != end && is_digit(*p); ++p) {
+                if (explicit_exponent < 100000) {
+                    explicit_exponent = explicit_exponent * 10 + (*p - '0');
+                }
+            }
+            exponent += exponent_minus ? -explicit_exponent : explicit_exponent;
+        }
+        *end_out = p;
+
+        static const double powers_of_ten[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+            1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+        if (is_integer && digits <= 19) {
+            const double d = static_cast<double>(significand);
+            // RapidJSON turns `-0` into an integer zero, which has no sign.
+            return (minus && significand != 0) ? -d : d;
+        } else if (!is_integer && digits <= 15
+                   && exponent >= -22 && exponent <= 22) {
+            double d = static_cast<double>(significand);
+            d = exponent >= 0
+                ? d * powers_of_ten[exponent]
+                : d / powers_of_ten[-exponent];
+            return minus ? -d : d;
+        }
+
+        json_number_handler_t handler;
+        rapidjson::MemoryStream stream(start, p - start);
+        if (number_reader.Parse<rapidjson::kParseDefaultFlags>(stream, handler)
+                .IsError()) {
+            fail();
+        }
+        return handler.value;
+    }
+
+    const char *const json;
+    const char *const end;
+    const configured_limits_t &limits;
+
+    std::vector<uint32_t> structurals;
+    // The index of the next structural character to look at.
+    size_t next;
+
+    const std::set<std::string> literal_ptypes;
+    std::string scratch;
+    rapidjson::Reader number_reader;
+
+    static const size_t KEY_CACHE_SLOTS = 64;
+    // Indices into `key_cache` plus one, or zero for empty slots.
+    size_t key_cache_slots[KEY_CACHE_SLOTS];
+    std::vector<datum_string_t> key_cache;
+
+    DISABLE_COPYING(json_datum_parser_t);
+};
+
+datum_t parse_json(const char *json, size_t size,
+                   const configured_limits_t &limits, reql_version_t reql_version) {
+    // The structural index stores 32 bit positions.
+    if (size <= std::numeric_limits<uint32_t>::max()) {
+        try {
+            json_datum_parser_t parser(json, size, limits);
+            return parser.parse();
+        } catch (const json_fallback_exc_t &) {
+        } catch (const base_exc_t &) {
+            // If there's also a syntax error further on in the text, that's the one
+            // RapidJSON reports.
+        }
+    }
+
+    rapidjson::Document doc;
+    rapidjson::MemoryStream stream(json, size);
+    doc.ParseStream<rapidjson::kParseDefaultFlags, rapidjson::UTF8<> >(stream);
+    if (doc.HasParseError()) {
+        throw json_parse_exc_t(doc.GetParseError());
+    }
+    return to_datum(doc, limits, reql_version);
+}
+
+}  // namespace ql
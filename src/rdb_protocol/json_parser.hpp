@@ -0,0 +1,39 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_JSON_PARSER_HPP_
+#define RDB_PROTOCOL_JSON_PARSER_HPP_
+
+#include <exception>
+
+#include "rapidjson/document.h"
+#include "rdb_protocol/datum.hpp"
+#include "version.hpp"
+
+namespace ql {
+
+class configured_limits_t;
+
+// Thrown by `parse_json()` if the text isn't valid JSON.  The error codes (and thus
+// the messages) are the same ones RapidJSON reports.
+class json_parse_exc_t : public std::exception {
+public:
+    explicit json_parse_exc_t(rapidjson::ParseErrorCode _code) : code(_code) { }
+    const char *what() const throw ();
+
+    rapidjson::ParseErrorCode code;
+};
+
+/* Turns a JSON text into a datum without building a RapidJSON DOM first.  A first
+pass finds the structural characters of the text (brackets, braces, colons, commas,
+the opening quotes of strings and the first characters of all other values) 64 bytes
+at a time, using SSE2 where it's available.  A second pass walks that index and builds
+the datums directly, letting object keys that repeat share their buffers.
+
+The result, and the error if there is one, is the same as that of parsing the text
+with RapidJSON and calling `to_datum()` on the document.  The text doesn't have to be
+null-terminated. */
+datum_t parse_json(const char *json, size_t size,
+                   const configured_limits_t &limits, reql_version_t reql_version);
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_JSON_PARSER_HPP_
@@ -40,6 +40,7 @@ static const std::set<std::string> acceptable_optargs({
     "_EVAL_FLAGS_",
     "_NO_RECURSE_",
     "_SHORTCUT_",
+    "adaptive_batching",
     "array_limit",
     "attempts",
     "auth",
@@ -81,7 +81,7 @@ void resume_construct_sindex(
         /* It's safe to use a noop deletion context because this part of the index has
         never been live. */
         rdb_noop_deletion_context_t noop_deletion_context;
-        rdb_value_sizer_t sizer(store->cache->max_block_size());
+        rdb_value_sizer_t sizer(store->cache.get());
         store->clear_sindex_data(
             sindex_to_construct,
             &sizer,
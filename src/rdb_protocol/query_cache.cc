@@ -1,7 +1,9 @@
 // Copyright 2010-2015 RethinkDB, all rights reserved.
 #include "rdb_protocol/query_cache.hpp"
 
+#include "config/args.hpp"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
 #include "rdb_protocol/pseudo_time.hpp"
 #include "rdb_protocol/response.hpp"
 #include "rdb_protocol/term_walker.hpp"
@@ -83,6 +85,59 @@ scoped_ptr_t<query_cache_t::ref_t> query_cache_t::create(query_params_t *query_p
     return ref;
 }
 
+datum_t query_cache_t::prepare(query_params_t *query_params) {
+    guarantee(this == query_params->query_cache);
+    query_params->maybe_release_query_id();
+
+    std::string source;
+    counted_t<const term_t> term_tree;
+    try {
+        source = query_params->term_storage->root_term_source();
+        query_params->term_storage->preprocess();
+        raw_term_t root_term = query_params->term_storage->root_term();
+        rcheck_src(root_term.bt(), root_term.type() == Term::FUNC, base_exc_t::LOGIC,
+                   "A prepared query must be a function.");
+
+        compile_env_t compile_env((var_visibility_t()));
+        term_tree = compile_term(&compile_env, root_term);
+    } catch (const exc_t &e) {
+        throw bt_exc_t(Response::COMPILE_ERROR,
+            e.get_error_type(),
+            e.what(),
+            query_params->term_storage->backtrace_registry().datum_backtrace(e));
+    } catch (const datum_exc_t &e) {
+        throw bt_exc_t(Response::COMPILE_ERROR,
+                       e.get_error_type(),
+                       e.what(),
+                       backtrace_registry_t::EMPTY_BACKTRACE);
+    }
+
+    // Preparing the same function again gives the same id.
+    std::string id = strprintf("%016zx", std::hash<std::string>()(source));
+    auto it = prepared_queries.find(id);
+    if (it != prepared_queries.end()) {
+        if (it->second->source != source) {
+            throw bt_exc_t(Response::CLIENT_ERROR, Response::QUERY_LOGIC,
+                strprintf("ERROR: prepared query id `%s` is already in use by a "
+                          "different query.", id.c_str()),
+                backtrace_registry_t::EMPTY_BACKTRACE);
+        }
+    } else {
+        if (prepared_queries.size() >= MAX_PREPARED_QUERIES_PER_CONNECTION) {
+            throw bt_exc_t(Response::CLIENT_ERROR, Response::RESOURCE_LIMIT,
+                strprintf("ERROR: a connection can't have more than %d prepared "
+                          "queries.", MAX_PREPARED_QUERIES_PER_CONNECTION),
+                backtrace_registry_t::EMPTY_BACKTRACE);
+        }
+        prepared_queries.insert(std::make_pair(
+            id,
+            make_counted<const prepared_query_t>(std::move(source),
+                                                 std::move(query_params->term_storage),
+                                                 std::move(term_tree))));
+    }
+    return datum_t(datum_string_t(id));
+}
+
 scoped_ptr_t<query_cache_t::ref_t> query_cache_t::get(query_params_t *query_params,
                                                       signal_t *interruptor) {
     guarantee(this == query_params->query_cache);
@@ -209,6 +264,7 @@ void query_cache_t::ref_t::fill_response(response_t *res) {
             &combined_interruptor,
             serializable,
             trace.get_or_null());
+        env.set_temporary_files_budget(entry->temporary_files_budget);
 
         if (entry->state == entry_t::state_t::START) {
             run(&env, res);
@@ -256,13 +312,13 @@ void query_cache_t::ref_t::fill_response(response_t *res) {
         throw bt_exc_t(Response::RUNTIME_ERROR,
                        ex.get_error_type(),
                        ex.what(),
-                       entry->term_storage->backtrace_registry().datum_backtrace(ex));
+                       entry->backtrace_registry().datum_backtrace(ex));
     } catch (const datum_exc_t &ex) {
         query_cache->terminate_internal(entry);
         throw bt_exc_t(Response::RUNTIME_ERROR,
                        ex.get_error_type(),
                        ex.what(),
-                       entry->term_storage->backtrace_registry().datum_backtrace(
+                       entry->backtrace_registry().datum_backtrace(
                             backtrace_id_t::empty(), 0));
     } catch (const std::exception &ex) {
         query_cache->terminate_internal(entry);
@@ -275,7 +331,9 @@ void query_cache_t::ref_t::fill_response(response_t *res) {
 
 void query_cache_t::ref_t::run(env_t *env, response_t *res) {
     scope_env_t scope_env(env, var_scope_t());
-    scoped_ptr_t<val_t> val = entry->term_tree->eval(&scope_env);
+    scoped_ptr_t<val_t> val = entry->execute
+        ? call_prepared(&scope_env)
+        : entry->term_tree->eval(&scope_env);
 
     if (val->get_type().is_convertible(val_t::type_t::DATUM)) {
         res->set_type(Response::SUCCESS_ATOM);
@@ -307,6 +365,29 @@ void query_cache_t::ref_t::run(env_t *env, response_t *res) {
     }
 }
 
+scoped_ptr_t<val_t> query_cache_t::ref_t::call_prepared(scope_env_t *scope_env) {
+    datum_t args = entry->term_tree->eval(scope_env)->as_datum();
+    rcheck_toplevel(args.get_type() == datum_t::R_ARRAY
+                    && args.arr_size() >= 1
+                    && args.get(0).get_type() == datum_t::R_STR,
+                    base_exc_t::LOGIC,
+                    "An EXECUTE query must be an array of a prepared query id "
+                    "followed by the arguments.");
+    auto it = query_cache->prepared_queries.find(args.get(0).as_str().to_std());
+    rcheck_toplevel(it != query_cache->prepared_queries.end(), base_exc_t::LOGIC,
+                    strprintf("Prepared query `%s` not found on this connection.",
+                              args.get(0).as_str().to_std().c_str()));
+    entry->prepared = it->second;
+
+    std::vector<datum_t> func_args;
+    func_args.reserve(args.arr_size() - 1);
+    for (size_t i = 1; i < args.arr_size(); ++i) {
+        func_args.push_back(args.get(i));
+    }
+    counted_t<const func_t> func = entry->prepared->term_tree->eval(scope_env)->as_func();
+    return func->call(scope_env->env, func_args);
+}
+
 void query_cache_t::ref_t::serve(env_t *env, response_t *res) {
     guarantee(entry->stream.has());
 
@@ -319,8 +400,18 @@ void query_cache_t::ref_t::serve(env_t *env, response_t *res) {
     batch_type_t batch_type = entry->has_sent_batch
                                   ? batch_type_t::NORMAL
                                   : batch_type_t::NORMAL_FIRST;
-    std::vector<datum_t> ds = entry->stream->next_batch(
-            env, batchspec_t::user(batch_type, env));
+    batchspec_t batchspec = batchspec_t::user(batch_type, env);
+    if (cfeed_type == feed_type_t::not_feed) {
+        batchspec = entry->batch_tuner.tune(batchspec);
+    }
+    kiloticks_t batch_start = get_kiloticks();
+    std::vector<datum_t> ds = entry->stream->next_batch(env, batchspec);
+    if (cfeed_type == feed_type_t::not_feed) {
+        entry->batch_tuner.note_batch(
+            batchspec,
+            ds.size(),
+            kiloticks_t{get_kiloticks().micros - batch_start.micros});
+    }
     entry->has_sent_batch = true;
     res->set_data(std::move(ds));
 
@@ -367,6 +458,7 @@ query_cache_t::entry_t::entry_t(query_params_t *query_params,
         state(state_t::START),
         interrupt_reason(interrupt_reason_t::UNKNOWN),
         job_id(generate_uuid()),
+        execute(query_params->type == Query::EXECUTE),
         noreply(query_params->noreply),
         profile(query_params->profile ? profile_bool_t::PROFILE :
                                         profile_bool_t::DONT_PROFILE),
@@ -375,8 +467,23 @@ query_cache_t::entry_t::entry_t(query_params_t *query_params,
         deterministic_time(_deterministic_time),
         start_time(get_kiloticks()),
         term_tree(std::move(_term_tree)),
-        has_sent_batch(false) { }
+        has_sent_batch(false),
+        temporary_files_budget(make_counted<temporary_files_budget_t>()) { }
 
 query_cache_t::entry_t::~entry_t() { }
 
+const backtrace_registry_t &query_cache_t::entry_t::backtrace_registry() const {
+    return prepared.has()
+        ? prepared->term_storage->backtrace_registry()
+        : term_storage->backtrace_registry();
+}
+
+query_cache_t::prepared_query_t::prepared_query_t(
+        std::string &&_source,
+        scoped_ptr_t<term_storage_t> &&_term_storage,
+        counted_t<const term_t> &&_term_tree) :
+    source(std::move(_source)),
+    term_storage(std::move(_term_storage)),
+    term_tree(std::move(_term_tree)) { }
+
 } // namespace ql
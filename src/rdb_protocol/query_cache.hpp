@@ -20,6 +20,7 @@
 #include "containers/counted.hpp"
 #include "containers/intrusive_list.hpp"
 #include "containers/object_buffer.hpp"
+#include "rdb_protocol/batching.hpp"
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/rdb_backtrace.hpp"
 #include "rdb_protocol/error.hpp"
@@ -57,6 +58,8 @@ public:
 
         // Run a new query
         void run(env_t *env, response_t *res);
+        // Evaluate the arguments of an `EXECUTE` query and call the prepared query
+        scoped_ptr_t<val_t> call_prepared(scope_env_t *scope_env);
         // Serve a batch from a stream
         void serve(env_t *env, response_t *res);
 
@@ -89,6 +92,10 @@ public:
     scoped_ptr_t<ref_t> get(query_params_t *query_params,
                             signal_t *interruptor);
 
+    // Compiles the function in a `PREPARE` query and keeps it until the connection
+    // is closed.  Returns the id with which `EXECUTE` queries refer to it.
+    datum_t prepare(query_params_t *query_params);
+
     void noreply_wait(const query_params_t &query_params,
                       signal_t *interruptor);
 
@@ -103,6 +110,23 @@ public:
     auth::user_context_t const &get_user_context() const;
 
 private:
+    // A compiled function that `EXECUTE` queries may call.  The entries of the
+    // queries calling it hold a reference, so it stays alive while they run.
+    class prepared_query_t : public single_threaded_countable_t<prepared_query_t> {
+    public:
+        prepared_query_t(std::string &&_source,
+                         scoped_ptr_t<term_storage_t> &&_term_storage,
+                         counted_t<const term_t> &&_term_tree);
+
+        // The function term as the client sent it.
+        const std::string source;
+        const scoped_ptr_t<const term_storage_t> term_storage;
+        const counted_t<const term_t> term_tree;
+
+    private:
+        DISABLE_COPYING(prepared_query_t);
+    };
+
     class entry_t {
     public:
         entry_t(query_params_t *query_params,
@@ -115,6 +139,7 @@ private:
         interrupt_reason_t interrupt_reason;
 
         const uuid_u job_id;
+        const bool execute;
         const bool noreply;
         const profile_bool_t profile;
         const scoped_ptr_t<const term_storage_t> term_storage;
@@ -135,6 +160,16 @@ private:
         // stream is finished
         counted_t<datum_stream_t> stream;
         bool has_sent_batch;
+        // Shared by all the batches of the query, like the temporary files of `stream`.
+        const counted_t<temporary_files_budget_t> temporary_files_budget;
+        batch_tuner_t batch_tuner;
+
+        // This will be empty unless this is an `EXECUTE` query that has looked up its
+        // prepared query.
+        counted_t<const prepared_query_t> prepared;
+
+        // The backtraces of errors come from the prepared query once it's running.
+        const backtrace_registry_t &backtrace_registry() const;
 
         // The order of these is very important, do not move them around
         new_mutex_t mutex; // Only one coroutine may be using this query at a time
@@ -151,6 +186,8 @@ private:
     return_empty_normal_batches_t return_empty_normal_batches;
     auth::user_context_t user_context;
     std::map<int64_t, scoped_ptr_t<entry_t> > queries;
+    // Keyed by the id returned by `prepare`, a hash of the function's source.
+    std::map<std::string, counted_t<const prepared_query_t> > prepared_queries;
 
     // Used for noreply waiting, this contains all allocated-but-incomplete query ids
     friend class query_params_t::query_id_t;
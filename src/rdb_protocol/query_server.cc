@@ -59,6 +59,16 @@ void rdb_query_server_t::run_query(ql::query_params_t *query_params,
             query_params->query_cache->noreply_wait(*query_params, interruptor);
             response_out->set_type(Response::WAIT_COMPLETE);
         } break;
+        case Query::PREPARE: {
+            response_out->set_data(query_params->query_cache->prepare(query_params));
+            response_out->set_type(Response::SUCCESS_ATOM);
+        } break;
+        case Query::EXECUTE: {
+            scoped_ptr_t<ql::query_cache_t::ref_t> query_ref =
+                query_params->query_cache->create(query_params, ql::pseudo::time_now(),
+                                                  interruptor);
+            query_ref->fill_response(response_out);
+        } break;
         case Query::SERVER_INFO: {
             fill_server_info(response_out);
             response_out->set_type(Response::SERVER_INFO);
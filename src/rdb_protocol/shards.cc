@@ -1,12 +1,17 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/shards.hpp"
 
+#include <unordered_map>
 #include <utility>
 
 #include "errors.hpp"
 #include <boost/variant.hpp>
 
+#include "config/args.hpp"
+#include "containers/disk_backed_queue.hpp"
 #include "debug.hpp"
+#include "rdb_protocol/context.hpp"
+#include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/profile.hpp"
 #include "rdb_protocol/protocol.hpp"
@@ -108,7 +113,9 @@ private:
 
     virtual void unshard(env_t *env, const std::vector<result_t *> &results) {
         guarantee(acc.size() == 0);
-        std::map<datum_t, std::vector<T *>, optional_datum_less_t> vecs;
+        // `acc` provides the ordering, so `vecs` doesn't need one.
+        std::unordered_map<datum_t, std::vector<T *>,
+                           optional_datum_hash_t, optional_datum_equal_t> vecs;
         r_sanity_check(results.size() != 0);
         for (auto res = results.begin(); res != results.end(); ++res) {
             guarantee(*res);
@@ -505,6 +512,84 @@ scoped_ptr_t<eager_acc_t> make_to_array() {
     return make_scoped<to_array_t>();
 }
 
+// Moves the groups of a `grouped_t<T>` to temporary files in the server's data
+// directory.  The groups are split into partitions by their hash, so that all the
+// partial results for one group end up in the same partition and the partitions can be
+// merged one at a time.
+template<class T>
+class grouped_spill_t {
+public:
+    explicit grouped_spill_t(env_t *_env)
+        : env(_env), budget(env->get_temporary_files_budget()), bytes_charged(0) {
+        partitions.resize(GROUPED_ACC_SPILL_PARTITIONS);
+    }
+
+    ~grouped_spill_t() {
+        budget->release(bytes_charged);
+    }
+
+    static bool is_available(env_t *env) {
+        return env->get_rdb_ctx() != nullptr
+            && env->get_rdb_ctx()->io_backender != nullptr;
+    }
+
+    env_t *get_env() { return env; }
+
+    // Writes out and clears all the groups of `groups`.
+    void spill(grouped_t<T> *groups) {
+        std::vector<grouped_t<T> > chunks(partitions.size());
+        for (auto &&kv : *groups) {
+            size_t p = optional_datum_hash_t()(kv.first) % partitions.size();
+            chunks[p].insert(std::make_pair(kv.first, std::move(kv.second)));
+        }
+        groups->clear();
+        for (size_t p = 0; p < partitions.size(); ++p) {
+            if (chunks[p].size() == 0) {
+                continue;
+            }
+            if (!partitions[p].has()) {
+                partitions[p].init(new internal_disk_backed_queue_t(
+                    env->get_rdb_ctx()->io_backender,
+                    serializer_filepath_t(
+                        env->get_rdb_ctx()->base_path,
+                        GROUPED_SPILL_FILE_PREFIX + uuid_to_str(generate_uuid())),
+                    &stats));
+            }
+            write_message_t wm;
+            // The file doesn't outlive the query, so the version doesn't matter.
+            serialize<cluster_version_t::CLUSTER>(&wm, chunks[p]);
+            budget->charge(wm.size());
+            bytes_charged += wm.size();
+            partitions[p]->push(wm);
+        }
+    }
+
+    size_t num_partitions() const { return partitions.size(); }
+
+    // Reads the next chunk of groups written to partition `p` into `chunk_out`, which
+    // must be empty.  Returns `false` if there are none left.
+    bool pop(size_t p, grouped_t<T> *chunk_out) {
+        if (!partitions[p].has() || partitions[p]->empty()) {
+            return false;
+        }
+        deserializing_viewer_t<grouped_t<T> > viewer(chunk_out);
+        partitions[p]->pop(&viewer);
+        return true;
+    }
+
+private:
+    env_t *const env;
+    const counted_t<temporary_files_budget_t> budget;
+    // What we have written to the files so far.  Popping doesn't shrink the files.
+    uint64_t bytes_charged;
+    // The temporary files get a perfmon collection of their own, so that they don't
+    // show up in the server's stats.
+    perfmon_collection_t stats;
+    std::vector<scoped_ptr_t<internal_disk_backed_queue_t> > partitions;
+
+    DISABLE_COPYING(grouped_spill_t);
+};
+
 template<class T>
 class terminal_t : public grouped_acc_t<T>, public eager_acc_t {
 protected:
@@ -525,6 +610,57 @@ private:
             }
         }
         groups->clear();
+        maybe_spill(env);
+    }
+
+    // Once `acc` holds too many groups, they go to disk until `finish_eager`.
+    void maybe_spill(env_t *env) {
+        grouped_t<T> *_acc = grouped_acc_t<T>::get_acc();
+        if (_acc->size() <= GROUPED_ACC_MAX_IN_MEMORY_GROUPS
+            || !grouped_spill_t<T>::is_available(env)) {
+            return;
+        }
+        if (!spill.has()) {
+            spill.init(new grouped_spill_t<T>(env));
+        }
+        profile::starter_t starter("Spilling groups to disk.", env->trace);
+        spill->spill(_acc);
+    }
+
+    // Merges the spilled groups one partition at a time and unpacks them into `out`.
+    // Spilling only bounds the memory for merging the partial results of the shards.
+    // The result itself still has to fit in memory, so like any other grouped data it
+    // can't have more groups than the array size limit, and we fail as soon as it
+    // grows past that instead of after merging everything.
+    void unpack_spilled(grouped_data_t *out) {
+        grouped_t<T> *_acc = grouped_acc_t<T>::get_acc();
+        const T *_default_val = grouped_acc_t<T>::get_default_val();
+        env_t *env = spill->get_env();
+        const size_t limit = env->limits().array_size_limit();
+        profile::starter_t starter("Merging spilled groups.", env->trace);
+        spill->spill(_acc);
+        for (size_t p = 0; p < spill->num_partitions(); ++p) {
+            // The partition's groups go into the ordered `out` in the end, so
+            // there's no point in ordering them here.
+            std::unordered_map<datum_t, T,
+                               optional_datum_hash_t, optional_datum_equal_t> merged;
+            grouped_t<T> chunk;
+            while (spill->pop(p, &chunk)) {
+                for (auto &&kv : chunk) {
+                    auto pair = merged.insert(std::make_pair(kv.first, *_default_val));
+                    unshard_impl(env, &pair.first->second, &kv.second);
+                }
+                chunk.clear();
+                rcheck_toplevel(
+                    out->size() + merged.size() <= limit, base_exc_t::RESOURCE,
+                    strprintf("Grouped data over size limit `%zu`.  "
+                              "Try putting a reduction (like `.reduce` or `.count`) "
+                              "on the end.", limit).c_str());
+            }
+            for (auto &&kv : merged) {
+                out->insert(std::make_pair(kv.first, unpack(&kv.second)));
+            }
+        }
     }
 
     virtual scoped_ptr_t<val_t> finish_eager(backtrace_id_t bt,
@@ -534,7 +670,14 @@ private:
         grouped_t<T> *_acc = grouped_acc_t<T>::get_acc();
         const T *_default_val = grouped_acc_t<T>::get_default_val();
         scoped_ptr_t<val_t> retval;
-        if (is_grouped) {
+        if (spill.has()) {
+            // We only spill once there is more than one group.
+            r_sanity_check(is_grouped);
+            counted_t<grouped_data_t> ret(new grouped_data_t());
+            unpack_spilled(ret.get());
+            spill.reset();
+            retval = make_scoped<val_t>(std::move(ret), bt);
+        } else if (is_grouped) {
             counted_t<grouped_data_t> ret(new grouped_data_t());
             // The order of `acc` doesn't matter here because we're putting stuff
             // into the parallel map, `ret`.
@@ -574,6 +717,7 @@ private:
                 unshard_impl(env, &t_it->second, &kv->second);
             }
         }
+        maybe_spill(env);
     }
 
     virtual bool accumulate(env_t *env,
@@ -595,6 +739,8 @@ private:
     }
     virtual void unshard_impl(env_t *env, T *out, T *el) = 0;
     virtual bool should_send_batch() { return false; }
+
+    scoped_ptr_t<grouped_spill_t<T> > spill;
 };
 
 class count_terminal_t : public terminal_t<uint64_t> {
@@ -603,6 +749,15 @@ public:
         : terminal_t<uint64_t>(0) { }
 private:
     virtual bool uses_val() { return false; }
+    virtual bool counts_rows_without_keys() { return true; }
+    virtual void add_row_count(uint64_t n) {
+        if (n == 0) {
+            return;
+        }
+        grouped_t<uint64_t> *_acc = get_acc();
+        auto t_it = _acc->insert(std::make_pair(datum_t(), *get_default_val())).first;
+        t_it->second += n;
+    }
     virtual bool accumulate(env_t *,
                             const datum_t &,
                             uint64_t *out) {
@@ -1035,7 +1190,16 @@ public:
         : f(_f.filter_func.compile_wire_func()),
           default_val(_f.default_filter_val.has_value()
                       ? _f.default_filter_val->compile_wire_func()
-                      : counted_t<const func_t>()) { }
+                      : counted_t<const func_t>()) {
+        // The program treats missing fields as not matching, which is only right
+        // without a default value.
+        if (!default_val.has()) {
+            program = filter_program_t::compile(*f);
+        }
+    }
+    const filter_program_t *filter_program() const {
+        return program.has_value() ? &*program : nullptr;
+    }
 private:
     virtual void lst_transform(
         env_t *env, datums_t *lst, const std::function<datum_t()> &) {
@@ -1043,7 +1207,12 @@ private:
         auto loc = it;
         try {
             for (it = lst->begin(); it != lst->end(); ++it) {
-                if (f->filter_call(env, *it, default_val)) {
+                filter_program_t::result_t res = program.has_value()
+                    ? program->run(*it)
+                    : filter_program_t::result_t::UNKNOWN;
+                if (res == filter_program_t::result_t::MATCH
+                    || (res == filter_program_t::result_t::UNKNOWN
+                        && f->filter_call(env, *it, default_val))) {
                     std::swap(*loc, *it);
                     ++loc;
                 }
@@ -1054,6 +1223,7 @@ private:
         lst->erase(loc, lst->end());
     }
     counted_t<const func_t> f, default_val;
+    optional<filter_program_t> program;
 };
 
 class concatmap_trans_t : public ungrouped_op_t {
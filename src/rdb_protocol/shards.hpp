@@ -18,6 +18,7 @@
 #include "rdb_protocol/configured_limits.hpp"
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/datum_utils.hpp"
+#include "rdb_protocol/filter_program.hpp"
 #include "rdb_protocol/profile.hpp"
 #include "rdb_protocol/wire_func.hpp"
 #include "region/region.hpp"
@@ -364,6 +365,10 @@ public:
                             groups_t *groups,
                             // Returns a datum that might be null
                             const std::function<datum_t()> &lazy_sindex_val) = 0;
+    // Non-null if this is a `filter` whose predicate could be compiled.  Rows for
+    // which the program returns `MATCH` or `NO_MATCH` don't have to go through the
+    // op at all.
+    virtual const filter_program_t *filter_program() const { return nullptr; }
 };
 
 struct limit_read_t {
@@ -393,6 +398,11 @@ public:
     virtual ~accumulator_t();
     // May be overridden as an optimization (currently is for `count`).
     virtual bool uses_val() { return true; }
+    // Accumulators that only need to know how many rows there are (currently
+    // `count`) can return `true` here.  They can then be given whole numbers of rows
+    // through `add_row_count()` instead of individual rows.
+    virtual bool counts_rows_without_keys() { return false; }
+    virtual void add_row_count(uint64_t) { unreachable(); }
     virtual void stop_at_boundary(store_key_t &&) { }
     virtual bool should_send_batch() = 0;
     virtual continue_bool_t operator()(
@@ -111,7 +111,7 @@ void store_t::help_construct_bring_sindexes_up_to_date() {
             // This is in contrast to `delayed_clear_and_drop_sindex()`, where we
             // have to deal with some parts of the index still potentially being live.
             rdb_noop_deletion_context_t noop_deletion_context;
-            rdb_value_sizer_t sizer(cache->max_block_size());
+            rdb_value_sizer_t sizer(cache.get());
 
             /* Clear the sindex. */
             clear_sindex_data(
@@ -997,7 +997,7 @@ void store_t::delayed_clear_and_drop_sindex(
         auto_drainer_t::lock_t store_keepalive)
         THROWS_NOTHING {
     try {
-        rdb_value_sizer_t sizer(cache->max_block_size());
+        rdb_value_sizer_t sizer(cache.get());
         /* If the index had been completely constructed, we must
          * detach its values since snapshots might be accessing it.
          * If on the other hand the index had not finished post
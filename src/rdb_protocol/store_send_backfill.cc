@@ -96,7 +96,7 @@ continue_bool_t store_t::send_backfill_pre(
             limiting_btree_backfill_pre_item_consumer_t
                 limiter(pre_item_consumer, &threshold);
 
-            rdb_value_sizer_t sizer(cache->max_block_size());
+            rdb_value_sizer_t sizer(cache.get());
             key_range_t to_do = pair.first;
             to_do.left = threshold.key();
             continue_bool_t cont = btree_send_backfill_pre(sb.get(),
@@ -263,7 +263,7 @@ continue_bool_t store_t::send_backfill(
             limiting_btree_backfill_item_consumer_t limiter(
                 item_consumer, &threshold, &metainfo_copy);
 
-            rdb_value_sizer_t sizer(cache->max_block_size());
+            rdb_value_sizer_t sizer(cache.get());
             key_range_t to_do = pair.first;
             to_do.left = threshold.key();
             continue_bool_t cont = btree_send_backfill(sb.get(),
@@ -2,6 +2,8 @@
 #include "rdb_protocol/term_storage.hpp"
 
 #include "arch/runtime/coroutines.hpp"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
 #include "rdb_protocol/optargs.hpp"
 #include "rdb_protocol/term_walker.hpp"
 
@@ -30,6 +32,8 @@ bool query_type_is_valid(Query::QueryType query_type) {
     case Query::STOP:
     case Query::NOREPLY_WAIT:
     case Query::SERVER_INFO:
+    case Query::PREPARE:
+    case Query::EXECUTE:
         return true;
     default:
         return false;
@@ -229,6 +233,12 @@ bool term_storage_t::static_optarg_as_bool(UNUSED const std::string &key,
     unreachable();
 }
 
+std::string term_storage_t::root_term_source() const {
+    r_sanity_check(false, "root_term_source() is unimplemented "
+                   "for this term_storage_t type");
+    unreachable();
+}
+
 global_optargs_t term_storage_t::global_optargs() {
     r_sanity_check(false, "global_optargs() is unimplemented "
                    "for this term_storage_t type");
@@ -295,6 +305,14 @@ raw_term_t json_term_storage_t::root_term() const {
     return raw_term_t(&query_json[1]);
 }
 
+std::string json_term_storage_t::root_term_source() const {
+    r_sanity_check(query_json.Size() >= 2);
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    query_json[1].Accept(writer);
+    return std::string(buffer.GetString(), buffer.GetSize());
+}
+
 bool json_term_storage_t::static_optarg_as_bool(const std::string &key,
                                                 bool default_value) const {
     r_sanity_check(query_json.IsArray());
@@ -133,6 +133,9 @@ public:
                                        bool default_value) const;
     virtual void preprocess();
     virtual global_optargs_t global_optargs();
+    // The root term as the client sent it, for use as a cache key.  Must be called
+    // before `preprocess`.
+    virtual std::string root_term_source() const;
 
 protected:
     backtrace_registry_t bt_reg;
@@ -148,6 +151,7 @@ public:
     void preprocess();
     raw_term_t root_term() const;
     global_optargs_t global_optargs();
+    std::string root_term_source() const;
 private:
     scoped_array_t<char> original_data;
     rapidjson::Document query_json;
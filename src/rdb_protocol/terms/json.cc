@@ -1,10 +1,11 @@
 // Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <string.h>
+
 #include "cjson/json.hpp"
+#include "rdb_protocol/json_parser.hpp"
 #include "rdb_protocol/op.hpp"
 #include "rdb_protocol/term.hpp"
 #include "rdb_protocol/terms/terms.hpp"
-#include "rapidjson/document.h"
-#include "rapidjson/error/en.h"
 #include "rapidjson/rapidjson.h"
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
@@ -29,30 +30,19 @@ public:
             return new_val(to_datum(cjson.get(), env->env->limits(),
                                     env->env->reql_version()));
         } else {
-            // Copy the string into a null-terminated c-string that we can write
-            // to, so we can use RapidJSON in-situ parsing (and at least avoid
-            // some additional copying).
-            std::vector<char> str_buf(data.size() + 1);
-            memcpy(str_buf.data(), data.data(), data.size());
-            for (size_t i = 0; i < data.size(); ++i) {
-                rcheck(str_buf[i] != '\0', base_exc_t::LOGIC,
-                       "Encountered unescaped null byte in JSON string.");
+            rcheck(memchr(data.data(), '\0', data.size()) == nullptr, base_exc_t::LOGIC,
+                   "Encountered unescaped null byte in JSON string.");
+            try {
+                return new_val(parse_json(data.data(), data.size(),
+                                          env->env->limits(),
+                                          env->env->reql_version()));
+            } catch (const json_parse_exc_t &ex) {
+                rfail(base_exc_t::LOGIC, "Failed to parse \"%s\" as JSON: %s",
+                      (data.size() > 40
+                       ? (data.to_std().substr(0, 37) + "...").c_str()
+                       : data.to_std().c_str()),
+                      ex.what());
             }
-            str_buf[data.size()] = '\0';
-
-            rapidjson::Document json;
-            // Note: Insitu will cause some parts of `json` to directly point into
-            // `str_buf`. `str_buf`'s life time must be at least as long as `json`'s.
-            json.ParseInsitu(str_buf.data());
-
-            rcheck(!json.HasParseError(), base_exc_t::LOGIC,
-                   strprintf("Failed to parse \"%s\" as JSON: %s",
-                       (data.size() > 40
-                        ? (data.to_std().substr(0, 37) + "...").c_str()
-                        : data.to_std().c_str()),
-                       rapidjson::GetParseError_En(json.GetParseError())));
-            return new_val(to_datum(json, env->env->limits(),
-                                    env->env->reql_version()));
         }
     }
 
@@ -28,12 +28,21 @@
 // Number of messages after which the message handling loop yields
 #define MESSAGE_HANDLER_MAX_BATCH_SIZE           16
 
+// Batches of outgoing messages at least this big (in bytes) are written to the
+// connection with `writev()` rather than copied into its write buffer
+#define MIN_VECTORED_WRITE_SIZE                  (16 * KILOBYTE)
+
+// Over a connection with compression enabled, messages at least this big (in bytes)
+// are compressed unless they ask not to be
+#define MIN_COMPRESSED_MESSAGE_SIZE              KILOBYTE
+
 // The cluster communication protocol version.
 static_assert(cluster_version_t::CLUSTER == cluster_version_t::v2_5_is_latest,
               "We need to update CLUSTER_VERSION_STRING when we add a new cluster "
               "version.");
 
-#define CLUSTER_VERSION_STRING "2.5.0"
+// 2.5.1 added message compression and changed the serialization of `batchspec_t`.
+#define CLUSTER_VERSION_STRING "2.5.1"
 
 const std::string connectivity_cluster_t::cluster_proto_header("RethinkDB cluster\n");
 const std::string connectivity_cluster_t::cluster_version_string(CLUSTER_VERSION_STRING);
@@ -42,7 +51,8 @@ const std::string connectivity_cluster_t::cluster_version_string(CLUSTER_VERSION
 // version_string is a recognized version and the same or earlier than our version.
 static bool version_number_recognized_compatible(const std::string &version_string,
                                                  cluster_version_t *out) {
-    // Right now, we only support one cluster version -- ours.
+    // Right now, we only support one cluster version -- ours.  In particular 2.5.0 is
+    // not compatible, because the serialization of `batchspec_t` changed in 2.5.1.
     if (version_string == CLUSTER_VERSION_STRING) {
         *out = cluster_version_t::CLUSTER;
         return true;
@@ -133,9 +143,11 @@ connectivity_cluster_t::connection_t::connection_t(
         const peer_id_t &_peer_id,
         const server_id_t &_server_id,
         keepalive_tcp_conn_stream_t *_conn,
-        const peer_address_t &_peer_address) THROWS_NOTHING :
+        const peer_address_t &_peer_address,
+        bool compress_outgoing) THROWS_NOTHING :
     conn(_conn),
     peer_address(_peer_address),
+    compressor(compress_outgoing ? new message_compressor_t() : nullptr),
     flusher([&](signal_t *) {
         guarantee(this->conn != nullptr);
         // We need to acquire the send_mutex because flushing the buffer
@@ -221,11 +233,13 @@ connectivity_cluster_t::run_t::run_t(
             _heartbeat_sl_view,
         std::shared_ptr<semilattice_read_view_t<auth_semilattice_metadata_t> >
             _auth_sl_view,
-        tls_ctx_t *_tls_ctx)
+        tls_ctx_t *_tls_ctx,
+        cluster_compression_t _compression)
         THROWS_ONLY(address_in_use_exc_t, tcp_socket_exc_t) :
     parent(_parent),
     server_id(_server_id),
     tls_ctx(_tls_ctx),
+    compression(_compression),
 
     /* Create the socket to use when listening for connections from peers */
     cluster_listener_socket(new tcp_bound_socket_t(local_addresses, port)),
@@ -257,7 +271,8 @@ connectivity_cluster_t::run_t::run_t(
     `connection_map` on each thread and notifying any listeners that we're now
     connected to ourself. The destructor will remove us from the
     `connection_map` and again notify any listeners. */
-    connection_to_ourself(this, parent->me, _server_id, nullptr, routing_table[parent->me]),
+    connection_to_ourself(this, parent->me, _server_id, nullptr, routing_table[parent->me],
+                          false),
 
     heartbeat_sl_view(_heartbeat_sl_view),
     auth_sl_view(_auth_sl_view),
@@ -541,7 +556,7 @@ public:
         }
     }
 
-    void write(write_stream_t *) {
+    void write(write_message_t *) {
         /* Do nothing. The cluster will end up sending just the tag 'H' with no message
         attached, which will trigger `keepalive_read()` on the remote server. */
     }
@@ -947,9 +962,8 @@ join_result_t connectivity_cluster_t::run_t::handle(
 
     // Check version number (e.g. 1.9.0-466-gadea67)
     cluster_version_t resolved_version;
+    std::string remote_version_string;
     {
-        std::string remote_version_string;
-
         if (!deserialize_compatible_string(conn, &remote_version_string, peername)) {
             return join_result_t::TEMPORARY_ERROR;
         }
@@ -1096,6 +1110,28 @@ join_result_t connectivity_cluster_t::run_t::handle(
         }
     }
 
+    /* Tell each other which compression methods we can decompress, as a bit set of
+    `cluster_compression_t` values. We can decompress all of them, but only compress
+    the messages we send if the other server can decompress them too. Every cluster
+    version that we can talk to does this. */
+    bool compress_outgoing;
+    {
+        write_message_t wm;
+        serialize_universal(&wm, static_cast<uint8_t>(
+            1 << static_cast<int>(cluster_compression_t::zlib)));
+        if (send_write_message(conn, &wm)) {
+            return join_result_t::TEMPORARY_ERROR; // network error.
+        }
+
+        uint8_t remote_accepted_compression;
+        if (deserialize_universal_and_check(conn, &remote_accepted_compression,
+                                            peername)) {
+            return join_result_t::TEMPORARY_ERROR;
+        }
+        compress_outgoing = compression != cluster_compression_t::none
+            && (remote_accepted_compression & (1 << static_cast<int>(compression))) != 0;
+    }
+
     // Look up the ip addresses for the other host
     object_buffer_t<peer_address_t> other_peer_addr;
 
@@ -1317,7 +1353,8 @@ join_result_t connectivity_cluster_t::run_t::handle(
         constructor registers it in the `connectivity_cluster_t`'s connection
         map. */
         connection_t conn_structure(
-            this, other_id, remote_server_id, conn, *other_peer_addr.get());
+            this, other_id, remote_server_id, conn, *other_peer_addr.get(),
+            compress_outgoing);
 
         /* `heartbeat_manager` will periodically send a heartbeat message to
         other servers, and it will also close the connection if we don't
@@ -1332,28 +1369,65 @@ join_result_t connectivity_cluster_t::run_t::handle(
         it's closed, which may be due to network events, or the other end
         shutting down, or us shutting down. */
         try {
+            auto handle_message = [&](message_tag_t tag, read_stream_t *stream) {
+                cluster_message_handler_t *handler = parent->message_handlers[tag];
+                guarantee(handler != nullptr, "Got a message for an unfamiliar tag. "
+                    "Apparently we aren't compatible with the cluster on the other "
+                    "end.");
+
+                /* If you really want to support old cluster versions, the
+                resolved_version should be passed into the on_message() handler. */
+                guarantee(resolved_version == cluster_version_t::CLUSTER);
+                handler->on_message(
+                    &conn_structure,
+                    auto_drainer_t::lock_t(conn_structure.drainers.get()),
+                    stream); // might raise fake_archive_exc_t
+            };
+
+            /* The other server's compressed messages form a single stream, so we
+            must decompress them in the order they arrive in. */
+            message_decompressor_t decompressor;
+
             int messages_handled_since_yield = 0;
             while (true) {
                 message_tag_t tag;
                 archive_result_t res = deserialize_universal(conn, &tag);
                 if (bad(res)) { throw fake_archive_exc_t(); }
 
-                /* Ignore messages tagged with the heartbeat tag. The
-                `keepalive_tcp_conn_stream_t` will have already notified the
-                `heartbeat_manager_t` as soon as the heartbeat arrived. */
-                if (tag != heartbeat_tag) {
-                    cluster_message_handler_t *handler = parent->message_handlers[tag];
-                    guarantee(handler != nullptr, "Got a message for an unfamiliar tag. "
-                        "Apparently we aren't compatible with the cluster on the other "
-                        "end.");
-
-                    /* If you really want to support old cluster versions, the
-                    resolved_version should be passed into the on_message() handler. */
-                    guarantee(resolved_version == cluster_version_t::CLUSTER);
-                    handler->on_message(
-                        &conn_structure,
-                        auto_drainer_t::lock_t(conn_structure.drainers.get()),
-                        conn); // might raise fake_archive_exc_t
+                if (tag == compressed_tag) {
+                    uint64_t compressed_size;
+                    res = deserialize_universal(conn, &compressed_size);
+                    if (bad(res)) { throw fake_archive_exc_t(); }
+                    /* Don't let a corrupted or malicious size make us allocate
+                    arbitrary amounts of memory. */
+                    if (compressed_size > static_cast<uint64_t>(
+                            MAX_COMPRESSED_FRAME_SIZE)) {
+                        throw fake_archive_exc_t();
+                    }
+                    std::vector<char> compressed(compressed_size);
+                    int64_t num_read = force_read(conn, compressed.data(),
+                                                  compressed_size);
+                    if (num_read != static_cast<int64_t>(compressed_size)) {
+                        throw fake_archive_exc_t();
+                    }
+                    std::vector<char> data;
+                    if (!decompressor.decompress(compressed.data(), compressed_size,
+                                                 MAX_COMPRESSED_MESSAGE_SIZE,
+                                                 &data)) {
+                        throw fake_archive_exc_t();
+                    }
+
+                    vector_read_stream_t stream(std::move(data));
+                    res = deserialize_universal(&stream, &tag);
+                    if (bad(res) || tag == compressed_tag || tag == heartbeat_tag) {
+                        throw fake_archive_exc_t();
+                    }
+                    handle_message(tag, &stream);
+                } else if (tag != heartbeat_tag) {
+                    /* We ignore messages tagged with the heartbeat tag. The
+                    `keepalive_tcp_conn_stream_t` will have already notified the
+                    `heartbeat_manager_t` as soon as the heartbeat arrived. */
+                    handle_message(tag, conn);
                 }
 
                 ++messages_handled_since_yield;
@@ -1467,37 +1541,42 @@ void connectivity_cluster_t::send_message(connection_t *connection,
                                      auto_drainer_t::lock_t connection_keepalive,
                                      message_tag_t tag,
                                      cluster_send_message_write_callback_t *callback) {
+    send_messages(connection, std::move(connection_keepalive), tag,
+                  std::vector<cluster_send_message_write_callback_t *>{callback});
+}
+
+void connectivity_cluster_t::send_messages(
+        connection_t *connection,
+        auto_drainer_t::lock_t connection_keepalive,
+        message_tag_t tag,
+        const std::vector<cluster_send_message_write_callback_t *> &callbacks) {
     // We could be on _any_ thread.
 
-    /* If the connection is being closed, just drop the message now. It's not going
+    /* If the connection is being closed, just drop the messages now. They're not going
     to actually get sent anyway. That way we avoid getting in line for the send_mutex. */
     if (connection_keepalive.get_drain_signal()->is_pulsed()) {
         return;
     }
 
-    /* We currently write the message to a vector_stream_t, then
-       serialize that as a string. It's horribly inefficient, of course. */
-    // TODO: If we don't do it this way, we (or the caller) will need
-    // to worry about having the writer run on the connection thread.
-    vector_stream_t buffer;
-    // Reserve some space to reduce overhead (especially for small messages)
-    buffer.reserve(1024);
-    {
-        ASSERT_FINITE_CORO_WAITING;
-        callback->write(&buffer);
-    }
+    /* The messages are serialized into `write_message_t`s, whose buffers then go to
+    the network as they are. */
+    std::vector<write_message_t> messages(callbacks.size());
+    size_t bytes_sent = 0;
+    for (size_t i = 0; i < callbacks.size(); ++i) {
+        {
+            ASSERT_FINITE_CORO_WAITING;
+            callbacks[i]->write(&messages[i]);
+        }
+        size_t message_size = messages[i].size();
+        bytes_sent += message_size;
 
-#ifdef CLUSTER_MESSAGE_DEBUGGING
-    {
-        printf_buffer_t buf;
-        buf.appendf("from ");
-        debug_print(&buf, me);
-        buf.appendf(" to ");
-        debug_print(&buf, dest);
-        buf.appendf("\n");
-        print_hd(buffer.vector().data(), 0, buffer.vector().size());
-    }
+#ifdef ENABLE_MESSAGE_PROFILER
+        std::pair<uint64_t, uint64_t> *stats =
+            &(*message_profiler_counts.get())[callbacks[i]->message_profiler_tag()];
+        stats->first += 1;
+        stats->second += message_size;
 #endif
+    }
 
 #ifndef NDEBUG
     connection_keepalive.assert_is_holding(connection->drainers.get());
@@ -1509,79 +1588,118 @@ void connectivity_cluster_t::send_message(connection_t *connection,
     }
 #endif
 
-    size_t bytes_sent = buffer.vector().size();
-
-#ifdef ENABLE_MESSAGE_PROFILER
-    std::pair<uint64_t, uint64_t> *stats =
-        &(*message_profiler_counts.get())[callback->message_profiler_tag()];
-    stats->first += 1;
-    stats->second += bytes_sent;
-#endif
-
     if (connection->is_loopback()) {
         // We could be on any thread here! Oh no!
-        std::vector<char> buffer_data;
-        buffer.swap(&buffer_data);
         rassert(message_handlers[tag], "No message handler for tag %" PRIu8, tag);
-        message_handlers[tag]->on_local_message(connection, connection_keepalive,
-            std::move(buffer_data));
-    } else {
+        for (const write_message_t &message : messages) {
+            vector_stream_t buffer;
+            buffer.reserve(message.size());
+            int res = send_write_message(&buffer, &message);
+            guarantee(res == 0);
+            std::vector<char> buffer_data;
+            buffer.swap(&buffer_data);
+            message_handlers[tag]->on_local_message(connection, connection_keepalive,
+                std::move(buffer_data));
+        }
+        return;
+    }
+
+    // All cluster versions use a uint8_t tag here.
+    static_assert(std::is_same<message_tag_t, uint8_t>::value,
+                  "We expect to be serializing a uint8_t -- if this has "
+                  "changed, the cluster communication format has changed and "
+                  "you need to ask yourself whether live cluster upgrades work."
+                  );
+
+    {
         on_thread_t threader(connection->conn->home_thread());
 
-        /* Acquire the send-mutex so we don't collide with other things trying
-        to send on the same connection. */
-        {
-            /* The `true` is for eager waiting, which is a significant performance
-            optimization in this case. */
-            mutex_t::acq_t acq(&connection->send_mutex, true);
-
-            /* Write the tag to the network */
-            {
-                // All cluster versions use a uint8_t tag here.
-                write_message_t wm;
-                static_assert(std::is_same<message_tag_t, uint8_t>::value,
-                              "We expect to be serializing a uint8_t -- if this has "
-                              "changed, the cluster communication format has changed and "
-                              "you need to ask yourself whether live cluster upgrades work."
-                              );
-                serialize_universal(&wm, tag);
-                make_buffered_tcp_conn_stream_wrapper_t buffered_conn(connection->conn);
-                int res = send_write_message(&buffered_conn, &wm);
-                if (res == -1) {
-                    /* Close the other half of the connection to make sure that
-                       `connectivity_cluster_t::run_t::handle()` notices that something is
-                       up */
-                    if (connection->conn->is_read_open()) {
-                        connection->conn->shutdown_read();
-                    }
-                    return;
-                }
+        /* Acquire the send-mutex so we don't collide with other things trying to send
+        on the same connection. The `true` is for eager waiting, which is a
+        significant performance optimization in this case. We hold it while we
+        compress the messages as well, so that they are compressed in the same order
+        as they go out on the connection. */
+        mutex_t::acq_t acq(&connection->send_mutex, true);
+
+        /* Each message goes out as its tag followed by its buffers, or as the
+        compressed tag followed by a frame that contains both of them compressed. */
+        message_tag_t compressed_frame_tag = compressed_tag;
+        std::vector<write_message_t> frames(messages.size());
+        std::vector<iovec> bufs;
+        size_t wire_size = 0;
+        for (size_t i = 0; i < messages.size(); ++i) {
+            write_message_t *payload = &messages[i];
+            iovec tag_buf;
+            tag_buf.iov_base = &tag;
+            tag_buf.iov_len = sizeof(tag);
+            const message_compression_t compression = callbacks[i]->get_compression();
+            if (connection->compressor.has()
+                    && (compression == message_compression_t::ALWAYS
+                        || (compression == message_compression_t::DEFAULT
+                            && messages[i].size() >= static_cast<size_t>(
+                                MIN_COMPRESSED_MESSAGE_SIZE)))
+                    && sizeof(tag) + messages[i].size()
+                        <= static_cast<size_t>(MAX_COMPRESSED_MESSAGE_SIZE)) {
+                write_message_t compressed;
+                connection->compressor->compress(tag, &messages[i], &compressed);
+                serialize_universal(&frames[i],
+                                    static_cast<uint64_t>(compressed.size()));
+                frames[i].append(std::move(compressed));
+                payload = &frames[i];
+                tag_buf.iov_base = &compressed_frame_tag;
             }
+            bufs.push_back(tag_buf);
+            wire_size += sizeof(tag) + payload->size();
+            intrusive_list_t<write_buffer_t> *list = payload->unsafe_expose_buffers();
+            for (write_buffer_t *b = list->head(); b != nullptr; b = list->next(b)) {
+                iovec buf;
+                buf.iov_base = b->data;
+                buf.iov_len = b->size;
+                bufs.push_back(buf);
+            }
+        }
 
-            /* Write the message itself to the network */
-            {
-                int64_t res = connection->conn->write_buffered(buffer.vector().data(),
-                                                               buffer.vector().size());
-                if (res == -1) {
-                    if (connection->conn->is_read_open()) {
-                        connection->conn->shutdown_read();
-                    }
-                    return;
-                } else {
-                    guarantee(res == static_cast<int64_t>(buffer.vector().size()));
+        /* Large messages are handed to the kernel straight from the buffers they were
+        serialized into. This also flushes anything that other senders have buffered,
+        so we don't need the flusher afterwards. Small messages are copied into the
+        connection's write buffer instead, so that the flusher can send the messages
+        of concurrent senders together. */
+        const bool vectored = wire_size >= static_cast<size_t>(MIN_VECTORED_WRITE_SIZE);
+        bool failed = false;
+        if (vectored) {
+            failed = connection->conn->write_vectored(bufs.data(), bufs.size()) == -1;
+        } else {
+            for (const iovec &buf : bufs) {
+                if (connection->conn->write_buffered(buf.iov_base, buf.iov_len) == -1) {
+                    failed = true;
+                    break;
                 }
             }
-        } /* Releases the send_mutex */
+        }
+        acq.reset();
+
+        if (failed) {
+            /* Close the other half of the connection to make sure that
+               `connectivity_cluster_t::run_t::handle()` notices that something is
+               up */
+            if (connection->conn->is_read_open()) {
+                connection->conn->shutdown_read();
+            }
+            return;
+        }
 
-        connection->flusher.notify();
-        cond_t dummy_interruptor;
-        connection->flusher.flush(&dummy_interruptor);
+        if (!vectored) {
+            connection->flusher.notify();
+            cond_t dummy_interruptor;
+            connection->flusher.flush(&dummy_interruptor);
+        }
         if (!connection->conn->is_write_open()) {
             if (connection->conn->is_read_open()) {
                 connection->conn->shutdown_read();
             }
             return;
         }
+        bytes_sent = wire_size;
     }
 
     connection->pm_bytes_sent.record(bytes_sent);
@@ -1596,6 +1714,9 @@ cluster_message_handler_t::cluster_message_handler_t(
     rassert(tag != connectivity_cluster_t::heartbeat_tag,
         "Tag %" PRIu8 " is reserved for heartbeat messages.",
         connectivity_cluster_t::heartbeat_tag);
+    rassert(tag != connectivity_cluster_t::compressed_tag,
+        "Tag %" PRIu8 " is reserved for compressed messages.",
+        connectivity_cluster_t::compressed_tag);
     rassert(connectivity_cluster->message_handlers[tag] == nullptr);
     connectivity_cluster->message_handlers[tag] = this;
 }
@@ -19,6 +19,7 @@
 #include "concurrency/pump_coro.hpp"
 #include "perfmon/perfmon.hpp"
 #include "random.hpp"
+#include "rpc/connectivity/compression.hpp"
 #include "rpc/connectivity/peer_id.hpp"
 #include "rpc/connectivity/server_id.hpp"
 #include "utils.hpp"
@@ -56,8 +57,15 @@ class cluster_send_message_write_callback_t {
 public:
     virtual ~cluster_send_message_write_callback_t() { }
     // write() doesn't take a version argument because the version is always
-    // cluster_version_t::CLUSTER for cluster messages.
-    virtual void write(write_stream_t *stream) = 0;
+    // cluster_version_t::CLUSTER for cluster messages. The buffers of `wm` are
+    // handed to the network as they are, so there's no need to copy them.
+    virtual void write(write_message_t *wm) = 0;
+
+    /* Whether to compress the message if compression is enabled for the connection
+    it's sent over. */
+    virtual message_compression_t get_compression() const {
+        return message_compression_t::DEFAULT;
+    }
 
 #ifdef ENABLE_MESSAGE_PROFILER
     /* This should return a string that describes the type of message being sent for
@@ -105,6 +113,11 @@ public:
     /* This tag is reserved exclusively for heartbeat messages. */
     static const message_tag_t heartbeat_tag = 'H';
 
+    /* This tag is reserved for compressed messages. It's followed by the size of the
+    compressed data and the data, which decompresses to the tag and contents of a
+    single message with another tag. */
+    static const message_tag_t compressed_tag = 'Z';
+
     class run_t;
 
     /* `connection_t` represents an open connection to another server. If we lose
@@ -154,7 +167,8 @@ public:
             const peer_id_t &peer_id,
             const server_id_t &server_id,
             keepalive_tcp_conn_stream_t *,
-            const peer_address_t &peer_address) THROWS_NOTHING;
+            const peer_address_t &peer_address,
+            bool compress_outgoing) THROWS_NOTHING;
         ~connection_t() THROWS_NOTHING;
 
         /* NULL for the loopback connection (i.e. our "connection" to ourself) */
@@ -165,9 +179,21 @@ public:
         cross-thread to access the routing table. */
         peer_address_t peer_address;
 
-        /* Unused for our connection to ourself */
+        /* Unused for our connection to ourself. Every message to the peer goes
+        through this one TCP connection, so all senders on all threads take turns
+        here. Spreading the messages over several connections per peer on different
+        threads would need a handshake that attaches the extra connections to an
+        existing `connection_t`, and the directory and semilattice messages would
+        have to stay on a single connection to keep their order. That's a cluster
+        protocol change of its own, and isn't implemented. */
         mutex_t send_mutex;
 
+        /* Compresses the outgoing messages if the other server accepts compressed
+        messages and we are configured to send them. Only used on the connection's
+        thread while holding `send_mutex`, so that the messages are compressed in
+        the order they go out in. Empty if we don't compress. */
+        scoped_ptr_t<message_compressor_t> compressor;
+
         /* Calls `conn->flush_buffer()`. Can be used for making sure that a
         buffered write makes it to the TCP stack. */
         pump_coro_t flusher;
@@ -203,7 +229,8 @@ public:
                   heartbeat_semilattice_metadata_t> > heartbeat_sl_view,
               std::shared_ptr<semilattice_read_view_t<
                   auth_semilattice_metadata_t> > auth_sl_view,
-              tls_ctx_t *tls_ctx)
+              tls_ctx_t *tls_ctx,
+              cluster_compression_t compression)
             THROWS_ONLY(address_in_use_exc_t, tcp_socket_exc_t);
 
         ~run_t();
@@ -298,6 +325,10 @@ public:
 
         tls_ctx_t *tls_ctx;
 
+        /* The compression method for the messages we send, if the other server
+        accepts it. */
+        cluster_compression_t compression;
+
         /* `attempt_table` is a table of all the host:port pairs we're currently
         trying to connect to or have connected to. If we are told to connect to
         an address already in this table, we'll just ignore it. That's important
@@ -365,6 +396,15 @@ public:
                       message_tag_t tag,
                       cluster_send_message_write_callback_t *callback);
 
+    /* Like `send_message()`, but for several messages to the same server. They are
+    written to the connection together, so they only wait for the connection's send
+    mutex and flush it once. */
+    void send_messages(connection_t *connection,
+                       auto_drainer_t::lock_t connection_keepalive,
+                       message_tag_t tag,
+                       const std::vector<cluster_send_message_write_callback_t *>
+                           &callbacks);
+
 private:
     friend class cluster_message_handler_t;
     friend class run_t;
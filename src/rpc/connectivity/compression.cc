@@ -0,0 +1,98 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "rpc/connectivity/compression.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "containers/archive/archive.hpp"
+
+// The compressed data is collected in chunks of this size.
+#define COMPRESSION_SCRATCH_SIZE 4096
+
+message_compressor_t::message_compressor_t() : scratch(COMPRESSION_SCRATCH_SIZE) {
+    memset(&stream, 0, sizeof(stream));
+    // Negative window bits give us raw deflate data without the zlib header and
+    // trailer. TCP already protects the data.
+    int res = deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED,
+                           -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    guarantee(res == Z_OK, "deflateInit2 failed (%d)", res);
+}
+
+message_compressor_t::~message_compressor_t() {
+    deflateEnd(&stream);
+}
+
+void message_compressor_t::compress(uint8_t tag,
+                                    write_message_t *message,
+                                    write_message_t *out) {
+    // Feeds `size` bytes to the stream. With `Z_SYNC_FLUSH` all the input is
+    // compressed once `deflate()` leaves some of the output space unused.
+    auto feed = [&](const void *data, size_t size, int flush) {
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<void *>(data));
+        stream.avail_in = size;
+        do {
+            stream.next_out = reinterpret_cast<Bytef *>(scratch.data());
+            stream.avail_out = scratch.size();
+            int res = deflate(&stream, flush);
+            guarantee(res == Z_OK || res == Z_BUF_ERROR, "deflate failed (%d)", res);
+            out->append(scratch.data(), scratch.size() - stream.avail_out);
+        } while (stream.avail_in > 0 || stream.avail_out == 0);
+    };
+
+    feed(&tag, sizeof(tag), Z_NO_FLUSH);
+    intrusive_list_t<write_buffer_t> *list = message->unsafe_expose_buffers();
+    for (write_buffer_t *b = list->head(); b != nullptr; b = list->next(b)) {
+        feed(b->data, b->size, Z_NO_FLUSH);
+    }
+    feed(nullptr, 0, Z_SYNC_FLUSH);
+}
+
+message_decompressor_t::message_decompressor_t() : initialized(false) {
+    memset(&stream, 0, sizeof(stream));
+}
+
+message_decompressor_t::~message_decompressor_t() {
+    if (initialized) {
+        inflateEnd(&stream);
+    }
+}
+
+bool message_decompressor_t::decompress(const char *data,
+                                        size_t size,
+                                        size_t max_size,
+                                        std::vector<char> *out) {
+    if (!initialized) {
+        int res = inflateInit2(&stream, -MAX_WBITS);
+        guarantee(res == Z_OK, "inflateInit2 failed (%d)", res);
+        initialized = true;
+    }
+
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    stream.avail_in = size;
+    const size_t start = out->size();
+    do {
+        const size_t offset = out->size();
+        // We let the output grow one byte past `max_size`, so that we can tell a
+        // message of exactly `max_size` bytes from a bigger one.
+        if (offset - start > max_size) {
+            return false;
+        }
+        out->resize(offset + std::min<size_t>(
+            std::max<size_t>(2 * size, COMPRESSION_SCRATCH_SIZE),
+            max_size + 1 - (offset - start)));
+        stream.next_out = reinterpret_cast<Bytef *>(out->data() + offset);
+        stream.avail_out = out->size() - offset;
+        int res = inflate(&stream, Z_SYNC_FLUSH);
+        out->resize(out->size() - stream.avail_out);
+        // The sender never ends the stream, so `Z_STREAM_END` means that the data
+        // is corrupted as well.
+        if (res != Z_OK && res != Z_BUF_ERROR) {
+            return false;
+        }
+        if (res == Z_BUF_ERROR && stream.avail_in > 0 && stream.avail_out > 0) {
+            return false;
+        }
+    } while (stream.avail_in > 0 || stream.avail_out == 0);
+    return out->size() - start <= max_size;
+}
@@ -0,0 +1,89 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#ifndef RPC_CONNECTIVITY_COMPRESSION_HPP_
+#define RPC_CONNECTIVITY_COMPRESSION_HPP_
+
+#include <stdint.h>
+#include <zlib.h>
+
+#include <vector>
+
+#include "config/args.hpp"
+#include "containers/scoped.hpp"
+#include "errors.hpp"
+
+class write_message_t;
+
+/* Messages (including their tag) that are bigger than this are never compressed, so
+that the receiver can reject compressed messages that would decompress to more than
+this without trusting the sender. */
+#define MAX_COMPRESSED_MESSAGE_SIZE (256 * MEGABYTE)
+
+/* The biggest compressed frame that a message of at most
+`MAX_COMPRESSED_MESSAGE_SIZE` bytes can turn into. Deflate adds at most a few bytes
+for every 16 KB of incompressible data, so this leaves plenty of room. */
+#define MAX_COMPRESSED_FRAME_SIZE \
+    (MAX_COMPRESSED_MESSAGE_SIZE + MAX_COMPRESSED_MESSAGE_SIZE / 64)
+
+/* The compression method that a server uses for the messages it sends to the other
+servers, set with `--cluster-compression`. The values are the bit positions in the
+set of methods that the servers exchange during the handshake, so they must not
+change. */
+enum class cluster_compression_t : uint8_t {
+    none = 0,
+    zlib = 1
+};
+
+/* Whether a message should be compressed when it's sent over a connection that has
+compression enabled. By default only messages of at least
+`MIN_COMPRESSED_MESSAGE_SIZE` bytes are compressed, since compressing small messages
+saves little bandwidth but adds latency. */
+enum class message_compression_t {
+    DEFAULT,
+    ALWAYS,
+    NEVER
+};
+
+/* Each direction of a compressed cluster connection is a single zlib stream that
+lasts as long as the connection. Every message is flushed with `Z_SYNC_FLUSH`, so
+that the receiver can decompress it as soon as it arrives, but the compressor keeps
+its window between messages. Later messages can therefore refer back to earlier
+ones, which is what makes compressing the many similar small messages we send
+worthwhile.
+
+Because of that, the messages must be decompressed in the same order as they were
+compressed. Neither class is thread-safe. */
+class message_compressor_t {
+public:
+    message_compressor_t();
+    ~message_compressor_t();
+
+    /* Compresses `tag` followed by the contents of `message` and appends the
+    compressed data to `out`. */
+    void compress(uint8_t tag, write_message_t *message, write_message_t *out);
+
+private:
+    z_stream stream;
+    scoped_array_t<char> scratch;
+
+    DISABLE_COPYING(message_compressor_t);
+};
+
+class message_decompressor_t {
+public:
+    message_decompressor_t();
+    ~message_decompressor_t();
+
+    /* Decompresses the data of one call to `message_compressor_t::compress()` and
+    appends it to `out`. Returns `false` if the data is corrupted, or if it would
+    decompress to more than `max_size` bytes. */
+    MUST_USE bool decompress(const char *data, size_t size, size_t max_size,
+                             std::vector<char> *out);
+
+private:
+    bool initialized;
+    z_stream stream;
+
+    DISABLE_COPYING(message_decompressor_t);
+};
+
+#endif  // RPC_CONNECTIVITY_COMPRESSION_HPP_
@@ -45,15 +45,10 @@ public:
             uint64_t _timestamp, const key_t &_key, optional<value_t> &&_value) :
         timestamp(_timestamp), key(_key), value(std::move(_value)) { }
 
-    void write(write_stream_t *s) {
-        write_message_t wm;
-        serialize<cluster_version_t::CLUSTER>(&wm, timestamp);
-        serialize<cluster_version_t::CLUSTER>(&wm, key);
-        serialize<cluster_version_t::CLUSTER>(&wm, value);
-        int res = send_write_message(s, &wm);
-        if (res) {
-            throw fake_archive_exc_t();
-        }
+    void write(write_message_t *wm) {
+        serialize<cluster_version_t::CLUSTER>(wm, timestamp);
+        serialize<cluster_version_t::CLUSTER>(wm, key);
+        serialize<cluster_version_t::CLUSTER>(wm, value);
     }
 
 #ifdef ENABLE_MESSAGE_PROFILER
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 
+#include <algorithm>
 #include <functional>
 
 #include "debug.hpp"
@@ -74,30 +75,26 @@ public:
         subwriter(_subwriter) { }
     virtual ~raw_mailbox_writer_t() { }
 
-    void write(write_stream_t *stream) {
-        write_message_t wm;
+    void write(write_message_t *wm) {
+        write_message_t body;
         // Right now, we serialize this length/thread/mailbox information the same
         // way irrespective of version. (Serialization methods for primitive types
         // all behave the same way anyway -- this is just for performance, avoiding
         // unnecessary branching on cluster_version.)  See read_mailbox_header for
         // the deserialization.
-        serialize_universal(&wm, dest_thread);
-        serialize_universal(&wm, dest_mailbox_id);
-        uint64_t prefix_length = static_cast<uint64_t>(wm.size());
+        serialize_universal(&body, dest_thread);
+        serialize_universal(&body, dest_mailbox_id);
+        uint64_t prefix_length = static_cast<uint64_t>(body.size());
 
-        subwriter->write(cluster_version_t::CLUSTER, &wm);
+        subwriter->write(cluster_version_t::CLUSTER, &body);
 
         // Prepend the message length.
-        // TODO: It would be more efficient if we could make this part of `msg`.
-        //  e.g. with a `prepend()` method on write_message_t.
-        write_message_t length_msg;
-        serialize_universal(&length_msg,
-                            static_cast<uint64_t>(wm.size()) - prefix_length);
-
-        int res = send_write_message(stream, &length_msg);
-        if (res) { throw fake_archive_exc_t(); }
-        res = send_write_message(stream, &wm);
-        if (res) { throw fake_archive_exc_t(); }
+        serialize_universal(wm, static_cast<uint64_t>(body.size()) - prefix_length);
+        wm->append(std::move(body));
+    }
+
+    message_compression_t get_compression() const {
+        return subwriter->get_compression();
     }
 
 #ifdef ENABLE_MESSAGE_PROFILER
@@ -129,6 +126,48 @@ void send_write(mailbox_manager_t *src, raw_mailbox_t::address_t dest,
         src->get_message_tag(), &writer);
 }
 
+// `send_write_multi()` writes at most this many messages for one peer at once, so that
+// fanning out a large message to many mailboxes doesn't keep all the copies in memory
+// at the same time.
+static const size_t MAX_MESSAGES_PER_SEND = 32;
+
+void send_write_multi(mailbox_manager_t *src,
+                      const std::vector<raw_mailbox_t::address_t> &dests,
+                      const std::vector<mailbox_write_callback_t *> &callbacks) {
+    guarantee(src);
+    guarantee(dests.size() == callbacks.size());
+    std::map<peer_id_t, std::vector<size_t> > indices_by_peer;
+    for (size_t i = 0; i < dests.size(); ++i) {
+        guarantee(!dests[i].is_nil());
+        indices_by_peer[dests[i].peer].push_back(i);
+    }
+    for (const auto &pair : indices_by_peer) {
+        for (size_t begin = 0; begin < pair.second.size();
+             begin += MAX_MESSAGES_PER_SEND) {
+            const size_t end = std::min(pair.second.size(),
+                                        begin + MAX_MESSAGES_PER_SEND);
+            new_semaphore_in_line_t acq(src->semaphores.get(), 1);
+            acq.acquisition_signal()->wait();
+            connectivity_cluster_t::connection_t *connection;
+            auto_drainer_t::lock_t connection_keepalive;
+            if (!(connection = src->get_connectivity_cluster()->get_connection(
+                    pair.first, &connection_keepalive))) {
+                break;
+            }
+            std::vector<raw_mailbox_writer_t> writers;
+            writers.reserve(end - begin);
+            std::vector<cluster_send_message_write_callback_t *> writer_ptrs;
+            for (size_t j = begin; j < end; ++j) {
+                const size_t i = pair.second[j];
+                writers.emplace_back(dests[i].thread, dests[i].mailbox_id, callbacks[i]);
+                writer_ptrs.push_back(&writers.back());
+            }
+            src->get_connectivity_cluster()->send_messages(connection,
+                connection_keepalive, src->get_message_tag(), writer_ptrs);
+        }
+    }
+}
+
 static const int MAX_OUTSTANDING_MAILBOX_WRITES_PER_THREAD = 4;
 
 mailbox_manager_t::mailbox_manager_t(connectivity_cluster_t *_connectivity_cluster,
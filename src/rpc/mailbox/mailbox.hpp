@@ -24,6 +24,10 @@ public:
     virtual ~mailbox_write_callback_t() { }
     virtual void write(cluster_version_t cluster_version,
                        write_message_t *wm) = 0;
+    /* See `cluster_send_message_write_callback_t::get_compression()`. */
+    virtual message_compression_t get_compression() const {
+        return message_compression_t::DEFAULT;
+    }
 #ifdef ENABLE_MESSAGE_PROFILER
     virtual const char *message_profiler_tag() const = 0;
 #endif
@@ -54,6 +58,9 @@ private:
     friend class mailbox_manager_t;
     friend class raw_mailbox_writer_t;
     friend void send_write(mailbox_manager_t *, address_t, mailbox_write_callback_t *);
+    friend void send_write_multi(mailbox_manager_t *,
+                                 const std::vector<address_t> &,
+                                 const std::vector<mailbox_write_callback_t *> &);
 
     mailbox_manager_t *manager;
 
@@ -99,6 +106,9 @@ public:
 
     private:
         friend void send_write(mailbox_manager_t *, raw_mailbox_t::address_t, mailbox_write_callback_t *callback);
+        friend void send_write_multi(mailbox_manager_t *,
+                                     const std::vector<raw_mailbox_t::address_t> &,
+                                     const std::vector<mailbox_write_callback_t *> &);
         friend struct raw_mailbox_t;
         friend class mailbox_manager_t;
 
@@ -133,6 +143,14 @@ void send_write(mailbox_manager_t *src,
                 raw_mailbox_t::address_t dest,
                 mailbox_write_callback_t *callback);
 
+/* `send_write_multi()` sends a message to each of `dests`, where `callbacks[i]` writes
+the message for `dests[i]`. The messages to mailboxes on the same peer are sent
+together, a bounded number at a time. It has the same caveats as `send_write()`. */
+
+void send_write_multi(mailbox_manager_t *src,
+                      const std::vector<raw_mailbox_t::address_t> &dests,
+                      const std::vector<mailbox_write_callback_t *> &callbacks);
+
 /* `mailbox_manager_t` is a `cluster_message_handler_t` that takes care
 of actually routing messages to mailboxes. */
 
@@ -144,6 +162,9 @@ public:
 private:
     friend struct raw_mailbox_t;
     friend void send_write(mailbox_manager_t *, raw_mailbox_t::address_t, mailbox_write_callback_t *callback);
+    friend void send_write_multi(mailbox_manager_t *,
+                                 const std::vector<raw_mailbox_t::address_t> &,
+                                 const std::vector<mailbox_write_callback_t *> &);
 
     struct mailbox_table_t {
         mailbox_table_t();
@@ -4,6 +4,7 @@
 
 #include <functional>
 #include <tuple>
+#include <vector>
 
 #include "containers/archive/versioned.hpp"
 #include "containers/archive/tuple.hpp"
@@ -30,6 +31,13 @@ public:
 private:
     template <class... Args2>
     friend void send(mailbox_manager_t *, mailbox_addr_t<Args2...>, const Args2 &... args);
+    template <class... Args2>
+    friend void send(mailbox_manager_t *, message_compression_t,
+                     mailbox_addr_t<Args2...>, const Args2 &... args);
+    template <class... Args2>
+    friend void send_multi(mailbox_manager_t *,
+                           const std::vector<mailbox_addr_t<Args2...> > &,
+                           const std::vector<mailbox_write_callback_t *> &);
 
     raw_mailbox_t::address_t addr;
 };
@@ -84,12 +92,20 @@ template <class... Args>
 class mailbox_write_impl : public mailbox_write_callback_t {
 private:
     const std::tuple<Args...> args;
+    const message_compression_t compression;
 public:
-    explicit mailbox_write_impl(const Args &... _args) : args(_args...) { }
+    explicit mailbox_write_impl(const Args &... _args)
+        : args(_args...), compression(message_compression_t::DEFAULT) { }
+    explicit mailbox_write_impl(message_compression_t _compression,
+                                const Args &... _args)
+        : args(_args...), compression(_compression) { }
     void write(DEBUG_VAR cluster_version_t cluster_version, write_message_t *wm) {
         rassert(cluster_version == cluster_version_t::CLUSTER);
         serialize<cluster_version_t::CLUSTER>(wm, args);
     }
+    message_compression_t get_compression() const {
+        return compression;
+    }
 #ifdef ENABLE_MESSAGE_PROFILER
     const char *message_profiler_tag() const {
         static const std::string tag =
@@ -105,4 +121,29 @@ void send(mailbox_manager_t *src, mailbox_addr_t<Args...> dest, const Args &...
     send_write(src, dest.addr, &writer);
 }
 
+/* Like `send()`, but overrides whether the message is compressed if compression is
+enabled for the connection. */
+template <class... Args>
+void send(mailbox_manager_t *src, message_compression_t compression,
+          mailbox_addr_t<Args...> dest, const Args &... args) {
+    mailbox_write_impl<Args...> writer(compression, args...);
+    send_write(src, dest.addr, &writer);
+}
+
+/* Sends a message to each of `dests`, where `writers[i]` must serialize the arguments
+for `dests[i]` the way `mailbox_write_impl<Args...>` would. This is for senders that
+serialize the part of the message that all of the destinations have in common only
+once. */
+template <class... Args>
+void send_multi(mailbox_manager_t *src,
+                const std::vector<mailbox_addr_t<Args...> > &dests,
+                const std::vector<mailbox_write_callback_t *> &writers) {
+    std::vector<raw_mailbox_t::address_t> raw_dests;
+    raw_dests.reserve(dests.size());
+    for (const mailbox_addr_t<Args...> &dest : dests) {
+        raw_dests.push_back(dest.addr);
+    }
+    send_write_multi(src, raw_dests, writers);
+}
+
 #endif // RPC_MAILBOX_TYPED_HPP_
@@ -0,0 +1,275 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "serializer/block_arena.hpp"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include <atomic>
+
+#include "arch/runtime/runtime.hpp"
+#include "arch/spinlock.hpp"
+#include "config/args.hpp"
+#include "errors.hpp"
+#include "math.hpp"
+#include "memory_utils.hpp"
+
+#if defined(_WIN32) || defined(VALGRIND)
+// Without `mmap` there are no huge pages to be had.  Under Valgrind we want every
+// block to be a separate allocation, so that Valgrind can keep track of it.
+#define BLOCK_ARENA_USE_MALLOC
+#endif
+
+#ifdef BLOCK_ARENA_USE_MALLOC
+
+void *block_arena_alloc(size_t size) {
+    return raw_malloc_aligned(size, DEVICE_BLOCK_SIZE);
+}
+
+void block_arena_free(void *ptr) {
+    raw_free_aligned(ptr);
+}
+
+block_arena_usage_t get_block_arena_usage() {
+    return block_arena_usage_t{0, 0};
+}
+
+#else  // BLOCK_ARENA_USE_MALLOC
+
+namespace {
+
+class block_arena_t;
+
+// Every chunk starts with a `chunk_t`, which takes up the first DEVICE_BLOCK_SIZE
+// bytes.  The blocks come after it.
+struct chunk_t {
+    block_arena_t *arena;
+    // The neighbors in the arena's list of partially used chunks for `block_size`.
+    chunk_t *prev;
+    chunk_t *next;
+    size_t block_size;
+    size_t num_blocks;
+    size_t num_used;
+    // Blocks at or after this index have never been handed out.  We carve new blocks
+    // off the end instead of building a free list up front, so that a new chunk
+    // doesn't get touched all at once.
+    size_t num_carved;
+    // The freed blocks, linked through their first bytes.
+    void *free_blocks;
+};
+
+static_assert(sizeof(chunk_t) <= DEVICE_BLOCK_SIZE, "chunk_t doesn't fit");
+
+const size_t MAX_BLOCK_SIZE = 64 * KILOBYTE;
+const size_t NUM_SIZE_CLASSES = MAX_BLOCK_SIZE / DEVICE_BLOCK_SIZE + 1;
+
+// Explicit huge pages only exist if the administrator reserved some.  We stop asking
+// for them once the kernel has refused.
+std::atomic<bool> try_explicit_huge_pages(true);
+
+void *map_chunk() {
+#ifdef MAP_HUGETLB
+    if (try_explicit_huge_pages.load(std::memory_order_relaxed)) {
+        void *ptr = mmap(nullptr, BLOCK_ARENA_CHUNK_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED) {
+            guarantee(divides(BLOCK_ARENA_CHUNK_SIZE, reinterpret_cast<uintptr_t>(ptr)));
+            return ptr;
+        }
+        try_explicit_huge_pages.store(false, std::memory_order_relaxed);
+    }
+#endif
+
+    // `mmap` only aligns to the page size, so we map twice the chunk size and unmap
+    // the parts before and after an aligned chunk.
+    void *ptr = mmap(nullptr, 2 * BLOCK_ARENA_CHUNK_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        crash_oom();
+    }
+    char *const start = static_cast<char *>(ptr);
+    char *const chunk = start + (BLOCK_ARENA_CHUNK_SIZE
+        - reinterpret_cast<uintptr_t>(start) % BLOCK_ARENA_CHUNK_SIZE)
+        % BLOCK_ARENA_CHUNK_SIZE;
+    if (chunk != start) {
+        guarantee_err(munmap(start, chunk - start) == 0, "munmap failed");
+    }
+    char *const end = chunk + BLOCK_ARENA_CHUNK_SIZE;
+    if (end != start + 2 * BLOCK_ARENA_CHUNK_SIZE) {
+        guarantee_err(munmap(end, start + 2 * BLOCK_ARENA_CHUNK_SIZE - end) == 0,
+                      "munmap failed");
+    }
+
+#ifdef MADV_HUGEPAGE
+    // Ask for transparent huge pages.  This fails harmlessly if they are disabled.
+    madvise(chunk, BLOCK_ARENA_CHUNK_SIZE, MADV_HUGEPAGE);
+#endif
+    return chunk;
+}
+
+void unmap_chunk(chunk_t *chunk) {
+    guarantee_err(munmap(chunk, BLOCK_ARENA_CHUNK_SIZE) == 0, "munmap failed");
+}
+
+class block_arena_t {
+public:
+    block_arena_t() : spare_chunk_(nullptr), num_chunks_(0), bytes_in_use_(0) {
+        for (size_t i = 0; i < NUM_SIZE_CLASSES; ++i) {
+            partial_chunks_[i] = nullptr;
+        }
+    }
+
+    void *alloc(size_t size) {
+        guarantee(size != 0 && size <= MAX_BLOCK_SIZE
+                  && divides(DEVICE_BLOCK_SIZE, size), "Bad block size %zu", size);
+        spinlock_acq_t acq(&lock_);
+
+        chunk_t *chunk = partial_chunks_[size / DEVICE_BLOCK_SIZE];
+        if (chunk == nullptr) {
+            chunk = get_empty_chunk(size);
+            add_partial(chunk);
+        }
+
+        void *ret;
+        if (chunk->free_blocks != nullptr) {
+            ret = chunk->free_blocks;
+            chunk->free_blocks = *static_cast<void **>(ret);
+        } else {
+            rassert(chunk->num_carved < chunk->num_blocks);
+            ret = reinterpret_cast<char *>(chunk) + DEVICE_BLOCK_SIZE
+                + chunk->num_carved * size;
+            ++chunk->num_carved;
+        }
+        ++chunk->num_used;
+        if (chunk->num_used == chunk->num_blocks) {
+            remove_partial(chunk);
+        }
+        bytes_in_use_ += size;
+        return ret;
+    }
+
+    void free(chunk_t *chunk, void *ptr) {
+        spinlock_acq_t acq(&lock_);
+        rassert(chunk->num_used > 0);
+
+        *static_cast<void **>(ptr) = chunk->free_blocks;
+        chunk->free_blocks = ptr;
+        if (chunk->num_used == chunk->num_blocks) {
+            add_partial(chunk);
+        }
+        --chunk->num_used;
+        bytes_in_use_ -= chunk->block_size;
+
+        if (chunk->num_used == 0) {
+            remove_partial(chunk);
+            // We keep one empty chunk around, so that a thread that allocates and
+            // frees a block over and over doesn't map and unmap a chunk each time.
+            if (spare_chunk_ == nullptr) {
+                spare_chunk_ = chunk;
+            } else {
+                unmap_chunk(chunk);
+                --num_chunks_;
+            }
+        }
+    }
+
+    void add_usage(block_arena_usage_t *usage) {
+        spinlock_acq_t acq(&lock_);
+        usage->bytes_reserved += num_chunks_ * BLOCK_ARENA_CHUNK_SIZE;
+        usage->bytes_in_use += bytes_in_use_;
+    }
+
+private:
+    chunk_t *get_empty_chunk(size_t block_size) {
+        chunk_t *chunk;
+        if (spare_chunk_ != nullptr) {
+            chunk = spare_chunk_;
+            spare_chunk_ = nullptr;
+        } else {
+            chunk = static_cast<chunk_t *>(map_chunk());
+            ++num_chunks_;
+        }
+        chunk->arena = this;
+        chunk->prev = nullptr;
+        chunk->next = nullptr;
+        chunk->block_size = block_size;
+        chunk->num_blocks = (BLOCK_ARENA_CHUNK_SIZE - DEVICE_BLOCK_SIZE) / block_size;
+        chunk->num_used = 0;
+        chunk->num_carved = 0;
+        chunk->free_blocks = nullptr;
+        return chunk;
+    }
+
+    void add_partial(chunk_t *chunk) {
+        chunk_t **head = &partial_chunks_[chunk->block_size / DEVICE_BLOCK_SIZE];
+        chunk->prev = nullptr;
+        chunk->next = *head;
+        if (*head != nullptr) {
+            (*head)->prev = chunk;
+        }
+        *head = chunk;
+    }
+
+    void remove_partial(chunk_t *chunk) {
+        chunk_t **head = &partial_chunks_[chunk->block_size / DEVICE_BLOCK_SIZE];
+        if (chunk->prev != nullptr) {
+            chunk->prev->next = chunk->next;
+        } else {
+            rassert(*head == chunk);
+            *head = chunk->next;
+        }
+        if (chunk->next != nullptr) {
+            chunk->next->prev = chunk->prev;
+        }
+        chunk->prev = nullptr;
+        chunk->next = nullptr;
+    }
+
+    // Blocks freed on other threads come back to this arena, so we still need a lock.
+    // It's almost never contended.
+    spinlock_t lock_;
+    // The chunks for each size class (in units of DEVICE_BLOCK_SIZE) that have free
+    // blocks.  Full chunks aren't in any list.
+    chunk_t *partial_chunks_[NUM_SIZE_CLASSES];
+    chunk_t *spare_chunk_;
+    uint64_t num_chunks_;
+    uint64_t bytes_in_use_;
+
+    DISABLE_COPYING(block_arena_t);
+};
+
+// Index 0 is for threads outside the thread pool, index `i + 1` for thread `i`.  The
+// arenas are never destroyed, because blocks might get freed during shutdown.
+block_arena_t *get_arenas() {
+    static block_arena_t *const arenas = new block_arena_t[MAX_THREADS + 1];
+    return arenas;
+}
+
+}  // namespace
+
+void *block_arena_alloc(size_t size) {
+    const int threadnum = get_thread_id().threadnum;
+    rassert(threadnum >= -1 && threadnum < MAX_THREADS);
+    return get_arenas()[threadnum + 1].alloc(size);
+}
+
+void block_arena_free(void *ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    chunk_t *chunk = reinterpret_cast<chunk_t *>(
+        reinterpret_cast<uintptr_t>(ptr) & ~static_cast<uintptr_t>(
+            BLOCK_ARENA_CHUNK_SIZE - 1));
+    chunk->arena->free(chunk, ptr);
+}
+
+block_arena_usage_t get_block_arena_usage() {
+    block_arena_usage_t usage{0, 0};
+    block_arena_t *arenas = get_arenas();
+    for (int i = 0; i < MAX_THREADS + 1; ++i) {
+        arenas[i].add_usage(&usage);
+    }
+    return usage;
+}
+
+#endif  // BLOCK_ARENA_USE_MALLOC
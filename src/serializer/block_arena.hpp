@@ -0,0 +1,42 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_BLOCK_ARENA_HPP_
+#define SERIALIZER_BLOCK_ARENA_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "containers/scoped.hpp"
+
+/* The block arena allocates the DEVICE_BLOCK_SIZE-aligned buffers behind `buf_ptr_t`.
+It doesn't make one heap allocation per block.  Instead it carves the blocks out of
+BLOCK_ARENA_CHUNK_SIZE chunks that it maps directly, backed by huge pages when
+possible.  Each chunk holds blocks of a single size, so a block takes up exactly its
+aligned size.  Millions of cached blocks then don't fragment the heap or thrash the
+TLB.  A chunk is returned to the OS once all of its blocks have been freed.
+
+There is one arena per thread, so threads don't contend with each other when they
+allocate blocks.  A block may be freed on any thread, and it goes back to the arena
+that it came from. */
+
+// `size` must be a multiple of DEVICE_BLOCK_SIZE.  The result is aligned to
+// DEVICE_BLOCK_SIZE.
+void *block_arena_alloc(size_t size);
+// Accepts `nullptr`, like `free()`.
+void block_arena_free(void *ptr);
+
+struct block_arena_usage_t {
+    // The memory mapped for chunks, including the unused parts of partially used
+    // chunks.
+    uint64_t bytes_reserved;
+    // The memory taken up by blocks that haven't been freed.
+    uint64_t bytes_in_use;
+};
+
+// Returns the usage summed over the arenas of all threads.
+block_arena_usage_t get_block_arena_usage();
+
+template <class T>
+TEMPLATE_ALIAS(scoped_block_arena_ptr_t,
+               scoped_alloc_t<T, block_arena_alloc, block_arena_free>);
+
+#endif  // SERIALIZER_BLOCK_ARENA_HPP_
@@ -9,7 +9,7 @@ buf_ptr_t buf_ptr_t::alloc_uninitialized(block_size_t size) {
     const size_t count = compute_aligned_block_size(size);
     buf_ptr_t ret;
     ret.block_size_ = size;
-    ret.ser_buffer_ = scoped_device_block_aligned_ptr_t<ser_buffer_t>(count);
+    ret.ser_buffer_ = scoped_block_arena_ptr_t<ser_buffer_t>(count);
     return ret;
 }
 
@@ -20,11 +20,11 @@ buf_ptr_t buf_ptr_t::alloc_zeroed(block_size_t size) {
     return ret;
 }
 
-scoped_device_block_aligned_ptr_t<ser_buffer_t>
+scoped_block_arena_ptr_t<ser_buffer_t>
 help_allocate_copy(const ser_buffer_t *copyee, size_t amount_to_copy,
                    size_t reserved_size) {
     rassert(amount_to_copy <= reserved_size);
-    auto buf = scoped_device_block_aligned_ptr_t<ser_buffer_t>(reserved_size);
+    auto buf = scoped_block_arena_ptr_t<ser_buffer_t>(reserved_size);
     memcpy(buf.get(), copyee, amount_to_copy);
     memset(reinterpret_cast<char *>(buf.get()) + amount_to_copy,
            0,
@@ -35,19 +35,47 @@ help_allocate_copy(const ser_buffer_t *copyee, size_t amount_to_copy,
 buf_ptr_t buf_ptr_t::alloc_copy(const buf_ptr_t &copyee) {
     guarantee(copyee.has());
     return buf_ptr_t(copyee.block_size(),
-                   help_allocate_copy(copyee.ser_buffer_.get(),
+                   help_allocate_copy(copyee.ser_buffer(),
                                       copyee.block_size().ser_value(),
                                       copyee.aligned_block_size()));
 }
 
+buf_ptr_t buf_ptr_t::share() {
+    guarantee(has());
+    if (!shared_.has()) {
+        shared_ = make_counted<shared_buffer_t>(std::move(ser_buffer_));
+    }
+    buf_ptr_t ret;
+    ret.block_size_ = block_size_;
+    ret.shared_ = shared_;
+    return ret;
+}
+
+void buf_ptr_t::make_unique() {
+    guarantee(has());
+    if (!shared_.has()) {
+        return;
+    }
+    if (shared_.unique()) {
+        // The other owners are gone, so we can take the buffer back without copying.
+        ser_buffer_ = std::move(shared_->buffer);
+    } else {
+        ser_buffer_ = help_allocate_copy(shared_->buffer.get(),
+                                         block_size_.ser_value(),
+                                         aligned_block_size());
+    }
+    shared_.reset();
+}
+
 void buf_ptr_t::resize_fill_zero(block_size_t new_size) {
     guarantee(new_size.ser_value() != 0);
-    guarantee(ser_buffer_.has());
+    guarantee(has());
 
     uint16_t old_reserved = compute_aligned_block_size(block_size_);
     uint16_t new_reserved = compute_aligned_block_size(new_size);
 
     if (old_reserved == new_reserved) {
+        make_unique();
         if (new_size.ser_value() < block_size_.ser_value()) {
             // Set the newly unused part of the block to zero.
             memset(reinterpret_cast<char *>(ser_buffer_.get()) + new_size.ser_value(),
@@ -55,20 +83,23 @@ void buf_ptr_t::resize_fill_zero(block_size_t new_size) {
                    block_size_.ser_value() - new_size.ser_value());
         }
     } else {
-        // We actually need to reallocate.
-        scoped_device_block_aligned_ptr_t<ser_buffer_t> buf
-            = help_allocate_copy(ser_buffer_.get(),
+        // We actually need to reallocate.  This also unshares the buffer, so we
+        // don't need to copy it twice.
+        scoped_block_arena_ptr_t<ser_buffer_t> buf
+            = help_allocate_copy(ser_buffer(),
                                  std::min(block_size_.ser_value(),
                                           new_size.ser_value()),
                                  new_reserved);
 
         ser_buffer_ = std::move(buf);
+        shared_.reset();
     }
     block_size_ = new_size;
 }
 
 void buf_ptr_t::fill_padding_zero() const {
     guarantee(has());
+    rassert(!is_shared());
     char *p = reinterpret_cast<char *>(ser_buffer());
     uint16_t ser_block_size = block_size().ser_value();
     uint16_t aligned = aligned_block_size();
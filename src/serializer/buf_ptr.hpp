@@ -3,13 +3,24 @@
 
 #include <utility>
 
+#include "containers/counted.hpp"
 #include "containers/scoped.hpp"
 #include "errors.hpp"
 #include "math.hpp"
+#include "serializer/block_arena.hpp"
 #include "serializer/types.hpp"
 
-// Memory-aligned bufs.  This type also keeps the unused part of the buf (up to the
-// DEVICE_BLOCK_SIZE multiple) zeroed out.
+// Memory-aligned bufs, allocated from the block arena (see block_arena.hpp).  This
+// type also keeps the unused part of the buf (up to the DEVICE_BLOCK_SIZE multiple)
+// zeroed out.
+//
+// Several buf_ptr_t's can share one buffer (see `share()`), which lets the cache
+// hand the same block contents to a snapshot and to the current version of a page
+// without copying them.  A shared buffer must not be modified -- call
+// `make_unique()` first, which copies the buffer only if it's actually shared.  The
+// refcount gets allocated on the first `share()`, so bufs that are never shared
+// (the common case) don't pay for it.  Sharing is single-threaded: a shared
+// buf_ptr_t must stay on the thread it was shared on.
 
 // Note: This wastes 4 bytes of space on a 64-bit system.  (Arguably, it wastes more
 // than that given that block sizes could be 16 bits and pointers are really 48
@@ -19,12 +30,13 @@ public:
     buf_ptr_t() : block_size_(block_size_t::undefined()) { }
     buf_ptr_t(buf_ptr_t &&movee)
         : block_size_(movee.block_size_),
-          ser_buffer_(std::move(movee.ser_buffer_)) {
+          ser_buffer_(std::move(movee.ser_buffer_)),
+          shared_(std::move(movee.shared_)) {
         movee.block_size_ = block_size_t::undefined();
     }
 
     buf_ptr_t(block_size_t size,
-              scoped_device_block_aligned_ptr_t<ser_buffer_t> _ser_buffer)
+              scoped_block_arena_ptr_t<ser_buffer_t> _ser_buffer)
         : block_size_(size),
           ser_buffer_(std::move(_ser_buffer)) {
         guarantee(block_size_.ser_value() != 0);
@@ -35,12 +47,14 @@ public:
         buf_ptr_t tmp(std::move(movee));
         std::swap(block_size_, tmp.block_size_);
         std::swap(ser_buffer_, tmp.ser_buffer_);
+        std::swap(shared_, tmp.shared_);
         return *this;
     }
 
     void reset() {
         block_size_ = block_size_t::undefined();
         ser_buffer_.reset();
+        shared_.reset();
     }
 
     // Allocates a block, all of whose bytes are zeroed.
@@ -51,14 +65,26 @@ public:
 
     static buf_ptr_t alloc_copy(const buf_ptr_t &copyee);
 
+    // Returns a buf_ptr_t that shares this buf's buffer, without copying it.
+    buf_ptr_t share();
+
+    // Returns true if some other buf_ptr_t shares the buffer.
+    bool is_shared() const {
+        return shared_.has() && !shared_.unique();
+    }
+
+    // Copies the buffer if it's shared, so that it can be modified.
+    void make_unique();
+
     block_size_t block_size() const {
-        guarantee(ser_buffer_.has());
+        guarantee(has());
         return block_size_;
     }
 
+    // The buffer must not be modified through this pointer while `is_shared()`.
     ser_buffer_t *ser_buffer() const {
-        guarantee(ser_buffer_.has());
-        return ser_buffer_.get();
+        guarantee(has());
+        return shared_.has() ? shared_->buffer.get() : ser_buffer_.get();
     }
 
     void *cache_data() const {
@@ -69,7 +95,7 @@ public:
     // DEVICE_BLOCK_SIZE-aligned.  (Returns the value of block_size().ser_value()
     // rounded up to the next multiple of DEVICE_BLOCK_SIZE.)
     uint16_t aligned_block_size() const {
-        guarantee(ser_buffer_.has());
+        guarantee(has());
         return buf_ptr_t::compute_aligned_block_size(block_size_);
     }
 
@@ -79,19 +105,22 @@ public:
         return ceil_aligned(block_size.ser_value(), DEVICE_BLOCK_SIZE);
     }
 
+    // Copies the buffer first if it's shared.
     void release(block_size_t *block_size_out,
-                 scoped_device_block_aligned_ptr_t<ser_buffer_t> *ser_buffer_out) {
+                 scoped_block_arena_ptr_t<ser_buffer_t> *ser_buffer_out) {
         buf_ptr_t tmp(std::move(*this));
+        tmp.make_unique();
         *block_size_out = tmp.block_size_;
         *ser_buffer_out = std::move(tmp.ser_buffer_);
     }
 
     bool has() const {
-        return ser_buffer_.has();
+        return ser_buffer_.has() || shared_.has();
     }
 
     // Increases or decreases the block size of the pointee, reallocating if
-    // necessary, filling unused space with zeros.
+    // necessary, filling unused space with zeros.  Like `make_unique()`, this leaves
+    // the buf with a buffer of its own.
     void resize_fill_zero(block_size_t new_size);
 
     // Fills the padding space with zeroes.  Generally speaking, you want to write
@@ -106,14 +135,25 @@ public:
 
 
 private:
-    // Valid only when ser_buffer_.has() is true.  Contains the size of the buffer as
-    // exposed to outside users of the cache.  The buffer is actually allocated to
-    // size `compute_aligned_block_size(block_size_)` (the next multiple of
+    class shared_buffer_t : public single_threaded_countable_t<shared_buffer_t> {
+    public:
+        explicit shared_buffer_t(scoped_block_arena_ptr_t<ser_buffer_t> &&b)
+            : buffer(std::move(b)) { }
+        scoped_block_arena_ptr_t<ser_buffer_t> buffer;
+    };
+
+    // Valid only when has() is true.  Contains the size of the buffer as exposed to
+    // outside users of the cache.  The buffer is actually allocated to size
+    // `compute_aligned_block_size(block_size_)` (the next multiple of
     // DEVICE_BLOCK_SIZE), and the extra space is left zero-padded, so that we can
     // more efficiently write the buffer to disk.
     block_size_t block_size_;
-    // The buffer, or empty if this buf_ptr_t is empty.
-    scoped_device_block_aligned_ptr_t<ser_buffer_t> ser_buffer_;
+    // The buffer, if it has never been shared.  At most one of `ser_buffer_` and
+    // `shared_` is non-empty, and both are empty if this buf_ptr_t is empty.
+    scoped_block_arena_ptr_t<ser_buffer_t> ser_buffer_;
+    // The buffer, once it has been shared.  It may or may not still be shared with
+    // another buf_ptr_t.
+    counted_t<shared_buffer_t> shared_;
 
     DISABLE_COPYING(buf_ptr_t);
 };
@@ -0,0 +1,126 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "serializer/log/compression.hpp"
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "errors.hpp"
+#include "serializer/buf_ptr.hpp"
+
+block_compressor_t::block_compressor_t(block_compression_t _compression)
+    : compression(_compression),
+      deflate_initialized(false),
+      inflate_initialized(false) {
+    memset(&deflate_stream, 0, sizeof(deflate_stream));
+    memset(&inflate_stream, 0, sizeof(inflate_stream));
+}
+
+block_compressor_t::~block_compressor_t() {
+    if (deflate_initialized) {
+        deflateEnd(&deflate_stream);
+    }
+    if (inflate_initialized) {
+        inflateEnd(&inflate_stream);
+    }
+}
+
+buf_ptr_t block_compressor_t::compress(const ser_buffer_t *buf,
+                                       block_size_t block_size) {
+    if (compression == block_compression_t::none) {
+        return buf_ptr_t();
+    }
+    guarantee(compression == block_compression_t::zlib);
+
+    // The stored block has to take up at least one device block less than the
+    // uncompressed one, or compressing it is pointless.
+    const uint16_t aligned_size = buf_ptr_t::compute_aligned_block_size(block_size);
+    if (aligned_size <= DEVICE_BLOCK_SIZE) {
+        return buf_ptr_t();
+    }
+    const size_t max_payload_size =
+        aligned_size - DEVICE_BLOCK_SIZE - sizeof(ls_buf_data_t) - 1;
+
+    if (!scratch.has() || scratch.size() < max_payload_size) {
+        scratch.reset();
+        scratch.init(max_payload_size);
+    }
+
+    if (!deflate_initialized) {
+        // Negative window bits give us raw deflate data without the zlib header and
+        // trailer. We have our own checksums.
+        int res = deflateInit2(&deflate_stream, Z_BEST_SPEED, Z_DEFLATED,
+                               -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+        guarantee(res == Z_OK, "deflateInit2 failed (%d)", res);
+        deflate_initialized = true;
+    } else {
+        int res = deflateReset(&deflate_stream);
+        guarantee(res == Z_OK, "deflateReset failed (%d)", res);
+    }
+
+    deflate_stream.next_in = reinterpret_cast<Bytef *>(
+        const_cast<char *>(buf->cache_data));
+    deflate_stream.avail_in = block_size.value();
+    deflate_stream.next_out = reinterpret_cast<Bytef *>(scratch.data());
+    deflate_stream.avail_out = max_payload_size;
+
+    int res = deflate(&deflate_stream, Z_FINISH);
+    if (res != Z_STREAM_END) {
+        // The compressed data didn't fit.
+        guarantee(res == Z_OK || res == Z_BUF_ERROR, "deflate failed (%d)", res);
+        return buf_ptr_t();
+    }
+
+    const size_t payload_size = max_payload_size - deflate_stream.avail_out;
+    const block_size_t stored_size = block_size_t::unsafe_make(
+        sizeof(ls_buf_data_t) + 1 + payload_size);
+    buf_ptr_t ret = buf_ptr_t::alloc_uninitialized(stored_size);
+    ret.ser_buffer()->ser_header = buf->ser_header;
+    ret.ser_buffer()->cache_data[0] = static_cast<char>(compression);
+    memcpy(ret.ser_buffer()->cache_data + 1, scratch.data(), payload_size);
+    ret.fill_padding_zero();
+    return ret;
+}
+
+buf_ptr_t block_compressor_t::decompress(const ser_buffer_t *stored,
+                                         block_size_t stored_size,
+                                         block_size_t block_size) {
+    const block_id_t block_id = stored->ser_header.block_id;
+    if (stored_size.ser_value() <= sizeof(ls_buf_data_t)) {
+        crash("Compressed block %" PRIi64 " is too short (%" PRIu16 " bytes). The "
+              "database file is corrupted.", block_id, stored_size.ser_value());
+    }
+    const uint8_t method = stored->cache_data[0];
+    if (method != static_cast<uint8_t>(block_compression_t::zlib)) {
+        crash("Block %" PRIi64 " was compressed with an unknown method (%" PRIu8 "). "
+              "The database file is either corrupted or was written by a newer "
+              "version of RethinkDB.", block_id, method);
+    }
+
+    if (!inflate_initialized) {
+        int res = inflateInit2(&inflate_stream, -MAX_WBITS);
+        guarantee(res == Z_OK, "inflateInit2 failed (%d)", res);
+        inflate_initialized = true;
+    } else {
+        int res = inflateReset(&inflate_stream);
+        guarantee(res == Z_OK, "inflateReset failed (%d)", res);
+    }
+
+    buf_ptr_t ret = buf_ptr_t::alloc_uninitialized(block_size);
+    ret.ser_buffer()->ser_header = stored->ser_header;
+
+    inflate_stream.next_in = reinterpret_cast<Bytef *>(
+        const_cast<char *>(stored->cache_data + 1));
+    inflate_stream.avail_in = stored_size.value() - 1;
+    inflate_stream.next_out = reinterpret_cast<Bytef *>(ret.cache_data());
+    inflate_stream.avail_out = block_size.value();
+
+    int res = inflate(&inflate_stream, Z_FINISH);
+    if (res != Z_STREAM_END || inflate_stream.avail_out != 0) {
+        crash("Could not decompress block %" PRIi64 " (zlib returned %d, %" PRIu32
+              " bytes missing). The database file is corrupted.",
+              block_id, res, static_cast<uint32_t>(inflate_stream.avail_out));
+    }
+
+    ret.fill_padding_zero();
+    return ret;
+}
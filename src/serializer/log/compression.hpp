@@ -0,0 +1,54 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_LOG_COMPRESSION_HPP_
+#define SERIALIZER_LOG_COMPRESSION_HPP_
+
+#include <zlib.h>
+
+#include "containers/scoped.hpp"
+#include "serializer/log/config.hpp"
+#include "serializer/types.hpp"
+
+class buf_ptr_t;
+
+/* A compressed block is stored as the usual `ls_buf_data_t` header (so the GC can
+still find the block id), followed by a one-byte `block_compression_t` tag and the
+compressed contents of the block's `cache_data`.
+
+The LBA records both the block's size and its stored size. A block is compressed if
+and only if the two differ. We only store a block compressed if that saves at least
+one `DEVICE_BLOCK_SIZE` on disk.
+
+A `block_compressor_t` keeps the compression streams around between blocks, because
+setting them up is expensive. It is not thread-safe; the log serializer uses one on
+its home thread. */
+class block_compressor_t {
+public:
+    explicit block_compressor_t(block_compression_t compression);
+    ~block_compressor_t();
+
+    /* Compresses the block in `buf`. Returns an empty `buf_ptr_t` if compression is
+    disabled or wouldn't make the block take up less space on disk. Otherwise the
+    returned buf holds the stored block, and its `block_size()` is the stored size. */
+    buf_ptr_t compress(const ser_buffer_t *buf, block_size_t block_size);
+
+    /* Decompresses a block that `compress()` produced, using whichever method the
+    block was compressed with. Crashes if the block can't be decompressed. */
+    buf_ptr_t decompress(const ser_buffer_t *stored,
+                         block_size_t stored_size,
+                         block_size_t block_size);
+
+private:
+    const block_compression_t compression;
+
+    bool deflate_initialized;
+    z_stream deflate_stream;
+    bool inflate_initialized;
+    z_stream inflate_stream;
+
+    // Compressed data ends up here before we know how large it is.
+    scoped_array_t<char> scratch;
+
+    DISABLE_COPYING(block_compressor_t);
+};
+
+#endif  // SERIALIZER_LOG_COMPRESSION_HPP_
@@ -9,16 +9,53 @@
 #include "serializer/types.hpp"
 #include "rpc/serialize_macros.hpp"
 
+/* How the serializer compresses blocks that it writes. Compressed blocks can always be
+read back, whatever this is set to. */
+enum class block_compression_t {
+    none = 0,
+    // Raw deflate at the fastest compression level.
+    zlib = 1
+};
+
+/* How the data block GC picks the extents that it collects. */
+enum class gc_policy_t {
+    // Collect the extent with the most garbage first. Blocks that the GC moves go to
+    // the same extents as new writes.
+    greedy,
+    // Weigh the garbage in each extent against the age of its data, as in the
+    // cost-benefit policy of the LFS paper, so that extents with cold data get
+    // collected at a lower garbage ratio than extents with hot data. Blocks that the
+    // GC moves go to their own extents, so that they don't get mixed with hot data.
+    cost_benefit
+};
+
 /* Configuration for the serializer that can change from run to run */
 
 struct log_serializer_dynamic_config_t {
     log_serializer_dynamic_config_t() {
         read_ahead = true;
+        checksum_blocks = true;
+        compression = block_compression_t::none;
+        gc_policy = gc_policy_t::greedy;
     }
 
     /* Enable reading more data than requested to let the cache warmup more quickly
        esp. on rotational drives */
     bool read_ahead;
+
+    /* Store a CRC-32C of each newly written block in the LBA, and run a background
+       scrubber that verifies them.  Checksums that are already on disk are verified
+       on every read regardless of this setting.  Turned off by
+       `--no-block-checksums`.  The in-memory index keeps a 4-byte checksum slot for
+       every block either way. */
+    bool checksum_blocks;
+
+    /* Compress blocks before writing them.  Files that contain compressed blocks
+       can't be opened by versions of RethinkDB that don't support compression. */
+    block_compression_t compression;
+
+    /* Set by `--gc-policy`. */
+    gc_policy_t gc_policy;
 };
 
 /* This is equivalent to log_serializer_static_config_t below, but is an on-disk
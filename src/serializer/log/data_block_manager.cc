@@ -10,9 +10,12 @@
 #include "arch/runtime/coroutines.hpp"
 #include "concurrency/mutex.hpp"
 #include "concurrency/new_mutex.hpp"
+#include "crc32c.hpp"
 #include "errors.hpp"
+#include "logger.hpp"
 #include "perfmon/perfmon.hpp"
 #include "serializer/buf_ptr.hpp"
+#include "serializer/log/compression.hpp"
 #include "serializer/log/log_serializer.hpp"
 #include "stl_utils.hpp"
 
@@ -51,6 +54,10 @@ const size_t GC_YOUNG_EXTENT_MAX_SIZE = 50;
 // What's the definition of a "young" extent in microseconds?
 const kiloticks_t GC_YOUNG_EXTENT_TIMELIMIT = { 50000 };
 
+// How often the cost-benefit GC policy reorders the GC priority queue to account for
+// the extents getting older, in microseconds.
+const kiloticks_t GC_SCORE_REFRESH_INTERVAL = { 10 * 1000 * 1000 };
+
 
 // Identifies an extent, the time we started writing to the
 // extent, whether it's the extent we're currently writing to, and
@@ -72,6 +79,7 @@ public:
         : parent(_parent),
           extent_ref(parent->extent_manager->gen_extent()),
           timestamp(get_kiloticks()),
+          data_timestamp(timestamp),
           was_written(false),
           state(state_active),
           garbage_bytes_stat(_parent->static_config->extent_size()),
@@ -87,6 +95,7 @@ public:
         : parent(_parent),
           extent_ref(parent->extent_manager->reserve_extent(_offset)),
           timestamp(get_kiloticks()),
+          data_timestamp(timestamp),
           was_written(false),
           state(state_reconstructing),
           garbage_bytes_stat(_parent->static_config->extent_size()),
@@ -312,6 +321,23 @@ public:
         block_infos.shrink_to_fit();
     }
 
+    // The priority of the extent in the parent's `gc_pq`.  With the cost-benefit
+    // policy, this is the ratio of what we gain to what it costs to collect the
+    // extent, `(1 - u) * age / (1 + u)` where `u` is the fraction of the extent that's
+    // live, and `age` is how long ago its youngest data was written.
+    double gc_score() const {
+        if (parent->gc_policy == gc_policy_t::greedy) {
+            return garbage_bytes();
+        }
+        const double live_ratio = 1.0 - static_cast<double>(garbage_bytes())
+            / parent->static_config->extent_size();
+        // We add a second so that the score of brand new extents still depends on
+        // their garbage.
+        const double age_secs = 1.0 + std::max<int64_t>(
+            0, parent->gc_score_reference_time.micros - data_timestamp.micros) / 1e6;
+        return (1.0 - live_ratio) * age_secs / (1.0 + live_ratio);
+    }
+
 private:
     // Private because we cannot guarantee that our stats remain consistent if somebody
     // gets a non-const iterator.
@@ -360,6 +386,11 @@ public:
     // When we started writing to the extent (this time).
     const kiloticks_t timestamp;
 
+    // When the youngest data in the extent was written by a client of the serializer.
+    // For blocks that the GC moved here, that's the data timestamp of the extent they
+    // came from.
+    kiloticks_t data_timestamp;
+
     // The PQ entry pointing to us.
     priority_queue_t<gc_entry_t *, gc_entry_less_t>::entry_t *our_pq_entry;
 
@@ -401,7 +432,9 @@ data_block_manager_t::data_block_manager_t(
         log_serializer_stats_t *_stats)
     : stats(_stats), shutdown_callback(nullptr), state(state_unstarted),
       gc_enabled(true), static_config(_static_config), extent_manager(em),
-      serializer(_serializer),
+      serializer(_serializer), active_extent(nullptr), cold_active_extent(nullptr),
+      gc_policy(_serializer->dynamic_config.gc_policy),
+      gc_score_reference_time(get_kiloticks()),
       gc_index_write_pumper(std::bind(
           &data_block_manager_t::flush_gc_index_writes, this, std::placeholders::_1)),
       /* The capacity of the gc_index_write_semaphore will be scaled
@@ -586,6 +619,17 @@ void read_ahead_offset_and_size(int64_t off_in,
     *size_out = end_offset - offset;
 }
 
+uint32_t compute_block_checksum(const ser_buffer_t *buf, block_size_t block_size) {
+    const uint32_t crc = crc32c(buf, block_size.ser_value());
+    return crc == 0 ? 1 : crc;
+}
+
+bool block_checksum_matches(uint32_t expected,
+                            const ser_buffer_t *buf,
+                            block_size_t block_size) {
+    return expected == 0 || expected == compute_block_checksum(buf, block_size);
+}
+
 class dbm_read_ahead_t {
 public:
     static std::vector<uint32_t> get_boundaries(data_block_manager_t *parent,
@@ -665,14 +709,38 @@ public:
 
                 const block_size_t block_size
                     = block_size_t::unsafe_make(info.ser_block_size);
-                buf_ptr_t buf = buf_ptr_t::alloc_uninitialized(block_size);
-                memcpy(buf.ser_buffer(), current_buf, info.ser_block_size);
-                buf.fill_padding_zero();
-                guarantee(info.ser_block_size <= *(lower_it + 1) - *lower_it);
+                const block_size_t stored_block_size
+                    = block_size_t::unsafe_make(info.stored_block_size);
+                guarantee(info.stored_block_size <= *(lower_it + 1) - *lower_it);
+                const ser_buffer_t *stored_buf
+                    = reinterpret_cast<const ser_buffer_t *>(current_buf);
+
+                // Nobody asked for this block, so we don't crash if it's corrupted.
+                // If somebody reads it later, `block_read` will catch the problem.
+                if (!block_checksum_matches(info.checksum, stored_buf,
+                                            stored_block_size)) {
+                    ++stats->pm_serializer_checksum_failures;
+                    logERR("Checksum mismatch for block %" PRIi64 " at offset %"
+                           PRIi64 " during read-ahead. The database file might be "
+                           "corrupted.", block_id, current_offset);
+                    continue;
+                }
+
+                buf_ptr_t buf;
+                if (stored_block_size != block_size) {
+                    buf = parent->serializer->compressor->decompress(
+                        stored_buf, stored_block_size, block_size);
+                } else {
+                    buf = buf_ptr_t::alloc_uninitialized(block_size);
+                    memcpy(buf.ser_buffer(), current_buf, info.ser_block_size);
+                    buf.fill_padding_zero();
+                }
 
                 counted_t<block_token_t> token
                     = parent->serializer->generate_block_token(current_offset,
-                                                               block_size);
+                                                               block_size,
+                                                               stored_block_size,
+                                                               info.checksum);
 
                 parent->serializer->offer_buf_to_read_ahead_callbacks(
                         block_id,
@@ -708,48 +776,66 @@ buf_ptr_t data_block_manager_t::read(int64_t off_in, block_size_t block_size,
         ret.fill_padding_zero();
         return ret;
     } else {
-        if (divides(DEVICE_BLOCK_SIZE, off_in)) {
-            buf_ptr_t ret = buf_ptr_t::alloc_uninitialized(block_size);
-            co_read(dbfile, off_in, ret.aligned_block_size(),
-                    ret.ser_buffer(), io_account);
-            stats->bytes_read(ret.aligned_block_size());
-            // Blocks are written DEVICE_BLOCK_SIZE-aligned -- so the block on disk
-            // should have been written with zero padding.
-            ret.assert_padding_zero();
-            return ret;
-        } else {
-            int64_t floor_off_in = floor_aligned(off_in, DEVICE_BLOCK_SIZE);
-            int64_t ceil_off_end = ceil_aligned(off_in + block_size.ser_value(),
-                                                DEVICE_BLOCK_SIZE);
-            scoped_device_block_aligned_ptr_t<char> buf(ceil_off_end - floor_off_in);
-            co_read(dbfile, floor_off_in, ceil_off_end - floor_off_in,
-                    buf.get(), io_account);
-
-            buf_ptr_t ret = buf_ptr_t::alloc_uninitialized(block_size);
-            memcpy(ret.ser_buffer(), buf.get() + (off_in - floor_off_in),
-                   block_size.ser_value());
-            stats->bytes_read(ret.aligned_block_size());
-            // We have to fill the padding to zero, in this case.
-            ret.fill_padding_zero();
-            return ret;
-        }
+        return read_without_read_ahead(off_in, block_size, io_account);
+    }
+}
+
+buf_ptr_t data_block_manager_t::read_without_read_ahead(int64_t off_in,
+                                                        block_size_t block_size,
+                                                        file_account_t *io_account) {
+    guarantee(state == state_ready);
+    if (divides(DEVICE_BLOCK_SIZE, off_in)) {
+        buf_ptr_t ret = buf_ptr_t::alloc_uninitialized(block_size);
+        co_read(dbfile, off_in, ret.aligned_block_size(),
+                ret.ser_buffer(), io_account);
+        stats->bytes_read(ret.aligned_block_size());
+        // Blocks are written DEVICE_BLOCK_SIZE-aligned -- so the block on disk
+        // should have been written with zero padding.
+        ret.assert_padding_zero();
+        return ret;
+    } else {
+        int64_t floor_off_in = floor_aligned(off_in, DEVICE_BLOCK_SIZE);
+        int64_t ceil_off_end = ceil_aligned(off_in + block_size.ser_value(),
+                                            DEVICE_BLOCK_SIZE);
+        scoped_device_block_aligned_ptr_t<char> buf(ceil_off_end - floor_off_in);
+        co_read(dbfile, floor_off_in, ceil_off_end - floor_off_in,
+                buf.get(), io_account);
+
+        buf_ptr_t ret = buf_ptr_t::alloc_uninitialized(block_size);
+        memcpy(ret.ser_buffer(), buf.get() + (off_in - floor_off_in),
+               block_size.ser_value());
+        stats->bytes_read(ret.aligned_block_size());
+        // We have to fill the padding to zero, in this case.
+        ret.fill_padding_zero();
+        return ret;
     }
 }
 
 std::vector<counted_t<block_token_t> >
 data_block_manager_t::many_writes(const buf_write_info_t *writes,
                                   size_t writes_count,
+                                  const std::vector<block_size_t> &block_sizes,
+                                  const gc_entry_t *gc_source,
                                   file_account_t *io_account,
                                   iocallback_t *cb) {
-    // These tokens are grouped by extent.  You can do a contiguous write in each
-    // extent.
-    std::vector<std::vector<counted_t<block_token_t> > > token_groups
-        = gimme_some_new_offsets(writes, writes_count);
-
     for (size_t i = 0; i < writes_count; ++i) {
         writes[i].buf->ser_header.block_id = writes[i].block_id;
     }
 
+    // The checksum covers the block id header, so we compute it after setting that.
+    std::vector<uint32_t> checksums(writes_count, 0);
+    if (serializer->dynamic_config.checksum_blocks) {
+        for (size_t i = 0; i < writes_count; ++i) {
+            checksums[i] = compute_block_checksum(writes[i].buf, writes[i].block_size);
+        }
+    }
+
+    // These tokens are grouped by extent.  You can do a contiguous write in each
+    // extent.
+    std::vector<std::vector<counted_t<block_token_t> > > token_groups
+        = gimme_some_new_offsets(writes, writes_count, block_sizes, checksums,
+                                 gc_source);
+
     struct intermediate_cb_t : public iocallback_t {
         virtual void on_io_complete() {
             --ops_remaining;
@@ -775,7 +861,7 @@ data_block_manager_t::many_writes(const buf_write_info_t *writes,
 
         const int64_t front_offset = token_groups[i].front()->offset();
         const int64_t back_offset = token_groups[i].back()->offset()
-            + gc_entry_t::aligned_value(token_groups[i].back()->block_size());
+            + gc_entry_t::aligned_value(token_groups[i].back()->stored_block_size());
 
         guarantee(divides(DEVICE_BLOCK_SIZE, front_offset));
 
@@ -788,7 +874,7 @@ data_block_manager_t::many_writes(const buf_write_info_t *writes,
 
         for (size_t j = 0; j < token_groups[i].size(); ++j) {
             const int64_t j_offset = token_groups[i][j]->offset();
-            const block_size_t j_block_size = token_groups[i][j]->block_size();
+            const block_size_t j_block_size = token_groups[i][j]->stored_block_size();
             guarantee(j_offset == last_written_offset);
             const size_t j_aligned_size = gc_entry_t::aligned_value(j_block_size);
             total_aligned_size += j_aligned_size;
@@ -810,6 +896,11 @@ data_block_manager_t::many_writes(const buf_write_info_t *writes,
                              std::move(iovecs), io_account, intermediate_cb);
 
         stats->bytes_written(total_aligned_size);
+        if (gc_source != nullptr) {
+            stats->pm_serializer_gc_written_bytes_total += total_aligned_size;
+        } else {
+            stats->pm_serializer_client_written_bytes_total += total_aligned_size;
+        }
     }
 
     // Call on_io_complete for degenerate case (we added 1 to ops_remaining
@@ -1076,6 +1167,7 @@ void data_block_manager_t::gc_one_extent(gc_state_t *gc_state) {
         ++stats->pm_serializer_data_extents_gced;
 
         /* grab the entry */
+        maybe_refresh_gc_scores();
         guarantee (!gc_pq.empty());
         guarantee(gc_state->current_entry == nullptr);
         gc_state->current_entry = gc_pq.pop();
@@ -1248,23 +1340,59 @@ void data_block_manager_t::write_gcs(
         // Step 1: Write buffers to disk and assemble index operations
         ASSERT_NO_CORO_WAITING;
 
+        // The GC moves the blocks exactly as they are stored on disk, so compressed
+        // blocks stay compressed.
         std::vector<buf_write_info_t> the_writes;
         the_writes.reserve(writes.size());
+        std::vector<block_size_t> block_sizes;
+        block_sizes.reserve(writes.size());
+        std::vector<uint32_t> old_checksums;
+        old_checksums.reserve(writes.size());
         for (size_t i = 0; i < writes.size(); ++i) {
+            const block_id_t block_id = writes[i].buf->ser_header.block_id;
+            block_size_t block_size = block_size_t::undefined();
+            uint32_t old_checksum;
+            get_gc_block_info(block_id, writes[i].old_offset,
+                              &block_size, &old_checksum);
+            block_sizes.push_back(block_size);
+            old_checksums.push_back(old_checksum);
+
             old_block_tokens.push_back(
                     serializer->generate_block_token(writes[i].old_offset,
-                                                     writes[i].block_size));
+                                                     block_size,
+                                                     writes[i].block_size,
+                                                     old_checksum));
 
             the_writes.push_back(buf_write_info_t(writes[i].buf,
                                                   writes[i].block_size,
-                                                  writes[i].buf->ser_header.block_id));
+                                                  block_id));
         }
 
         new_block_tokens = many_writes(the_writes.data(), the_writes.size(),
+                                       block_sizes,
+                                       gc_state->current_entry,
                                        choose_gc_io_account(),
                                        &block_write_cond);
 
         guarantee(new_block_tokens.size() == writes.size());
+
+        // We move the data unchanged, so the new copy keeps the old checksum.  If
+        // the data got corrupted on disk, we must not compute a new checksum that
+        // would hide the corruption from later reads.
+        for (size_t i = 0; i < writes.size(); ++i) {
+            if (old_checksums[i] == 0) {
+                continue;
+            }
+            if (!block_checksum_matches(old_checksums[i], writes[i].buf,
+                                        writes[i].block_size)) {
+                ++stats->pm_serializer_checksum_failures;
+                logERR("Checksum mismatch for block %" PRIi64 " at offset %" PRIi64
+                       " during garbage collection. The database file might be "
+                       "corrupted.",
+                       writes[i].buf->ser_header.block_id, writes[i].old_offset);
+            }
+            new_block_tokens[i]->checksum_ = old_checksums[i];
+        }
     }
 
     // Step 2: Wait on all writes to finish
@@ -1293,6 +1421,25 @@ void data_block_manager_t::write_gcs(
     // `write_gcs` steps continue in `flush_gc_index_writes`
 }
 
+void data_block_manager_t::get_gc_block_info(block_id_t block_id, int64_t old_offset,
+                                             block_size_t *block_size_out,
+                                             uint32_t *checksum_out) {
+    const index_block_info_t info = serializer->lba_index->get_block_info(block_id);
+    if (info.offset.has_value() && info.offset.get_value() == old_offset) {
+        *block_size_out = block_size_t::unsafe_make(info.ser_block_size);
+        *checksum_out = info.checksum;
+        return;
+    }
+
+    // The block is no longer in the index, so it must be kept alive by a token.
+    auto it = serializer->offset_tokens.find(old_offset);
+    guarantee(it != serializer->offset_tokens.end(),
+              "Block %" PRIi64 " at offset %" PRIi64 " is neither in the index nor "
+              "referenced by a block token.", block_id, old_offset);
+    *block_size_out = it->second->block_size();
+    *checksum_out = it->second->checksum();
+}
+
 void data_block_manager_t::flush_gc_index_writes(signal_t *) {
     // Acquire half the tickets from the `index_write_semaphore`.
     // This means that if all tickets in the semaphore are currently
@@ -1414,6 +1561,12 @@ void data_block_manager_t::actually_shutdown() {
         active_extent = nullptr;
     }
 
+    if (cold_active_extent != nullptr) {
+        UNUSED int64_t extent = cold_active_extent->extent_ref.release();
+        delete cold_active_extent;
+        cold_active_extent = nullptr;
+    }
+
     while (gc_entry_t *entry = young_extent_queue.head()) {
         young_extent_queue.remove(entry);
         UNUSED int64_t extent = entry->extent_ref.release();
@@ -1433,45 +1586,62 @@ void data_block_manager_t::actually_shutdown() {
 
 std::vector<std::vector<counted_t<block_token_t> > >
 data_block_manager_t::gimme_some_new_offsets(const buf_write_info_t *writes,
-                                             size_t writes_count) {
+                                             size_t writes_count,
+                                             const std::vector<block_size_t> &block_sizes,
+                                             const std::vector<uint32_t> &checksums,
+                                             const gc_entry_t *gc_source) {
     ASSERT_NO_CORO_WAITING;
+    guarantee(block_sizes.size() == writes_count);
+    guarantee(checksums.size() == writes_count);
+
+    // Blocks that the GC moves have survived at least one round of GC, so they are
+    // likely to stay live for a while. The cost-benefit policy keeps them apart from
+    // new writes, so that extents tend to contain either mostly hot or mostly cold
+    // data.
+    gc_entry_t **const active = gc_source != nullptr
+        && gc_policy == gc_policy_t::cost_benefit
+        ? &cold_active_extent
+        : &active_extent;
+    const kiloticks_t data_timestamp = gc_source != nullptr
+        ? gc_source->data_timestamp
+        : get_kiloticks();
 
     // Start a new extent if necessary.
-    if (active_extent == nullptr) {
-        active_extent = new gc_entry_t(this);
+    if (*active == nullptr) {
+        *active = new gc_entry_t(this);
         ++stats->pm_serializer_data_extents_allocated;
     }
 
 
-    guarantee(active_extent->state == gc_entry_t::state_active);
+    guarantee((*active)->state == gc_entry_t::state_active);
 
     std::vector<std::vector<counted_t<block_token_t>>> ret;
 
     std::vector<counted_t<block_token_t> > tokens;
     for (size_t i = 0; i < writes_count; ++i) {
-        block_size_t block_size = writes[i].block_size;
+        block_size_t stored_block_size = writes[i].block_size;
         uint32_t relative_offset = valgrind_undefined<uint32_t>(UINT32_MAX);
         unsigned int block_index = valgrind_undefined<unsigned int>(UINT_MAX);
-        if (!active_extent->new_offset(block_size,
-                                       &relative_offset, &block_index)) {
-            // Move the active_extent gc_entry_t to the young extent queue (if it's
+        if (!(*active)->new_offset(stored_block_size,
+                                   &relative_offset, &block_index)) {
+            // Move the active extent's gc_entry_t to the young extent queue (if it's
             // not already empty), and make a new gc_entry_t.
-            if (active_extent->num_live_blocks() == 0) {
-                gc_entry_t *old_active_extent = active_extent;
-                active_extent = new gc_entry_t(this);
+            if ((*active)->num_live_blocks() == 0) {
+                gc_entry_t *old_active_extent = *active;
+                *active = new gc_entry_t(this);
                 destroy_entry(old_active_extent);
             } else {
-                active_extent->state = gc_entry_t::state_young;
-                active_extent->shrink_to_fit();
-                young_extent_queue.push_back(active_extent);
+                (*active)->state = gc_entry_t::state_young;
+                (*active)->shrink_to_fit();
+                young_extent_queue.push_back(*active);
                 mark_unyoung_entries();
-                active_extent = new gc_entry_t(this);
+                *active = new gc_entry_t(this);
             }
 
             ++stats->pm_serializer_data_extents_allocated;
-            const bool succeeded = active_extent->new_offset(block_size,
-                                                             &relative_offset,
-                                                             &block_index);
+            const bool succeeded = (*active)->new_offset(stored_block_size,
+                                                         &relative_offset,
+                                                         &block_index);
             guarantee(succeeded);
 
             // Push the current group of tokens, if it's nonempty, onto the return
@@ -1482,11 +1652,16 @@ data_block_manager_t::gimme_some_new_offsets(const buf_write_info_t *writes,
             }
         }
 
-        const int64_t offset = active_extent->extent_ref.offset() + relative_offset;
-        active_extent->was_written = true;
-        active_extent->mark_live_tokenwise(block_index);
+        const int64_t offset = (*active)->extent_ref.offset() + relative_offset;
+        (*active)->was_written = true;
+        (*active)->mark_live_tokenwise(block_index);
+        if ((*active)->data_timestamp.micros < data_timestamp.micros) {
+            (*active)->data_timestamp = data_timestamp;
+        }
 
-        tokens.push_back(serializer->generate_block_token(offset, block_size));
+        tokens.push_back(serializer->generate_block_token(offset, block_sizes[i],
+                                                          stored_block_size,
+                                                          checksums[i]));
     }
 
     if (!tokens.empty()) {
@@ -1532,6 +1707,23 @@ void data_block_manager_t::remove_last_unyoung_entry() {
     gc_stats.old_garbage_block_bytes += entry->garbage_bytes();
 }
 
+void data_block_manager_t::maybe_refresh_gc_scores() {
+    ASSERT_NO_CORO_WAITING;
+    if (gc_policy != gc_policy_t::cost_benefit) {
+        return;
+    }
+    // The scores of all extents grow as their data gets older, but not all at the
+    // same rate, so we can't keep `gc_pq` ordered at all times.  Instead we measure
+    // the age of all extents at the same reference time, and only reorder the queue
+    // once in a while.
+    const kiloticks_t now = get_kiloticks();
+    if (now.micros - gc_score_reference_time.micros
+        >= GC_SCORE_REFRESH_INTERVAL.micros) {
+        gc_score_reference_time = now;
+        gc_pq.rebuild();
+    }
+}
+
 /* functions for gc structures */
 
 // Answers the following question: We're in the middle of gc'ing, and
@@ -1554,7 +1746,7 @@ bool data_block_manager_t::do_we_want_to_start_gcing() const {
 }
 
 bool gc_entry_less_t::operator()(const gc_entry_t *x, const gc_entry_t *y) {
-    return x->garbage_bytes() < y->garbage_bytes();
+    return x->gc_score() < y->gc_score();
 }
 
 /****************
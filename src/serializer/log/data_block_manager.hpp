@@ -15,6 +15,7 @@
 #include "serializer/log/config.hpp"
 #include "serializer/log/extent_manager.hpp"
 #include "serializer/types.hpp"
+#include "time.hpp"
 
 class buf_ptr_t;
 class log_serializer_t;
@@ -23,6 +24,15 @@ class gc_entry_t;
 
 struct dbm_metablock_mixin_t;
 
+/* Computes the checksum that we store in the LBA for a block.  Never returns 0,
+because that value marks blocks that don't have a checksum. */
+uint32_t compute_block_checksum(const ser_buffer_t *buf, block_size_t block_size);
+
+/* Returns true if `expected` is 0, or if it matches the block's checksum. */
+bool block_checksum_matches(uint32_t expected,
+                            const ser_buffer_t *buf,
+                            block_size_t block_size);
+
 struct gc_entry_less_t {
     bool operator() (const gc_entry_t *x, const gc_entry_t *y);
 };
@@ -51,6 +61,11 @@ public:
     buf_ptr_t read(int64_t off_in, block_size_t block_size,
                    file_account_t *io_account);
 
+    /* Like `read()`, but never reads ahead or offers blocks to the read-ahead
+    callbacks. */
+    buf_ptr_t read_without_read_ahead(int64_t off_in, block_size_t block_size,
+                                      file_account_t *io_account);
+
     /* exposed gc api */
     /* mark a buffer as garbage */
     void mark_garbage(int64_t offset, extent_transaction_t *txn);  // Takes a real int64_t.
@@ -82,14 +97,25 @@ public:
     // ratio of garbage to blocks in the system
     double garbage_ratio() const;
 
+    // The `writes` describe the blocks as they are stored on disk (possibly
+    // compressed). `block_sizes` holds the uncompressed size of each block.
+    // `gc_source` is the extent that the GC moves the blocks from, or null for writes
+    // from the serializer's clients.
     std::vector<counted_t<block_token_t> >
     many_writes(const buf_write_info_t *writes,
                 size_t writes_count,
+                const std::vector<block_size_t> &block_sizes,
+                const gc_entry_t *gc_source,
                 file_account_t *io_account,
                 iocallback_t *cb);
 
+    // `block_sizes` and `checksums` hold one value for each of the `writes_count`
+    // writes. `gc_source` is as in `many_writes()`.
     std::vector<std::vector<counted_t<block_token_t> > >
-    gimme_some_new_offsets(const buf_write_info_t *writes, size_t writes_count);
+    gimme_some_new_offsets(const buf_write_info_t *writes, size_t writes_count,
+                           const std::vector<block_size_t> &block_sizes,
+                           const std::vector<uint32_t> &checksums,
+                           const gc_entry_t *gc_source);
 
     bool is_gc_active() const;
 
@@ -130,6 +156,11 @@ private:
         scoped_device_block_aligned_ptr_t<char> &&gc_blocks,
         new_semaphore_in_line_t &&index_write_semaphore_acq);
 
+    // Finds the uncompressed size and the checksum of the live block at
+    // `old_offset`, either in the LBA or in a block token that refers to it.
+    void get_gc_block_info(block_id_t block_id, int64_t old_offset,
+                           block_size_t *block_size_out, uint32_t *checksum_out);
+
     void flush_gc_index_writes(signal_t *);
 
     // Determine how many GC processes should run concurrently at the moment.
@@ -153,6 +184,11 @@ private:
     // Pops things off young_extent_queue that are no longer young.
     void mark_unyoung_entries();
 
+    // With the cost-benefit GC policy, an extent's priority in `gc_pq` depends on how
+    // old its data is at `gc_score_reference_time`.  This moves the reference time
+    // forward and reorders `gc_pq` if it's gotten out of date.
+    void maybe_refresh_gc_scores();
+
     // Pops the last gc_entry_t off young_extent_queue and declares it
     // to be not young.
     void remove_last_unyoung_entry();
@@ -193,9 +229,21 @@ private:
     /* Contains every extent in the gc_entry_t::state_reconstructing state */
     intrusive_list_t<gc_entry_t> reconstructed_extents;
 
-    /* Contains the extent in the gc_entry_t::state_active state. */
+    /* Contains the extent in the gc_entry_t::state_active state that new writes go
+    to. */
     gc_entry_t *active_extent;
 
+    /* With the cost-benefit GC policy, the blocks that the GC moves go to this extent
+    instead of `active_extent`.  It's in the gc_entry_t::state_active state too.  Unlike
+    `active_extent` it isn't recorded in the metablock, so after a restart it becomes
+    an old extent like any other. */
+    gc_entry_t *cold_active_extent;
+
+    const gc_policy_t gc_policy;
+
+    /* The time that the cost-benefit GC policy measures the age of extents against. */
+    kiloticks_t gc_score_reference_time;
+
     /* Contains every extent in the gc_entry_t::state_young state */
     intrusive_list_t<gc_entry_t> young_extent_queue;
 
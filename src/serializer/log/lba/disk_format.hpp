@@ -60,13 +60,21 @@ ATTR_PACKED(struct lba_entry_t {
     // (It probably assumes that sizeof(lba_entry_t) evenly divides
     // DEVICE_BLOCK_SIZE).
 
-    // Put the zero-padding at the beginning of the LBA entry.  We could use this, or
-    // the first 16 bits, perhaps, as a version flag.
-    uint32_t zero_reserved;
-
-    // This could be a uint16_t if you wanted it to be, as long as block sizes are
-    // all less than or equal to 4K (which is less than 64K).
-    uint32_t ser_block_size;
+    // The CRC-32C of the block's `ser_block_size` bytes, or 0 if the block was written
+    // without a checksum.  Older versions always wrote 0 here and never looked at it,
+    // so files remain compatible in both directions.
+    //
+    // The LBA extents themselves aren't checksummed: the entries have no spare bytes
+    // left, and a per-extent checksum would change the LBA format so that older
+    // versions couldn't read it.  A corrupted entry usually still gets caught when the
+    // block is read, because the data at the offset it points to then doesn't match
+    // the checksum.  Entries that were written without a checksum aren't protected.
+    uint32_t checksum;
+
+    // The low 16 bits hold the block's serializer block size.  If the block is stored
+    // compressed, the high 16 bits hold its size on disk, otherwise they are zero.
+    // Older versions require the high bits to be zero.
+    uint32_t ser_block_size_and_stored_size;
 
     block_id_t block_id;
 
@@ -76,24 +84,38 @@ ATTR_PACKED(struct lba_entry_t {
     flagged_off64_t offset;
 
     static lba_entry_t make(block_id_t block_id, repli_timestamp_t recency,
-                            flagged_off64_t offset, uint16_t ser_block_size) {
+                            flagged_off64_t offset, uint16_t ser_block_size,
+                            uint16_t stored_block_size, uint32_t checksum) {
         guarantee(ser_block_size != 0 || !offset.has_value());
         lba_entry_t entry;
-        entry.zero_reserved = 0;
-        entry.ser_block_size = ser_block_size;
+        entry.checksum = checksum;
+        entry.ser_block_size_and_stored_size = ser_block_size;
+        if (stored_block_size != ser_block_size) {
+            entry.ser_block_size_and_stored_size |=
+                static_cast<uint32_t>(stored_block_size) << 16;
+        }
         entry.block_id = block_id;
         entry.recency = recency;
         entry.offset = offset;
         return entry;
     }
 
+    uint16_t ser_block_size() const {
+        return ser_block_size_and_stored_size & 0xFFFF;
+    }
+
+    uint16_t stored_block_size() const {
+        const uint16_t stored = ser_block_size_and_stored_size >> 16;
+        return stored == 0 ? ser_block_size() : stored;
+    }
+
     static bool is_padding(const lba_entry_t *entry) {
         return entry->block_id == PADDING_BLOCK_ID  && entry->offset.is_padding();
     }
 
     static lba_entry_t make_padding_entry() {
         return make(PADDING_BLOCK_ID, repli_timestamp_t::invalid,
-                    flagged_off64_t::padding(), 0);
+                    flagged_off64_t::padding(), 0, 0, 0);
     }
 });
 
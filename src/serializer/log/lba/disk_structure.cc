@@ -2,7 +2,11 @@
 #include "serializer/log/lba/disk_structure.hpp"
 
 #include <algorithm>
+#include <functional>
+#include <vector>
 
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/cond_var.hpp"
 #include "containers/scoped.hpp"
 #include "math.hpp"
 
@@ -70,6 +74,7 @@ void lba_disk_structure_t::on_extent_read() {
 
 void lba_disk_structure_t::add_entry(block_id_t block_id, repli_timestamp_t recency,
                                      flagged_off64_t offset, uint16_t ser_block_size,
+                                     uint16_t stored_block_size, uint32_t checksum,
                                      file_account_t *io_account,
                                      extent_transaction_t *txn) {
     if (last_extent && last_extent->full()) {
@@ -90,7 +95,9 @@ void lba_disk_structure_t::add_entry(block_id_t block_id, repli_timestamp_t rece
 
     rassert(!last_extent->full());
 
-    last_extent->add_entry(lba_entry_t::make(block_id, recency, offset, ser_block_size), io_account);
+    last_extent->add_entry(lba_entry_t::make(block_id, recency, offset, ser_block_size,
+                                             stored_block_size, checksum),
+                           io_account);
 }
 
 std::set<lba_disk_extent_t *> lba_disk_structure_t::get_inactive_extents() const {
@@ -209,114 +216,112 @@ void lba_disk_structure_t::write_outstanding(file_account_t *io_account,
     }
 }
 
+/* reader_t reads the extents of an LBA shard and applies their entries to the
+in-memory index.  Reading is pipelined: up to `LBA_READ_BUFFER_SIZE / LBA_SHARD_FACTOR`
+bytes of extents are read ahead while earlier extents are being applied.  Applying the
+entries is the CPU-heavy part, so it happens on `apply_thread`, which lets the shards of
+an LBA get applied on different threads at the same time. */
 struct reader_t
 {
     lba_disk_structure_t *ds;   // The disk structure we are reading from
     in_memory_index_t *index;   // The in-memory-index we are reading into
+    threadnum_t apply_thread;   // The thread on which we apply the entries to `index`
     lba_disk_structure_t::read_callback_t *rcb;   // Who to call back when we finish
 
     /* extent_reader_t takes care of reading a single extent. */
     struct extent_reader_t :
         public extent_t::read_callback_t
     {
-        reader_t *parent;   // Our reader_t that we were created by
-        int index;   // parent->readers[index] = this
-        lba_disk_extent_t *extent;   // The extent we are supposed to read
-        lba_disk_extent_t::read_info_t read_info;   // Opaque data used by extent_t::read()
-        bool have_read;   // true if our extent has been loaded from disk
-
-        /* true if the extent before us called read_step_2(). We keep track of this
-        because we must be sure to call read_step_2() in the right order at all times;
-        otherwise more recent LBA data would be applied after less recent LBA data
-        and the LBA would be corrupted. */
-        bool prev_done;
-
-        extent_reader_t(reader_t *p, lba_disk_extent_t *e)
-            : parent(p), extent(e), have_read(false)
-        {
-            index = parent->readers.size();
-            parent->readers.push_back(this);
-
-            if (index == 0) {
-                // We are the first; we don't have to wait for a previous extent
-                prev_done = true;
-            } else {
-                prev_done = false;
-            }
-        }
+        explicit extent_reader_t(lba_disk_extent_t *e) : extent(e) { }
+
         void start_reading() {
-            parent->active_readers++;
             extent->read_step_1(&read_info, this);
         }
         void on_extent_read() {   // Called when our extent has been read from disk
-            rassert(!have_read);
-            have_read = true;
-            if (prev_done) done();
-        }
-        void on_prev_done() {   // Called by the previous extent_reader_t when it finishes
-            rassert(!prev_done);
-            prev_done = true;
-            if (have_read) done();
-        }
-        void done() {
-            extent->read_step_2(&read_info, parent->index);
-            parent->active_readers--;
-            parent->start_more_readers();
-            if (index == static_cast<int>(parent->readers.size()) - 1) {
-                parent->done();
-            } else {
-                parent->readers[index+1]->on_prev_done();
-            }
-            delete this;
+            read_done.pulse();
         }
+
+        lba_disk_extent_t *extent;   // The extent we are supposed to read
+        lba_disk_extent_t::read_info_t read_info;   // Opaque data used by extent_t::read()
+        cond_t read_done;   // Pulsed when our extent has been loaded from disk
     };
-    std::vector< extent_reader_t* > readers;
+    std::vector<scoped_ptr_t<extent_reader_t> > readers;
 
     // The index of the next reader that we should call start_reading() on
-    int next_reader;
+    size_t next_reader;
 
-    // The number of readers that have done start_reading() but not done(). Used to
-    // throttle the reading process so that we stay under LBA_READ_BUFFER_SIZE.
+    // The number of readers that have done start_reading() but whose extent hasn't been
+    // applied yet. Used to throttle the reading process so that we stay under
+    // LBA_READ_BUFFER_SIZE.
     int active_readers;
 
-    reader_t(lba_disk_structure_t *_ds, in_memory_index_t *_index, lba_disk_structure_t::read_callback_t *cb)
-        : ds(_ds), index(_index), rcb(cb)
+    reader_t(lba_disk_structure_t *_ds, in_memory_index_t *_index,
+             threadnum_t _apply_thread, lba_disk_structure_t::read_callback_t *cb)
+        : ds(_ds), index(_index), apply_thread(_apply_thread), rcb(cb),
+          next_reader(0), active_readers(0)
     {
         for (lba_disk_extent_t *e = ds->extents_in_superblock.head();
              e != nullptr; e = ds->extents_in_superblock.next(e)) {
-            new extent_reader_t(this, e);
+            readers.push_back(make_scoped<extent_reader_t>(e));
         }
-        if (ds->last_extent) new extent_reader_t(this, ds->last_extent);
-
-        /* The constructor for extent_reader_t pushed them onto our 'readers' vector. So
-        now we have a vector with an extent_reader_t object for each extent we need to
-        read, but none of them have been started yet. */
-
-        if (readers.empty()) {
-            done();
-        } else {
-            next_reader = 0;
-            active_readers = 0;
-            start_more_readers();
+        if (ds->last_extent) {
+            readers.push_back(make_scoped<extent_reader_t>(ds->last_extent));
         }
+
+        coro_t::spawn_sometime(std::bind(&reader_t::apply_extents, this));
     }
 
     void start_more_readers() {
         int limit = std::max<int>(LBA_READ_BUFFER_SIZE / ds->em->extent_size / LBA_SHARD_FACTOR, 1);
-        while (next_reader != static_cast<int>(readers.size())
-               && active_readers < limit) {
+        while (next_reader != readers.size() && active_readers < limit) {
+            active_readers++;
             readers[next_reader++]->start_reading();
         }
     }
 
-    void done() {
+    void apply_extents() {
+        start_more_readers();
+
+        /* We must apply the extents in the right order; otherwise more recent LBA data
+        would be applied before less recent LBA data and the LBA would be corrupted. */
+        size_t next_to_apply = 0;
+        while (next_to_apply != readers.size()) {
+            readers[next_to_apply]->read_done.wait_lazily_unordered();
+
+            // Apply every extent that has been read by now in one go, so that we
+            // don't switch threads more often than necessary.
+            size_t end = next_to_apply + 1;
+            while (end < next_reader && readers[end]->read_done.is_pulsed()) {
+                ++end;
+            }
+            {
+                on_thread_t thread_switcher(apply_thread);
+                for (size_t i = next_to_apply; i < end; ++i) {
+                    readers[i]->extent->read_step_2(&readers[i]->read_info, index);
+                }
+            }
+
+            for (size_t i = next_to_apply; i < end; ++i) {
+                readers[i].reset();
+                active_readers--;
+                rcb->on_lba_extent_applied();
+            }
+            next_to_apply = end;
+            start_more_readers();
+        }
+
         rcb->on_lba_extents_read();
         delete this;
     }
 };
 
-void lba_disk_structure_t::read(in_memory_index_t *index, read_callback_t *cb) {
-    new reader_t(this, index, cb);
+void lba_disk_structure_t::read(in_memory_index_t *index, threadnum_t apply_thread,
+                                read_callback_t *cb) {
+    new reader_t(this, index, apply_thread, cb);
+}
+
+int lba_disk_structure_t::num_extents() const {
+    return static_cast<int>(extents_in_superblock.size()) + (last_extent != nullptr ? 1 : 0);
 }
 
 void lba_disk_structure_t::prepare_metablock(lba_shard_metablock_t *mb_out) {
@@ -34,6 +34,7 @@ public:
     // Put entries in an LBA and then call wait_for_write_completion() to write to disk
     void add_entry(block_id_t block_id, repli_timestamp_t recency,
                    flagged_off64_t offset, uint16_t ser_block_size,
+                   uint16_t stored_block_size, uint32_t checksum,
                    file_account_t *io_account,
                    extent_transaction_t *txn);
     struct completion_callback_t {
@@ -55,12 +56,19 @@ public:
                          file_account_t *io_account, extent_transaction_t *txn);
 
     // If you call read(), then the in_memory_index_t will be populated and then the
-    // read_callback_t will be called when it is done.
+    // read_callback_t will be called when it is done. The entries get applied to the
+    // index on `apply_thread`, and the callbacks get called on our thread. read() never
+    // calls the callbacks before it returns.
     struct read_callback_t {
         virtual void on_lba_extents_read() = 0;
+        // Called after each extent has been applied to the index.
+        virtual void on_lba_extent_applied() { }
         virtual ~read_callback_t() {}
     };
-    void read(in_memory_index_t *index, read_callback_t *cb);
+    void read(in_memory_index_t *index, threadnum_t apply_thread, read_callback_t *cb);
+
+    // The number of LBA extents that read() reads.
+    int num_extents() const;
 
     void prepare_metablock(lba_shard_metablock_t *mb_out);
 
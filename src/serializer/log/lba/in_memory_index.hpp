@@ -12,25 +12,38 @@ ATTR_PACKED(struct index_block_info_t {
     index_block_info_t()
         : offset(flagged_off64_t::unused()),
           recency(repli_timestamp_t::invalid),
-          ser_block_size(0) { }
+          ser_block_size(0),
+          stored_block_size(0),
+          checksum(0) { }
 
     index_block_info_t(flagged_off64_t _offset,
                        repli_timestamp_t _recency,
-                       uint16_t _ser_block_size)
+                       uint16_t _ser_block_size,
+                       uint16_t _stored_block_size,
+                       uint32_t _checksum)
         : offset(_offset),
           recency(_recency),
-          ser_block_size(_ser_block_size) { }
+          ser_block_size(_ser_block_size),
+          stored_block_size(_stored_block_size),
+          checksum(_checksum) { }
 
     // For two_level_array_t.
     bool operator==(const index_block_info_t &other) const {
         return offset == other.offset &&
             recency == other.recency &&
-            ser_block_size == other.ser_block_size;
+            ser_block_size == other.ser_block_size &&
+            stored_block_size == other.stored_block_size &&
+            checksum == other.checksum;
     }
 
     flagged_off64_t offset;
     repli_timestamp_t recency;
     uint16_t ser_block_size;
+    // The number of bytes the block takes up on disk. This is smaller than
+    // `ser_block_size` if the block is stored compressed.
+    uint16_t stored_block_size;
+    // The CRC-32C of the block's contents, or 0 if we don't have one.
+    uint32_t checksum;
 });
 
 /* This is a reduced-size block info for auxiliary blocks (currently
@@ -39,30 +52,52 @@ timestamp, because we don't need it for those blocks. */
 ATTR_PACKED(struct index_aux_block_info_t {
     index_aux_block_info_t()
         : offset(flagged_off64_t::unused()),
-          ser_block_size(0) { }
+          ser_block_size(0),
+          stored_block_size(0),
+          checksum(0) { }
 
     index_aux_block_info_t(flagged_off64_t _offset,
-                           uint16_t _ser_block_size)
+                           uint16_t _ser_block_size,
+                           uint16_t _stored_block_size,
+                           uint32_t _checksum)
         : offset(_offset),
-          ser_block_size(_ser_block_size) { }
+          ser_block_size(_ser_block_size),
+          stored_block_size(_stored_block_size),
+          checksum(_checksum) { }
 
     // For two_level_array_t.
     bool operator==(const index_aux_block_info_t &other) const {
         return offset == other.offset &&
-            ser_block_size == other.ser_block_size;
+            ser_block_size == other.ser_block_size &&
+            stored_block_size == other.stored_block_size &&
+            checksum == other.checksum;
     }
 
     flagged_off64_t offset;
     uint16_t ser_block_size;
+    uint16_t stored_block_size;
+    uint32_t checksum;
 });
 
 
 
+/* The index is split into `LBA_SHARD_FACTOR` shards, the same way as the LBA on disk
+(see `lba_list_t`): block `id` lives in shard `id % LBA_SHARD_FACTOR`.  The shards don't
+share any state, so while the LBA is being loaded at startup, `set_block_info` calls for
+different shards can run concurrently on different threads, as long as nothing else
+accesses the index at the same time. */
 class in_memory_index_t {
-    two_level_array_t<index_block_info_t> infos_;
-    block_id_t end_block_id_;
-    two_level_array_t<index_aux_block_info_t> aux_infos_;
-    block_id_t end_aux_block_id_;
+    struct shard_t {
+        shard_t();
+
+        // Both arrays are indexed by `id / LBA_SHARD_FACTOR`, relative to
+        // `FIRST_AUX_BLOCK_ID` for aux blocks.
+        two_level_array_t<index_block_info_t> infos;
+        block_id_t end_block_id;
+        two_level_array_t<index_aux_block_info_t> aux_infos;
+        block_id_t end_aux_block_id;
+    };
+    shard_t shards_[LBA_SHARD_FACTOR];
 
 public:
     in_memory_index_t();
@@ -73,7 +108,8 @@ public:
 
     index_block_info_t get_block_info(block_id_t id);
     void set_block_info(block_id_t id, repli_timestamp_t recency,
-                        flagged_off64_t offset, uint16_t ser_block_size);
+                        flagged_off64_t offset, uint16_t ser_block_size,
+                        uint16_t stored_block_size, uint32_t checksum);
 
 };
 
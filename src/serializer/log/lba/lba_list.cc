@@ -13,7 +13,8 @@
 lba_list_t::lba_list_t(extent_manager_t *em,
         const lba_list_t::write_metablock_fun_t &_write_metablock_fun)
     : gc_drainer(new auto_drainer_t), write_metablock_fun(_write_metablock_fun),
-      extent_manager(em), state(state_unstarted), inline_lba_entries_count(0)
+      extent_manager(em), state(state_unstarted), startup_extents_total(0),
+      startup_extents_applied(0), inline_lba_entries_count(0)
 {
     for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
         gc_active[i] = false;
@@ -85,13 +86,27 @@ public:
         rassert(cbs_out > 0);
         cbs_out--;
         if (cbs_out == 0) {
+            for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
+                owner->startup_extents_total += owner->disk_structures[i]->num_extents();
+            }
+            // The shards of the in-memory index are independent, so we apply each shard
+            // on a different thread, starting with the one after ours.
+            const int num_threads = get_num_threads();
+            const int our_thread = get_thread_id().threadnum;
             cbs_out = LBA_SHARD_FACTOR;
             for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
-                owner->disk_structures[i]->read(&owner->in_memory_index, this);
+                owner->disk_structures[i]->read(
+                    &owner->in_memory_index,
+                    threadnum_t((our_thread + 1 + i) % num_threads),
+                    this);
             }
         }
     }
 
+    void on_lba_extent_applied() {
+        ++owner->startup_extents_applied;
+    }
+
     void on_lba_extents_read() {
         rassert(cbs_out > 0);
         cbs_out--;
@@ -101,15 +116,13 @@ public:
             // the metablock into the index:
             for (int32_t i = 0; i < owner->inline_lba_entries_count; ++i) {
                 lba_entry_t *e = &owner->inline_lba_entries[i];
-                // The on-disk format still stores 32 bit block sizes.
-                // We've never actually used them, and we now use 16 bit block sizes
-                // for the in-memory index to save a few bytes.
-                guarantee(e->ser_block_size <= std::numeric_limits<uint16_t>::max());
                 owner->in_memory_index.set_block_info(
                         e->block_id,
                         e->recency,
                         e->offset,
-                        static_cast<uint16_t>(e->ser_block_size));
+                        e->ser_block_size(),
+                        e->stored_block_size(),
+                        e->checksum);
             }
 
             owner->state = lba_list_t::state_ready;
@@ -135,6 +148,12 @@ bool lba_list_t::start_existing(file_t *file, lba_metablock_mixin_t *last_metabl
     }
 }
 
+void lba_list_t::get_startup_progress(int64_t *extents_applied_out,
+                                      int64_t *extents_total_out) const {
+    *extents_applied_out = startup_extents_applied;
+    *extents_total_out = startup_extents_total;
+}
+
 block_id_t lba_list_t::end_block_id() {
     rassert(state == state_ready || state == state_gc_shutting_down);
 
@@ -164,6 +183,10 @@ block_size_t lba_list_t::get_block_size(block_id_t block) {
     return block_size_t::unsafe_make(get_block_info(block).ser_block_size);
 }
 
+block_size_t lba_list_t::get_stored_block_size(block_id_t block) {
+    return block_size_t::unsafe_make(get_block_info(block).stored_block_size);
+}
+
 repli_timestamp_t lba_list_t::get_block_recency(block_id_t block) {
     return get_block_info(block).recency;
 }
@@ -192,10 +215,12 @@ segmented_vector_t<repli_timestamp_t> lba_list_t::get_block_recencies(block_id_t
 
 void lba_list_t::set_block_info(block_id_t block, repli_timestamp_t recency,
                                 flagged_off64_t offset, uint16_t ser_block_size,
+                                uint16_t stored_block_size, uint32_t checksum,
                                 file_account_t *io_account, extent_transaction_t *txn) {
     rassert(state == state_ready || state == state_gc_shutting_down);
 
-    in_memory_index.set_block_info(block, recency, offset, ser_block_size);
+    in_memory_index.set_block_info(block, recency, offset, ser_block_size,
+                                   stored_block_size, checksum);
 
     // If the inline LBA is full, free it up first by moving its entries to
     // the LBA extents
@@ -204,7 +229,8 @@ void lba_list_t::set_block_info(block_id_t block, repli_timestamp_t recency,
         rassert(!check_inline_lba_full());
     }
     // Then store the entry inline
-    add_inline_entry(block, recency, offset, ser_block_size);
+    add_inline_entry(block, recency, offset, ser_block_size, stored_block_size,
+                     checksum);
 }
 
 bool lba_list_t::check_inline_lba_full() const {
@@ -241,7 +267,9 @@ void lba_list_t::move_inline_entries_to_extents(file_account_t *io_account, exte
                 e.block_id,
                 e.recency,
                 e.offset,
-                e.ser_block_size,
+                e.ser_block_size(),
+                e.stored_block_size(),
+                e.checksum,
                 io_account,
                 txn);
     }
@@ -250,11 +278,13 @@ void lba_list_t::move_inline_entries_to_extents(file_account_t *io_account, exte
 }
 
 void lba_list_t::add_inline_entry(block_id_t block, repli_timestamp_t recency,
-                                flagged_off64_t offset, uint16_t ser_block_size) {
+                                flagged_off64_t offset, uint16_t ser_block_size,
+                                uint16_t stored_block_size, uint32_t checksum) {
 
     rassert(!check_inline_lba_full());
     inline_lba_entries[inline_lba_entries_count++] =
-            lba_entry_t::make(block, recency, offset, ser_block_size);
+            lba_entry_t::make(block, recency, offset, ser_block_size,
+                              stored_block_size, checksum);
 }
 
 class lba_writer_t :
@@ -348,13 +378,14 @@ void lba_list_t::gc(int lba_shard, auto_drainer_t::lock_t) {
             break;
         }
 
-        flagged_off64_t off = get_block_offset(id);
-        if (off.has_value()) {
-            uint16_t ser_block_size = get_ser_block_size(id);
+        const index_block_info_t info = get_block_info(id);
+        if (info.offset.has_value()) {
             disk_structures[lba_shard]->add_entry(id,
-                                                  get_block_recency(id),
-                                                  off,
-                                                  ser_block_size,
+                                                  info.recency,
+                                                  info.offset,
+                                                  info.ser_block_size,
+                                                  info.stored_block_size,
+                                                  info.checksum,
                                                   gc_io_account.get(),
                                                   txns.back().get());
         }
@@ -39,12 +39,19 @@ public:
     bool start_existing(file_t *dbfile, lba_metablock_mixin_t *last_metablock,
                         ready_callback_t *cb);
 
+    // While start_existing() is loading the LBA, this tells how many of its extents
+    // have been applied to the in-memory index so far, and how many there are in
+    // total. The total is 0 until the LBA superblocks have been read.
+    void get_startup_progress(int64_t *extents_applied_out,
+                              int64_t *extents_total_out) const;
+
     index_block_info_t get_block_info(block_id_t block);
 
     // These return individual fields of get_block_info.
     flagged_off64_t get_block_offset(block_id_t block);
     uint16_t get_ser_block_size(block_id_t block);
     block_size_t get_block_size(block_id_t block);
+    block_size_t get_stored_block_size(block_id_t block);
     repli_timestamp_t get_block_recency(block_id_t block);
     segmented_vector_t<repli_timestamp_t> get_block_recencies(block_id_t first,
                                                               block_id_t step);
@@ -62,6 +69,7 @@ public:
 
     void set_block_info(block_id_t block, repli_timestamp_t recency,
                         flagged_off64_t offset, uint16_t ser_block_size,
+                        uint16_t stored_block_size, uint32_t checksum,
                         file_account_t *io_account,
                         extent_transaction_t *txn);
 
@@ -105,6 +113,9 @@ private:
     file_t *dbfile;
     scoped_ptr_t<file_account_t> gc_io_account;
 
+    int64_t startup_extents_total;
+    int64_t startup_extents_applied;
+
     in_memory_index_t in_memory_index;
 
     // This is a set of inlined LBA entries which are written directly into the
@@ -117,7 +128,8 @@ private:
     void move_inline_entries_to_extents(file_account_t *io_account,
                                         extent_transaction_t *txn);
     void add_inline_entry(block_id_t block, repli_timestamp_t recency,
-                          flagged_off64_t offset, uint16_t ser_block_size);
+                          flagged_off64_t offset, uint16_t ser_block_size,
+                          uint16_t stored_block_size, uint32_t checksum);
 
     lba_disk_structure_t *disk_structures[LBA_SHARD_FACTOR];
 
@@ -11,12 +11,17 @@
 #include "arch/io/disk.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
 #include "buffer_cache/types.hpp"
 #include "concurrency/new_mutex.hpp"
+#include "concurrency/wait_any.hpp"
 #include "logger.hpp"
 #include "perfmon/perfmon.hpp"
 #include "serializer/buf_ptr.hpp"
+#include "serializer/log/compression.hpp"
 #include "serializer/log/data_block_manager.hpp"
+#include "serializer/log/scrubber.hpp"
+#include "time.hpp"
 
 filepath_file_opener_t::filepath_file_opener_t(const serializer_filepath_t &filepath,
                                                io_backender_t *backender)
@@ -135,7 +140,11 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
       pm_serializer_data_extents_gced(),
       pm_serializer_old_garbage_block_bytes(),
       pm_serializer_old_total_block_bytes(),
+      pm_serializer_client_written_bytes_total(),
+      pm_serializer_gc_written_bytes_total(),
       pm_serializer_lba_gcs(),
+      pm_serializer_checksum_failures(),
+      pm_serializer_blocks_scrubbed(),
       parent_collection_membership(parent, &serializer_collection, "serializer"),
       stats_membership(&serializer_collection,
           &pm_serializer_block_reads, "serializer_block_reads",
@@ -155,7 +164,12 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
           &pm_serializer_data_extents_gced, "serializer_data_extents_gced",
           &pm_serializer_old_garbage_block_bytes, "serializer_old_garbage_block_bytes",
           &pm_serializer_old_total_block_bytes, "serializer_old_total_block_bytes",
-          &pm_serializer_lba_gcs, "serializer_lba_gcs")
+          &pm_serializer_client_written_bytes_total,
+              "serializer_client_written_bytes_total",
+          &pm_serializer_gc_written_bytes_total, "serializer_gc_written_bytes_total",
+          &pm_serializer_lba_gcs, "serializer_lba_gcs",
+          &pm_serializer_checksum_failures, "serializer_checksum_failures",
+          &pm_serializer_blocks_scrubbed, "serializer_blocks_scrubbed")
 { }
 
 void log_serializer_stats_t::bytes_read(size_t count) {
@@ -314,11 +328,11 @@ struct ls_start_existing_fsm_t :
                     break;
                 }
 
-                flagged_off64_t offset =
-                    ser->lba_index->get_block_offset(next_block_to_reconstruct);
-                if (offset.has_value()) {
-                    ser->data_block_manager->mark_live(offset.get_value(),
-                        ser->lba_index->get_block_size(next_block_to_reconstruct));
+                const index_block_info_t info =
+                    ser->lba_index->get_block_info(next_block_to_reconstruct);
+                if (info.offset.has_value()) {
+                    ser->data_block_manager->mark_live(info.offset.get_value(),
+                        block_size_t::unsafe_make(info.stored_block_size));
                 }
 
                 ++next_block_to_reconstruct;
@@ -342,6 +356,10 @@ struct ls_start_existing_fsm_t :
             rassert(ser->state == log_serializer_t::state_starting_up);
             ser->state = log_serializer_t::state_ready;
 
+            if (ser->dynamic_config.checksum_blocks) {
+                ser->scrubber.init(new log_serializer_scrubber_t(ser));
+            }
+
             if (to_signal_when_done) to_signal_when_done->pulse();
 
             delete this;
@@ -367,6 +385,28 @@ struct ls_start_existing_fsm_t :
         next_starting_up_step();
     }
 
+    // Describes how far the startup process has gotten, for the progress messages
+    // that the serializer logs when loading a big file takes a while.
+    std::string describe_progress() const {
+        if (start_existing_state == state_waiting_for_lba) {
+            int64_t extents_applied, extents_total;
+            ser->lba_index->get_startup_progress(&extents_applied, &extents_total);
+            return strprintf("loaded %" PRIi64 " of %" PRIi64 " LBA extents",
+                             extents_applied, extents_total);
+        } else if (start_existing_state == state_reconstruct_ongoing) {
+            const uint64_t num_blocks = ser->lba_index->end_block_id();
+            const uint64_t total = num_blocks
+                + make_aux_block_id_relative(ser->lba_index->end_aux_block_id());
+            const uint64_t done = is_aux_block_id(next_block_to_reconstruct)
+                ? num_blocks + make_aux_block_id_relative(next_block_to_reconstruct)
+                : next_block_to_reconstruct;
+            return strprintf("reconstructed the block map for %" PRIu64 " of %" PRIu64
+                             " blocks", done, total);
+        } else {
+            return "reading the metablock";
+        }
+    }
+
     void on_lba_ready() {
         rassert(start_existing_state == state_waiting_for_lba);
         start_existing_state = state_reconstruct;
@@ -427,11 +467,35 @@ log_serializer_t::log_serializer_t(dynamic_config_t _dynamic_config,
       lba_index(nullptr),
       data_block_manager(nullptr),
       active_write_count(0) {
+    compressor.init(new block_compressor_t(dynamic_config.compression));
+
     // STATE A
     /* This is because the serializer is not completely converted to coroutines yet. */
     ls_start_existing_fsm_t *s = new ls_start_existing_fsm_t(this);
     cond_t cond;
-    if (!s->run(&cond, file_opener)) cond.wait();
+    if (!s->run(&cond, file_opener)) {
+        // Loading the LBA of a big file can take a while, so we let the user know how
+        // it's going.  `s` deletes itself once it pulses `cond`.
+        const microtime_t start_time = current_microtime();
+        bool logged_progress = false;
+        while (!cond.is_pulsed()) {
+            signal_timer_t timer;
+            timer.start(LBA_LOAD_PROGRESS_INTERVAL_MS);
+            wait_any_t waiter(&cond, &timer);
+            waiter.wait_lazily_unordered();
+            if (!cond.is_pulsed()) {
+                logNTC("Still loading the index of `%s`: %s.",
+                       file_opener->file_name().c_str(),
+                       s->describe_progress().c_str());
+                logged_progress = true;
+            }
+        }
+        if (logged_progress) {
+            logNTC("Loaded the index of `%s` in %.1f seconds.",
+                   file_opener->file_name().c_str(),
+                   (current_microtime() - start_time) / 1000000.0);
+        }
+    }
 }
 
 log_serializer_t::~log_serializer_t() {
@@ -462,9 +526,29 @@ buf_ptr_t log_serializer_t::block_read(const counted_t<block_token_t> &token,
     ticks_t pm_time;
     stats->pm_serializer_block_reads.begin(&pm_time);
 
-    buf_ptr_t ret = data_block_manager->read(token->offset_, token->block_size(),
+    buf_ptr_t ret = data_block_manager->read(token->offset_,
+                                             token->stored_block_size_,
                                              io_account);
 
+    // The checksum covers the block as it is stored, so we verify it before we
+    // decompress anything.
+    if (!block_checksum_matches(token->checksum_, ret.ser_buffer(),
+                                token->stored_block_size_)) {
+        ++stats->pm_serializer_checksum_failures;
+        crash("Data corruption detected: the block at offset %" PRIi64 " (%" PRIu16
+              " bytes, block id %" PRIi64 ") in the database file does not match "
+              "its checksum (expected %08" PRIx32 ", found %08" PRIx32 "). The "
+              "file was damaged after it was written, possibly by a failing disk.",
+              token->offset_, token->stored_block_size_.ser_value(),
+              ret.ser_buffer()->ser_header.block_id, token->checksum_,
+              compute_block_checksum(ret.ser_buffer(), token->stored_block_size_));
+    }
+
+    if (token->stored_block_size_ != token->block_size_) {
+        ret = compressor->decompress(ret.ser_buffer(), token->stored_block_size_,
+                                     token->block_size_);
+    }
+
     stats->pm_serializer_block_reads.end(&pm_time);
     return ret;
 }
@@ -491,8 +575,11 @@ void log_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
              write_op_it != write_ops.end();
              ++write_op_it) {
             const index_write_op_t &op = *write_op_it;
-            flagged_off64_t offset = lba_index->get_block_offset(op.block_id);
-            uint16_t ser_block_size = lba_index->get_ser_block_size(op.block_id);
+            const index_block_info_t old_info = lba_index->get_block_info(op.block_id);
+            flagged_off64_t offset = old_info.offset;
+            uint16_t ser_block_size = old_info.ser_block_size;
+            uint16_t stored_block_size = old_info.stored_block_size;
+            uint32_t checksum = old_info.checksum;
 
             if (op.token) {
                 // Update the offset pointed to, and mark garbage/liveness as necessary.
@@ -506,22 +593,27 @@ void log_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
                 // Write new token to index, or remove from index as appropriate.
                 if (token.has()) {
                     offset = flagged_off64_t::make(token->offset_);
-                    ser_block_size = token->block_size().ser_value();
+                    ser_block_size = token->block_size_.ser_value();
+                    stored_block_size = token->stored_block_size_.ser_value();
+                    checksum = token->checksum_;
 
                     /* mark the life */
                     data_block_manager->mark_live(offset.get_value(),
-                                                  token->block_size());
+                                                  token->stored_block_size_);
                 } else {
                     offset = flagged_off64_t::unused();
                     ser_block_size = 0;
+                    stored_block_size = 0;
+                    checksum = 0;
                 }
             }
 
             repli_timestamp_t recency = op.recency ? op.recency.get()
-                : lba_index->get_block_recency(op.block_id);
+                : old_info.recency;
 
             lba_index->set_block_info(op.block_id, recency,
-                                      offset, ser_block_size,
+                                      offset, ser_block_size, stored_block_size,
+                                      checksum,
                                       index_writes_io_account.get(), &txn);
         }
     }
@@ -649,9 +741,12 @@ void log_serializer_t::write_metablock_sans_pipelining(
 }
 
 counted_t<block_token_t>
-log_serializer_t::generate_block_token(int64_t offset, block_size_t block_size) {
+log_serializer_t::generate_block_token(int64_t offset, block_size_t block_size,
+                                       block_size_t stored_block_size,
+                                       uint32_t checksum) {
     assert_thread();
-    counted_t<block_token_t> token(new block_token_t(this, offset, block_size));
+    counted_t<block_token_t> token(new block_token_t(this, offset, block_size,
+                                                     stored_block_size, checksum));
 
     auto location = offset_tokens.find(offset);
     if (location == offset_tokens.end()) {
@@ -671,9 +766,49 @@ log_serializer_t::block_writes(const buf_write_info_t *write_infos,
     assert_thread();
     stats->pm_serializer_block_writes += write_infos_count;
 
+    // Blocks that compress well are written in their compressed form. The
+    // compressed copies have to stay around until the write has completed.
+    struct compressed_bufs_cb_t : public iocallback_t {
+        void on_io_complete() {
+            iocallback_t *local_cb = cb;
+            delete this;
+            local_cb->on_io_complete();
+        }
+        std::vector<buf_ptr_t> bufs;
+        iocallback_t *cb;
+    };
+    scoped_ptr_t<compressed_bufs_cb_t> compressed_cb;
+
+    std::vector<buf_write_info_t> stored_infos;
+    stored_infos.reserve(write_infos_count);
+    std::vector<block_size_t> block_sizes;
+    block_sizes.reserve(write_infos_count);
+    for (size_t i = 0; i < write_infos_count; ++i) {
+        const buf_write_info_t &info = write_infos[i];
+        block_sizes.push_back(info.block_size);
+        // The compressed block keeps the block id header.
+        info.buf->ser_header.block_id = info.block_id;
+        buf_ptr_t compressed = compressor->compress(info.buf, info.block_size);
+        if (!compressed.has()) {
+            stored_infos.push_back(info);
+            continue;
+        }
+        if (!compressed_cb.has()) {
+            compressed_cb.init(new compressed_bufs_cb_t);
+            compressed_cb->cb = cb;
+        }
+        stored_infos.push_back(buf_write_info_t(compressed.ser_buffer(),
+                                                compressed.block_size(),
+                                                info.block_id));
+        compressed_cb->bufs.push_back(std::move(compressed));
+    }
+
     std::vector<counted_t<block_token_t> > result
-        = data_block_manager->many_writes(write_infos, write_infos_count, io_account,
-                                          cb);
+        = data_block_manager->many_writes(stored_infos.data(), stored_infos.size(),
+                                          block_sizes, nullptr, io_account,
+                                          compressed_cb.has()
+                                              ? compressed_cb.release()
+                                              : cb);
     guarantee(result.size() == write_infos_count);
     return result;
 }
@@ -794,7 +929,9 @@ counted_t<block_token_t> log_serializer_t::index_read(block_id_t block_id) {
     index_block_info_t info = lba_index->get_block_info(block_id);
     if (info.offset.has_value()) {
         return generate_block_token(info.offset.get_value(),
-                                    block_size_t::unsafe_make(info.ser_block_size));
+                                    block_size_t::unsafe_make(info.ser_block_size),
+                                    block_size_t::unsafe_make(info.stored_block_size),
+                                    info.checksum);
     } else {
         return counted_t<block_token_t>();
     }
@@ -825,6 +962,10 @@ void log_serializer_t::shutdown(cond_t *cb) {
     rassert(shutdown_state == shutdown_not_started);
     shutdown_state = shutdown_begin;
 
+    // Stop the scrubber first, since it reads blocks through the data block manager
+    // and holds block tokens.  Destroying it waits for its current read to finish.
+    scrubber.reset();
+
     // We must shutdown the LBA GC before we shut down
     // the data_block_manager or metablock_manager, because the LBA GC
     // uses our `write_metablock()` method which depends on those.
@@ -989,9 +1130,14 @@ bool log_serializer_t::should_perform_read_ahead() {
 
 block_token_t::block_token_t(log_serializer_t *serializer,
                              int64_t initial_offset,
-                             block_size_t initial_block_size)
+                             block_size_t initial_block_size,
+                             block_size_t initial_stored_block_size,
+                             uint32_t checksum)
     : serializer_(serializer), ref_count_(0),
-      block_size_(initial_block_size), offset_(initial_offset) {
+      block_size_(initial_block_size),
+      stored_block_size_(initial_stored_block_size),
+      offset_(initial_offset),
+      checksum_(checksum) {
     serializer_->assert_thread();
 }
 
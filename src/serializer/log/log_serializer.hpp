@@ -29,6 +29,8 @@ class data_block_manager_t;
 struct block_magic_t;
 class io_backender_t;
 class log_serializer_t;
+class log_serializer_scrubber_t;
+class block_compressor_t;
 
 namespace data_block_manager {
 struct shutdown_callback_t {
@@ -100,6 +102,7 @@ class log_serializer_t :
     friend class data_block_manager_t;
     friend class dbm_read_ahead_t;
     friend class block_token_t;
+    friend class log_serializer_scrubber_t;
 
 public:
     /* Serializer configuration. dynamic_config_t is everything that can be changed from
@@ -157,7 +160,9 @@ private:
     void unregister_block_token(block_token_t *token);
     void remap_block_to_new_offset(int64_t current_offset, int64_t new_offset);
     counted_t<block_token_t> generate_block_token(int64_t offset,
-                                                             block_size_t block_size);
+                                                  block_size_t block_size,
+                                                  block_size_t stored_block_size,
+                                                  uint32_t checksum);
 
     void offer_buf_to_read_ahead_callbacks(
             block_id_t block_id,
@@ -255,6 +260,14 @@ private:
     lba_list_t *lba_index;
     data_block_manager_t *data_block_manager;
 
+    // Only exists while we are in `state_ready` and `dynamic_config.checksum_blocks`
+    // is set.
+    scoped_ptr_t<log_serializer_scrubber_t> scrubber;
+
+    // Compresses blocks as we write them (if `dynamic_config.compression` says so),
+    // and decompresses compressed blocks as we read them.
+    scoped_ptr_t<block_compressor_t> compressor;
+
     /* The running index writes organize themselves into a list so that they can be sure
     to write their metablocks in the correct order. The first element in the list is the
     oldest transaction that started but did not finish. */
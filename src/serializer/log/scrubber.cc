@@ -0,0 +1,99 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "serializer/log/scrubber.hpp"
+
+#include <inttypes.h>
+
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "logger.hpp"
+#include "serializer/buf_ptr.hpp"
+#include "serializer/log/data_block_manager.hpp"
+#include "serializer/log/log_serializer.hpp"
+
+log_serializer_scrubber_t::log_serializer_scrubber_t(log_serializer_t *_serializer)
+    : serializer(_serializer),
+      io_account(new file_account_t(serializer->dbfile, SCRUBBER_IO_PRIORITY, 1)) {
+    serializer->assert_thread();
+    coro_t::spawn_sometime(std::bind(&log_serializer_scrubber_t::run,
+                                     this, auto_drainer_t::lock_t(&drainer)));
+}
+
+log_serializer_scrubber_t::~log_serializer_scrubber_t() {
+    drainer.drain();
+}
+
+void log_serializer_scrubber_t::run(auto_drainer_t::lock_t keepalive) {
+    try {
+        // Don't compete with the cache warming up after a restart.
+        nap(SCRUBBER_START_DELAY_MS, keepalive.get_drain_signal());
+        while (true) {
+            scrub_all_blocks(keepalive.get_drain_signal());
+            nap(SCRUBBER_PASS_INTERVAL_MS, keepalive.get_drain_signal());
+        }
+    } catch (const interrupted_exc_t &) {
+        // We are shutting down.
+    }
+}
+
+void log_serializer_scrubber_t::scrub_all_blocks(signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t) {
+    int num_scrubbed_in_batch = 0;
+    for (block_id_t id = 0; ; ++id) {
+        // The index can grow while we are scrubbing, so we check the end of the
+        // regular and the aux block ids again on every iteration.
+        if (!is_aux_block_id(id) && id >= serializer->lba_index->end_block_id()) {
+            id = FIRST_AUX_BLOCK_ID;
+        }
+        if (id >= serializer->lba_index->end_aux_block_id()) {
+            break;
+        }
+
+        scrub_block(id);
+
+        ++num_scrubbed_in_batch;
+        if (num_scrubbed_in_batch >= SCRUBBER_BATCH_SIZE) {
+            num_scrubbed_in_batch = 0;
+            nap(SCRUBBER_BATCH_INTERVAL_MS, interruptor);
+        }
+    }
+}
+
+void log_serializer_scrubber_t::scrub_block(block_id_t block_id) {
+    const index_block_info_t info = serializer->lba_index->get_block_info(block_id);
+    if (!info.offset.has_value() || info.checksum == 0) {
+        return;
+    }
+
+    // The token keeps the data block manager from reusing the block's space while
+    // we are reading it.
+    counted_t<block_token_t> token = serializer->generate_block_token(
+        info.offset.get_value(),
+        block_size_t::unsafe_make(info.ser_block_size),
+        block_size_t::unsafe_make(info.stored_block_size),
+        info.checksum);
+    const int64_t offset = token->offset();
+    // The checksum covers the block as it is stored, so there is no need to
+    // decompress it.
+    buf_ptr_t buf = serializer->data_block_manager->read_without_read_ahead(
+        offset, token->stored_block_size(), io_account.get());
+
+    if (token->offset() != offset) {
+        // The GC moved the block while we were reading it, so what we read might
+        // already have been overwritten. We will check it again on the next pass.
+        return;
+    }
+
+    ++serializer->stats->pm_serializer_blocks_scrubbed;
+    if (!block_checksum_matches(token->checksum(), buf.ser_buffer(),
+                                token->stored_block_size())) {
+        ++serializer->stats->pm_serializer_checksum_failures;
+        logERR("The scrubber found a checksum mismatch for block %" PRIi64
+               " at offset %" PRIi64 " (expected %08" PRIx32 ", found %08" PRIx32
+               "). The database file is corrupted, possibly by a failing disk.",
+               block_id, offset, token->checksum(),
+               compute_block_checksum(buf.ser_buffer(),
+                                      token->stored_block_size()));
+    }
+}
@@ -0,0 +1,40 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_LOG_SCRUBBER_HPP_
+#define SERIALIZER_LOG_SCRUBBER_HPP_
+
+#include "arch/types.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/interruptor.hpp"
+#include "containers/scoped.hpp"
+#include "serializer/types.hpp"
+
+class log_serializer_t;
+class signal_t;
+
+/* The scrubber walks over all blocks in the serializer's index in the background,
+reads them at a very low I/O priority and verifies their checksums. That way we learn
+about corrupted blocks before somebody needs them. The scrubber only reports problems
+(in the log and through the `serializer_checksum_failures` perfmon); it doesn't try to
+repair anything.
+
+It lives on the serializer's home thread and is created once the serializer is ready.
+Destroying it waits for the block read that is currently in progress. */
+class log_serializer_scrubber_t {
+public:
+    explicit log_serializer_scrubber_t(log_serializer_t *serializer);
+    ~log_serializer_scrubber_t();
+
+private:
+    void run(auto_drainer_t::lock_t keepalive);
+    void scrub_all_blocks(signal_t *interruptor) THROWS_ONLY(interrupted_exc_t);
+    void scrub_block(block_id_t block_id);
+
+    log_serializer_t *const serializer;
+    scoped_ptr_t<file_account_t> io_account;
+
+    auto_drainer_t drainer;
+
+    DISABLE_COPYING(log_serializer_scrubber_t);
+};
+
+#endif  // SERIALIZER_LOG_SCRUBBER_HPP_
@@ -35,10 +35,19 @@ struct log_serializer_stats_t {
     perfmon_counter_t pm_serializer_data_extents_gced;
     perfmon_counter_t pm_serializer_old_garbage_block_bytes;
     perfmon_counter_t pm_serializer_old_total_block_bytes;
+    // The bytes of data blocks written for the serializer's clients and by the GC. The
+    // write amplification of the GC is (client + gc) / client.
+    perfmon_counter_t pm_serializer_client_written_bytes_total;
+    perfmon_counter_t pm_serializer_gc_written_bytes_total;
 
     /* used in serializer/log/lba/lba_list.cc */
     perfmon_counter_t pm_serializer_lba_gcs;
 
+    /* used in serializer/log/log_serializer.cc, data_block_manager.cc and
+    scrubber.cc */
+    perfmon_counter_t pm_serializer_checksum_failures;
+    perfmon_counter_t pm_serializer_blocks_scrubbed;
+
     perfmon_membership_t parent_collection_membership;
     perfmon_multi_membership_t stats_membership;
 };
@@ -134,9 +134,15 @@ class block_token_t {
 public:
     int64_t offset() const { return offset_; }
     block_size_t block_size() const { return block_size_; }
+    // The number of bytes the block takes up on disk. This differs from
+    // `block_size()` if and only if the block is stored compressed.
+    block_size_t stored_block_size() const { return stored_block_size_; }
+    // The CRC-32C the block is expected to have, or 0 if it has none.
+    uint32_t checksum() const { return checksum_; }
 
 private:
     friend class log_serializer_t;
+    friend class data_block_manager_t;  // For GC rewrites of corrupted blocks.
     friend class dbm_read_ahead_fsm_t;  // For read-ahead tokens.
 
     friend void counted_add_ref(block_token_t *p);
@@ -144,7 +150,9 @@ private:
 
     block_token_t(log_serializer_t *serializer,
                   int64_t initial_offset,
-                  block_size_t initial_ser_block_size);
+                  block_size_t initial_ser_block_size,
+                  block_size_t initial_stored_block_size,
+                  uint32_t checksum);
 
     log_serializer_t *const serializer_;
     std::atomic<intptr_t> ref_count_;
@@ -152,9 +160,15 @@ private:
     // The block's size.
     block_size_t block_size_;
 
+    // The block's size on disk.
+    block_size_t stored_block_size_;
+
     // The block's offset on disk.
     int64_t offset_;
 
+    // See `lba_entry_t::checksum`.
+    uint32_t checksum_;
+
     void do_destroy();
 
     DISABLE_COPYING(block_token_t);
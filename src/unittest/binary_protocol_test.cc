@@ -0,0 +1,72 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "client_protocol/binary.hpp"
+#include "containers/archive/string_stream.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/response.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+static ql::datum_t read_binary_response(ql::response_t *response) {
+    write_message_t wm;
+    binary_protocol_t::write_response_to_message(response, &wm);
+    string_stream_t write_stream;
+    int write_res = send_write_message(&write_stream, &wm);
+    guarantee(write_res == 0);
+
+    string_read_stream_t read_stream(std::move(write_stream.str()), 0);
+    ql::datum_t res;
+    archive_result_t read_res = ql::datum_deserialize(&read_stream, &res);
+    guarantee(read_res == archive_result_t::SUCCESS);
+    return res;
+}
+
+static ql::datum_t num(double d) {
+    return ql::datum_t(d);
+}
+
+TEST(BinaryProtocolTest, SequenceResponse) {
+    std::vector<ql::datum_t> rows{
+        num(1),
+        ql::datum_t(datum_string_t("a")),
+        ql::datum_t::binary(datum_string_t(std::string("\0\1", 2)))};
+    ql::response_t response;
+    response.set_type(Response::SUCCESS_PARTIAL);
+    response.set_data(std::vector<ql::datum_t>(rows));
+    response.add_note(Response::SEQUENCE_FEED);
+
+    ql::datum_t res = read_binary_response(&response);
+    ASSERT_EQ(num(Response::SUCCESS_PARTIAL), res.get_field("t"));
+    ASSERT_EQ(ql::datum_t(std::move(rows), ql::configured_limits_t::unlimited),
+              res.get_field("r"));
+    ASSERT_EQ(ql::datum_t(std::vector<ql::datum_t>{num(Response::SEQUENCE_FEED)},
+                          ql::configured_limits_t::unlimited),
+              res.get_field("n"));
+    ASSERT_FALSE(res.get_field("e", ql::NOTHROW).has());
+    ASSERT_FALSE(res.get_field("b", ql::NOTHROW).has());
+}
+
+TEST(BinaryProtocolTest, ErrorResponse) {
+    ql::response_t response;
+    response.fill_error(Response::RUNTIME_ERROR, Response::OP_FAILED, "message",
+                        ql::datum_t::empty_array());
+
+    ql::datum_t res = read_binary_response(&response);
+    ASSERT_EQ(num(Response::RUNTIME_ERROR), res.get_field("t"));
+    ASSERT_EQ(num(Response::OP_FAILED), res.get_field("e"));
+    ASSERT_EQ(ql::datum_t(datum_string_t("message")), res.get_field("r").get(0));
+    ASSERT_EQ(ql::datum_t::empty_array(), res.get_field("b"));
+}
+
+TEST(BinaryProtocolTest, ExtremaBecomeAnError) {
+    ql::response_t response;
+    response.set_type(Response::SUCCESS_ATOM);
+    response.set_data(ql::datum_t::minval());
+
+    ql::datum_t res = read_binary_response(&response);
+    ASSERT_EQ(num(Response::RUNTIME_ERROR), res.get_field("t"));
+    ASSERT_EQ(num(Response::QUERY_LOGIC), res.get_field("e"));
+}
+
+}  // namespace unittest
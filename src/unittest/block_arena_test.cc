@@ -0,0 +1,60 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <vector>
+
+#include "config/args.hpp"
+#include "math.hpp"
+#include "serializer/block_arena.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+TPTEST(BlockArenaTest, AllocAndFree) {
+    const block_arena_usage_t usage_before = get_block_arena_usage();
+
+    // Enough blocks to fill more than one chunk for some of the sizes.
+    std::vector<std::pair<char *, size_t> > blocks;
+    uint64_t total_size = 0;
+    for (size_t i = 0; i < 2000; ++i) {
+        const size_t size = DEVICE_BLOCK_SIZE * (1 + i % 9);
+        char *block = static_cast<char *>(block_arena_alloc(size));
+        ASSERT_TRUE(divides(DEVICE_BLOCK_SIZE, reinterpret_cast<uintptr_t>(block)));
+        memset(block, static_cast<char>(i), size);
+        blocks.emplace_back(block, size);
+        total_size += size;
+    }
+
+    // The blocks don't overlap.
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        for (size_t j = 0; j < blocks[i].second; ++j) {
+            ASSERT_EQ(static_cast<char>(i), blocks[i].first[j]);
+        }
+    }
+
+    const block_arena_usage_t usage = get_block_arena_usage();
+    // The arena isn't used in Valgrind builds.
+    if (usage.bytes_reserved != 0) {
+        EXPECT_EQ(usage_before.bytes_in_use + total_size, usage.bytes_in_use);
+        EXPECT_LE(usage.bytes_in_use, usage.bytes_reserved);
+    }
+
+    // Free every other block first, so that freed space gets reused.
+    for (size_t i = 0; i < blocks.size(); i += 2) {
+        block_arena_free(blocks[i].first);
+        blocks[i].first = static_cast<char *>(block_arena_alloc(blocks[i].second));
+    }
+    for (const auto &block : blocks) {
+        block_arena_free(block.first);
+    }
+    block_arena_free(nullptr);
+
+    const block_arena_usage_t usage_after = get_block_arena_usage();
+    EXPECT_EQ(usage_before.bytes_in_use, usage_after.bytes_in_use);
+    // All but one of the chunks that became empty have been returned to the OS.
+    EXPECT_LE(usage_after.bytes_reserved,
+              usage_before.bytes_reserved + BLOCK_ARENA_CHUNK_SIZE);
+}
+
+}  // namespace unittest
@@ -9,7 +9,8 @@ struct short_value_t;
 
 class short_value_sizer_t : public value_sizer_t {
 public:
-    explicit short_value_sizer_t(max_block_size_t bs) : block_size_(bs) { }
+    explicit short_value_sizer_t(max_block_size_t bs, bool prefix_compression = false)
+        : block_size_(bs), prefix_compression_(prefix_compression) { }
 
     int size(const void *value) const {
         int x = *reinterpret_cast<const uint8_t *>(value);
@@ -31,8 +32,11 @@ public:
 
     max_block_size_t block_size() const { return block_size_; }
 
+    bool btree_leaf_prefix_compression() const { return prefix_compression_; }
+
 private:
     max_block_size_t block_size_;
+    bool prefix_compression_;
 
     DISABLE_COPYING(short_value_sizer_t);
 };
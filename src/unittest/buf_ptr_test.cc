@@ -0,0 +1,62 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include "serializer/buf_ptr.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+buf_ptr_t make_filled_buf(block_size_t block_size, char fill) {
+    buf_ptr_t buf = buf_ptr_t::alloc_zeroed(block_size);
+    memset(buf.cache_data(), fill, block_size.value());
+    return buf;
+}
+
+TPTEST(BufPtrTest, ShareWithoutCopying) {
+    const block_size_t block_size = block_size_t::make_from_cache(1000);
+    buf_ptr_t original = make_filled_buf(block_size, 'a');
+    ser_buffer_t *const buffer = original.ser_buffer();
+    EXPECT_FALSE(original.is_shared());
+
+    buf_ptr_t copy = original.share();
+    EXPECT_TRUE(original.is_shared());
+    EXPECT_TRUE(copy.is_shared());
+    EXPECT_EQ(buffer, original.ser_buffer());
+    EXPECT_EQ(buffer, copy.ser_buffer());
+    EXPECT_EQ(block_size, copy.block_size());
+
+    // Once the other owner is gone, the buffer is taken back without a copy.
+    original.reset();
+    EXPECT_FALSE(copy.is_shared());
+    copy.make_unique();
+    EXPECT_EQ(buffer, copy.ser_buffer());
+}
+
+TPTEST(BufPtrTest, CopyOnWrite) {
+    const block_size_t block_size = block_size_t::make_from_cache(1000);
+    buf_ptr_t original = make_filled_buf(block_size, 'a');
+    buf_ptr_t copy = original.share();
+
+    copy.make_unique();
+    EXPECT_NE(original.ser_buffer(), copy.ser_buffer());
+    EXPECT_FALSE(original.is_shared());
+    EXPECT_FALSE(copy.is_shared());
+    memset(copy.cache_data(), 'b', block_size.value());
+    EXPECT_EQ('a', static_cast<char *>(original.cache_data())[0]);
+    EXPECT_EQ('b', static_cast<char *>(copy.cache_data())[0]);
+    copy.assert_padding_zero();
+
+    // Resizing a shared buf unshares it too, whether or not it has to reallocate.
+    for (uint32_t new_size : { 900, 2000 }) {
+        buf_ptr_t resized = original.share();
+        resized.resize_fill_zero(block_size_t::make_from_cache(new_size));
+        EXPECT_NE(original.ser_buffer(), resized.ser_buffer());
+        EXPECT_FALSE(original.is_shared());
+        EXPECT_EQ('a', static_cast<char *>(resized.cache_data())[0]);
+        EXPECT_EQ(block_size, original.block_size());
+        resized.assert_padding_zero();
+    }
+}
+
+}  // namespace unittest
@@ -0,0 +1,51 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <string>
+
+#include "crc32c.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(Crc32cTest, KnownValues) {
+    // The standard check value for CRC-32C.
+    const char *check = "123456789";
+    EXPECT_EQ(0xE3069283u, crc32c(check, strlen(check)));
+    EXPECT_EQ(0xE3069283u, crc32c_software(check, strlen(check)));
+
+    EXPECT_EQ(0u, crc32c("", 0));
+
+    // 32 bytes of zeros and 32 bytes of ones, from RFC 3720 (iSCSI).
+    std::string zeros(32, '\x00');
+    EXPECT_EQ(0x8A9136AAu, crc32c(zeros.data(), zeros.size()));
+    std::string ones(32, '\xFF');
+    EXPECT_EQ(0x62A8AB43u, crc32c(ones.data(), ones.size()));
+}
+
+TEST(Crc32cTest, HardwareMatchesSoftware) {
+    char buf[1024];
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+        buf[i] = static_cast<char>(i * 7 + (i >> 3));
+    }
+    // Cover all alignments and the tails that don't fill a whole word.
+    for (size_t offset = 0; offset < 8; ++offset) {
+        for (size_t size = 0; size + offset <= sizeof(buf); size += 13) {
+            ASSERT_EQ(crc32c_software(buf + offset, size), crc32c(buf + offset, size));
+        }
+    }
+}
+
+TEST(Crc32cTest, Incremental) {
+    char buf[500];
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+        buf[i] = static_cast<char>(i);
+    }
+    const uint32_t whole = crc32c(buf, sizeof(buf));
+    for (size_t split = 0; split <= sizeof(buf); split += 37) {
+        const uint32_t first = crc32c(buf, split);
+        EXPECT_EQ(whole, crc32c(buf + split, sizeof(buf) - split, first));
+    }
+}
+
+}  // namespace unittest
@@ -4,6 +4,7 @@
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/datum_string.hpp"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
 #include "unittest/gtest.hpp"
 
 
@@ -205,4 +206,37 @@ TEST(DatumTest, OffsetScaling) {
     }
 }
 
+TEST(DatumTest, HashAgreesWithEquality) {
+    std::vector<std::pair<ql::datum_t, ql::datum_t> > equal_pairs{
+        {ql::datum_t(0.0), ql::datum_t(-0.0)},
+        {ql::pseudo::make_time(1.5, "+00:00"), ql::pseudo::make_time(1.5, "+03:00")},
+        {ql::datum_t(std::vector<ql::datum_t>{ql::datum_t(1.0), ql::datum_t::null()},
+                     ql::configured_limits_t::unlimited),
+         ql::datum_t(std::vector<ql::datum_t>{ql::datum_t(1.0), ql::datum_t::null()},
+                     ql::configured_limits_t::unlimited)}};
+    for (const auto &pair : equal_pairs) {
+        ASSERT_EQ(pair.first, pair.second);
+        ASSERT_EQ(pair.first.hash(), pair.second.hash());
+    }
+
+    // A datum read back from its serialization has a different representation.
+    ql::datum_t obj(std::map<datum_string_t, ql::datum_t>{
+            std::make_pair(datum_string_t("a"), ql::datum_t(1.0)),
+            std::make_pair(datum_string_t("b"), ql::datum_t(datum_string_t("x")))});
+    string_stream_t write_stream;
+    write_message_t wm;
+    serialize<cluster_version_t::LATEST_OVERALL>(&wm, obj);
+    ASSERT_EQ(0, send_write_message(&write_stream, &wm));
+    string_read_stream_t read_stream(std::move(write_stream.str()), 0);
+    ql::datum_t deserialized_obj;
+    ASSERT_EQ(archive_result_t::SUCCESS,
+              deserialize<cluster_version_t::LATEST_OVERALL>(&read_stream,
+                                                             &deserialized_obj));
+    ASSERT_EQ(obj.hash(), deserialized_obj.hash());
+
+    ASSERT_NE(ql::datum_t(1.0).hash(), ql::datum_t(2.0).hash());
+    ASSERT_NE(ql::datum_t(datum_string_t("a")).hash(),
+              ql::datum_t(datum_string_t("b")).hash());
+}
+
 }  // namespace unittest
@@ -56,8 +56,8 @@ TEST(DiskFormatTest, LbaMetablockMixinT) {
 }
 
 TEST(DiskFormatTest, LbaEntryT) {
-    EXPECT_EQ(0u, offsetof(lba_entry_t, zero_reserved));
-    EXPECT_EQ(4u, offsetof(lba_entry_t, ser_block_size));
+    EXPECT_EQ(0u, offsetof(lba_entry_t, checksum));
+    EXPECT_EQ(4u, offsetof(lba_entry_t, ser_block_size_and_stored_size));
     EXPECT_EQ(8u, offsetof(lba_entry_t, block_id));
     EXPECT_EQ(16u, offsetof(lba_entry_t, recency));
     EXPECT_EQ(24u, offsetof(lba_entry_t, offset));
@@ -69,12 +69,23 @@ TEST(DiskFormatTest, LbaEntryT) {
     ASSERT_TRUE(lba_entry_t::is_padding(&ent));
     flagged_off64_t real = flagged_off64_t::unused();
     real = flagged_off64_t::make(1);
-    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, real, 1234);
+    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, real, 1234, 1234, 0);
     ASSERT_FALSE(lba_entry_t::is_padding(&ent));
+    EXPECT_EQ(0u, ent.checksum);
+    // Uncompressed blocks look exactly like they did before compression existed.
+    EXPECT_EQ(1234u, ent.ser_block_size_and_stored_size);
+    EXPECT_EQ(1234u, ent.ser_block_size());
+    EXPECT_EQ(1234u, ent.stored_block_size());
     flagged_off64_t deleteblock = flagged_off64_t::unused();
     deleteblock = flagged_off64_t::make(1);
-    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, deleteblock, 1234);
+    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, deleteblock, 1234,
+                            1234, 0xE3069283);
     ASSERT_FALSE(lba_entry_t::is_padding(&ent));
+    EXPECT_EQ(0xE3069283u, ent.checksum);
+    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, real, 4096, 700, 0);
+    EXPECT_EQ(4096u + (700u << 16), ent.ser_block_size_and_stored_size);
+    EXPECT_EQ(4096u, ent.ser_block_size());
+    EXPECT_EQ(700u, ent.stored_block_size());
 }
 
 TEST(DiskFormatTest, LbaExtentT) {
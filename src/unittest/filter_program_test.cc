@@ -0,0 +1,106 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include <string>
+
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/filter_program.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/json_parser.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+typedef ql::filter_program_t::result_t result_t;
+
+static const ql::minidriver_t::dummy_var_t row_var =
+    ql::minidriver_t::dummy_var_t::IGNORED;
+
+class filter_program_tester_t {
+public:
+    filter_program_tester_t() : r(ql::backtrace_id_t::empty()) { }
+
+    ql::minidriver_t::reql_t field(const std::string &name) {
+        return r.var(row_var)[name];
+    }
+
+    optional<ql::filter_program_t> compile(const ql::minidriver_t::reql_t &body) {
+        ql::compile_env_t env((ql::var_visibility_t()));
+        counted_t<ql::func_term_t> func_term =
+            make_counted<ql::func_term_t>(&env, r.fun(row_var, body).root_term());
+        counted_t<const ql::func_t> func = func_term->eval_to_func(ql::var_scope_t());
+        return ql::filter_program_t::compile(*func);
+    }
+
+    ql::minidriver_t r;
+};
+
+static ql::datum_t row(const std::string &json) {
+    return ql::parse_json(json.data(), json.size(),
+                          ql::configured_limits_t::unlimited, reql_version_t::LATEST);
+}
+
+TEST(FilterProgramTest, Comparisons) {
+    filter_program_tester_t t;
+    auto program = t.compile(t.field("a") > 5.0);
+    ASSERT_TRUE(program.has_value());
+    EXPECT_EQ(result_t::MATCH, program->run(row("{\"a\": 6}")));
+    EXPECT_EQ(result_t::NO_MATCH, program->run(row("{\"a\": 5}")));
+    // Strings sort after numbers.
+    EXPECT_EQ(result_t::MATCH, program->run(row("{\"a\": \"x\"}")));
+    // A missing field is a non-existence error, which doesn't match.
+    EXPECT_EQ(result_t::NO_MATCH, program->run(row("{\"b\": 6}")));
+
+    program = t.compile(t.field("a")[std::string("b")] == t.field("c"));
+    ASSERT_TRUE(program.has_value());
+    EXPECT_EQ(result_t::MATCH, program->run(row("{\"a\": {\"b\": 1}, \"c\": 1}")));
+    EXPECT_EQ(result_t::NO_MATCH, program->run(row("{\"a\": {\"b\": 1}, \"c\": 2}")));
+    // Bracket on a number is an error that the interpreter has to report.
+    EXPECT_EQ(result_t::UNKNOWN, program->run(row("{\"a\": 1, \"c\": 2}")));
+}
+
+TEST(FilterProgramTest, BooleanOperators) {
+    filter_program_tester_t t;
+    auto program = t.compile(
+        (t.field("a") == 1.0).call(Term::OR, t.field("b") == 2.0));
+    ASSERT_TRUE(program.has_value());
+    EXPECT_EQ(result_t::MATCH, program->run(row("{\"a\": 1}")));
+    EXPECT_EQ(result_t::MATCH, program->run(row("{\"a\": 0, \"b\": 2}")));
+    EXPECT_EQ(result_t::NO_MATCH, program->run(row("{\"a\": 0, \"b\": 3}")));
+    // The error in the first operand ends the evaluation.
+    EXPECT_EQ(result_t::NO_MATCH, program->run(row("{\"b\": 2}")));
+
+    program = t.compile(!(t.field("a") == 1.0) && t.field("flag"));
+    ASSERT_TRUE(program.has_value());
+    EXPECT_EQ(result_t::MATCH, program->run(row("{\"a\": 0, \"flag\": true}")));
+    EXPECT_EQ(result_t::NO_MATCH, program->run(row("{\"a\": 0, \"flag\": false}")));
+    EXPECT_EQ(result_t::NO_MATCH, program->run(row("{\"a\": 1, \"flag\": true}")));
+    EXPECT_EQ(result_t::NO_MATCH, program->run(row("{\"flag\": true}")));
+    EXPECT_EQ(result_t::UNKNOWN, program->run(row("{\"a\": 0, \"flag\": 1}")));
+
+    program = t.compile(t.r.var(row_var).has_fields(std::string("a"), std::string("b")));
+    ASSERT_TRUE(program.has_value());
+    EXPECT_EQ(result_t::MATCH, program->run(row("{\"a\": 0, \"b\": 1}")));
+    EXPECT_EQ(result_t::NO_MATCH, program->run(row("{\"a\": 0, \"b\": null}")));
+}
+
+TEST(FilterProgramTest, ObjectLiterals) {
+    filter_program_tester_t t;
+    auto program = t.compile(t.r.expr(row("{\"a\": 1, \"b\": {\"c\": 2}}")));
+    ASSERT_TRUE(program.has_value());
+    EXPECT_EQ(result_t::MATCH, program->run(row("{\"a\": 1, \"b\": {\"c\": 2, \"d\": 3}}")));
+    EXPECT_EQ(result_t::NO_MATCH, program->run(row("{\"a\": 1, \"b\": {\"c\": 3}}")));
+    EXPECT_EQ(result_t::NO_MATCH, program->run(row("{\"a\": 1}")));
+    // A nested pattern against a field that isn't an object is left to the
+    // interpreter.
+    EXPECT_EQ(result_t::UNKNOWN, program->run(row("{\"a\": 1, \"b\": 2}")));
+    EXPECT_EQ(result_t::UNKNOWN, program->run(row("{\"a\": 1, \"b\": [2]}")));
+}
+
+TEST(FilterProgramTest, UnsupportedShapes) {
+    filter_program_tester_t t;
+    EXPECT_FALSE(t.compile(t.field("a") + 1.0 == 2.0).has_value());
+    EXPECT_FALSE(t.compile(t.field("a").call(Term::LT, 1.0, 2.0)).has_value());
+    EXPECT_FALSE(t.compile(t.r.expr(1.0)).has_value());
+}
+
+}  // namespace unittest
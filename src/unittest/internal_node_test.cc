@@ -6,11 +6,14 @@
 
 #include "btree/internal_node.hpp"
 #include "btree/node.hpp"
+#include "containers/scoped.hpp"
+#include "utils.hpp"
 
 namespace unittest {
 
 void verify(block_size_t block_size, const internal_node_t *buf) {
-    EXPECT_TRUE(buf->magic == internal_node_t::expected_magic);
+    EXPECT_TRUE(buf->magic == internal_node_t::expected_magic
+                || buf->magic == internal_node_t::counted_magic);
 
     // Internal nodes must have at least one pair.
     ASSERT_LE(1, buf->npairs);
@@ -29,7 +32,7 @@ void verify(block_size_t block_size, const internal_node_t *buf) {
     for (std::vector<uint16_t>::const_iterator p = offsets.begin(), e = offsets.end(); p < e; ++p) {
         ASSERT_LE(expected, block_size.value());
         ASSERT_EQ(expected, *p);
-        expected += internal_node::pair_size(internal_node::get_pair(buf, *p));
+        expected += internal_node::pair_size(buf, internal_node::get_pair(buf, *p));
     }
     ASSERT_EQ(block_size.value(), expected);
 
@@ -61,6 +64,105 @@ TEST(InternalNodeTest, Offsets) {
     EXPECT_EQ(9u, sizeof(btree_internal_pair));
 }
 
+store_key_t child_key(int i) {
+    return store_key_t(strprintf("key%03d", i));
+}
+
+// Fills `node` with `num_children` children with the block ids 1 to `num_children`.
+void fill_internal_node(block_size_t block_size, internal_node_t *node,
+                        int num_children, bool counted) {
+    internal_node::init(block_size, node, counted);
+    for (int i = 1; i < num_children; ++i) {
+        ASSERT_TRUE(internal_node::insert(node, child_key(i).btree_key(), i, i + 1));
+    }
+    verify(block_size, node);
+}
+
+void expect_child_counts(const internal_node_t *node) {
+    for (int i = 0; i < node->npairs; ++i) {
+        const block_id_t child = internal_node::get_pair_by_index(node, i)->lnode;
+        EXPECT_EQ(1000 + child, internal_node::child_count(node, i));
+        EXPECT_EQ(i, internal_node::child_index(node, child));
+    }
+}
+
+TEST(InternalNodeTest, CountedSplitAndMerge) {
+    block_size_t block_size = block_size_t::unsafe_make(4096);
+    scoped_malloc_t<internal_node_t> node(block_size.value());
+    scoped_malloc_t<internal_node_t> rnode(block_size.value());
+    scoped_malloc_t<internal_node_t> parent(block_size.value());
+
+    fill_internal_node(block_size, node.get(), 100, true);
+    ASSERT_TRUE(internal_node::is_counted(node.get()));
+    ASSERT_EQ(100, node->npairs);
+    for (int i = 0; i < node->npairs; ++i) {
+        EXPECT_EQ(internal_node::UNKNOWN_CHILD_COUNT,
+                  internal_node::child_count(node.get(), i));
+        internal_node::set_child_count(
+            node.get(), i, 1000 + internal_node::get_pair_by_index(node.get(), i)->lnode);
+    }
+    EXPECT_EQ(-1, internal_node::child_index(node.get(), 101));
+
+    // Splitting a child forgets its count, but no other.
+    ASSERT_TRUE(internal_node::insert(node.get(), store_key_t("key050a").btree_key(),
+                                      51, 200));
+    verify(block_size, node.get());
+    EXPECT_EQ(internal_node::UNKNOWN_CHILD_COUNT,
+              internal_node::child_count(node.get(), 50));
+    EXPECT_EQ(internal_node::UNKNOWN_CHILD_COUNT,
+              internal_node::child_count(node.get(), 51));
+    internal_node::set_child_count(node.get(), 50, 1051);
+    internal_node::set_child_count(node.get(), 51, 1200);
+    expect_child_counts(node.get());
+
+    store_key_t median;
+    internal_node::split(block_size, node.get(), rnode.get(), median.btree_key());
+    verify(block_size, node.get());
+    verify(block_size, rnode.get());
+    EXPECT_TRUE(internal_node::is_counted(rnode.get()));
+    EXPECT_EQ(101, node->npairs + rnode->npairs);
+    expect_child_counts(node.get());
+    expect_child_counts(rnode.get());
+
+    internal_node::init(block_size, parent.get());
+    ASSERT_TRUE(internal_node::insert(parent.get(), median.btree_key(), 300, 301));
+    internal_node::merge(block_size, node.get(), rnode.get(), parent.get());
+    verify(block_size, rnode.get());
+    EXPECT_EQ(101, rnode->npairs);
+    expect_child_counts(rnode.get());
+}
+
+TEST(InternalNodeTest, MakeCounted) {
+    block_size_t block_size = block_size_t::unsafe_make(4096);
+    scoped_malloc_t<internal_node_t> node(block_size.value());
+
+    fill_internal_node(block_size, node.get(), 100, false);
+    ASSERT_FALSE(internal_node::is_counted(node.get()));
+    EXPECT_EQ(internal_node::UNKNOWN_CHILD_COUNT,
+              internal_node::child_count(node.get(), 0));
+
+    ASSERT_TRUE(internal_node::make_counted(block_size, node.get()));
+    verify(block_size, node.get());
+    EXPECT_TRUE(internal_node::is_counted(node.get()));
+    ASSERT_EQ(100, node->npairs);
+    for (int i = 0; i < node->npairs; ++i) {
+        EXPECT_EQ(i + 1, internal_node::get_pair_by_index(node.get(), i)->lnode);
+        EXPECT_EQ(internal_node::UNKNOWN_CHILD_COUNT,
+                  internal_node::child_count(node.get(), i));
+    }
+
+    // A node that would become full isn't converted.
+    fill_internal_node(block_size, node.get(), 10, false);
+    while (!internal_node::is_full(node.get())) {
+        const int n = node->npairs;
+        const store_key_t long_key(strprintf("key%03d", n) + std::string(200, 'x'));
+        ASSERT_TRUE(internal_node::insert(node.get(), long_key.btree_key(), n, n + 1));
+    }
+    EXPECT_FALSE(internal_node::make_counted(block_size, node.get()));
+    EXPECT_FALSE(internal_node::is_counted(node.get()));
+    verify(block_size, node.get());
+}
+
 
 }  // namespace unittest
 
@@ -0,0 +1,291 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "config/args.hpp"
+#include "rapidjson/document.h"
+#include "rapidjson/memorystream.h"
+#include "random.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/json_parser.hpp"
+#include "rdb_protocol/term_storage.hpp"
+#include "time.hpp"
+#include "unittest/gtest.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+// Checks that `parse_json` gives the same result, or the same error, as parsing the
+// text with RapidJSON and converting the document with `to_datum`.  We don't use
+// `Document::Parse` here, because it can read past the terminating null byte if the
+// text ends in the middle of an escape sequence.
+void check_same_as_rapidjson(const std::string &text) {
+    const ql::configured_limits_t &limits = ql::configured_limits_t::unlimited;
+    rapidjson::Document doc;
+    rapidjson::MemoryStream stream(text.data(), text.size());
+    doc.ParseStream<rapidjson::kParseDefaultFlags, rapidjson::UTF8<> >(stream);
+    if (doc.HasParseError()) {
+        try {
+            ql::parse_json(text.data(), text.size(), limits, reql_version_t::LATEST);
+            ADD_FAILURE() << "Expected a parse error for " << text;
+        } catch (const ql::json_parse_exc_t &ex) {
+            EXPECT_EQ(doc.GetParseError(), ex.code) << text;
+        }
+        return;
+    }
+
+    ql::datum_t expected;
+    std::string expected_error;
+    try {
+        expected = ql::to_datum(doc, limits, reql_version_t::LATEST);
+    } catch (const ql::base_exc_t &ex) {
+        expected_error = ex.what();
+    }
+    try {
+        ql::datum_t actual =
+            ql::parse_json(text.data(), text.size(), limits, reql_version_t::LATEST);
+        ASSERT_EQ("", expected_error) << text;
+        ASSERT_EQ(expected, actual) << text;
+        if (expected.get_type() == ql::datum_t::R_NUM) {
+            EXPECT_EQ(std::signbit(expected.as_num()), std::signbit(actual.as_num()))
+                << text;
+        }
+    } catch (const ql::base_exc_t &ex) {
+        EXPECT_EQ(expected_error, ex.what()) << text;
+    }
+}
+
+TEST(JsonParserTest, Values) {
+    const std::vector<std::string> texts = {
+        "null", "true", "false", "\"\"", "\"abc\"", "[]", "{}", " [ ] ", "\n{\t}\r",
+        "[1,2,3]", "[[[]],[{}]]", "{\"a\":{\"b\":[1,{\"c\":null}]}}",
+        "{\"a\":1,\"b\":2,\"c\":3}", "[{\"a\":1},{\"a\":2},{\"a\":3,\"b\":\"a\"}]",
+        " { \"a\" : [ true , false , null ] , \"b\" : \"c\" } ",
+        "\"\\\"\\\\\\/\\b\\f\\n\\r\\t\"", "\"\\u0041\\u00e9\\u20ac\"",
+        "\"\\ud83d\\ude00\"", "\"\\u0000\"", "\"h\xc3\xa9llo\"",
+        "{\"\\u0061\":1}", "{\"\":\"\"}",
+        "{\"$reql_type$\":\"LITERAL\",\"value\":1}",
+        "{\"a\":{\"$reql_type$\":\"BINARY\",\"data\":\"YWJj\"}}",
+        "\"a string that is long enough to cross from one block of sixty-four "
+        "bytes into the next one, with \\\"escaped quotes\\\" in it\"" };
+    for (const std::string &text : texts) {
+        check_same_as_rapidjson(text);
+    }
+}
+
+TEST(JsonParserTest, Numbers) {
+    const std::vector<std::string> texts = {
+        "0", "-0", "0.0", "-0.0", "-0e5", "1", "-1", "123456789", "2147483648",
+        "-2147483649", "4294967296", "9007199254740993", "9223372036854775807",
+        "-9223372036854775808", "-9223372036854775809", "18446744073709551615",
+        "18446744073709551616", "123456789012345678901234567890", "0.1", "0.3",
+        "-1.5", "3.141592653589793", "2.718281828459045235360287", "1e10", "1E10",
+        "1e+10", "1e-10", "1.5e300", "1e308", "1.7976931348623157e308", "1e309",
+        "1e400", "1e-400", "4.9e-324", "2.2250738585072014e-308", "0.000001234",
+        "123.456e-7", "1e22", "1e23", "9999999999999999e22", "0.1e-22",
+        "[1.0, 2.5, -3.25e2]", "{\"a\":-0.0,\"b\":1e2}" };
+    for (const std::string &text : texts) {
+        check_same_as_rapidjson(text);
+    }
+}
+
+TEST(JsonParserTest, Errors) {
+    const std::vector<std::string> texts = {
+        "", "   ", "[", "]", "{", "}", "[1,2", "[1,]", "[,1]", "[1 2]", "[1,,2]",
+        "{\"a\"}", "{\"a\":}", "{\"a\" 1}", "{\"a\":1,}", "{\"a\":1 \"b\":2}", "{1:2}",
+        "{a:1}", "[1]]", "[1] [2]", "1 2", "tru", "truex", "nul", "[true false]",
+        "01", "-", "1.", ".5", "1e", "1e+", "+1", "-a", "\"abc", "\"\\x\"",
+        "\"\\u12\"", "\"\\u12g4\"", "\"\\ud800\"", "\"\\ud800\\u0041\"", "\"a\"b",
+        "[\"a\"\"b\"]", "{\"a\"x:1}", "\"\x01\"", "[1]x", "\\", "[\\\"a\"]",
+        "{\"a\":1,\"a\":2}", "\"\xff\"", "{\"\xc3\":1}", "\"\\udc00\"",
+        "{\"$reql_type$\":\"FOO\"}" };
+    for (const std::string &text : texts) {
+        check_same_as_rapidjson(text);
+    }
+}
+
+TEST(JsonParserTest, BlockBoundaries) {
+    // Runs of backslashes and quotes need to be handled the same no matter where
+    // they fall relative to the 64 byte blocks of the first pass.
+    for (size_t prefix = 50; prefix < 140; ++prefix) {
+        for (size_t backslashes = 0; backslashes < 6; ++backslashes) {
+            const std::string run =
+                std::string(prefix, 'a') + std::string(backslashes, '\\');
+            check_same_as_rapidjson("[\"" + run + "\", 1]");
+            check_same_as_rapidjson("[\"" + run + "\"\", 1]");
+            check_same_as_rapidjson("{\"" + run + "\":[\"" + run + "\"]}");
+            check_same_as_rapidjson(
+                "[" + std::string(prefix, ' ') + "\"" + std::string(backslashes, '\\')
+                + "\"]");
+            check_same_as_rapidjson("[" + std::string(prefix, '1') + "]");
+        }
+    }
+}
+
+void random_json(rng_t *rng, int depth, std::string *out) {
+    const char *const keys[] = { "id", "name", "a", "\\u00e9", "nested", "" };
+    const char *const whitespace[] = { "", "", " ", "\n  ", "\t" };
+    *out += whitespace[rng->randint(5)];
+    switch (depth > 0 ? rng->randint(8) : 2 + rng->randint(6)) {
+    case 0: {
+        *out += "[";
+        const int size = rng->randint(5);
+        for (int i = 0; i < size; ++i) {
+            if (i != 0) {
+                *out += ",";
+            }
+            random_json(rng, depth - 1, out);
+        }
+        *out += "]";
+    } break;
+    case 1: {
+        *out += "{";
+        const int size = rng->randint(5);
+        for (int i = 0; i < size; ++i) {
+            if (i != 0) {
+                *out += ",";
+            }
+            *out += strprintf("\"%s%d\":", keys[rng->randint(6)], i);
+            random_json(rng, depth - 1, out);
+        }
+        *out += "}";
+    } break;
+    case 2: *out += strprintf("%d", rng->randint(2000000) - 1000000); break;
+    case 3: *out += strprintf("%.17g", (rng->randdouble() - 0.5) * 1e6); break;
+    case 4: *out += strprintf("%de%d", rng->randint(1000), rng->randint(60) - 30); break;
+    case 5: {
+        *out += "\"";
+        const char *const parts[] = { "abc", "\\\"", "\\\\", "\\n", "\\u20ac", " ",
+                                      "\xc3\xa9", "0123456789abcdef" };
+        const int size = rng->randint(12);
+        for (int i = 0; i < size; ++i) {
+            *out += parts[rng->randint(8)];
+        }
+        *out += "\"";
+    } break;
+    case 6: *out += rng->randint(2) == 0 ? "true" : "false"; break;
+    case 7: *out += "null"; break;
+    default: unreachable();
+    }
+    *out += whitespace[rng->randint(5)];
+}
+
+TEST(JsonParserTest, RandomDocuments) {
+    rng_t rng(1234);
+    for (int i = 0; i < 2000; ++i) {
+        std::string text;
+        random_json(&rng, 4, &text);
+        check_same_as_rapidjson(text);
+        // Also try a prefix of the text, which is usually invalid.
+        check_same_as_rapidjson(text.substr(0, rng.randsize(text.size() + 1)));
+    }
+}
+
+// This is not really a unit test, but a micro benchmark that compares `parse_json`
+// to RapidJSON and `to_datum`.  No need to run this in debug mode.
+#ifdef NDEBUG
+double secs_since(ticks_t start) {
+    return ticks_to_secs(ticks_t{get_ticks().nanos - start.nanos});
+}
+
+// Documents as they may be bulk inserted.  With `as_terms` the arrays in the documents
+// are written as `MAKE_ARRAY` terms, the way the drivers send them in a query.
+std::string benchmark_documents(bool as_terms) {
+    std::string text;
+    rng_t rng(5678);
+    const int NUM_DOCUMENTS = 10000;
+    for (int i = 0; i < NUM_DOCUMENTS; ++i) {
+        text += strprintf(
+            "%s{\"id\":\"%08x-4a5b-4c6d-8e9f-%012d\",\"name\":\"User number %d\","
+            "\"email\":\"user%d@example.com\",\"age\":%d,\"score\":%.6f,"
+            "\"active\":%s,\"tags\":%s[\"alpha\",\"beta\",\"gamma\"]%s,"
+            "\"address\":{\"street\":\"%d Main Street\",\"city\":\"Springfield\","
+            "\"zip\":\"%05d\"},\"bio\":\"Likes \\\"quotes\\\" and caf\\u00e9s.\"}",
+            i == 0 ? "" : ",", i, i, i, i, 18 + rng.randint(60),
+            rng.randdouble() * 100, rng.randint(2) == 0 ? "true" : "false",
+            as_terms ? "[2," : "", as_terms ? "]" : "",
+            rng.randint(1000), rng.randint(100000));
+    }
+    return text;
+}
+
+TEST(JsonParserTest, ParseBenchmark) {
+    // Documents as they may be bulk inserted, in an array.
+    const std::string text = "[" + benchmark_documents(false) + "]";
+
+    const int NUM_REPETITIONS = 20;
+    const ql::configured_limits_t &limits = ql::configured_limits_t::unlimited;
+    ql::datum_t rapidjson_result;
+    ticks_t start_ticks = get_ticks();
+    for (int i = 0; i < NUM_REPETITIONS; ++i) {
+        rapidjson::Document doc;
+        doc.Parse(text.c_str());
+        ASSERT_FALSE(doc.HasParseError());
+        rapidjson_result = ql::to_datum(doc, limits, reql_version_t::LATEST);
+    }
+    const double rapidjson_secs = secs_since(start_ticks);
+
+    ql::datum_t result;
+    start_ticks = get_ticks();
+    for (int i = 0; i < NUM_REPETITIONS; ++i) {
+        result = ql::parse_json(
+            text.data(), text.size(), limits, reql_version_t::LATEST);
+    }
+    const double parse_json_secs = secs_since(start_ticks);
+    ASSERT_EQ(rapidjson_result, result);
+
+    const double megabytes =
+        static_cast<double>(text.size()) * NUM_REPETITIONS / MEGABYTE;
+    printf("RapidJSON and to_datum: %f MB/s\n", megabytes / rapidjson_secs);
+    printf("parse_json: %f MB/s\n", megabytes / parse_json_secs);
+}
+
+// Measures what a bulk insert query costs before it is compiled, to compare with
+// `parse_json` on the same documents.  The query is parsed in place into a DOM that
+// `preprocess_term_tree` rewrites into terms, so `parse_json` could only replace the
+// first of these steps.
+TEST(JsonParserTest, QueryBenchmark) {
+    const std::string query =
+        "[1,[56,[[15,[[14,[\"test\"]],\"users\"]],[2,["
+        + benchmark_documents(true) + "]]]],{}]";
+    const std::string payload = "[" + benchmark_documents(false) + "]";
+
+    const int NUM_REPETITIONS = 20;
+    double parse_secs = 0;
+    double preprocess_secs = 0;
+    for (int i = 0; i < NUM_REPETITIONS; ++i) {
+        scoped_array_t<char> buffer(query.size() + 1);
+        memcpy(buffer.data(), query.c_str(), query.size() + 1);
+        ticks_t start_ticks = get_ticks();
+        rapidjson::Document doc;
+        doc.ParseInsitu(buffer.data());
+        ASSERT_FALSE(doc.HasParseError());
+        parse_secs += secs_since(start_ticks);
+
+        start_ticks = get_ticks();
+        ql::json_term_storage_t term_storage(std::move(buffer), std::move(doc));
+        term_storage.preprocess();
+        preprocess_secs += secs_since(start_ticks);
+    }
+
+    const ql::configured_limits_t &limits = ql::configured_limits_t::unlimited;
+    ticks_t start_ticks = get_ticks();
+    for (int i = 0; i < NUM_REPETITIONS; ++i) {
+        ql::parse_json(payload.data(), payload.size(), limits, reql_version_t::LATEST);
+    }
+    const double parse_json_secs = secs_since(start_ticks);
+
+    const double megabytes =
+        static_cast<double>(query.size()) * NUM_REPETITIONS / MEGABYTE;
+    printf("Query ParseInsitu: %f MB/s\n", megabytes / parse_secs);
+    printf("Query preprocess_term_tree: %f MB/s\n", megabytes / preprocess_secs);
+    printf("parse_json of the documents: %f MB/s\n",
+           static_cast<double>(payload.size()) * NUM_REPETITIONS / MEGABYTE
+           / parse_json_secs);
+}
+#endif
+
+}  // namespace unittest
@@ -15,9 +15,9 @@ namespace unittest {
 
 class LeafNodeTracker {
 public:
-    LeafNodeTracker()
+    explicit LeafNodeTracker(bool prefix_compression = false)
         : bs_(max_block_size_t::unsafe_make(4096)),
-          sizer_(bs_),
+          sizer_(bs_, prefix_compression),
           node_(bs_.value()),
           tstamp_counter_(0),
           maximum_existing_tstamp_(repli_timestamp_t::distant_past) {
@@ -346,16 +346,18 @@ scoped_ptr_t<LeafNodeTracker> test_random_out_of_order(
         int num_ops,
         bool random_tstamps,
         store_key_t low_key = store_key_t::min(),
-        store_key_t high_key = store_key_t::max()) {
+        store_key_t high_key = store_key_t::max(),
+        bool prefix_compression = false,
+        const std::string &key_prefix = std::string()) {
 
-    scoped_ptr_t<LeafNodeTracker> tracker(new LeafNodeTracker());
+    scoped_ptr_t<LeafNodeTracker> tracker(new LeafNodeTracker(prefix_compression));
 
     rng_t rng;
 
     std::vector<store_key_t> key_pool(num_keys);
     for (int i = 0; i < num_keys; ++i) {
         do {
-            key_pool[i] = store_key_t(random_letter_string(&rng, 0, 159));
+            key_pool[i] = store_key_t(key_prefix + random_letter_string(&rng, 0, 159));
         } while (key_pool[i].compare(low_key) < 0 || key_pool[i].compare(high_key) >= 0);
     }
 
@@ -402,11 +404,12 @@ void make_node_underfull(LeafNodeTracker *tracker, rng_t *rng) {
     while (!tracker->IsUnderfull() ||
            (node->num_pairs > 0 && rng->randint(2) == 0)) {
         int chosen = rng->randint(node->num_pairs);
-        auto pair = *leaf_node_t::iterator(node, chosen);
+        // The key pointer is only valid as long as the iterator exists.
+        store_key_t key((*leaf_node_t::iterator(node, chosen)).first);
 
         // We might hit a removal entry; skip those.
-        if (tracker->ShouldHave(store_key_t(pair.first))) {
-            tracker->Remove(store_key_t(pair.first));
+        if (tracker->ShouldHave(key)) {
+            tracker->Remove(key);
         }
     }
 }
@@ -711,4 +714,148 @@ TEST(LeafNodeTest, Fullness) {
     ASSERT_TRUE(node.IsFull(store_key_t(strprintf("a%d", i)), strprintf("A%d", i)));
 }
 
+// Keys in the prefix-compressed tests share this prefix, the way keys of one
+// table or secondary index do.
+const char *const shared_key_prefix = "a_table_name_that_is_shared_by_all_keys/";
+
+// Inserts random keys that start with `prefix` until the node is full.
+void fill_node(LeafNodeTracker *tracker, rng_t *rng, const std::string &prefix) {
+    while (true) {
+        store_key_t key(prefix + random_letter_string(rng, 0, 40));
+        std::string value = random_letter_string(rng, 0, 40);
+        if (tracker->IsFull(key, value)) {
+            break;
+        }
+        tracker->Insert(key, value);
+    }
+}
+
+TEST(LeafNodeTest, PrefixedRandomOutOfOrder) {
+    for (int try_num = 0; try_num < 10; ++try_num) {
+        test_random_out_of_order(10, 20000, true, store_key_t::min(),
+                                 store_key_t::max(), true, shared_key_prefix);
+        test_random_out_of_order(50, 20000, false, store_key_t::min(),
+                                 store_key_t::max(), true, shared_key_prefix);
+    }
+}
+
+TEST(LeafNodeTest, PrefixedRandomSplitting) {
+    rng_t rng;
+
+    for (int try_num = 0; try_num < 100; ++try_num) {
+        bool zero_timestamps = (try_num % 2) == 0;
+
+        scoped_ptr_t<LeafNodeTracker> node = test_random_out_of_order(
+                40, 200, zero_timestamps, store_key_t::min(), store_key_t::max(),
+                true, shared_key_prefix);
+        fill_node(node.get(), &rng, shared_key_prefix);
+
+        LeafNodeTracker right(true);
+        node->Split(&right);
+
+        // The halves now have longer prefixes. Keep modifying them, including
+        // with keys that don't share those prefixes.
+        for (int i = 0; i < 200; ++i) {
+            LeafNodeTracker *half = rng.randint(2) == 0 ? node.get() : &right;
+            store_key_t key(std::string(shared_key_prefix, rng.randint(strlen(shared_key_prefix) + 1))
+                            + random_letter_string(&rng, 0, 40));
+            if (half->ShouldHave(key) && rng.randint(2) == 0) {
+                half->Remove(key);
+            } else {
+                half->Insert(key, random_letter_string(&rng, 0, 40));
+            }
+        }
+    }
+}
+
+TEST(LeafNodeTest, PrefixedRandomMergingAndLeveling) {
+    rng_t rng;
+
+    for (int try_num = 0; try_num < 100; ++try_num) {
+        LeafNodeTracker left(true);
+        fill_node(&left, &rng, shared_key_prefix);
+        LeafNodeTracker right(true);
+        left.Split(&right);
+
+        make_node_underfull(&left, &rng);
+        if (try_num % 2 == 0) {
+            make_node_underfull(&right, &rng);
+        }
+
+        // Like `check_and_handle_underfull()` does.
+        if (leaf::is_mergable(right.sizer(), left.node(), right.node())) {
+            right.Merge(&left);
+        } else {
+            bool could_level;
+            left.Level(-1, &right, &could_level);
+        }
+    }
+}
+
+TEST(LeafNodeTest, MixedFormatMerging) {
+    rng_t rng;
+
+    for (int try_num = 0; try_num < 100; ++try_num) {
+        // Existing nodes keep the classic format even if new nodes are
+        // prefix-compressed.
+        LeafNodeTracker left(false);
+        LeafNodeTracker right(true);
+        for (int i = 0; i < 20; ++i) {
+            left.Insert(store_key_t(strprintf("a%d", i)), strprintf("A%d", i));
+        }
+        fill_node(&right, &rng, shared_key_prefix);
+        LeafNodeTracker rightmost(true);
+        right.Split(&rightmost);
+        make_node_underfull(&right, &rng);
+
+        if (leaf::is_mergable(right.sizer(), left.node(), right.node())) {
+            right.Merge(&left);
+        } else {
+            bool could_level;
+            left.Level(-1, &right, &could_level);
+        }
+    }
+}
+
+TEST(LeafNodeTest, MixedFormatLeveling) {
+    rng_t rng;
+
+    for (int try_num = 0; try_num < 100; ++try_num) {
+        LeafNodeTracker left(true);
+        LeafNodeTracker right(false);
+        fill_node(&left, &rng, shared_key_prefix);
+        LeafNodeTracker middle(true);
+        left.Split(&middle);
+        right.Insert(store_key_t("b0"), "B0");
+
+        // Entries move from the prefix-compressed node to the classic one.
+        bool could_level;
+        right.Level(1, &middle, &could_level);
+        ASSERT_TRUE(could_level);
+    }
+}
+
+TEST(LeafNodeTest, PrefixCompressionDensity) {
+    // After a split the halves of a prefix-compressed node only store the part
+    // of the keys after the shared prefix, so they take more keys than the
+    // halves of a classic node.
+    int num_keys[2];
+    for (int prefix_compression = 0; prefix_compression < 2; ++prefix_compression) {
+        LeafNodeTracker left(prefix_compression != 0);
+        int i = 0;
+        while (left.Insert(store_key_t(strprintf("%s%04d", shared_key_prefix, i)),
+                           strprintf("%d", i))) {
+            ++i;
+        }
+        LeafNodeTracker right(prefix_compression != 0);
+        left.Split(&right);
+        while (right.Insert(store_key_t(strprintf("%s%04d", shared_key_prefix, i)),
+                            strprintf("%d", i))) {
+            ++i;
+        }
+        num_keys[prefix_compression] = i;
+    }
+    ASSERT_GT(num_keys[1], num_keys[0] * 3 / 2);
+}
+
 }  // namespace unittest
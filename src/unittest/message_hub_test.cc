@@ -0,0 +1,62 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "time.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// This is not really a unit test, but a micro benchmark for the cost of switching
+// threads with `on_thread_t`, which goes through the message hubs.  No need to run this
+// in debug mode.
+#ifdef NDEBUG
+static double hop_secs_since(ticks_t start) {
+    return ticks_to_secs(ticks_t{get_ticks().nanos - start.nanos});
+}
+
+TEST(MessageHubTest, HopBenchmark) {
+    const int num_threads = 8;
+    run_in_thread_pool([&]() {
+        // Latency: a single coroutine bouncing between two otherwise idle threads, so
+        // every hop has to wake up the receiving thread.
+        const int NUM_ROUND_TRIPS = 50000;
+        ticks_t start_ticks = get_ticks();
+        for (int i = 0; i < NUM_ROUND_TRIPS; ++i) {
+            on_thread_t t((threadnum_t(1)));
+        }
+        const double latency_secs = hop_secs_since(start_ticks);
+
+        // Throughput: many coroutines that all hop from every other thread back to
+        // thread 0 at the same time, so thread 0 receives from many senders at once.
+        const int NUM_COROS = 1000;
+        const int ROUND_TRIPS_PER_CORO = 100;
+        int num_finished = 0;
+        start_ticks = get_ticks();
+        {
+            auto_drainer_t drainer;
+            for (int i = 0; i < NUM_COROS; ++i) {
+                auto_drainer_t::lock_t lock(&drainer);
+                coro_t::spawn_sometime([&num_finished, i, num_threads, lock]() {
+                    threadnum_t other_thread(i % (num_threads - 1) + 1);
+                    for (int j = 0; j < ROUND_TRIPS_PER_CORO; ++j) {
+                        on_thread_t t(other_thread);
+                    }
+                    ++num_finished;
+                });
+            }
+            drainer.drain();
+        }
+        const double throughput_secs = hop_secs_since(start_ticks);
+        ASSERT_EQ(NUM_COROS, num_finished);
+
+        printf("Hop latency: %f us\n",
+               latency_secs * 1000000 / (2 * NUM_ROUND_TRIPS));
+        printf("Hop throughput: %f hops/s\n",
+               2.0 * NUM_COROS * ROUND_TRIPS_PER_CORO / throughput_secs);
+    }, num_threads);
+}
+#endif
+
+}  // namespace unittest
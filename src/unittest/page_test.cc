@@ -1,10 +1,13 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <vector>
+
 #include "arch/runtime/coroutines.hpp"
 #include "arch/timing.hpp"
 #include "buffer_cache/page_cache.hpp"
 #include "buffer_cache/alt.hpp"
 #include "buffer_cache/cache_balancer.hpp"
 #include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
 #include "concurrency/pmap.hpp"
 #include "containers/scoped.hpp"
 #include "serializer/log/log_serializer.hpp"
@@ -312,8 +315,11 @@ TPTEST(PageTest, WriteWaitForFlush, 4) {
 
 class bigger_test_t {
 public:
-    explicit bigger_test_t(uint64_t _memory_limit)
-        : memory_limit(_memory_limit), mock(), c(NULL),
+    explicit bigger_test_t(uint64_t _memory_limit,
+                           cache_eviction_policy_t _eviction_policy
+                               = cache_eviction_policy_t::random_sampling)
+        : memory_limit(_memory_limit), eviction_policy(_eviction_policy),
+          mock(), c(NULL),
           txn1_ptr(NULL), txn2_ptr(NULL) {
         for (size_t i = 0; i < b_len; ++i) {
             b[i] = NULL_BLOCK_ID;
@@ -322,7 +328,7 @@ public:
 
     void run() {
         {
-            dummy_cache_balancer_t balancer(memory_limit);
+            dummy_cache_balancer_t balancer(memory_limit, eviction_policy);
             test_cache_t cache(mock.ser.get(), &balancer, mock.throttler.get());
             auto_drainer_t drain;
             c = &cache;
@@ -368,7 +374,7 @@ public:
         c = nullptr;
 
         {
-            dummy_cache_balancer_t balancer(memory_limit);
+            dummy_cache_balancer_t balancer(memory_limit, eviction_policy);
             test_cache_t cache(mock.ser.get(), &balancer, mock.throttler.get());
             auto_drainer_t drain;
             c = &cache;
@@ -380,7 +386,7 @@ public:
         c = nullptr;
 
         {
-            dummy_cache_balancer_t balancer(memory_limit);
+            dummy_cache_balancer_t balancer(memory_limit, eviction_policy);
             test_cache_t cache(mock.ser.get(), &balancer, mock.throttler.get());
             c = &cache;
             auto txn = make_scoped<test_txn_t>(c);
@@ -1127,6 +1133,7 @@ private:
     }
 
     const uint64_t memory_limit;
+    const cache_eviction_policy_t eviction_policy;
 
     mock_ser_t mock;
     test_cache_t *c;
@@ -1177,4 +1184,175 @@ TPTEST(PageTest, BiggerTestNoMemory, 4) {
     test.run();
 }
 
+TPTEST(PageTest, BiggerTestTightMemoryTwoQueue, 4) {
+    bigger_test_t test(8192, cache_eviction_policy_t::two_queue);
+    test.run();
+}
+
+TPTEST(PageTest, BiggerTestNoMemoryTwoQueue, 4) {
+    bigger_test_t test(0, cache_eviction_policy_t::two_queue);
+    test.run();
+}
+
+void read_blocks(test_cache_t *cache, const std::vector<block_id_t> &block_ids) {
+    auto txn = make_scoped<test_txn_t>(cache);
+    for (block_id_t block_id : block_ids) {
+        current_test_acq_t acq(txn.get(), block_id, access_t::read);
+        test_acq_t page_acq;
+        page_acq.init(acq.current_page_for_read(), cache);
+        page_acq.get_buf_read();
+    }
+    cache->flush(std::move(txn));
+}
+
+// Reads a few hot blocks before every scan over blocks that haven't been read
+// before, in a cache that holds fewer pages than a scan reads.  Returns how often
+// the hot blocks had to be read from disk after the first few rounds.
+uint64_t count_hot_misses_between_scans(cache_eviction_policy_t eviction_policy) {
+    const size_t num_hot_blocks = 4;
+    const size_t scan_length = 40;
+    const size_t num_rounds = 10;
+    const size_t num_warm_up_rounds = 3;
+
+    mock_ser_t mock;
+    std::vector<block_id_t> hot_block_ids;
+    std::vector<std::vector<block_id_t> > scan_block_ids(num_rounds);
+    {
+        dummy_cache_balancer_t balancer(GIGABYTE);
+        test_cache_t cache(mock.ser.get(), &balancer, mock.throttler.get());
+        auto txn = make_scoped<test_txn_t>(&cache);
+        for (size_t i = 0; i < num_hot_blocks + num_rounds * scan_length; ++i) {
+            current_test_acq_t acq(txn.get(), alt_create_t::create);
+            test_acq_t page_acq;
+            page_acq.init(acq.current_page_for_write(), &cache);
+            memset(page_acq.get_buf_write(), 0, page_acq.get_buf_size().value());
+            if (i < num_hot_blocks) {
+                hot_block_ids.push_back(acq.block_id());
+            } else {
+                scan_block_ids[(i - num_hot_blocks) / scan_length].push_back(
+                    acq.block_id());
+            }
+        }
+        cache.flush(std::move(txn));
+    }
+
+    // Room for about 16 pages.
+    const uint64_t memory_limit = 16 * mock.ser->max_block_size().ser_value();
+    dummy_cache_balancer_t balancer(memory_limit, eviction_policy);
+    test_cache_t cache(mock.ser.get(), &balancer, mock.throttler.get());
+    uint64_t hot_misses = 0;
+    for (size_t round = 0; round < num_rounds; ++round) {
+        const uint64_t misses_before = cache.evicter().page_misses();
+        read_blocks(&cache, hot_block_ids);
+        if (round >= num_warm_up_rounds) {
+            hot_misses += cache.evicter().page_misses() - misses_before;
+        }
+        read_blocks(&cache, scan_block_ids[round]);
+    }
+
+    // Every block got read at least once, and the hot ones got read repeatedly.
+    EXPECT_LE(num_hot_blocks + num_rounds * scan_length, cache.evicter().page_misses());
+    EXPECT_LE(num_hot_blocks + num_rounds * (num_hot_blocks + scan_length),
+              cache.evicter().page_hits() + cache.evicter().page_misses());
+    return hot_misses;
+}
+
+TPTEST(PageTest, TwoQueueScanResistance, 4) {
+    // The hot blocks get evicted during the first scan, read again from disk while
+    // the evicter still remembers them, and are protected from eviction after that.
+    EXPECT_EQ(0u, count_hot_misses_between_scans(cache_eviction_policy_t::two_queue));
+    // The scans push the hot blocks out of the cache every time.
+    EXPECT_LT(0u, count_hot_misses_between_scans(
+        cache_eviction_policy_t::random_sampling));
+}
+
+TPTEST(PageTest, WarmUp, 4) {
+    const size_t num_blocks = 20;
+
+    mock_ser_t mock;
+    std::vector<block_id_t> block_ids;
+    {
+        dummy_cache_balancer_t balancer(GIGABYTE);
+        test_cache_t cache(mock.ser.get(), &balancer, mock.throttler.get());
+        auto txn = make_scoped<test_txn_t>(&cache);
+        for (size_t i = 0; i < num_blocks; ++i) {
+            current_test_acq_t acq(txn.get(), alt_create_t::create);
+            test_acq_t page_acq;
+            page_acq.init(acq.current_page_for_write(), &cache);
+            memset(page_acq.get_buf_write(), 0, page_acq.get_buf_size().value());
+            block_ids.push_back(acq.block_id());
+        }
+        cache.flush(std::move(txn));
+    }
+
+    const std::vector<block_id_t> hot_block_ids
+        = { block_ids[3], block_ids[17], block_ids[8] };
+    std::vector<block_id_t> saved_block_ids;
+    {
+        dummy_cache_balancer_t balancer(GIGABYTE);
+        test_cache_t cache(mock.ser.get(), &balancer, mock.throttler.get());
+        read_blocks(&cache, hot_block_ids);
+        saved_block_ids = cache.evicter().hottest_block_ids(num_blocks);
+        // Only the most recently accessed blocks are kept when there are too many.
+        const std::vector<block_id_t> expected_hottest_two
+            = { block_ids[8], block_ids[17] };
+        ASSERT_EQ(expected_hottest_two, cache.evicter().hottest_block_ids(2));
+    }
+    // The most recently accessed block comes first.
+    const std::vector<block_id_t> expected_block_ids
+        = { block_ids[8], block_ids[17], block_ids[3] };
+    ASSERT_EQ(expected_block_ids, saved_block_ids);
+
+    dummy_cache_balancer_t balancer(GIGABYTE);
+    test_cache_t cache(mock.ser.get(), &balancer, mock.throttler.get());
+    // Blocks that don't exist anymore get skipped.
+    saved_block_ids.push_back(block_ids.back() + 1);
+    cond_t non_interruptor;
+    cache.warm_up(saved_block_ids, &non_interruptor);
+    read_blocks(&cache, hot_block_ids);
+    EXPECT_EQ(0u, cache.evicter().page_misses());
+    EXPECT_EQ(hot_block_ids.size(), cache.evicter().page_hits());
+}
+
+TPTEST(PageTest, Prefetch, 4) {
+    const size_t num_blocks = 20;
+
+    mock_ser_t mock;
+    std::vector<block_id_t> block_ids;
+    {
+        dummy_cache_balancer_t balancer(GIGABYTE);
+        test_cache_t cache(mock.ser.get(), &balancer, mock.throttler.get());
+        auto txn = make_scoped<test_txn_t>(&cache);
+        for (size_t i = 0; i < num_blocks; ++i) {
+            current_test_acq_t acq(txn.get(), alt_create_t::create);
+            test_acq_t page_acq;
+            page_acq.init(acq.current_page_for_write(), &cache);
+            memset(page_acq.get_buf_write(), 0, page_acq.get_buf_size().value());
+            block_ids.push_back(acq.block_id());
+        }
+        cache.flush(std::move(txn));
+    }
+
+    dummy_cache_balancer_t balancer(GIGABYTE);
+    test_cache_t cache(mock.ser.get(), &balancer, mock.throttler.get());
+    const std::vector<block_id_t> prefetched_block_ids(
+        block_ids.begin(), block_ids.begin() + num_blocks / 2);
+    for (block_id_t block_id : prefetched_block_ids) {
+        cache.prefetch(block_id, cache.default_reads_account());
+        // Prefetching a block twice doesn't load it twice.
+        cache.prefetch(block_id, cache.default_reads_account());
+    }
+    // Blocks that don't exist get skipped.
+    cache.prefetch(block_ids.back() + 1, cache.default_reads_account());
+    EXPECT_EQ(prefetched_block_ids.size(), cache.evicter().prefetches());
+
+    read_blocks(&cache, block_ids);
+    EXPECT_EQ(prefetched_block_ids.size(), cache.evicter().prefetch_hits());
+    EXPECT_EQ(0u, cache.evicter().prefetch_waste());
+    // Acquiring a block only counts as a prefetch hit once.
+    read_blocks(&cache, prefetched_block_ids);
+    EXPECT_EQ(prefetched_block_ids.size(), cache.evicter().prefetch_hits());
+    EXPECT_EQ(num_blocks, cache.evicter().page_misses());
+}
+
 }  // namespace unittest
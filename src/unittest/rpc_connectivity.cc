@@ -11,9 +11,11 @@
 #include "arch/timing.hpp"
 #include "containers/scoped.hpp"
 #include "containers/archive/socket_stream.hpp"
+#include "containers/archive/vector_stream.hpp"
 #include "unittest/clustering_utils.hpp"
 #include "unittest/unittest_utils.hpp"
 #include "rpc/connectivity/cluster.hpp"
+#include "rpc/connectivity/compression.hpp"
 #include "unittest/gtest.hpp"
 
 namespace unittest {
@@ -46,11 +48,8 @@ public:
         public:
             explicit writer_t(int _data) : data(_data) { }
             virtual ~writer_t() { }
-            void write(write_stream_t *stream) {
-                write_message_t wm;
-                serialize<cluster_version_t::CLUSTER>(&wm, data);
-                int res = send_write_message(stream, &wm);
-                if (res) { throw fake_archive_exc_t(); }
+            void write(write_message_t *wm) {
+                serialize<cluster_version_t::CLUSTER>(wm, data);
             }
 #ifdef ENABLE_MESSAGE_PROFILER
             const char *message_profiler_tag() const {
@@ -400,13 +399,12 @@ public:
             public cluster_send_message_write_callback_t {
         public:
             virtual ~dump_spectrum_writer_t() { }
-            void write(write_stream_t *stream) {
+            void write(write_message_t *wm) {
                 char spectrum[CHAR_MAX - CHAR_MIN + 1];
                 for (int i = CHAR_MIN; i <= CHAR_MAX; i++) {
                     spectrum[i - CHAR_MIN] = i;
                 }
-                int64_t res = stream->write(spectrum, CHAR_MAX - CHAR_MIN + 1);
-                if (res != CHAR_MAX - CHAR_MIN + 1) { throw fake_archive_exc_t(); }
+                wm->append(spectrum, CHAR_MAX - CHAR_MIN + 1);
             }
 #ifdef ENABLE_MESSAGE_PROFILER
             const char *message_profiler_tag() const {
@@ -452,6 +450,180 @@ TPTEST_MULTITHREAD(RPCConnectivityTest, BinaryData, 3) {
     EXPECT_TRUE(a2.got_spectrum);
 }
 
+/* `LargeMessages` sends a batch of messages that is big enough to be written with
+`writev()`, and makes sure they arrive intact and in order. */
+
+class large_message_application_t : public cluster_message_handler_t {
+public:
+    explicit large_message_application_t(connectivity_cluster_t *cm) :
+        cluster_message_handler_t(cm, 'L') { }
+    static const int64_t message_size = 100000;
+    void send_large(peer_id_t peer, const std::vector<char> &seeds) {
+        class large_writer_t : public cluster_send_message_write_callback_t {
+        public:
+            explicit large_writer_t(char _seed) : seed(_seed) { }
+            void write(write_message_t *wm) {
+                std::vector<char> data(message_size);
+                for (int64_t i = 0; i < message_size; ++i) {
+                    data[i] = seed + i;
+                }
+                wm->append(data.data(), data.size());
+            }
+#ifdef ENABLE_MESSAGE_PROFILER
+            const char *message_profiler_tag() const {
+                return "unittest";
+            }
+#endif
+        private:
+            char seed;
+        };
+        std::vector<large_writer_t> writers(seeds.begin(), seeds.end());
+        std::vector<cluster_send_message_write_callback_t *> writer_ptrs;
+        for (auto &writer : writers) {
+            writer_ptrs.push_back(&writer);
+        }
+        auto_drainer_t::lock_t connection_keepalive;
+        connectivity_cluster_t::connection_t *connection =
+            get_connectivity_cluster()->get_connection(peer, &connection_keepalive);
+        ASSERT_TRUE(connection != nullptr);
+        get_connectivity_cluster()->send_messages(connection, connection_keepalive,
+                                                  get_message_tag(), writer_ptrs);
+    }
+    void on_message(connectivity_cluster_t::connection_t *,
+                    auto_drainer_t::lock_t,
+                    read_stream_t *stream) {
+        std::vector<char> data(message_size);
+        int64_t res = force_read(stream, data.data(), message_size);
+        if (res != message_size) { throw fake_archive_exc_t(); }
+        char seed = data[0];
+        for (int64_t i = 0; i < message_size; ++i) {
+            EXPECT_EQ(static_cast<char>(seed + i), data[i]);
+        }
+        received.push_back(seed);
+    }
+    std::vector<char> received;
+};
+
+TPTEST_MULTITHREAD(RPCConnectivityTest, LargeMessages, 3) {
+    connectivity_cluster_t c1, c2;
+    large_message_application_t a1(&c1), a2(&c2);
+    test_cluster_run_t cr1(&c1);
+    test_cluster_run_t cr2(&c2);
+    cr1.join(get_cluster_local_address(&c2), 0);
+
+    let_stuff_happen();
+
+    std::vector<char> seeds = {1, 2, 3};
+    a1.send_large(c2.get_me(), seeds);
+
+    let_stuff_happen();
+
+    EXPECT_EQ(seeds, a2.received);
+}
+
+/* `Compression` checks that both large and small messages arrive intact and in order
+over connections that compress them, and that a server that doesn't compress can
+still talk to ones that do. */
+TPTEST_MULTITHREAD(RPCConnectivityTest, Compression, 3) {
+    connectivity_cluster_t c1, c2, c3;
+    recording_test_application_t a1(&c1, 'T'), a2(&c2, 'T'), a3(&c3, 'T');
+    large_message_application_t l1(&c1), l2(&c2), l3(&c3);
+    test_cluster_run_t cr1(&c1, peer_address_t(), cluster_compression_t::zlib);
+    test_cluster_run_t cr2(&c2, peer_address_t(), cluster_compression_t::zlib);
+    test_cluster_run_t cr3(&c3, peer_address_t(), cluster_compression_t::none);
+    cr2.join(get_cluster_local_address(&c1), 0);
+    cr3.join(get_cluster_local_address(&c1), 0);
+
+    let_stuff_happen();
+
+    for (int i = 0; i < 10; ++i) {
+        a1.send(i, c2.get_me());
+        a1.send(i, c3.get_me());
+        a3.send(100 + i, c1.get_me());
+    }
+    std::vector<char> seeds = {1, 2, 3};
+    l1.send_large(c2.get_me(), seeds);
+    l1.send_large(c3.get_me(), seeds);
+    l2.send_large(c1.get_me(), seeds);
+    l3.send_large(c1.get_me(), seeds);
+
+    let_stuff_happen();
+
+    for (int i = 0; i < 10; ++i) {
+        a2.expect(i, c1.get_me());
+        a3.expect(i, c1.get_me());
+        a1.expect(100 + i, c3.get_me());
+    }
+    for (int i = 1; i < 10; ++i) {
+        a2.expect_order(i - 1, i);
+    }
+    EXPECT_EQ(seeds, l2.received);
+    EXPECT_EQ(seeds, l3.received);
+    EXPECT_EQ(std::vector<char>({1, 2, 3, 1, 2, 3}), l1.received);
+}
+
+/* `CompressionStream` checks that the messages of a compressed stream decompress to
+what was compressed, and that corrupted data is detected. */
+TEST(RPCConnectivityTest, CompressionStream) {
+    message_compressor_t compressor;
+    message_decompressor_t decompressor;
+    for (int i = 0; i < 5; ++i) {
+        std::string contents = strprintf("message %d ", i);
+        for (int j = 0; j < 10000 * i; ++j) {
+            contents += static_cast<char>('a' + j % 7);
+        }
+        write_message_t message;
+        message.append(contents.data(), contents.size());
+        write_message_t compressed;
+        compressor.compress('T', &message, &compressed);
+
+        vector_stream_t stream;
+        ASSERT_EQ(0, send_write_message(&stream, &compressed));
+        std::vector<char> decompressed;
+        ASSERT_TRUE(decompressor.decompress(stream.vector().data(),
+                                            stream.vector().size(),
+                                            MAX_COMPRESSED_MESSAGE_SIZE,
+                                            &decompressed));
+        ASSERT_EQ(contents.size() + 1, decompressed.size());
+        EXPECT_EQ('T', decompressed[0]);
+        EXPECT_EQ(contents, std::string(decompressed.begin() + 1, decompressed.end()));
+    }
+
+    message_decompressor_t corrupted_decompressor;
+    std::vector<char> garbage(100, static_cast<char>(0xff));
+    std::vector<char> decompressed;
+    EXPECT_FALSE(corrupted_decompressor.decompress(garbage.data(), garbage.size(),
+                                                   MAX_COMPRESSED_MESSAGE_SIZE,
+                                                   &decompressed));
+
+    // Messages that decompress to more than the limit are rejected.
+    message_compressor_t big_compressor;
+    std::string contents(100000, 'x');
+    write_message_t message;
+    message.append(contents.data(), contents.size());
+    write_message_t compressed;
+    big_compressor.compress('T', &message, &compressed);
+    vector_stream_t stream;
+    ASSERT_EQ(0, send_write_message(&stream, &compressed));
+    {
+        message_decompressor_t limited_decompressor;
+        decompressed.clear();
+        EXPECT_FALSE(limited_decompressor.decompress(stream.vector().data(),
+                                                     stream.vector().size(),
+                                                     contents.size(),
+                                                     &decompressed));
+    }
+    {
+        message_decompressor_t exact_decompressor;
+        decompressed.clear();
+        EXPECT_TRUE(exact_decompressor.decompress(stream.vector().data(),
+                                                  stream.vector().size(),
+                                                  contents.size() + 1,
+                                                  &decompressed));
+        EXPECT_EQ(contents.size() + 1, decompressed.size());
+    }
+}
+
 /* `PeerIDSemantics` makes sure that `peer_id_t::is_nil()` works as expected. */
 TPTEST_MULTITHREAD(RPCConnectivityTest, PeerIDSemantics, 3) {
     peer_id_t nil_peer;
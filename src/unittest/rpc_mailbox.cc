@@ -54,6 +54,9 @@ private:
     read_impl_t reader;
 public:
     friend void send(mailbox_manager_t *, raw_mailbox_t::address_t, int);
+    friend void send_each(mailbox_manager_t *,
+                          const std::vector<raw_mailbox_t::address_t> &,
+                          const std::vector<int> &);
 
     explicit dummy_mailbox_t(mailbox_manager_t *m) :
         reader(this), mailbox(m, &reader)
@@ -69,6 +72,17 @@ void send(mailbox_manager_t *c, raw_mailbox_t::address_t dest, int message) {
     send_write(c, dest, &writer);
 }
 
+void send_each(mailbox_manager_t *c,
+               const std::vector<raw_mailbox_t::address_t> &dests,
+               const std::vector<int> &messages) {
+    std::vector<dummy_mailbox_t::write_impl_t> writers(messages.begin(), messages.end());
+    std::vector<mailbox_write_callback_t *> writer_ptrs;
+    for (auto &writer : writers) {
+        writer_ptrs.push_back(&writer);
+    }
+    send_write_multi(c, dests, writer_ptrs);
+}
+
 }   /* anonymous namespace */
 
 /* `MailboxStartStop` creates and destroys some mailboxes. */
@@ -109,6 +123,47 @@ TPTEST_MULTITHREAD(RPCMailboxTest, MailboxMessage, 3) {
     mbox.expect(7);
 }
 
+/* `MailboxMulticast` sends messages to several mailboxes at once, some of them on the
+same peer. */
+TPTEST_MULTITHREAD(RPCMailboxTest, MailboxMulticast, 3) {
+    connectivity_cluster_t c1, c2;
+    mailbox_manager_t m1(&c1, 'M'), m2(&c2, 'M');
+    test_cluster_run_t r1(&c1);
+    test_cluster_run_t r2(&c2);
+    r1.join(get_cluster_local_address(&c2), 0);
+    let_stuff_happen();
+
+    dummy_mailbox_t mbox1(&m1), mbox2(&m2), mbox3(&m2);
+    send_each(&m1,
+              {mbox1.mailbox.get_address(),
+               mbox2.mailbox.get_address(),
+               mbox3.mailbox.get_address(),
+               mbox2.mailbox.get_address()},
+              {1, 2, 3, 4});
+
+    let_stuff_happen();
+
+    mbox1.expect(1);
+    mbox2.expect(2);
+    mbox3.expect(3);
+    mbox2.expect(4);
+
+    // More messages than `send_write_multi()` sends at once.
+    std::vector<raw_mailbox_t::address_t> dests;
+    std::vector<int> messages;
+    for (int i = 100; i < 200; ++i) {
+        dests.push_back((i % 2 == 0 ? mbox2 : mbox3).mailbox.get_address());
+        messages.push_back(i);
+    }
+    send_each(&m1, dests, messages);
+
+    let_stuff_happen();
+
+    for (int i = 100; i < 200; ++i) {
+        (i % 2 == 0 ? mbox2 : mbox3).expect(i);
+    }
+}
+
 /* `DeadMailbox` sends a message to a defunct mailbox. The expected behavior is
 for the message to be silently ignored. */
 TPTEST_MULTITHREAD(RPCMailboxTest, DeadMailbox, 3) {
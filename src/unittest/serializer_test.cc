@@ -1,6 +1,11 @@
+#include <algorithm>
 #include <functional>
+#include <map>
+#include <string>
+#include <vector>
 
 #include "arch/runtime/starter.hpp"
+#include "arch/timing.hpp"
 #include "concurrency/new_mutex.hpp"
 #include "serializer/buf_ptr.hpp"
 #include "serializer/log/log_serializer.hpp"
@@ -90,5 +95,326 @@ TEST(SerializerTest, AddDeleteRepeatedlyWithIndex) {
     run_in_thread_pool(std::bind(run_AddDeleteRepeatedly, true), 4);
 }
 
+void run_BlockChecksums(bool checksum_blocks) {
+    mock_file_opener_t file_opener;
+    log_serializer_t::create(&file_opener, log_serializer_t::static_config_t());
+    log_serializer_t::dynamic_config_t dynamic_config;
+    dynamic_config.checksum_blocks = checksum_blocks;
+    log_serializer_t ser(dynamic_config,
+                         &file_opener,
+                         &get_global_perfmon_collection());
+
+    buf_ptr_t buf = buf_ptr_t::alloc_zeroed(ser.max_block_size());
+    memset(buf.cache_data(), 'x', buf.block_size().value());
+
+    scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+
+    const block_id_t block_id = 7;
+    std::vector<buf_write_info_t> infos;
+    infos.push_back(buf_write_info_t(buf.ser_buffer(), buf.block_size(), block_id));
+
+    struct : public iocallback_t, public cond_t {
+        void on_io_complete() {
+            pulse();
+        }
+    } cb;
+
+    std::vector<counted_t<block_token_t> > tokens
+        = ser.block_writes(infos.data(), infos.size(), account.get(), &cb);
+    cb.wait();
+    ASSERT_EQ(1u, tokens.size());
+    if (checksum_blocks) {
+        EXPECT_NE(0u, tokens[0]->checksum());
+    } else {
+        EXPECT_EQ(0u, tokens[0]->checksum());
+    }
+
+    {
+        std::vector<index_write_op_t> write_ops;
+        write_ops.push_back(index_write_op_t(block_id, make_optional(tokens[0]),
+            make_optional(repli_timestamp_t::distant_past)));
+        new_mutex_in_line_t dummy_acq;
+        ser.index_write(&dummy_acq, []{ }, write_ops);
+    }
+
+    // The checksum must survive the trip through the index.
+    counted_t<block_token_t> token = ser.index_read(block_id);
+    ASSERT_TRUE(token.has());
+    EXPECT_EQ(tokens[0]->checksum(), token->checksum());
+
+    // Index writes that only change the recency must keep the checksum.
+    {
+        std::vector<index_write_op_t> write_ops;
+        write_ops.push_back(index_write_op_t(block_id, r_nullopt,
+            make_optional(repli_timestamp_t::distant_past.next())));
+        new_mutex_in_line_t dummy_acq;
+        ser.index_write(&dummy_acq, []{ }, write_ops);
+    }
+    EXPECT_EQ(tokens[0]->checksum(), ser.index_read(block_id)->checksum());
+
+    buf_ptr_t read_buf = ser.block_read(token, account.get());
+    EXPECT_EQ(0, memcmp(buf.cache_data(), read_buf.cache_data(),
+                        buf.block_size().value()));
+}
+
+TPTEST(SerializerTest, BlockChecksums, 4) {
+    run_BlockChecksums(true);
+}
+
+TPTEST(SerializerTest, NoBlockChecksums, 4) {
+    run_BlockChecksums(false);
+}
+
+void run_BlockCompression(block_compression_t compression) {
+    mock_file_opener_t file_opener;
+    log_serializer_t::create(&file_opener, log_serializer_t::static_config_t());
+    log_serializer_t::dynamic_config_t dynamic_config;
+    dynamic_config.compression = compression;
+    log_serializer_t ser(dynamic_config,
+                         &file_opener,
+                         &get_global_perfmon_collection());
+
+    // One block that compresses very well, and one that doesn't compress at all.
+    buf_ptr_t compressible = buf_ptr_t::alloc_zeroed(ser.max_block_size());
+    memset(compressible.cache_data(), 'x', compressible.block_size().value());
+    buf_ptr_t incompressible = buf_ptr_t::alloc_zeroed(ser.max_block_size());
+    uint32_t state = 12345;
+    for (uint32_t i = 0; i < incompressible.block_size().value(); ++i) {
+        state = state * 1103515245 + 12345;
+        static_cast<char *>(incompressible.cache_data())[i] =
+            static_cast<char>(state >> 16);
+    }
+
+    scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+
+    std::vector<buf_write_info_t> infos;
+    infos.push_back(buf_write_info_t(compressible.ser_buffer(),
+                                     compressible.block_size(), 1));
+    infos.push_back(buf_write_info_t(incompressible.ser_buffer(),
+                                     incompressible.block_size(), 2));
+
+    struct : public iocallback_t, public cond_t {
+        void on_io_complete() {
+            pulse();
+        }
+    } cb;
+
+    std::vector<counted_t<block_token_t> > tokens
+        = ser.block_writes(infos.data(), infos.size(), account.get(), &cb);
+    cb.wait();
+    ASSERT_EQ(2u, tokens.size());
+
+    // The tokens always report the uncompressed size to the cache.
+    EXPECT_EQ(compressible.block_size(), tokens[0]->block_size());
+    EXPECT_EQ(incompressible.block_size(), tokens[1]->block_size());
+    if (compression == block_compression_t::none) {
+        EXPECT_EQ(compressible.block_size(), tokens[0]->stored_block_size());
+    } else {
+        EXPECT_LT(tokens[0]->stored_block_size().ser_value(),
+                  compressible.block_size().ser_value());
+    }
+    EXPECT_EQ(incompressible.block_size(), tokens[1]->stored_block_size());
+
+    {
+        std::vector<index_write_op_t> write_ops;
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            write_ops.push_back(index_write_op_t(infos[i].block_id,
+                make_optional(tokens[i]),
+                make_optional(repli_timestamp_t::distant_past)));
+        }
+        new_mutex_in_line_t dummy_acq;
+        ser.index_write(&dummy_acq, []{ }, write_ops);
+    }
+
+    const buf_ptr_t *originals[2] = { &compressible, &incompressible };
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        // Both sizes must survive the trip through the index.
+        counted_t<block_token_t> token = ser.index_read(infos[i].block_id);
+        ASSERT_TRUE(token.has());
+        EXPECT_EQ(tokens[i]->block_size(), token->block_size());
+        EXPECT_EQ(tokens[i]->stored_block_size(), token->stored_block_size());
+
+        buf_ptr_t read_buf = ser.block_read(token, account.get());
+        ASSERT_EQ(originals[i]->block_size(), read_buf.block_size());
+        EXPECT_EQ(infos[i].block_id, read_buf.ser_buffer()->ser_header.block_id);
+        EXPECT_EQ(0, memcmp(originals[i]->cache_data(), read_buf.cache_data(),
+                            originals[i]->block_size().value()));
+    }
+}
+
+TPTEST(SerializerTest, BlockCompression, 4) {
+    run_BlockCompression(block_compression_t::zlib);
+}
+
+TPTEST(SerializerTest, NoBlockCompression, 4) {
+    run_BlockCompression(block_compression_t::none);
+}
+
+// Writes a block filled with `fill` for each of `block_ids` and points the index at
+// them.  Returns the blocks' offsets.
+std::vector<int64_t> write_blocks(log_serializer_t *ser, file_account_t *account,
+                                  const std::vector<block_id_t> &block_ids,
+                                  char fill) {
+    buf_ptr_t buf = buf_ptr_t::alloc_zeroed(ser->max_block_size());
+    memset(buf.cache_data(), fill, buf.block_size().value());
+    std::vector<buf_write_info_t> infos;
+    for (block_id_t block_id : block_ids) {
+        infos.push_back(buf_write_info_t(buf.ser_buffer(), buf.block_size(), block_id));
+    }
+
+    struct : public iocallback_t, public cond_t {
+        void on_io_complete() {
+            pulse();
+        }
+    } cb;
+
+    std::vector<counted_t<block_token_t> > tokens
+        = ser->block_writes(infos.data(), infos.size(), account, &cb);
+    cb.wait();
+
+    std::vector<int64_t> offsets;
+    std::vector<index_write_op_t> write_ops;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        offsets.push_back(tokens[i]->offset());
+        // Aux blocks don't have a recency.
+        write_ops.push_back(index_write_op_t(block_ids[i], make_optional(tokens[i]),
+            is_aux_block_id(block_ids[i])
+                ? optional<repli_timestamp_t>()
+                : make_optional(repli_timestamp_t::distant_past)));
+    }
+    new_mutex_in_line_t dummy_acq;
+    ser->index_write(&dummy_acq, []{ }, write_ops);
+    return offsets;
+}
+
+TPTEST(SerializerTest, ReloadIndex, 4) {
+    mock_file_opener_t file_opener;
+    log_serializer_t::create(&file_opener, log_serializer_t::static_config_t());
+
+    // Enough blocks that the LBA doesn't fit into the metablock, in every shard.
+    std::vector<block_id_t> block_ids;
+    for (block_id_t i = 0; i < 2000; ++i) {
+        block_ids.push_back(i);
+    }
+    for (block_id_t i = 0; i < 300; ++i) {
+        block_ids.push_back(FIRST_AUX_BLOCK_ID + i);
+    }
+
+    std::map<block_id_t, int64_t> expected_offsets;
+    {
+        log_serializer_t ser(log_serializer_t::dynamic_config_t(),
+                             &file_opener,
+                             &get_global_perfmon_collection());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+
+        // Every block gets written a few times, so that the reloaded index must apply
+        // the LBA entries in the right order.
+        const size_t batch_size = 100;
+        for (int round = 0; round < 3; ++round) {
+            for (size_t i = 0; i < block_ids.size(); i += batch_size) {
+                std::vector<block_id_t> batch(
+                    block_ids.begin() + i,
+                    block_ids.begin() + std::min(i + batch_size, block_ids.size()));
+                std::vector<int64_t> offsets
+                    = write_blocks(&ser, account.get(), batch, 0);
+                for (size_t j = 0; j < batch.size(); ++j) {
+                    expected_offsets[batch[j]] = offsets[j];
+                }
+            }
+        }
+
+        // Delete some of the blocks.
+        std::vector<index_write_op_t> write_ops;
+        for (block_id_t block_id : block_ids) {
+            if (block_id % 7 == 3) {
+                write_ops.push_back(index_write_op_t(block_id,
+                    make_optional(counted_t<block_token_t>())));
+                expected_offsets.erase(block_id);
+            }
+        }
+        new_mutex_in_line_t dummy_acq;
+        ser.index_write(&dummy_acq, []{ }, write_ops);
+    }
+
+    log_serializer_t ser(log_serializer_t::dynamic_config_t(),
+                         &file_opener,
+                         &get_global_perfmon_collection());
+    EXPECT_EQ(2000u, ser.end_block_id());
+    EXPECT_EQ(FIRST_AUX_BLOCK_ID + 300, ser.end_aux_block_id());
+    for (block_id_t block_id : block_ids) {
+        SCOPED_TRACE(block_id);
+        counted_t<block_token_t> token = ser.index_read(block_id);
+        auto it = expected_offsets.find(block_id);
+        if (it == expected_offsets.end()) {
+            EXPECT_FALSE(token.has());
+        } else {
+            ASSERT_TRUE(token.has());
+            EXPECT_EQ(it->second, token->offset());
+        }
+    }
+}
+
+void run_GcPolicy(gc_policy_t gc_policy) {
+    mock_file_opener_t file_opener;
+    log_serializer_t::create(&file_opener, log_serializer_t::static_config_t());
+    log_serializer_t::dynamic_config_t dynamic_config;
+    dynamic_config.gc_policy = gc_policy;
+
+    // Every round rewrites a few hot blocks and writes a few cold blocks that never
+    // change again, so that the GC has to move the cold blocks out of extents that
+    // are mostly garbage.
+    const block_id_t num_hot_blocks = 16;
+    const block_id_t num_cold_blocks_per_round = 8;
+    const int num_rounds = 300;
+
+    std::map<block_id_t, char> expected_fills;
+    {
+        log_serializer_t ser(dynamic_config,
+                             &file_opener,
+                             &get_global_perfmon_collection());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+        for (int round = 0; round < num_rounds; ++round) {
+            std::vector<block_id_t> block_ids;
+            for (block_id_t i = 0; i < num_hot_blocks; ++i) {
+                block_ids.push_back(i);
+            }
+            for (block_id_t i = 0; i < num_cold_blocks_per_round; ++i) {
+                block_ids.push_back(
+                    num_hot_blocks + round * num_cold_blocks_per_round + i);
+            }
+            const char fill = 'a' + round % 26;
+            write_blocks(&ser, account.get(), block_ids, fill);
+            for (block_id_t block_id : block_ids) {
+                expected_fills[block_id] = fill;
+            }
+            // Give the extents time to get old enough for the GC.
+            nap(1);
+        }
+    }
+
+    // The blocks must survive both the GC and a restart.
+    log_serializer_t ser(dynamic_config,
+                         &file_opener,
+                         &get_global_perfmon_collection());
+    scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+    for (const auto &pair : expected_fills) {
+        SCOPED_TRACE(pair.first);
+        counted_t<block_token_t> token = ser.index_read(pair.first);
+        ASSERT_TRUE(token.has());
+        buf_ptr_t buf = ser.block_read(token, account.get());
+        EXPECT_EQ(pair.first, buf.ser_buffer()->ser_header.block_id);
+        const char *data = static_cast<const char *>(buf.cache_data());
+        EXPECT_EQ(std::string(buf.block_size().value(), pair.second),
+                  std::string(data, buf.block_size().value()));
+    }
+}
+
+TPTEST(SerializerTest, GreedyGc, 4) {
+    run_GcPolicy(gc_policy_t::greedy);
+}
+
+TPTEST(SerializerTest, CostBenefitGc, 4) {
+    run_GcPolicy(gc_policy_t::cost_benefit);
+}
 
 }  // namespace unittest
@@ -0,0 +1,77 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "arch/io/disk/uring.hpp"
+
+#if USE_IO_URING
+
+#include <fcntl.h>
+
+#include <string>
+
+#include "arch/io/io_utils.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/wait_any.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+/* Fails the first `failures` submissions with `EAGAIN`, like a kernel that is
+temporarily out of resources. */
+class eagain_io_uring_t : public linux_io_uring_t {
+public:
+    explicit eagain_io_uring_t(int _failures) : failures(_failures) { }
+
+    int submit() {
+        if (failures > 0) {
+            --failures;
+            return -EAGAIN;
+        }
+        return linux_io_uring_t::submit();
+    }
+
+    int failures;
+};
+
+TPTEST(UringDiskmgrTest, RetryAfterEagainWhenIdle) {
+    eagain_io_uring_t *ring = new eagain_io_uring_t(3);
+    scoped_ptr_t<linux_io_uring_t> ring_ptr(ring);
+    if (ring->init(16) != 0) {
+        // The kernel doesn't support io_uring, so there's nothing to test.
+        return;
+    }
+
+    temp_file_t file;
+    scoped_fd_t fd(open(file.name().permanent_path().c_str(), O_RDWR | O_CREAT, 0644));
+    ASSERT_NE(INVALID_FD, fd.get());
+
+    unlimited_fifo_queue_t<pool_diskmgr_action_t *> source;
+    uring_diskmgr_t diskmgr(&linux_thread_pool_t::get_thread()->queue, &source, 4,
+                            std::move(ring_ptr));
+    cond_t done;
+    diskmgr.done_fun = [&](pool_diskmgr_action_t *) { done.pulse(); };
+
+    // Nothing else is in flight, so no completion will come along to retry the
+    // submission for us.
+    const std::string data(4096, 'x');
+    pool_diskmgr_action_t action;
+    action.make_write(fd.get(), data.data(), data.size(), 0, false);
+    source.push(&action);
+
+    signal_timer_t timeout(10000);
+    wait_any_t waiter(&done, &timeout);
+    waiter.wait_lazily_unordered();
+    ASSERT_TRUE(done.is_pulsed());
+    EXPECT_TRUE(action.get_succeeded());
+    EXPECT_EQ(0, ring->failures);
+
+    std::string read_back(data.size(), '\0');
+    ASSERT_EQ(static_cast<ssize_t>(data.size()),
+              pread(fd.get(), &read_back[0], read_back.size(), 0));
+    EXPECT_EQ(data, read_back);
+}
+
+}  // namespace unittest
+
+#endif  // USE_IO_URING
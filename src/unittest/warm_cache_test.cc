@@ -0,0 +1,67 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "buffer_cache/warm_cache.hpp"
+#include "paths.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+void overwrite_file(const std::string &path, const std::string &contents) {
+    FILE *file = fopen(path.c_str(), "wb");
+    ASSERT_TRUE(file != nullptr);
+    ASSERT_EQ(contents.size(), fwrite(contents.data(), 1, contents.size(), file));
+    ASSERT_EQ(0, fclose(file));
+}
+
+TPTEST(WarmCacheTest, RoundTrip) {
+    temp_file_t file;
+    const std::string path = file.name().permanent_path();
+
+    std::vector<block_id_t> block_ids = { 17, 3, 0, FIRST_AUX_BLOCK_ID + 5 };
+    ASSERT_TRUE(blocking_write_warm_cache_list(path, block_ids));
+    EXPECT_EQ(block_ids, blocking_read_warm_cache_list(path));
+
+    // Writing a list replaces the old one.
+    block_ids.resize(1);
+    ASSERT_TRUE(blocking_write_warm_cache_list(path, block_ids));
+    EXPECT_EQ(block_ids, blocking_read_warm_cache_list(path));
+
+    block_ids.clear();
+    ASSERT_TRUE(blocking_write_warm_cache_list(path, block_ids));
+    EXPECT_EQ(block_ids, blocking_read_warm_cache_list(path));
+}
+
+TPTEST(WarmCacheTest, MissingList) {
+    temp_file_t file;
+    // `temp_file_t` creates an empty file.
+    EXPECT_TRUE(blocking_read_warm_cache_list(file.name().permanent_path()).empty());
+    EXPECT_TRUE(blocking_read_warm_cache_list(
+        file.name().permanent_path() + ".missing").empty());
+}
+
+TPTEST(WarmCacheTest, DamagedList) {
+    temp_file_t file;
+    const std::string path = file.name().permanent_path();
+    ASSERT_TRUE(blocking_write_warm_cache_list(path, { 1, 2, 3, 4, 5 }));
+    const std::string contents = blocking_read_file(path.c_str());
+
+    for (size_t i = 0; i < contents.size(); i += 7) {
+        SCOPED_TRACE(i);
+        std::string damaged = contents;
+        damaged[i] ^= 0x10;
+        overwrite_file(path, damaged);
+        EXPECT_TRUE(blocking_read_warm_cache_list(path).empty());
+    }
+
+    overwrite_file(path, contents.substr(0, contents.size() - 1));
+    EXPECT_TRUE(blocking_read_warm_cache_list(path).empty());
+    overwrite_file(path, contents + "x");
+    EXPECT_TRUE(blocking_read_warm_cache_list(path).empty());
+}
+
+}  // namespace unittest